@@ -36,29 +36,40 @@ FREECLOTH_NAMESPACE_START
  *
  * Defines instants and durations, and methods for retrieving the current time
  * and measuring durations.
+ *
+ * Times are counted in 64-bit ticks of 1/705600000 of a second, sometimes
+ * called flicks. Every common frame rate, and small multiples of it,
+ * divides a second into a whole number of ticks: 1/150 s, for instance, is
+ * exactly 4704000 ticks. This lets simulation times and timesteps be
+ * exact, and the ticks are also finer than a nanosecond, for wall clock
+ * timing. A signed 64-bit count of ticks covers several centuries.
  */
 class BaTime
 {
 public:
     //----- types and enumerations -----
     //! A period of time.
-    typedef Int32  Duration;
+    typedef Int64  Duration;
     //! A single point in time.
-    typedef UInt32  Instant;
+    typedef UInt64  Instant;
 
     enum {
-        MS = 1,
-        S = 1000,
-        MIN = S * 60
+        //! Ticks per second.
+        S = 705600000,
+        MS = S / 1000
     };
 
     // ----- static member functions -----
 
-    //! Retrieve the current time.
+    //! Retrieve the current time, from a monotonic clock with an arbitrary
+    //! origin.
     static Instant getTime();
 
     //! Calculate the elapsed time between two instants.
     static Duration getDuration( Instant start, Instant end );
+    //! The exact duration of num / denom seconds, rounded down to a whole
+    //! tick if it isn't one.
+    static Duration fraction( UInt32 num, UInt32 denom );
 
     //! Return a floating point value representing the given instant as a
     //! number, measured in seconds.
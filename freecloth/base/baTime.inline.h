@@ -20,6 +20,8 @@
 #define freecloth_base_baTime_inline_h
 
 #include <freecloth/base/baMath.h>
+#include <freecloth/base/debug.h>
+#include <freecloth/base/math.h>
 
 FREECLOTH_NAMESPACE_START
 
@@ -29,30 +31,38 @@ FREECLOTH_NAMESPACE_START
 
 //------------------------------------------------------------------------------
 
+inline BaTime::Duration BaTime::fraction( UInt32 num, UInt32 denom )
+{
+    return Duration( num ) * S / denom;
+}
+
+//------------------------------------------------------------------------------
+
 inline Float BaTime::instantAsSeconds( Instant instant )
 {
-    return instant / Float( S );
+    return Float( Double( instant ) / S );
 }
 
 //------------------------------------------------------------------------------
 
 inline Float BaTime::durationAsSeconds( Duration duration )
 {
-    return duration / Float( S );
+    return Float( Double( duration ) / S );
 }
 
 //------------------------------------------------------------------------------
 
 inline BaTime::Instant BaTime::floatAsInstant( Float t )
 {
-    return BaMath::roundUInt32( t * Float( S ) );
+    DGFX_ASSERT( t >= 0 );
+    return Instant( Double( t ) * S + .5 );
 }
 
 //------------------------------------------------------------------------------
 
 inline BaTime::Duration BaTime::floatAsDuration( Float t )
 {
-    return BaMath::roundInt32( t * Float( S ) );
+    return Duration( ::floor( Double( t ) * S + .5 ) );
 }
 
 FREECLOTH_NAMESPACE_END
@@ -20,6 +20,7 @@
 #include <freecloth/base/debug.h>
 
 #include <sys/time.h>
+#include <time.h>
 
 FREECLOTH_NAMESPACE_START
 
@@ -30,9 +31,16 @@ FREECLOTH_NAMESPACE_START
 
 BaTime::Instant BaTime::getTime()
 {
+    // A nanosecond is 0.7056 ticks, or 882 / 1250.
+#ifdef CLOCK_MONOTONIC
+    ::timespec ts;
+    if ( ::clock_gettime( CLOCK_MONOTONIC, &ts ) == 0 ) {
+        return Instant( ts.tv_sec ) * S + Instant( ts.tv_nsec ) * 882 / 1250;
+    }
+#endif
     ::timeval tv;
     ::gettimeofday( &tv, 0 );
-    return tv.tv_sec * S + tv.tv_usec * MS / 1000;
+    return Instant( tv.tv_sec ) * S + Instant( tv.tv_usec ) * MS / 1000;
 }
 
 //------------------------------------------------------------------------------
@@ -40,7 +48,7 @@ BaTime::Instant BaTime::getTime()
 BaTime::Duration BaTime::getDuration( Instant start, Instant end )
 {
     DGFX_ASSERT( end >= start );
-    return end - start;
+    return Duration( end - start );
 }
 
 FREECLOTH_NAMESPACE_END
@@ -29,7 +29,17 @@ FREECLOTH_NAMESPACE_START
 
 BaTime::Instant BaTime::getTime()
 {
-    return ::timeGetTime();
+    static Instant frequency = 0;
+    LARGE_INTEGER count;
+    if ( frequency == 0 ) {
+        LARGE_INTEGER f;
+        ::QueryPerformanceFrequency( &f );
+        frequency = f.QuadPart;
+    }
+    ::QueryPerformanceCounter( &count );
+    // Split the conversion so that the product can't overflow.
+    const Instant c = count.QuadPart;
+    return c / frequency * S + c % frequency * S / frequency;
 }
 
 //------------------------------------------------------------------------------
@@ -37,7 +47,7 @@ BaTime::Instant BaTime::getTime()
 BaTime::Duration BaTime::getDuration( Instant start, Instant end )
 {
     DGFX_ASSERT( end >= start );
-    return end - start;
+    return Duration( end - start );
 }
 
 FREECLOTH_NAMESPACE_END
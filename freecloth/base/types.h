@@ -35,8 +35,28 @@ typedef unsigned short  UInt16;
 typedef signed short    Int16;
 typedef unsigned char   UInt8;
 typedef signed char     Int8;
+#if COMPILER_MSVC
+typedef unsigned __int64 UInt64;
+typedef signed __int64  Int64;
+#else
+typedef unsigned long long UInt64;
+typedef signed long long Int64;
+#endif
+
+// Scalar type for storage throughout the library. Define
+// FREECLOTH_DOUBLE_PRECISION to 1 for an all-double build; builds of either
+// precision can coexist in separate build directories.
+#ifndef FREECLOTH_DOUBLE_PRECISION
+#define FREECLOTH_DOUBLE_PRECISION 0
+#endif
 
+#if FREECLOTH_DOUBLE_PRECISION
+typedef double          Float;
+#else
 typedef float           Float;
+#endif
+//! Scalar type for accumulating long sums, whatever the storage precision.
+typedef double          Double;
 typedef std::string     String;
 
 FREECLOTH_NAMESPACE_END
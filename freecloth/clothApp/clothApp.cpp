@@ -20,6 +20,7 @@
 #include <freecloth/clothApp/clothAppConfig.h>
 #include <freecloth/simulator/simStepStrategyBasic.h>
 #include <freecloth/simulator/simStepStrategyAdaptive.h>
+#include <freecloth/simulator/simStepStrategyPI.h>
 #include <freecloth/colour/colColourRGB.h>
 #include <freecloth/geom/geMatrix4.h>
 #include <freecloth/geom/geMesh.h>
@@ -41,6 +42,7 @@ namespace {
     const Float DEFAULT_H = .01f;
     const Float DEFAULT_RHO = .1f;
     const Float DEFAULT_PCG_TOLERANCE = 1e-2f;
+    const Float DEFAULT_THICKNESS = .005f;
 }
 
 //------------------------------------------------------------------------------
@@ -63,9 +65,14 @@ public:
     Float _rho;
     Float _pcgTolerance;
     bool _adaptive;
+    bool _piControl;
+    bool _speculative;
     UInt32 _frameRate;
     Float _stretchLimit;
     ClothApp::ConstraintType _constraint;
+    ClothApp::ObstacleType _obstacle;
+    Float _thickness;
+    Float _selfThickness;
     bool _batchFlag;
     BaTime::Instant _batchEnd;
     bool _crop;
@@ -91,9 +98,14 @@ ClothAppArgs::ClothAppArgs( int argc, const char** argv )
     _rho( DEFAULT_RHO ),
     _pcgTolerance( DEFAULT_PCG_TOLERANCE ),
     _adaptive( true ),
+    _piControl( false ),
+    _speculative( false ),
     _frameRate( 25 ),
     _stretchLimit( 0.01f ),
-    _constraint( ClothApp::CON_CORNERS3b ),
+    _constraint( SimScene::CON_CORNERS3b ),
+    _obstacle( SimScene::OBS_NONE ),
+    _thickness( DEFAULT_THICKNESS ),
+    _selfThickness( 0 ),
     _batchFlag( false ),
     _crop( false )
 {
@@ -124,11 +136,20 @@ void ClothAppArgs::printSyntax()
         << "    -density x         Density, in kg/m^2" << std::endl
         << "    -tolerance x       Tolerance of PCG algorithm" << std::endl
         << "    -noAdaptive        Disable adaptive timestepping" << std::endl
+        << "    -piControl         Adapt timesteps by PI control" << std::endl
+        << "    -speculate         Try several timesteps at once" << std::endl
         << "    -timestep x        Timestep (nonadaptive only)" << std::endl
         << "    -stretchLimit x    Stretch limit" << std::endl
         << "    -frameRate x       Framerate for adaptive stepping" << std::endl
         << "    -constraint [none|centre|corners{4,3a,3b,1c,1d}|yank|table_square|" << std::endl
         << "        table_circle]  Constraint type" << std::endl
+        << "    -obstacle [none|floor|sphere|capsule|box]" << std::endl
+        << "                       Obstacle below the cloth" << std::endl
+        << "    -thickness x       Distance kept from obstacles" << std::endl
+        << "    -selfCollision x   Distance kept between parts of the cloth,"
+        << std::endl
+        << "                       or 0 to let it pass through itself"
+        << std::endl
         << "    -batch t           Run and record movie, exiting when time t is reached" << std::endl
         ;
 }
@@ -217,6 +238,12 @@ void ClothAppArgs::parseArgs( InputIterator first, InputIterator last )
         else if ( std::string( "-noAdaptive" ) == *i ) {
             _adaptive = false;
         }
+        else if ( std::string( "-piControl" ) == *i ) {
+            _piControl = true;
+        }
+        else if ( std::string( "-speculate" ) == *i ) {
+            _speculative = true;
+        }
         else if ( std::string( "-timestep" ) == *i ) {
             ++i; if ( i == last ) { _error = true; break; }
             _h = BaStringUtil::toFloat( *i );
@@ -231,7 +258,7 @@ void ClothAppArgs::parseArgs( InputIterator first, InputIterator last )
         }
         else if ( std::string( "-constraint" ) == *i ) {
             ++i; if ( i == last ) { _error = true; break; }
-            const String names[ ClothApp::NB_CONSTRAINTS ] = {
+            const String names[ SimScene::NB_CONSTRAINTS ] = {
                 "none",
 
                 "centre",
@@ -246,13 +273,40 @@ void ClothAppArgs::parseArgs( InputIterator first, InputIterator last )
             };
             String name = BaStringUtil::toLower( *i );
             _error = true;
-            for ( Int32 i = 0; i < ClothApp::NB_CONSTRAINTS; ++i ) {
+            for ( Int32 i = 0; i < SimScene::NB_CONSTRAINTS; ++i ) {
                 if ( name == names[ i ] ) {
                     _constraint = static_cast<ClothApp::ConstraintType>( i );
                     _error = false;
                 }
             }
         }
+        else if ( std::string( "-obstacle" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            const String names[ SimScene::NB_OBSTACLES ] = {
+                "none",
+
+                "floor",
+                "sphere",
+                "capsule",
+                "box"
+            };
+            String name = BaStringUtil::toLower( *i );
+            _error = true;
+            for ( Int32 i = 0; i < SimScene::NB_OBSTACLES; ++i ) {
+                if ( name == names[ i ] ) {
+                    _obstacle = static_cast<ClothApp::ObstacleType>( i );
+                    _error = false;
+                }
+            }
+        }
+        else if ( std::string( "-thickness" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _thickness = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-selfCollision" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _selfThickness = BaStringUtil::toFloat( *i );
+        }
         else if ( std::string( "-batch" ) == *i ) {
             ++i; if ( i == last ) { _error = true; break; }
             _batchFlag = true;
@@ -383,7 +437,11 @@ ClothApp::ClothApp( const ClothAppArgs& args )
     _pcgTolerance( args._pcgTolerance ),
     _frameRate( args._frameRate ),
     _stretchLimit( args._stretchLimit ),
+    _speculative( args._speculative ),
     _constraints( args._constraint ),
+    _obstacles( args._obstacle ),
+    _thickness( args._thickness ),
+    _selfThickness( args._selfThickness ),
     _batchFlag( args._batchFlag ),
     _batchEnd( args._batchEnd ),
     _quitFlag( false ),
@@ -403,9 +461,11 @@ ClothApp::ClothApp( const ClothAppArgs& args )
     setupMesh();
 
     loadSettings( args._settings );
-    _glWindow->setRadioGroup(
-        ID_STEP_STRATEGY, args._adaptive ? STEP_ADAPTIVE : STEP_BASIC
-    );
+    StepStrategy strategy = STEP_BASIC;
+    if ( args._adaptive ) {
+        strategy = args._piControl ? STEP_PI : STEP_ADAPTIVE;
+    }
+    _glWindow->setRadioGroup( ID_STEP_STRATEGY, strategy );
 
     // Read textures
     RCShdPtr<GfxImage> texImage;
@@ -507,7 +567,9 @@ void ClothApp::runApp()
 
 void ClothApp::setupMesh()
 {
-    _initialMesh = createRectMesh( _clothSize, _nbPatches, _nbPatches );
+    _initialMesh = SimScene::createRectMesh(
+        _clothSize, _nbPatches, _nbPatches
+    );
     DGFX_TRACE( ! _initialMesh.isNull() );
     // Centre mesh
     _meshPos = GePoint( _clothSize/-2.f, _clothSize/-2.f, 0 );
@@ -546,6 +608,8 @@ void ClothApp::setupSimulator()
     _simulator->setPCGTolerance( _pcgTolerance );
     _simulator->setStretchLimit( _stretchLimit );
     setConstraints();
+    setObstacles();
+    _simulator->setSelfCollisionThickness( _selfThickness );
     _nextMovieFrame = 0;
 
     setupStepper();
@@ -565,8 +629,17 @@ void ClothApp::setupStepper()
             _glWindow->disable( ID_STEP_STRETCH_LIMIT );
         } break;
         case STEP_ADAPTIVE: {
+            SimStepStrategyAdaptive* stepper =
+                new SimStepStrategyAdaptive( _simulator, _frameRate );
+            stepper->setSpeculative( _speculative );
+            _stepper = RCShdPtr<SimStepStrategy>( stepper );
+            _glWindow->disable( ID_STEP_TIMESTEP );
+            _glWindow->enable( ID_STEP_FRAME_RATE );
+            _glWindow->enable( ID_STEP_STRETCH_LIMIT );
+        } break;
+        case STEP_PI: {
             _stepper = RCShdPtr<SimStepStrategy>(
-                new SimStepStrategyAdaptive( _simulator, _frameRate )
+                new SimStepStrategyPI( _simulator, _frameRate )
             );
             _glWindow->disable( ID_STEP_TIMESTEP );
             _glWindow->enable( ID_STEP_FRAME_RATE );
@@ -579,69 +652,16 @@ void ClothApp::setupStepper()
 
 void ClothApp::setConstraints()
 {
-    const UInt32 N = _nbPatches;
-    _simulator->removeAllConstraints();
-    switch ( _constraints ) {
-        case CON_NONE: {
-        } break;
-
-        case CON_CENTRE: {
-            _simulator->setPosConstraintFull( (N+1)*(N/2) + N/2 );
-        } break;
-
-        case CON_CORNERS4: {
-            _simulator->setPosConstraintFull( 0 );
-            _simulator->setPosConstraintFull( N );
-            _simulator->setPosConstraintFull( N*(N+1) );
-            _simulator->setPosConstraintFull( (N+1)*(N+1)-1 );
-        } break;
-
-        case CON_CORNERS3a: {
-            _simulator->setPosConstraintFull( N );
-            _simulator->setPosConstraintFull( N*(N+1) );
-            _simulator->setPosConstraintFull( (N+1)*(N+1)-1 );
-        } break;
-
-        case CON_CORNERS3b: {
-            _simulator->setPosConstraintFull( 0 );
-            _simulator->setPosConstraintFull( N*(N+1) );
-            _simulator->setPosConstraintFull( (N+1)*(N+1)-1 );
-        } break;
-
-        case CON_CORNERS1c: {
-            _simulator->setPosConstraintFull( N*(N+1) );
-        } break;
-
-        case CON_CORNERS1d: {
-            _simulator->setPosConstraintFull( (N+1)*(N+1)-1 );
-        } break;
-
-        case CON_CORNERYANK: {
-            _simulator->setPosConstraintFull( (N+1)*(N+1)-1 );
-            _simulator->setVelConstraint(
-                (N+1)*(N+1)-1, -.1f * GeVector::xAxis()
-            );
-        } break;
+    SimScene::setConstraints( *_simulator, _constraints, _nbPatches );
+}
 
-        case CON_TABLE_SQUARE: {
-            const UInt32 C = BaMath::roundUInt32( std::max( 1.f, N*5/11.f ) );
-            const UInt32 x = (N-C)/2;
-            for (UInt32 i = 0; i <= C; ++i ) for ( UInt32 j = 0; j <= C; ++j ) {
-                _simulator->setPosConstraintFull( (x + i)*(N+1) + x + j );
-            }
-        } break;
+//------------------------------------------------------------------------------
 
-        case CON_TABLE_CIRCLE: {
-            const Float r = 7/11.f;
-            for (UInt32 i = 0; i <= N; ++i ) for ( UInt32 j = 0; j <= N; ++j ) {
-                Float x = 2*i/static_cast<Float>( N ) - 1;
-                Float y = 2*j/static_cast<Float>( N ) - 1;
-                if ( x*x + y*y < r*r ) {
-                    _simulator->setPosConstraintFull( i*(N+1) + j );
-                }
-            }
-        } break;
-    }
+void ClothApp::setObstacles()
+{
+    _simulator->setCollider(
+        SimScene::createCollider( _obstacles, _clothSize, _thickness )
+    );
 }
 
 //------------------------------------------------------------------------------
@@ -662,6 +682,7 @@ void ClothApp::setupWindow( const GfxConfig& config )
         PANEL_STEP,
         PANEL_PARAMS,
         PANEL_CON,
+        PANEL_OBS,
         PANEL_SNAPS, PANEL_SNAPS2,
         PANEL_DEBUG,
         PANEL_ENERGY,
@@ -704,6 +725,7 @@ void ClothApp::setupWindow( const GfxConfig& config )
     _glWindow->addRadioGroup( ID_STEP_STRATEGY, PANEL_STEP );
     _glWindow->addRadioButton( ID_STEP_STRATEGY, "Basic" );
     _glWindow->addRadioButton( ID_STEP_STRATEGY, "Adaptive" );
+    _glWindow->addRadioButton( ID_STEP_STRATEGY, "PI control" );
     _glWindow->setRadioGroup( ID_STEP_STRATEGY, STEP_ADAPTIVE );
     _glWindow->addEditFloat( "Timestep: ", ID_STEP_TIMESTEP, PANEL_STEP );
     _glWindow->setEditFloat( ID_STEP_TIMESTEP, _h );
@@ -751,6 +773,15 @@ void ClothApp::setupWindow( const GfxConfig& config )
     _glWindow->addRadioButton( ID_CONSTRAINTS, "Circular table" );
     _glWindow->setRadioGroup( ID_CONSTRAINTS, _constraints );
 
+    _glWindow->addRollout( "Obstacles", PANEL_OBS, false );
+    _glWindow->addRadioGroup( ID_OBSTACLES, PANEL_OBS );
+    _glWindow->addRadioButton( ID_OBSTACLES, "None" );
+    _glWindow->addRadioButton( ID_OBSTACLES, "Floor" );
+    _glWindow->addRadioButton( ID_OBSTACLES, "Sphere" );
+    _glWindow->addRadioButton( ID_OBSTACLES, "Capsule" );
+    _glWindow->addRadioButton( ID_OBSTACLES, "Box" );
+    _glWindow->setRadioGroup( ID_OBSTACLES, _obstacles );
+
     _glWindow->addRollout( "Snapshots", PANEL_SNAPS, false );
     _glWindow->addButton( "Snapshot", ID_SNAPSHOT, PANEL_SNAPS );
     _glWindow->addCheckbox( "Movie", ID_MOVIE, PANEL_SNAPS );
@@ -791,7 +822,6 @@ void ClothApp::setupWindow( const GfxConfig& config )
     _glWindow->setCheckbox( ID_VERT_VEL, false );
     _glWindow->addCheckbox( "Total force", ID_VERT_FORCE, PANEL_VERT );
     _glWindow->setCheckbox( ID_VERT_FORCE, false );
-#if !defined( NDEBUG )
     _glWindow->addCheckbox( "Damping forces", ID_VERT_FORCE_DAMP, PANEL_VERT );
     _glWindow->setCheckbox( ID_VERT_FORCE_DAMP, false );
     _glWindow->addCheckbox( "Stretch force", ID_VERT_FORCE_STRETCH, PANEL_VERT);
@@ -804,7 +834,6 @@ void ClothApp::setupWindow( const GfxConfig& config )
     _glWindow->setCheckbox( ID_VERT_FORCE_GRAVITY, false );
     _glWindow->addCheckbox( "Drag force", ID_VERT_FORCE_DRAG, PANEL_VERT );
     _glWindow->setCheckbox( ID_VERT_FORCE_DRAG, false );
-#endif
 
     _glWindow->addButton( "Quit", ID_QUIT );
 
@@ -919,6 +948,12 @@ void ClothApp::uiReceived( GfxWindow&, UInt32 uid )
                 dynamic_cast<SimStepStrategyAdaptive*>( _stepper.get() )
                     ->setFrameRate( _frameRate );
             }
+            else if (
+                _glWindow->getRadioGroup( ID_STEP_STRATEGY ) == STEP_PI
+            ) {
+                dynamic_cast<SimStepStrategyPI*>( _stepper.get() )
+                    ->setFrameRate( _frameRate );
+            }
         } break;
         case ID_STEP_STRETCH_LIMIT: {
             _stretchLimit = _glWindow->getEditFloat( uid );
@@ -1019,6 +1054,15 @@ void ClothApp::uiReceived( GfxWindow&, UInt32 uid )
             setConstraints();
         } break;
 
+        case ID_OBSTACLES: {
+            _obstacles = static_cast<ObstacleType>(
+                _glWindow->getRadioGroup( uid )
+            );
+            forceFinishStep();
+            setObstacles();
+            _glWindow->postRedisplay();
+        } break;
+
         case ID_TRI_STRETCH:
         case ID_TRI_SHEAR:
         case ID_TRI_BEND: {
@@ -1130,10 +1174,8 @@ void ClothApp::idleReceived()
     // FIXME: this is pretty naive...
     if (
         _glWindow->getCheckbox( ID_MOVIE ) &&
-        BaMath::isLess(
-            _nextMovieFrame / static_cast<Float>( _frameRate ),
-            BaTime::instantAsSeconds( _simulator->getTime() )
-        )
+        BaTime::Instant( _nextMovieFrame ) * BaTime::S / _frameRate <
+            _simulator->getTime()
     ) {
         _snapFlag = true;
         ++_nextMovieFrame; 
@@ -1156,44 +1198,6 @@ void ClothApp::forceFinishStep()
 
 //------------------------------------------------------------------------------
 
-RCShdPtr<GeMesh> ClothApp::createRectMesh(
-    Float size,
-    UInt32 nbRows,
-    UInt32 nbCols
-) {
-    GeMeshBuilder builder;
-    UInt32 r, c;
-    builder.preallocVertices( (nbRows + 1) * (nbCols + 1 ) );
-    builder.preallocTextureVertices( (nbRows + 1) * (nbCols + 1 ) );
-    builder.preallocFaces( nbRows * nbCols );
-    for ( r = 0; r <= nbRows; ++r ) {
-        for ( c = 0; c <= nbCols; ++c ) {
-            builder.addVertex(
-                GePoint( c * size / nbCols, r * size / nbRows, 0 )
-            );
-            builder.addTextureVertex(
-                GePoint( c * size / nbCols, r * size / nbRows, 0 )
-            );
-        }
-    }
-    const UInt32 rstride=nbCols+1;
-    for( r = 0; r < nbRows; ++r ) {
-        for ( c = 0; c < nbCols; ++c ) {
-            GeMesh::FaceId fid = builder.addFace(
-                r*rstride + c, r*rstride + c+1, (r+1)*rstride + c,
-                r*rstride + c, r*rstride + c+1, (r+1)*rstride + c
-            );
-            fid = builder.addFace(
-                (r+1)*rstride + c, r*rstride + c+1, (r+1)*rstride + c+1,
-                (r+1)*rstride + c, r*rstride + c+1, (r+1)*rstride + c+1
-            );
-        }
-    }
-    return builder.createMesh();
-}
-
-//------------------------------------------------------------------------------
-
 void ClothApp::initMeshIndices(
     const GeMesh& mesh,
     std::vector<UInt32>& indices
@@ -1240,33 +1244,7 @@ void ClothApp::initGL()
 
 void ClothApp::calcNormals()
 {
-    const RCShdPtr<GeMesh>& mesh = _simulator->getMeshPtr();
-    std::vector<GeVector> faceNormals( mesh->getNbFaces() );
-    GeMesh::FaceConstIterator fi;
-    for ( fi = mesh->beginFace(); fi != mesh->endFace(); ++fi ) {
-        faceNormals[ fi->getFaceId() ] = fi->calcNormal();
-    }
-    // FIXME: meshWE should be a member of clothApp.
-    GeMeshWingedEdge meshWE( mesh );
-    for ( GeMesh::VertexId vid = 0; vid < mesh->getNbVertices(); ++vid ) {
-        GeMeshWingedEdge::VertexFaceIterator vfi;
-        GeVector normal ( GeVector::zero() );
-        UInt32 nbFaces = 0;
-        for (
-            vfi = meshWE.beginVertexFace( vid );
-            vfi != meshWE.endVertexFace( vid );
-            ++vfi
-        ) {
-            normal += faceNormals[ vfi->getFaceId() ];
-            ++nbFaces;
-        }
-        if ( nbFaces > 0 ) {
-            _meshNormals[ vid ] = normal / nbFaces;
-        }
-        else {
-            _meshNormals[ vid ] = normal;
-        }
-    }
+    _meshWE->calcVertexNormals( _simulator->getMesh(), _meshNormals );
 }
 
 //------------------------------------------------------------------------------
@@ -1421,10 +1399,6 @@ void ClothApp::renderClothVertDebug()
     bool showvel = _glWindow->getCheckbox( ID_VERT_VEL );
     bool showf = _glWindow->getCheckbox( ID_VERT_FORCE );
     const UInt32 NB_FS = 5;
-#ifdef NDEBUG
-    const bool showfs[ NB_FS ] = { false, false, false, false, false };
-    const bool showdamp = false;
-#else
     const bool showfs[ NB_FS ] = {
         _glWindow->getCheckbox( ID_VERT_FORCE_STRETCH ),
         _glWindow->getCheckbox( ID_VERT_FORCE_SHEAR ),
@@ -1433,7 +1407,6 @@ void ClothApp::renderClothVertDebug()
         _glWindow->getCheckbox( ID_VERT_FORCE_DRAG ),
     };
     const bool showdamp = _glWindow->getCheckbox( ID_VERT_FORCE_DAMP );
-#endif
     if ( !showvel && !showf && !showfs[0] && !showfs[1] && !showfs[2] &&
          !showfs[3] && !showfs[4] ) {
         return;
@@ -1550,6 +1523,106 @@ void ClothApp::renderFloor()
 
 //------------------------------------------------------------------------------
 
+void ClothApp::renderObstacles()
+{
+    const RCShdPtr<SimCollider>& collider = _simulator->getCollider();
+    if ( collider.isNull() ) {
+        return;
+    }
+    const UInt32 SLICES = 32;
+    const UInt32 STACKS = 16;
+    GLUquadric* quadric = ::gluNewQuadric();
+    ::glPushAttrib( GL_ENABLE_BIT );
+    // Boxes are drawn scaled.
+    ::glEnable( GL_NORMALIZE );
+    ::glColor3f( .5f, .5f, .6f );
+    ::glPushMatrix();
+    GL::translate( _meshPos );
+    for ( UInt32 i = 0; i < collider->getNbObstacles(); ++i ) {
+        const SimCollider::Obstacle& obstacle = collider->getObstacle( i );
+        const GePoint& p = obstacle.getPoint();
+        ::glPushMatrix();
+        GL::translate( p );
+        switch ( obstacle.getType() ) {
+            case SimCollider::OBSTACLE_PLANE: {
+                // A square four cloth lengths across, centred below the
+                // cloth.
+                const GeVector& n = obstacle.getNormal();
+                const GeVector other = BaMath::abs( n[ 0 ] ) < .5f
+                    ? GeVector::xAxis() : GeVector::yAxis();
+                const GeVector u = n.cross( other ).getUnit() * 2 * _clothSize;
+                const GeVector v = n.cross( u );
+                const GeVector offset(
+                    p, GePoint( _clothSize / 2, _clothSize / 2, 0 )
+                );
+                const GePoint c = GePoint::ZERO + offset - n * n.dot( offset );
+                ::glBegin( GL_QUADS );
+                    GL::normal( n );
+                    GL::vertex( c - u - v );
+                    GL::vertex( c + u - v );
+                    GL::vertex( c + u + v );
+                    GL::vertex( c - u + v );
+                ::glEnd();
+            } break;
+
+            case SimCollider::OBSTACLE_SPHERE: {
+                ::gluSphere( quadric, obstacle.getRadius(), SLICES, STACKS );
+            } break;
+
+            case SimCollider::OBSTACLE_CAPSULE: {
+                // Rotate the z axis onto the capsule's axis.
+                const GeVector axis( p, obstacle.getEnd() );
+                const Float length = axis.length();
+                const GeVector rotAxis = GeVector::zAxis().cross( axis );
+                if ( rotAxis.length() > length * 1e-6f ) {
+                    GL::multMatrix( GeMatrix4::rotation(
+                        rotAxis.getUnit(), GeVector::zAxis().getAngle( axis )
+                    ) );
+                }
+                else if ( axis[ 2 ] < 0 ) {
+                    ::glRotatef( 180, 1, 0, 0 );
+                }
+                const Float r = obstacle.getRadius();
+                ::gluSphere( quadric, r, SLICES, STACKS );
+                ::gluCylinder( quadric, r, r, length, SLICES, 1 );
+                ::glTranslatef( 0, 0, length );
+                ::gluSphere( quadric, r, SLICES, STACKS );
+            } break;
+
+            case SimCollider::OBSTACLE_BOX: {
+                GL::multMatrix(
+                    GeMatrix4::rotation( obstacle.getOrientation() )
+                );
+                const GeVector& e = obstacle.getHalfExtents();
+                ::glScalef( e[ 0 ], e[ 1 ], e[ 2 ] );
+                // The unit cube [-1,1]^3, one face per axis and sign.
+                ::glBegin( GL_QUADS );
+                for ( UInt32 axis = 0; axis < 3; ++axis ) {
+                    const GeVector a = GeVector::axis( axis );
+                    const GeVector b = GeVector::axis( ( axis + 1 ) % 3 );
+                    const GeVector c = GeVector::axis( ( axis + 2 ) % 3 );
+                    for ( Int32 sign = -1; sign <= 1; sign += 2 ) {
+                        const GeVector f = a * sign;
+                        const GeVector t = b * sign;
+                        GL::normal( f );
+                        GL::vertex( GePoint::ZERO + f - t - c );
+                        GL::vertex( GePoint::ZERO + f + t - c );
+                        GL::vertex( GePoint::ZERO + f + t + c );
+                        GL::vertex( GePoint::ZERO + f - t + c );
+                    }
+                }
+                ::glEnd();
+            } break;
+        }
+        ::glPopMatrix();
+    }
+    ::glPopMatrix();
+    ::glPopAttrib();
+    ::gluDeleteQuadric( quadric );
+}
+
+//------------------------------------------------------------------------------
+
 void ClothApp::displayReceived( GfxWindow& )
 {
     calcNormals();
@@ -1721,6 +1794,7 @@ void ClothApp::render( bool debug_stretch, bool debug_shear, bool debug_bend )
     ::glEnable( GL_FOG );
     //renderFloor();
     ::glDisable( GL_FOG );
+    renderObstacles();
 
     ::glEnable( GL_POLYGON_OFFSET_FILL );
     ::glPolygonOffset( 1, 1 );
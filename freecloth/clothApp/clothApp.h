@@ -27,6 +27,10 @@
 #include <freecloth/simulator/simSimulator.h>
 #endif
 
+#ifndef freecloth_sim_simScene_h
+#include <freecloth/simulator/simScene.h>
+#endif
+
 #ifndef freecloth_base_vector
 #include <freecloth/base/vector>
 #endif
@@ -82,22 +86,8 @@ class ClothApp : public GfxWindowObserver
 public:
     // ----- types and enumerations -----
 
-    //! Constraint IDs
-    enum ConstraintType {
-        CON_NONE,
-
-        CON_CENTRE,
-        CON_CORNERS4,
-        CON_CORNERS3a,
-        CON_CORNERS3b,
-        CON_CORNERS1c,
-        CON_CORNERS1d,
-        CON_CORNERYANK,
-        CON_TABLE_SQUARE,
-        CON_TABLE_CIRCLE,
-
-        NB_CONSTRAINTS
-    };
+    typedef SimScene::ConstraintType ConstraintType;
+    typedef SimScene::ObstacleType ObstacleType;
     
     // ----- member functions -----
     explicit ClothApp( const ClothAppArgs& );
@@ -160,6 +150,7 @@ private:
         ID_PAR_RESET,
 
         ID_CONSTRAINTS,
+        ID_OBSTACLES,
 
         ID_EN_STRETCH,
         ID_EN_SHEAR,
@@ -189,15 +180,11 @@ private:
 
     enum StepStrategy {
         STEP_BASIC,
-        STEP_ADAPTIVE
+        STEP_ADAPTIVE,
+        STEP_PI
     };
 
     // ----- static member functions -----
-    static RCShdPtr<GeMesh> createRectMesh(
-        Float size,
-        UInt32 nbRows,
-        UInt32 nbColumns
-    );
     static void initMeshIndices(
         const GeMesh& mesh,
         std::vector<UInt32>& indices
@@ -208,6 +195,7 @@ private:
     void setupSimulator();
     void setupStepper();
     void setConstraints();
+    void setObstacles();
     void setupWindow( const GfxConfig& config );
     void initGL();
     void calcNormals();
@@ -217,6 +205,7 @@ private:
     void renderClothOutline();
     void renderAxes();
     void renderFloor();
+    void renderObstacles();
     void updateParamsUI();
 
     //! Force the completion of the current step.
@@ -247,7 +236,11 @@ private:
     Float                   _pcgTolerance;
     UInt32                  _frameRate;
     Float                   _stretchLimit;
+    bool                    _speculative;
     ConstraintType          _constraints;
+    ObstacleType            _obstacles;
+    Float                   _thickness;
+    Float                   _selfThickness;
     bool                    _batchFlag;
     BaTime::Instant         _batchEnd;
 
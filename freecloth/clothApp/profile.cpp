@@ -18,53 +18,11 @@
 
 #include <freecloth/clothApp/package.h>
 #include <freecloth/simulator/simSimulator.h>
+#include <freecloth/simulator/simScene.h>
 #include <freecloth/simulator/simStepStrategyAdaptive.h>
 #include <freecloth/simulator/simStepStrategyBasic.h>
 #include <freecloth/geom/geMatrix3.h>
 #include <freecloth/geom/geMesh.h>
-#include <freecloth/geom/geMeshBuilder.h>
-
-namespace {
-
-//------------------------------------------------------------------------------
-
-RCShdPtr<GeMesh> createRectMesh(
-    Float size,
-    UInt32 nbRows,
-    UInt32 nbCols
-) {
-    GeMeshBuilder builder;
-    UInt32 r, c;
-    builder.preallocVertices( (nbRows + 1) * (nbCols + 1 ) );
-    builder.preallocTextureVertices( (nbRows + 1) * (nbCols + 1 ) );
-    builder.preallocFaces( nbRows * nbCols );
-    for ( r = 0; r <= nbRows; ++r ) {
-        for ( c = 0; c <= nbCols; ++c ) {
-            builder.addVertex(
-                GePoint( c * size / nbCols, r * size / nbRows, 0 )
-            );
-            builder.addTextureVertex(
-                GePoint( c * size / nbCols, r * size / nbRows, 0 )
-            );
-        }
-    }
-    const UInt32 rstride=nbCols+1;
-    for( r = 0; r < nbRows; ++r ) {
-        for ( c = 0; c < nbCols; ++c ) {
-            GeMesh::FaceId fid = builder.addFace(
-                r*rstride + c, r*rstride + c+1, (r+1)*rstride + c,
-                r*rstride + c, r*rstride + c+1, (r+1)*rstride + c
-            );
-            fid = builder.addFace(
-                (r+1)*rstride + c, r*rstride + c+1, (r+1)*rstride + c+1,
-                (r+1)*rstride + c, r*rstride + c+1, (r+1)*rstride + c+1
-            );
-        }
-    }
-    return builder.createMesh();
-}
-
-}
 
 ////////////////////////////////////////////////////////////////////////////////
 // GLOBALS
@@ -76,27 +34,17 @@ int main()
     const UInt32 NB_ITER = 10;
     const UInt32 NB_PATCHES = 31;
 
-    RCShdPtr< GeMesh > mesh( createRectMesh( 1, NB_PATCHES, NB_PATCHES ) );
+    RCShdPtr< GeMesh > mesh(
+        SimScene::createRectMesh( 1, NB_PATCHES, NB_PATCHES )
+    );
     RCShdPtr<SimSimulator> simulator(
         RCShdPtr<SimSimulator>( new SimSimulator( *mesh ) )
     );
     simulator->setDensity( .1f );
     SimStepStrategyAdaptive stepper( simulator, 25 );
-    {
-        const UInt32 N = NB_PATCHES;
-#if 1
-        simulator->setPosConstraintFull( 0 );
-        simulator->setPosConstraintFull( N );
-        simulator->setPosConstraintFull( N*(N+1) );
-        simulator->setPosConstraintFull( N*(N+1) + N );
-#else
-        const UInt32 C = BaMath::roundUInt32( std::max( 1.f, N*5/11.f ) );
-        const UInt32 x = (N-C)/2;
-        for (UInt32 i = 0; i <= C; ++i ) for ( UInt32 j = 0; j <= C; ++j ) {
-            simulator->setPosConstraintFull( (x + i)*(N+1) + x + j );
-        }
-#endif
-    }
+    SimScene::setConstraints(
+        *simulator, SimScene::CON_CORNERS4, NB_PATCHES
+    );
 
     while ( simulator->getTime() < BaTime::S ) {
         std::cout << "Time "
@@ -0,0 +1,743 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <freecloth/clothBatch/clothBatch.h>
+#include <freecloth/simulator/simStepStrategyBasic.h>
+#include <freecloth/simulator/simStepStrategyAdaptive.h>
+#include <freecloth/simulator/simStepStrategyPI.h>
+#include <freecloth/simulator/simCollider.h>
+#include <freecloth/simulator/simWorld.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/base/baStringUtil.h>
+#include <freecloth/base/string.h>
+
+namespace {
+    const Float DEFAULT_H = .01f;
+    const Float DEFAULT_RHO = .1f;
+    const Float DEFAULT_PCG_TOLERANCE = 1e-2f;
+    const Float DEFAULT_NEWTON_TOLERANCE = 1e-2f;
+    const Float DEFAULT_END_TIME = 1.f;
+    const Float DEFAULT_THICKNESS = .005f;
+
+    const char FRAME_FILE_MAGIC[] = "FCB1";
+
+    const char* const PHASE_NAMES[ SimSimulator::NB_PHASES ] = {
+        "normals",
+        "bend",
+        "collision",
+        "stretchShear",
+        "system",
+        "preconditioner",
+        "pcg",
+        "selfCollision",
+        "commit"
+    };
+}
+
+//------------------------------------------------------------------------------
+
+class ClothBatchArgs
+{
+public:
+    ClothBatchArgs( int argc, const char** argv );
+
+    void printSyntax();
+
+    String _outFilename;
+
+    SimSimulator::Params _params;
+    UInt32 _nbPatches;
+    Float _clothSize;
+    Float _h;
+    Float _rho;
+    Float _pcgTolerance;
+    SimSimulator::Preconditioner _preconditioner;
+    bool _matrixFree;
+    bool _mixedPrecision;
+    UInt32 _newtonIterations;
+    Float _newtonTolerance;
+    bool _adaptive;
+    bool _piControl;
+    bool _speculative;
+    UInt32 _frameRate;
+    Float _stretchLimit;
+    ClothBatch::ConstraintType _constraint;
+    ClothBatch::ObstacleType _obstacle;
+    Float _thickness;
+    Float _selfThickness;
+    BaTime::Instant _batchEnd;
+    UInt32 _nbThreads;
+    UInt32 _nbGarments;
+    bool _profile;
+
+    bool _error;
+
+private:
+    template <class InputIterator>
+    void parseArgs( InputIterator first, InputIterator last );
+
+};
+
+//------------------------------------------------------------------------------
+
+ClothBatchArgs::ClothBatchArgs( int argc, const char** argv )
+  : _outFilename( "-" ),
+    _nbPatches( 11 ),
+    _clothSize( 1 ),
+    _h( DEFAULT_H ),
+    _rho( DEFAULT_RHO ),
+    _pcgTolerance( DEFAULT_PCG_TOLERANCE ),
+    _preconditioner( SimSimulator::PRECONDITIONER_DIAGONAL ),
+    _matrixFree( false ),
+    _mixedPrecision( false ),
+    _newtonIterations( 1 ),
+    _newtonTolerance( DEFAULT_NEWTON_TOLERANCE ),
+    _adaptive( true ),
+    _piControl( false ),
+    _speculative( false ),
+    _frameRate( 25 ),
+    _stretchLimit( 0.01f ),
+    _constraint( SimScene::CON_CORNERS3b ),
+    _obstacle( SimScene::OBS_NONE ),
+    _thickness( DEFAULT_THICKNESS ),
+    _selfThickness( 0 ),
+    _batchEnd( BaTime::floatAsInstant( DEFAULT_END_TIME ) ),
+    _nbThreads( 1 ),
+    _nbGarments( 1 ),
+    _profile( false )
+{
+    parseArgs( argv + 1, argv + argc );
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatchArgs::printSyntax()
+{
+    std::cerr
+        << "Syntax: clothBatch [options]" << std::endl
+        << "    -out name          Frame file, or - for standard output" << std::endl
+        << "    -batch t           Simulate until time t is reached" << std::endl
+        << "    -threads n         Number of simulator threads" << std::endl
+        << "    -garments n        Step n copies of the cloth, one per thread"
+        << std::endl
+        << "    -profile           Report the time of each step phase" << std::endl
+        << "    -nbPatches n       Number of patches" << std::endl
+        << "    -clothSize x       Length of cloth in metres" << std::endl
+        << "    -stretch x         Stretch constant" << std::endl
+        << "    -shear x           Shear constant" << std::endl
+        << "    -bend x y          Bend u/v constants" << std::endl
+        << "    -stretchDamp x     Stretch damping constant" << std::endl
+        << "    -shearDamp x       Shear damping constant" << std::endl
+        << "    -bendDamp x        Bend damping constant" << std::endl
+        << "    -drag x            Drag constant" << std::endl
+        << "    -gravity x         Gravity constant" << std::endl
+        << "    -density x         Density, in kg/m^2" << std::endl
+        << "    -tolerance x       Tolerance of PCG algorithm" << std::endl
+        << "    -preconditioner [diagonal|blockJacobi|ic0|multigrid|ldlt]"
+        << std::endl
+        << "                       PCG preconditioner" << std::endl
+        << "    -matrixFree        Solve without assembling the system matrix"
+        << std::endl
+        << "    -mixedPrecision    Reduce PCG sums in double precision"
+        << std::endl
+        << "    -newtonIterations n  Maximum Newton iterations per step"
+        << std::endl
+        << "    -newtonTolerance x Relative correction ending Newton iterations"
+        << std::endl
+        << "    -noAdaptive        Disable adaptive timestepping" << std::endl
+        << "    -piControl         Adapt timesteps by PI control" << std::endl
+        << "    -speculate         Try several timesteps at once" << std::endl
+        << "    -timestep x        Timestep (nonadaptive only)" << std::endl
+        << "    -stretchLimit x    Stretch limit" << std::endl
+        << "    -frameRate x       Framerate of the frame file" << std::endl
+        << "    -constraint [none|centre|corners{4,3a,3b,1c,1d}|yank|table_square|" << std::endl
+        << "        table_circle]  Constraint type" << std::endl
+        << "    -obstacle [none|floor|sphere|capsule|box]" << std::endl
+        << "                       Obstacle below the cloth" << std::endl
+        << "    -thickness x       Distance kept from obstacles" << std::endl
+        << "    -selfCollision x   Distance kept between parts of the cloth,"
+        << std::endl
+        << "                       or 0 to let it pass through itself"
+        << std::endl
+        ;
+}
+
+//------------------------------------------------------------------------------
+
+template <class InputIterator>
+void ClothBatchArgs::parseArgs( InputIterator first, InputIterator last )
+{
+    _error = false;
+    InputIterator i;
+    for ( i = first; i != last && !_error; ++i ) {
+        if ( std::string( "-out" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _outFilename = *i;
+        }
+        else if ( std::string( "-batch" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _batchEnd = BaTime::floatAsInstant( BaStringUtil::toFloat( *i ) );
+        }
+        else if ( std::string( "-threads" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _nbThreads = BaStringUtil::toInt32( *i );
+            _error = _nbThreads < 1;
+        }
+        else if ( std::string( "-garments" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _nbGarments = BaStringUtil::toInt32( *i );
+            _error = _nbGarments < 1;
+        }
+        else if ( std::string( "-profile" ) == *i ) {
+            _profile = true;
+        }
+        else if ( std::string( "-nbPatches" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _nbPatches = BaStringUtil::toInt32( *i );
+        }
+        else if ( std::string( "-clothSize" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _clothSize = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-stretch" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._k_stretch = BaStringUtil::toFloat( *i ) * 1000;
+        }
+        else if ( std::string( "-shear" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._k_shear = BaStringUtil::toFloat( *i ) * 1000;
+        }
+        else if ( std::string( "-bend" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._k_bend_u = BaStringUtil::toFloat( *i ) / 1000;
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._k_bend_v = BaStringUtil::toFloat( *i ) / 1000;
+        }
+        else if ( std::string( "-stretchDamp" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._k_stretch_damp = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-shearDamp" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._k_shear_damp = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-bendDamp" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._k_bend_damp = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-drag" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._k_drag = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-gravity" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _params._g = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-density" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _rho = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-tolerance" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _pcgTolerance = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-preconditioner" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            const String names[ SimSimulator::NB_PRECONDITIONERS ] = {
+                "diagonal",
+                "blockjacobi",
+                "ic0",
+                "multigrid",
+                "ldlt"
+            };
+            String name = BaStringUtil::toLower( *i );
+            _error = true;
+            for ( Int32 i = 0; i < SimSimulator::NB_PRECONDITIONERS; ++i ) {
+                if ( name == names[ i ] ) {
+                    _preconditioner =
+                        static_cast<SimSimulator::Preconditioner>( i );
+                    _error = false;
+                }
+            }
+        }
+        else if ( std::string( "-matrixFree" ) == *i ) {
+            _matrixFree = true;
+        }
+        else if ( std::string( "-mixedPrecision" ) == *i ) {
+            _mixedPrecision = true;
+        }
+        else if ( std::string( "-newtonIterations" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _newtonIterations = BaStringUtil::toInt32( *i );
+            _error = _newtonIterations < 1;
+        }
+        else if ( std::string( "-newtonTolerance" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _newtonTolerance = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-noAdaptive" ) == *i ) {
+            _adaptive = false;
+        }
+        else if ( std::string( "-piControl" ) == *i ) {
+            _piControl = true;
+        }
+        else if ( std::string( "-speculate" ) == *i ) {
+            _speculative = true;
+        }
+        else if ( std::string( "-timestep" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _h = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-stretchLimit" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _stretchLimit = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-frameRate" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _frameRate = BaStringUtil::toInt32( *i );
+            _error = _frameRate < 1;
+        }
+        else if ( std::string( "-constraint" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            const String names[ SimScene::NB_CONSTRAINTS ] = {
+                "none",
+
+                "centre",
+                "corners4",
+                "corners3a",
+                "corners3b",
+                "corners1c",
+                "corners1d",
+                "yank",
+                "table_square",
+                "table_circle"
+            };
+            String name = BaStringUtil::toLower( *i );
+            _error = true;
+            for ( Int32 i = 0; i < SimScene::NB_CONSTRAINTS; ++i ) {
+                if ( name == names[ i ] ) {
+                    _constraint = static_cast<ClothBatch::ConstraintType>( i );
+                    _error = false;
+                }
+            }
+        }
+        else if ( std::string( "-obstacle" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            const String names[ SimScene::NB_OBSTACLES ] = {
+                "none",
+
+                "floor",
+                "sphere",
+                "capsule",
+                "box"
+            };
+            String name = BaStringUtil::toLower( *i );
+            _error = true;
+            for ( Int32 i = 0; i < SimScene::NB_OBSTACLES; ++i ) {
+                if ( name == names[ i ] ) {
+                    _obstacle = static_cast<ClothBatch::ObstacleType>( i );
+                    _error = false;
+                }
+            }
+        }
+        else if ( std::string( "-thickness" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _thickness = BaStringUtil::toFloat( *i );
+        }
+        else if ( std::string( "-selfCollision" ) == *i ) {
+            ++i; if ( i == last ) { _error = true; break; }
+            _selfThickness = BaStringUtil::toFloat( *i );
+        }
+        else {
+            _error = true;
+        }
+    }
+    if ( i != last ) {
+        _error = true;
+    }
+    if ( _error ) {
+        printSyntax();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS ClothBatch
+
+//------------------------------------------------------------------------------
+
+ClothBatch::ClothBatch( const ClothBatchArgs& args )
+  : _outFilename( args._outFilename ),
+    _params( args._params ),
+    _nbPatches( args._nbPatches ),
+    _clothSize( args._clothSize ),
+    _h( args._h ),
+    _rho( args._rho ),
+    _pcgTolerance( args._pcgTolerance ),
+    _preconditioner( args._preconditioner ),
+    _matrixFree( args._matrixFree ),
+    _mixedPrecision( args._mixedPrecision ),
+    _newtonIterations( args._newtonIterations ),
+    _newtonTolerance( args._newtonTolerance ),
+    _adaptive( args._adaptive ),
+    _piControl( args._piControl ),
+    _speculative( args._speculative ),
+    _frameRate( args._frameRate ),
+    _stretchLimit( args._stretchLimit ),
+    _constraints( args._constraint ),
+    _obstacles( args._obstacle ),
+    _thickness( args._thickness ),
+    _selfThickness( args._selfThickness ),
+    _endTime( args._batchEnd ),
+    _nbThreads( args._nbThreads ),
+    _nbGarments( args._nbGarments ),
+    _profile( args._profile )
+{
+    _initialMesh = SimScene::createRectMesh(
+        _clothSize, _nbPatches, _nbPatches
+    );
+    if ( _nbGarments == 1 ) {
+        setupSimulator( _nbThreads );
+        return;
+    }
+    // The world's threads each step whole garments, so the garments
+    // themselves are single-threaded.
+    _world = RCShdPtr<SimWorld>( new SimWorld );
+    _world->setNbThreads( _nbThreads );
+    for ( UInt32 i = 0; i < _nbGarments; ++i ) {
+        setupSimulator( 1 );
+        _world->addSimulator( _simulator, _stepper );
+    }
+    _simulator = _world->getSimulator( 0 );
+    _stepper = _world->getStepStrategy( 0 );
+}
+
+//------------------------------------------------------------------------------
+
+int ClothBatch::run()
+{
+    // Statistics go to standard output, unless the frames do.
+    std::ofstream file;
+    std::ostream* out = &std::cout;
+    std::ostream* log = &std::cerr;
+    if ( _outFilename != "-" ) {
+        file.open( _outFilename.c_str(), std::ios::out | std::ios::binary );
+        if ( ! file ) {
+            std::cerr << "Can't open " << _outFilename << std::endl;
+            return 1;
+        }
+        out = &file;
+        log = &std::cout;
+    }
+
+    writeHeader( *out );
+    UInt32 frame = 0;
+    writeFrame( *out, frame );
+
+    FrameStats stats;
+    stats.clear();
+    BaTime::Instant start = BaTime::getTime();
+    const BaTime::Instant runStart = start;
+    while ( _simulator->getTime() < _endTime ) {
+        stepFrame( stats );
+        const UInt32 failed = findFailedGarment();
+        if ( failed < _nbGarments ) {
+            std::cerr << "Step failed at time "
+                << BaTime::instantAsSeconds( _simulator->getTime() );
+            if ( _nbGarments > 1 ) {
+                std::cerr << " for garment " << failed;
+            }
+            std::cerr << std::endl;
+            return 1;
+        }
+        // A frame is written once the simulation reaches its time, as
+        // ClothApp does for movies. A step can cross more than one frame
+        // boundary, so each frame crossed is written, with the time the
+        // simulation has actually reached.
+        const UInt32 lastFrame = static_cast<UInt32>(
+            _simulator->getTime() * _frameRate / BaTime::S
+        );
+        while ( frame < lastFrame ) {
+            ++frame;
+            writeFrame( *out, frame );
+
+            const BaTime::Instant end = BaTime::getTime();
+            *log << "frame " << frame
+                << " time " << BaTime::instantAsSeconds( _simulator->getTime() )
+                << " wall " << BaTime::durationAsSeconds(
+                    BaTime::getDuration( start, end )
+                )
+                << " steps "
+                << stats._nbInternalSteps + stats._nbFailedSteps
+                << " failed " << stats._nbFailedSteps
+                << " pcg " << stats._nbPCGIterations;
+            if ( _obstacles != SimScene::OBS_NONE ) {
+                *log << " contacts " << _simulator->getNbContacts();
+            }
+            if ( _selfThickness > 0 ) {
+                *log << " selfCollisions "
+                    << _simulator->getNbSelfCollisions();
+            }
+            if ( _speculative ) {
+                *log << " speculated " << stats._nbSpeculations
+                    << " won " << stats._nbSpeculationWins;
+            }
+            *log << std::endl;
+            if ( _profile ) {
+                writeStats( *log, frame, stats._stepStats );
+            }
+            stats.clear();
+            start = end;
+        }
+    }
+    out->flush();
+    *log << "total frames " << frame
+        << " wall " << BaTime::durationAsSeconds(
+            BaTime::getDuration( runStart, BaTime::getTime() )
+        ) << std::endl;
+    if ( ! *out ) {
+        std::cerr << "Error writing " << _outFilename << std::endl;
+        return 1;
+    }
+    const UInt32 diverged = findDivergedGarment();
+    if ( diverged < _nbGarments ) {
+        std::cerr << "Garment " << diverged << " differs from garment 0"
+            << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatch::setupSimulator( UInt32 nbThreads )
+{
+    _simulator = RCShdPtr<SimSimulator>(
+        new SimSimulator( *_initialMesh )
+    );
+    _simulator->setTimestep( BaTime::floatAsDuration( _h ) );
+    _simulator->setDensity( _rho );
+    _simulator->setParams( _params );
+    _simulator->setPCGTolerance( _pcgTolerance );
+    _simulator->setPreconditioner( _preconditioner );
+    _simulator->setMatrixFree( _matrixFree );
+    _simulator->setMixedPrecision( _mixedPrecision );
+    _simulator->setNewtonIterations( _newtonIterations );
+    _simulator->setNewtonTolerance( _newtonTolerance );
+    _simulator->setStretchLimit( _stretchLimit );
+    _simulator->setNbThreads( nbThreads );
+    _simulator->setProfiling( _profile );
+    SimScene::setConstraints( *_simulator, _constraints, _nbPatches );
+    _simulator->setCollider(
+        SimScene::createCollider( _obstacles, _clothSize, _thickness )
+    );
+    _simulator->setSelfCollisionThickness( _selfThickness );
+
+    if ( _adaptive && _piControl ) {
+        _stepper = RCShdPtr<SimStepStrategy>(
+            new SimStepStrategyPI( _simulator, _frameRate )
+        );
+    }
+    else if ( _adaptive ) {
+        SimStepStrategyAdaptive* stepper =
+            new SimStepStrategyAdaptive( _simulator, _frameRate );
+        stepper->setSpeculative( _speculative );
+        _stepper = RCShdPtr<SimStepStrategy>( stepper );
+    }
+    else {
+        _stepper = RCShdPtr<SimStepStrategy>(
+            new SimStepStrategyBasic( _simulator )
+        );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatch::stepFrame( FrameStats& stats )
+{
+    if ( _world.isNull() ) {
+        _stepper->step();
+        addFrameStats( *_simulator, *_stepper, stats );
+        return;
+    }
+    _world->step();
+    for ( UInt32 i = 0; i < _nbGarments; ++i ) {
+        addFrameStats(
+            *_world->getSimulator( i ), *_world->getStepStrategy( i ), stats
+        );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatch::addFrameStats(
+    const SimSimulator& simulator,
+    const SimStepStrategy& stepper,
+    FrameStats& stats
+) const {
+    // Each step's stats are cleared by the next, so the adaptive strategies
+    // keep totals over their steps.
+    if ( _adaptive && _piControl ) {
+        stats += static_cast<const SimStepStrategyPI&>(
+            stepper
+        ).getFrameStats();
+    }
+    else if ( _adaptive ) {
+        stats += static_cast<const SimStepStrategyAdaptive&>(
+            stepper
+        ).getFrameStats();
+    }
+    else {
+        // SimStepStrategyBasic takes a single step, and stops if it fails.
+        if ( stepper.stepSucceeded() ) {
+            ++stats._nbInternalSteps;
+        }
+        else {
+            ++stats._nbFailedSteps;
+        }
+        stats._nbPCGIterations += simulator.getNbPCGIterations();
+        if ( _profile ) {
+            stats._stepStats += simulator.getStepStats();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 ClothBatch::findFailedGarment() const
+{
+    if ( _world.isNull() ) {
+        return _stepper->stepSucceeded() ? _nbGarments : 0;
+    }
+    for ( UInt32 i = 0; i < _nbGarments; ++i ) {
+        if ( ! _world->getStepStrategy( i )->stepSucceeded() ) {
+            return i;
+        }
+    }
+    return _nbGarments;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 ClothBatch::findDivergedGarment() const
+{
+    const GeMesh& mesh = _simulator->getMesh();
+    for ( UInt32 i = 1; i < _nbGarments; ++i ) {
+        const GeMesh& other = _world->getSimulator( i )->getMesh();
+        for ( UInt32 j = 0; j < mesh.getNbVertices(); ++j ) {
+            if ( other.getVertex( j ) != mesh.getVertex( j ) ) {
+                return i;
+            }
+        }
+    }
+    return _nbGarments;
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatch::writeStats(
+    std::ostream& log,
+    UInt32 frame,
+    const SimSimulator::StepStats& stats
+) {
+    log << "profile " << frame;
+    UInt32 i;
+    for ( i = 0; i < SimSimulator::NB_PHASES; ++i ) {
+        log << " " << PHASE_NAMES[ i ] << " " << stats._time[ i ];
+    }
+    if ( stats._hasCounters ) {
+        UInt64 counts[ SimProfiler::NB_COUNTERS ] = { 0, 0 };
+        for ( i = 0; i < SimSimulator::NB_PHASES; ++i ) {
+            for ( UInt32 j = 0; j < SimProfiler::NB_COUNTERS; ++j ) {
+                counts[ j ] += stats._counts[ i ][ j ];
+            }
+        }
+        log << " cycles " << counts[ SimProfiler::COUNTER_CYCLES ]
+            << " misses " << counts[ SimProfiler::COUNTER_CACHE_MISSES ];
+    }
+    log << std::endl;
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatch::writeHeader( std::ostream& out ) const
+{
+    out.write( FRAME_FILE_MAGIC, 4 );
+    writeUInt32( out, _initialMesh->getNbVertices() );
+    writeUInt32( out, _initialMesh->getNbFaces() );
+    writeUInt32( out, _frameRate );
+    const GeMesh& mesh = *_initialMesh;
+    GeMesh::FaceConstIterator fi;
+    for ( fi = mesh.beginFace(); fi != mesh.endFace(); ++fi ) {
+        for ( UInt32 i = 0; i < fi->getNbVertices(); ++i ) {
+            writeUInt32( out, fi->getVertexId( i ) );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatch::writeFrame( std::ostream& out, UInt32 frame ) const
+{
+    writeUInt32( out, frame );
+    writeFloat32( out, BaTime::instantAsSeconds( _simulator->getTime() ) );
+    const GeMesh& mesh = _simulator->getMesh();
+    for ( UInt32 i = 0; i < mesh.getNbVertices(); ++i ) {
+        const GePoint& p = mesh.getVertex( i );
+        writeFloat32( out, p._x );
+        writeFloat32( out, p._y );
+        writeFloat32( out, p._z );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatch::writeUInt32( std::ostream& out, UInt32 value )
+{
+    const char bytes[ 4 ] = {
+        static_cast<char>( value & 0xff ),
+        static_cast<char>( ( value >> 8 ) & 0xff ),
+        static_cast<char>( ( value >> 16 ) & 0xff ),
+        static_cast<char>( ( value >> 24 ) & 0xff )
+    };
+    out.write( bytes, 4 );
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBatch::writeFloat32( std::ostream& out, Float value )
+{
+    const float f = static_cast<float>( value );
+    UInt32 bits;
+    ::memcpy( &bits, &f, sizeof( bits ) );
+    writeUInt32( out, bits );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// GLOBALS
+
+//------------------------------------------------------------------------------
+
+int main( int argc, const char** argv )
+{
+    ClothBatchArgs args( argc, argv );
+    if ( args._error ) {
+        return 1;
+    }
+    ClothBatch batch( args );
+    return batch.run();
+}
@@ -0,0 +1,174 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_clothBatch_clothBatch_h
+#define freecloth_clothBatch_clothBatch_h
+
+#ifndef freecloth_clothBatch_package_h
+#include <freecloth/clothBatch/package.h>
+#endif
+
+#ifndef freecloth_simulator_simSimulator_h
+#include <freecloth/simulator/simSimulator.h>
+#endif
+
+#ifndef freecloth_sim_simStepStrategyAdaptive_h
+#include <freecloth/simulator/simStepStrategyAdaptive.h>
+#endif
+
+#ifndef freecloth_sim_simScene_h
+#include <freecloth/simulator/simScene.h>
+#endif
+
+#ifndef freecloth_resmgt_rcShdPtr_h
+#include <freecloth/resmgt/rcShdPtr.h>
+#endif
+
+#ifndef freecloth_base_fstream
+#include <freecloth/base/fstream>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class ClothBatchArgs;
+
+FREECLOTH_NAMESPACE_START
+    class GeMesh;
+    class SimStepStrategy;
+    class SimWorld;
+FREECLOTH_NAMESPACE_END
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class ClothBatch freecloth/clothBatch/clothBatch.h
+ * \brief Headless batch driver for the Freecloth simulator
+ *
+ * Runs the same scenes as ClothApp's -batch mode, but depends only upon the
+ * simulator library, so it can run on machines without a display. The
+ * cloth is written out once per frame in the binary format below, and the
+ * wall time, internal step count and PCG iteration count of each frame are
+ * reported as text, along with the time of each step phase if profiling.
+ *
+ * With several garments, identical copies of the cloth are stepped together
+ * by a SimWorld, one garment per thread, instead of splitting each step
+ * across the threads. Only the first garment is written out, and the
+ * counts are totals over the garments. The copies must stay identical, so
+ * the run fails if any other garment ends up elsewhere.
+ *
+ * All values in the frame file are 32-bit and little-endian; floating
+ * point values are IEEE single precision, whatever the build's Float. The
+ * file starts with a header:
+ *
+ *   - the four characters "FCB1"
+ *   - the number of vertices, V, faces, F, and the frame rate
+ *   - 3F vertex indices, three per triangle
+ *
+ * followed by one record per frame:
+ *
+ *   - the frame number and the simulation time in seconds
+ *   - 3V vertex coordinates, x, y and z per vertex
+ */
+class ClothBatch
+{
+public:
+    // ----- types and enumerations -----
+
+    typedef SimScene::ConstraintType ConstraintType;
+    typedef SimScene::ObstacleType ObstacleType;
+    typedef SimStepStrategyAdaptive::FrameStats FrameStats;
+
+    // ----- member functions -----
+
+    explicit ClothBatch( const ClothBatchArgs& );
+    //! Run to the end time. Returns the process exit status.
+    int run();
+
+private:
+    // ----- static member functions -----
+
+    static void writeUInt32( std::ostream&, UInt32 );
+    static void writeFloat32( std::ostream&, Float );
+    //! Report the phase times and counts summed over a frame.
+    static void writeStats(
+        std::ostream&,
+        UInt32 frame,
+        const SimSimulator::StepStats&
+    );
+
+    // ----- member functions -----
+
+    //! Create a simulator and its strategy in _simulator and _stepper.
+    void setupSimulator( UInt32 nbThreads );
+    //! Advance one frame of every garment's strategy, adding its internal
+    //! steps, failed steps, PCG iterations and, if profiling, step stats to
+    //! the totals.
+    void stepFrame( FrameStats& );
+    //! Add the totals of the frame just taken by the given strategy, for
+    //! the given simulator.
+    void addFrameStats(
+        const SimSimulator&,
+        const SimStepStrategy&,
+        FrameStats&
+    ) const;
+    //! Index of the first garment whose last frame failed, or the number
+    //! of garments if none did.
+    UInt32 findFailedGarment() const;
+    //! Index of the first garment whose cloth differs from the first
+    //! garment's, or the number of garments if none does.
+    UInt32 findDivergedGarment() const;
+    void writeHeader( std::ostream& ) const;
+    void writeFrame( std::ostream&, UInt32 frame ) const;
+
+    // ----- data members -----
+
+    String                  _outFilename;
+    SimSimulator::Params    _params;
+    UInt32                  _nbPatches;
+    Float                   _clothSize;
+    Float                   _h;
+    Float                   _rho;
+    Float                   _pcgTolerance;
+    SimSimulator::Preconditioner _preconditioner;
+    bool                    _matrixFree;
+    bool                    _mixedPrecision;
+    UInt32                  _newtonIterations;
+    Float                   _newtonTolerance;
+    bool                    _adaptive;
+    bool                    _piControl;
+    bool                    _speculative;
+    UInt32                  _frameRate;
+    Float                   _stretchLimit;
+    ConstraintType          _constraints;
+    ObstacleType            _obstacles;
+    Float                   _thickness;
+    Float                   _selfThickness;
+    BaTime::Instant         _endTime;
+    UInt32                  _nbThreads;
+    UInt32                  _nbGarments;
+    bool                    _profile;
+
+    RCShdPtr<GeMesh>        _initialMesh;
+    //! The first garment's simulator and strategy.
+    RCShdPtr<SimSimulator>  _simulator;
+    RCShdPtr<SimStepStrategy> _stepper;
+    //! Null unless there are several garments.
+    RCShdPtr<SimWorld>      _world;
+};
+
+#endif
@@ -0,0 +1,232 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+//! \file clothBench.cpp
+//! Microbenchmarks for the simulator's inner kernels, run in isolation
+//! across mesh sizes. See ClothBenchmark for the kernels.
+//!
+//! Each kernel is repeated in samples of at least MIN_SAMPLE_TIME, after a
+//! warm-up run, and the median, minimum and spread over the samples are
+//! reported. Heap allocations are counted by replacing the global
+//! operator new.
+
+#include <freecloth/clothBatch/package.h>
+#include <freecloth/clothBatch/clothBenchmark.h>
+#include <freecloth/simulator/simScene.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/base/baStringUtil.h>
+#include <freecloth/base/baTime.h>
+#include <freecloth/base/algorithm>
+#include <freecloth/base/iomanip>
+#include <freecloth/base/stdlib.h>
+#include <new>
+
+namespace {
+
+const Float MIN_SAMPLE_TIME = .05f;
+const UInt32 DEFAULT_NB_SAMPLES = 7;
+const UInt32 DEFAULT_NB_PATCHES[] = { 15, 31, 63 };
+
+//! Number of calls to the global operator new.
+UInt32 theNbAllocations = 0;
+
+//------------------------------------------------------------------------------
+
+//! Seconds taken by nbRuns runs of the kernel.
+Float timeKernel(
+    ClothBenchmark& benchmark,
+    ClothBenchmark::Kernel kernel,
+    UInt32 nbRuns
+) {
+    const BaTime::Instant start = BaTime::getTime();
+    benchmark.run( kernel, nbRuns );
+    return BaTime::durationAsSeconds(
+        BaTime::getDuration( start, BaTime::getTime() )
+    );
+}
+
+//------------------------------------------------------------------------------
+
+void benchmarkKernel(
+    ClothBenchmark& benchmark,
+    ClothBenchmark::Kernel kernel,
+    UInt32 nbSamples
+) {
+    benchmark.run( kernel, 1 );
+    UInt32 nbRuns = 1;
+    while ( timeKernel( benchmark, kernel, nbRuns ) < MIN_SAMPLE_TIME ) {
+        nbRuns *= 2;
+    }
+
+    const Float nbElements = Float( benchmark.getNbElements( kernel ) );
+    std::vector<Float> nsPerElement( nbSamples );
+    const UInt32 nbAllocations = theNbAllocations;
+    for ( UInt32 i = 0; i < nbSamples; ++i ) {
+        nsPerElement[ i ] = timeKernel( benchmark, kernel, nbRuns ) * 1e9f /
+            ( nbRuns * nbElements );
+    }
+    const Float allocsPerRun = Float( theNbAllocations - nbAllocations ) /
+        ( nbSamples * nbRuns );
+
+    std::sort( nsPerElement.begin(), nsPerElement.end() );
+    const Float median = nsPerElement[ nbSamples / 2 ];
+    const Float spread = ( nsPerElement.back() - nsPerElement.front() ) /
+        median;
+    // Bytes per nanosecond is GB/s.
+    const Float bytes = benchmark.getNbBytes( kernel );
+
+    std::cout
+        << std::setw( 18 ) << ClothBenchmark::getKernelName( kernel )
+        << std::setw( 10 ) << benchmark.getNbElements( kernel )
+        << std::fixed << std::setprecision( 2 )
+        << std::setw( 10 ) << median
+        << std::setw( 10 ) << nsPerElement.front()
+        << std::setprecision( 1 )
+        << std::setw( 8 ) << spread * 100 << "%";
+    if ( bytes > 0 ) {
+        std::cout << std::setprecision( 2 )
+            << std::setw( 8 ) << bytes / ( median * nbElements );
+    }
+    else {
+        std::cout << std::setw( 8 ) << "-";
+    }
+    std::cout << std::setprecision( 1 )
+        << std::setw( 12 ) << allocsPerRun << std::endl;
+}
+
+//------------------------------------------------------------------------------
+
+void printSyntax()
+{
+    std::cerr
+        << "Syntax: clothBench [options] [nbPatches...]" << std::endl
+        << "    -samples n         Number of timed samples per kernel" << std::endl
+        << "    -kernel name       Only run the named kernel" << std::endl
+        ;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// GLOBALS
+
+//------------------------------------------------------------------------------
+
+void* operator new( std::size_t size )
+{
+    ++theNbAllocations;
+    void* p = ::malloc( size > 0 ? size : 1 );
+    if ( p == 0 ) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+//------------------------------------------------------------------------------
+
+void* operator new[]( std::size_t size )
+{
+    return operator new( size );
+}
+
+//------------------------------------------------------------------------------
+
+void operator delete( void* p ) throw()
+{
+    ::free( p );
+}
+
+//------------------------------------------------------------------------------
+
+void operator delete[]( void* p ) throw()
+{
+    ::free( p );
+}
+
+//------------------------------------------------------------------------------
+
+// Sized forms, which C++14 compilers call when the size is known.
+
+void operator delete( void* p, std::size_t ) throw()
+{
+    operator delete( p );
+}
+
+//------------------------------------------------------------------------------
+
+void operator delete[]( void* p, std::size_t ) throw()
+{
+    operator delete[]( p );
+}
+
+//------------------------------------------------------------------------------
+
+int main( int argc, const char** argv )
+{
+    UInt32 nbSamples = DEFAULT_NB_SAMPLES;
+    String kernelName;
+    std::vector<UInt32> sizes;
+    for ( int i = 1; i < argc; ++i ) {
+        if ( std::string( "-samples" ) == argv[ i ] && i + 1 < argc ) {
+            nbSamples = std::max( BaStringUtil::toInt32( argv[ ++i ] ), 1 );
+        }
+        else if ( std::string( "-kernel" ) == argv[ i ] && i + 1 < argc ) {
+            kernelName = argv[ ++i ];
+        }
+        else if ( argv[ i ][ 0 ] != '-' ) {
+            sizes.push_back( BaStringUtil::toInt32( argv[ i ] ) );
+        }
+        else {
+            printSyntax();
+            return 1;
+        }
+    }
+    if ( sizes.empty() ) {
+        sizes.assign(
+            DEFAULT_NB_PATCHES,
+            DEFAULT_NB_PATCHES + sizeof( DEFAULT_NB_PATCHES ) / sizeof( UInt32 )
+        );
+    }
+
+    for ( UInt32 s = 0; s < sizes.size(); ++s ) {
+        const RCShdPtr<GeMesh> mesh(
+            SimScene::createRectMesh( 1, sizes[ s ], sizes[ s ] )
+        );
+        ClothBenchmark benchmark( *mesh );
+        std::cout << "patches " << sizes[ s ]
+            << ": " << mesh->getNbVertices() << " vertices, "
+            << mesh->getNbFaces() << " faces" << std::endl
+            << std::setw( 18 ) << "kernel"
+            << std::setw( 10 ) << "elements"
+            << std::setw( 10 ) << "ns/elem"
+            << std::setw( 10 ) << "min"
+            << std::setw( 9 ) << "spread"
+            << std::setw( 8 ) << "GB/s"
+            << std::setw( 12 ) << "allocs/run" << std::endl;
+        for ( Int32 k = 0; k < ClothBenchmark::NB_KERNELS; ++k ) {
+            const ClothBenchmark::Kernel kernel = ClothBenchmark::Kernel( k );
+            if ( kernelName.empty() ||
+                kernelName == ClothBenchmark::getKernelName( kernel )
+            ) {
+                benchmarkKernel( benchmark, kernel, nbSamples );
+            }
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
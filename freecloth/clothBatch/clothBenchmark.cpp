@@ -0,0 +1,213 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <freecloth/clothBatch/clothBenchmark.h>
+#include <freecloth/simulator/simSimulator.h>
+#include <freecloth/simulator/simStepStrategyAdaptive.h>
+#include <freecloth/simulator/simMatrixPattern.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/geom/geMeshWingedEdge.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    //! Frames simulated before benchmarking, so that the cloth has folds.
+    const UInt32 NB_SETUP_FRAMES = 3;
+    const UInt32 SETUP_FRAME_RATE = 25;
+
+    //! Fill the blocks of m with arbitrary, well-scaled values.
+    template <class M>
+    void fillBlocks( M& m )
+    {
+        const UInt32 nbBlocks = m.getPattern()->nbBlocks();
+        for ( UInt32 slot = 0; slot < nbBlocks; ++slot ) {
+            m.getBlock( slot ) = GeMatrix3::identity() * ( 1 + slot % 7 );
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS ClothBenchmark
+
+//------------------------------------------------------------------------------
+
+const char* ClothBenchmark::getKernelName( Kernel kernel )
+{
+    switch ( kernel ) {
+        case KERNEL_MATRIX_MULTIPLY:        return "matrixMultiply";
+        case KERNEL_SYM_MATRIX_MULTIPLY:    return "symMatrixMultiply";
+        case KERNEL_MATRIX_ADD:             return "matrixAdd";
+        case KERNEL_PCG_SOLVE:              return "pcgSolve";
+        case KERNEL_PCG_SETUP:              return "pcgSetup";
+        case KERNEL_STRETCH_SHEAR:          return "stretchShear";
+        case KERNEL_BEND:                   return "bend";
+        case KERNEL_WINGED_EDGE:            return "wingedEdge";
+        case KERNEL_VERTEX_NORMALS:         return "vertexNormals";
+        default:                            return "unknown";
+    }
+}
+
+//------------------------------------------------------------------------------
+
+ClothBenchmark::ClothBenchmark( const GeMesh& mesh )
+  : _simulator( new SimSimulator( mesh ) ),
+    _meshWE( new GeMeshWingedEdge( RCShdPtr<GeMesh>( new GeMesh( mesh ) ) ) ),
+    _nbPCGIterations( 0 ),
+    _nbBendStencils( 0 )
+{
+    SimSimulator& sim = *_simulator;
+    sim.setPosConstraintFull( 0 );
+    SimStepStrategyAdaptive stepper( _simulator, SETUP_FRAME_RATE );
+    for ( UInt32 i = 0; i < NB_SETUP_FRAMES; ++i ) {
+        stepper.step();
+    }
+    // Start a step, to assemble the forces and the system.
+    sim.preSubSteps();
+    sim.runKernel( SimSimulator::KERNEL_PCG_SOLVE );
+    _nbPCGIterations = sim.getNbPCGIterations();
+
+    GeMeshWingedEdge::EdgeIterator ei;
+    for ( ei = _meshWE->beginEdge(); ei != _meshWE->endEdge(); ++ei ) {
+        if ( ei->hasTwin() ) {
+            ++_nbBendStencils;
+        }
+    }
+
+    // The same patterns as the simulator's.
+    _matrix = SimMatrix( SimMatrixPattern::createFromMesh( *_meshWE ) );
+    fillBlocks( _matrix );
+    _matrix2 = _matrix;
+    _symMatrix = SimSymMatrix(
+        SimMatrixPattern::createUpperTriangle( *_matrix.getPattern() )
+    );
+    fillBlocks( _symMatrix );
+
+    const UInt32 N = mesh.getNbVertices();
+    _src = SimVector( N );
+    _dest = SimVector( N );
+    for ( UInt32 i = 0; i < N; ++i ) {
+        _src[ i ] = GeVector( 1, -2, 3 ) * ( 1 + i % 5 );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+ClothBenchmark::~ClothBenchmark()
+{
+}
+
+//------------------------------------------------------------------------------
+
+void ClothBenchmark::run( Kernel kernel, UInt32 nbRuns )
+{
+    SimSimulator& sim = *_simulator;
+    for ( UInt32 i = 0; i < nbRuns; ++i ) {
+        switch ( kernel ) {
+            case KERNEL_MATRIX_MULTIPLY: {
+                SimMatrix::multiply( _dest, _matrix, _src );
+            } break;
+            case KERNEL_SYM_MATRIX_MULTIPLY: {
+                SimSymMatrix::multiply( _dest, _symMatrix, _src );
+            } break;
+            case KERNEL_MATRIX_ADD: {
+                _matrix2 += _matrix;
+            } break;
+            case KERNEL_PCG_SOLVE: {
+                sim.runKernel( SimSimulator::KERNEL_PCG_SOLVE );
+            } break;
+            case KERNEL_PCG_SETUP: {
+                sim.runKernel( SimSimulator::KERNEL_PCG_SETUP );
+            } break;
+            case KERNEL_STRETCH_SHEAR: {
+                sim.runKernel( SimSimulator::KERNEL_STRETCH_SHEAR );
+            } break;
+            case KERNEL_BEND: {
+                sim.runKernel( SimSimulator::KERNEL_BEND );
+            } break;
+            case KERNEL_WINGED_EDGE: {
+                GeMeshWingedEdge meshWE( sim.getMeshPtr() );
+            } break;
+            case KERNEL_VERTEX_NORMALS: {
+                _meshWE->calcVertexNormals( sim.getMesh(), _normals );
+            } break;
+            default: {
+                DGFX_ASSERT( false );
+            } break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 ClothBenchmark::getNbElements( Kernel kernel ) const
+{
+    const GeMesh& mesh = _simulator->getMesh();
+    const UInt32 N = mesh.getNbVertices();
+    switch ( kernel ) {
+        case KERNEL_MATRIX_MULTIPLY:
+        case KERNEL_MATRIX_ADD:
+            return _matrix.getPattern()->nbBlocks();
+        case KERNEL_SYM_MATRIX_MULTIPLY:
+            return _symMatrix.getPattern()->nbBlocks();
+        case KERNEL_PCG_SOLVE:
+            return N * std::max( _nbPCGIterations, 1U );
+        case KERNEL_PCG_SETUP:
+        case KERNEL_VERTEX_NORMALS:
+            return N;
+        case KERNEL_STRETCH_SHEAR:
+            return mesh.getNbFaces();
+        case KERNEL_BEND:
+            return _nbBendStencils;
+        case KERNEL_WINGED_EDGE:
+            return _meshWE->getNbHalfEdges();
+        default:
+            DGFX_ASSERT( false );
+            return 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+Float ClothBenchmark::getNbBytes( Kernel kernel ) const
+{
+    const UInt32 N = _src.size();
+    const Float vectorBytes = Float( N ) * sizeof( GeVector );
+    const Float rowBytes = Float( N + 1 ) * sizeof( UInt32 );
+    const Float blockBytes = sizeof( GeMatrix3 ) + sizeof( UInt32 );
+    switch ( kernel ) {
+        case KERNEL_MATRIX_MULTIPLY: {
+            const UInt32 nbBlocks = _matrix.getPattern()->nbBlocks();
+            return nbBlocks * blockBytes + rowBytes + 2 * vectorBytes;
+        }
+        case KERNEL_SYM_MATRIX_MULTIPLY: {
+            // The column index adds a slot and a row per off-diagonal
+            // block.
+            const UInt32 nbBlocks = _symMatrix.getPattern()->nbBlocks();
+            return nbBlocks * blockBytes
+                + Float( nbBlocks - N ) * 2 * sizeof( UInt32 )
+                + 2 * rowBytes + 2 * vectorBytes;
+        }
+        case KERNEL_MATRIX_ADD: {
+            const UInt32 nbBlocks = _matrix.getPattern()->nbBlocks();
+            return Float( nbBlocks ) * 3 * sizeof( GeMatrix3 );
+        }
+        default:
+            return 0;
+    }
+}
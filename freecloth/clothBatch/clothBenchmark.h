@@ -0,0 +1,158 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_clothBatch_clothBenchmark_h
+#define freecloth_clothBatch_clothBenchmark_h
+
+#ifndef freecloth_clothBatch_package_h
+#include <freecloth/clothBatch/package.h>
+#endif
+
+#ifndef freecloth_sim_simMatrix_h
+#include <freecloth/simulator/simMatrix.h>
+#endif
+
+#ifndef freecloth_sim_simSymMatrix_h
+#include <freecloth/simulator/simSymMatrix.h>
+#endif
+
+#ifndef freecloth_sim_simVector_h
+#include <freecloth/simulator/simVector.h>
+#endif
+
+#ifndef freecloth_geom_geVector_h
+#include <freecloth/geom/geVector.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+#ifndef freecloth_resmgt_rcShdPtr_h
+#include <freecloth/resmgt/rcShdPtr.h>
+#endif
+
+#ifndef freecloth_base_vector
+#include <freecloth/base/vector>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+FREECLOTH_NAMESPACE_START
+    class GeMesh;
+    class GeMeshWingedEdge;
+    class SimSimulator;
+FREECLOTH_NAMESPACE_END
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class ClothBenchmark freecloth/clothBatch/clothBenchmark.h
+ * \brief Runs the simulator's inner kernels in isolation, for timing.
+ *
+ * A benchmark owns a simulator for the given mesh, stepped a few frames so
+ * that the cloth is no longer flat, and matrices with the simulator's
+ * pattern. run() repeats a single kernel on that data, and leaves timing,
+ * repetition and statistics to the caller. getNbElements() and
+ * getNbBytes() give the work done by one run, for normalization.
+ *
+ * The simulator kernels are run through SimSimulator::runKernel(), in a
+ * step that is never finished, so they leave the simulator unusable for
+ * further stepping; it's only kept for the benchmark.
+ */
+class ClothBenchmark : public RCBase
+{
+public:
+    // ----- types and enumerations -----
+
+    enum Kernel {
+        //! SimMatrix::multiply(), with the full pattern of the mesh. One
+        //! element per block.
+        KERNEL_MATRIX_MULTIPLY,
+        //! SimSymMatrix::multiply(), as used by the simulator. One element
+        //! per stored block.
+        KERNEL_SYM_MATRIX_MULTIPLY,
+        //! SimMatrix::operator+=(). One element per block.
+        KERNEL_MATRIX_ADD,
+        //! A whole PCG solve of the step system. One element per vertex and
+        //! iteration, so that the setup, timed by KERNEL_PCG_SETUP, is
+        //! spread over the iterations.
+        KERNEL_PCG_SOLVE,
+        //! The preconditioner setup and initial residual alone. One element
+        //! per vertex.
+        KERNEL_PCG_SETUP,
+        //! Stretch and shear forces and derivatives, without the clearing
+        //! of the step's force and derivative arrays that precedes them.
+        //! One element per face.
+        KERNEL_STRETCH_SHEAR,
+        //! Bend, gravity and drag forces and derivatives. One element per
+        //! interior edge.
+        KERNEL_BEND,
+        //! Construction of a GeMeshWingedEdge. One element per half edge.
+        KERNEL_WINGED_EDGE,
+        //! GeMeshWingedEdge::calcVertexNormals(), as used for rendering.
+        //! One element per vertex.
+        KERNEL_VERTEX_NORMALS,
+
+        NB_KERNELS
+    };
+
+    // ----- static member functions -----
+
+    static const char* getKernelName( Kernel );
+
+    // ----- member functions -----
+
+    //! Set up the kernels' data for the given mesh, which is copied.
+    explicit ClothBenchmark( const GeMesh& );
+    virtual ~ClothBenchmark();
+
+    //! Run the kernel the given number of times.
+    void run( Kernel, UInt32 nbRuns );
+    //! Number of elements processed by one run of the kernel.
+    UInt32 getNbElements( Kernel ) const;
+    //! Estimate of the memory traffic of one run of the kernel, assuming
+    //! each array is read or written once. Zero for kernels whose traffic
+    //! isn't dominated by a few arrays.
+    Float getNbBytes( Kernel ) const;
+
+private:
+    // ----- member functions -----
+
+    // Benchmarks aren't copied.
+    ClothBenchmark( const ClothBenchmark& );
+    ClothBenchmark& operator=( const ClothBenchmark& );
+
+    // ----- data members -----
+
+    RCShdPtr<SimSimulator>  _simulator;
+    //! Topology of the mesh, as the simulator builds it.
+    RCShdPtr<GeMeshWingedEdge> _meshWE;
+    //! Matrices with the full pattern of the mesh.
+    SimMatrix               _matrix, _matrix2;
+    //! Matrix with the simulator's upper triangular pattern.
+    SimSymMatrix            _symMatrix;
+    SimVector               _src, _dest;
+    std::vector<GeVector>   _normals;
+    //! PCG iterations taken by a solve.
+    UInt32                  _nbPCGIterations;
+    //! Interior edges, each with a bend stencil.
+    UInt32                  _nbBendStencils;
+};
+
+#endif
@@ -0,0 +1,36 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_clothBatch_package_h
+#define freecloth_clothBatch_package_h
+
+#ifndef freecloth_base_types_h
+#include <freecloth/base/types.h>
+#endif
+
+#ifndef freecloth_base_debug_h
+#include <freecloth/base/debug.h>
+#endif
+
+#ifndef freecloth_base_baTime_h
+#include <freecloth/base/baTime.h>
+#endif
+
+using namespace freecloth;
+
+#endif
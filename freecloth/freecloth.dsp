@@ -158,14 +158,46 @@ SOURCE=.\resmgt\resConfigRegistryWindows.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simCollider.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\simulator\simMatrix.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simMatrixKernels.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simMatrixPattern.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simMultigrid.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simProfilerWindows.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simScene.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simSelfCollider.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\simulator\simSimulator.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simSparseLDLT.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\simulator\simStepStrategy.cpp
 # End Source File
 # Begin Source File
@@ -178,8 +210,28 @@ SOURCE=.\simulator\simStepStrategyBasic.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simStepStrategyPI.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simSymMatrix.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simThreadPool.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simThreadPoolWindows.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\simulator\simVector.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simWorld.cpp
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -362,6 +414,10 @@ SOURCE=.\resmgt\resConfigRegistryWindows.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simCollider.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\simulator\simMatrix.h
 # End Source File
 # Begin Source File
@@ -370,10 +426,42 @@ SOURCE=.\simulator\simMatrix.inline.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simMatrixKernels.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simMatrixPattern.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simMatrixPattern.inline.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simMultigrid.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simProfiler.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simScene.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simSelfCollider.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\simulator\simSimulator.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simSparseLDLT.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\simulator\simStepStrategy.h
 # End Source File
 # Begin Source File
@@ -386,6 +474,22 @@ SOURCE=.\simulator\simStepStrategyBasic.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simStepStrategyPI.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simSymMatrix.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simSymMatrix.inline.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\simulator\simThreadPool.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\simulator\simVector.h
 # End Source File
 # Begin Source File
@@ -394,6 +498,10 @@ SOURCE=.\simulator\simVector.inline.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\simulator\simWorld.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\base\stdio.h
 # End Source File
 # Begin Source File
@@ -402,6 +510,10 @@ SOURCE=.\base\stdlib.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\base\string.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\base\types.h
 # End Source File
 # Begin Source File
@@ -73,9 +73,9 @@ inline GeMatrix3 GeMatrix3::colMajor( const Float data[ 9 ] )
 inline GeMatrix3 GeMatrix3::rowMajor( const Float data[ 9 ] )
 {
     return GeMatrix3(
-        data[ 0 ], data[ 3 ], data[ 6 ],
-        data[ 1 ], data[ 4 ], data[ 7 ],
-        data[ 2 ], data[ 5 ], data[ 8 ]
+        data[ 0 ], data[ 1 ], data[ 2 ],
+        data[ 3 ], data[ 4 ], data[ 5 ],
+        data[ 6 ], data[ 7 ], data[ 8 ]
     );
 }
 
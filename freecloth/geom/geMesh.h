@@ -110,6 +110,11 @@ public:
     VertexIterator endVertex();
     VertexConstIterator beginVertex() const;
     VertexConstIterator endVertex() const;
+    //! Exchange the vertex positions with the given container, which must
+    //! hold the same number of vertices. This allows positions to be
+    //! double-buffered without copying. Pointers from getVertexArray() are
+    //! invalidated.
+    void swapVertices( VertexContainer& );
 
     bool hasTexture() const;
     UInt32 getNbTextureVertices() const;
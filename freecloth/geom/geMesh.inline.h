@@ -112,6 +112,14 @@ inline GeMesh::VertexConstIterator GeMesh::endVertex() const
 
 //------------------------------------------------------------------------------
 
+inline void GeMesh::swapVertices( VertexContainer& vertices )
+{
+    DGFX_ASSERT( vertices.size() == _vertices.size() );
+    _vertices.swap( vertices );
+}
+
+//------------------------------------------------------------------------------
+
 inline bool GeMesh::hasTexture() const
 {
     return getNbTextureVertices() > 0;
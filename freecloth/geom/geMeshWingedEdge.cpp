@@ -17,6 +17,7 @@
 // Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 #include <freecloth/geom/geMeshWingedEdge.imp.h>
+#include <freecloth/geom/geVector.h>
 #include <freecloth/base/map>
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -144,6 +145,41 @@ void GeMeshWingedEdge::build( const GeMesh& mesh )
 
 //------------------------------------------------------------------------------
 
+void GeMeshWingedEdge::calcVertexNormals(
+    const GeMesh& mesh,
+    std::vector<GeVector>& normals
+) const {
+    DGFX_ASSERT( mesh.getNbVertices() == _vertexHalfEdgeIds.size() );
+    DGFX_ASSERT( mesh.getNbFaces() == _faceHalfEdgeIds.size() );
+    std::vector<GeVector> faceNormals( mesh.getNbFaces() );
+    GeMesh::FaceConstIterator fi;
+    for ( fi = mesh.beginFace(); fi != mesh.endFace(); ++fi ) {
+        faceNormals[ fi->getFaceId() ] = fi->calcNormal();
+    }
+    normals.resize( mesh.getNbVertices() );
+    for ( VertexId vid = 0; vid < mesh.getNbVertices(); ++vid ) {
+        VertexFaceIterator vfi;
+        GeVector normal( GeVector::zero() );
+        UInt32 nbFaces = 0;
+        for (
+            vfi = beginVertexFace( vid );
+            vfi != endVertexFace( vid );
+            ++vfi
+        ) {
+            normal += faceNormals[ vfi->getFaceId() ];
+            ++nbFaces;
+        }
+        if ( nbFaces > 0 ) {
+            normals[ vid ] = normal / nbFaces;
+        }
+        else {
+            normals[ vid ] = normal;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
 inline const RCShdPtr<GeMesh>& GeMeshWingedEdge::getMeshPtr() const
 {
     return _mesh;
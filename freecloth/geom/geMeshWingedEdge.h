@@ -149,6 +149,15 @@ public:
     const RCShdPtr<GeMesh>& getMeshPtr() const;
     const GeMesh& getMesh() const;
 
+    //! Compute the normal of each vertex of mesh as the average of the
+    //! unit normals of the faces around it. mesh must have the same
+    //! topology as getMesh(), but may have moved, as for a simulated
+    //! copy.
+    void calcVertexNormals(
+        const GeMesh& mesh,
+        std::vector<GeVector>& normals
+    ) const;
+
 private:
 
     // ----- classes -----
@@ -84,6 +84,8 @@ public:
 
     //! Dot product
     Float dot( const GeVector& ) const;
+    //! Dot product, evaluated in double precision
+    Double dotDouble( const GeVector& ) const;
     //! Cross product
     GeVector cross( const GeVector& ) const;
 
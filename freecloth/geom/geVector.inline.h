@@ -232,6 +232,14 @@ inline Float GeVector::dot( const GeVector& rhs ) const
 
 //------------------------------------------------------------------------------
 
+inline Double GeVector::dotDouble( const GeVector& rhs ) const
+{
+    return Double( _x ) * rhs._x + Double( _y ) * rhs._y +
+        Double( _z ) * rhs._z;
+}
+
+//------------------------------------------------------------------------------
+
 inline GeVector GeVector::cross( const GeVector& rhs ) const
 {
     return GeVector(
@@ -70,7 +70,7 @@ void GL::light( GLenum light, GLenum pname, const ColColourRGB& c, Float alpha )
     DGFX_ASSERT(
         pname == GL_AMBIENT || pname == GL_DIFFUSE || pname == GL_SPECULAR
     );
-    const Float data[] = { c._r, c._g, c._b, alpha };
+    const GLfloat data[] = { c._r, c._g, c._b, alpha };
     ::glLightfv( light, pname, data );
 }
 
@@ -87,7 +87,7 @@ void GL::material(
         pname == GL_EMISSION || pname == GL_SHININESS ||
         pname == GL_AMBIENT_AND_DIFFUSE
     );
-    const Float data[] = { c._r, c._g, c._b, alpha };
+    const GLfloat data[] = { c._r, c._g, c._b, alpha };
     ::glMaterialfv( face, pname, data );
 }
 
@@ -72,7 +72,8 @@ void ResConfigRegistryW::writeTimeDuration(
     const String& key,
     BaTime::Duration value
 ) {
-    writeUInt32( key, value );
+    // Stored in milliseconds, as when durations were counted in them.
+    writeUInt32( key, UInt32( value / BaTime::MS ) );
 }
 
 //------------------------------------------------------------------------------
@@ -162,7 +163,9 @@ BaTime::Duration ResConfigRegistryR::readTimeDuration(
     const String& key,
     BaTime::Duration def
 ) const {
-    return readUInt32( key, def );
+    return BaTime::Duration(
+        readUInt32( key, UInt32( def / BaTime::MS ) )
+    ) * BaTime::MS;
 }
 
 //------------------------------------------------------------------------------
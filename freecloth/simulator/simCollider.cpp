@@ -0,0 +1,736 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simCollider.h>
+#include <freecloth/simulator/simThreadPool.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/base/baMath.h>
+#include <freecloth/base/algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    using namespace freecloth;
+
+    //! The grid is sized for about this many vertices per cell.
+    const Float VERTICES_PER_CELL = 4;
+    //! Thickness given to new colliders, in metres.
+    const Float DEFAULT_THICKNESS = .005f;
+    //! Half the diagonal of a unit cube.
+    const Float HALF_DIAGONAL = .8660254f;
+
+//------------------------------------------------------------------------------
+
+    //! Signed distance from p to the surface of the sphere, and its outward
+    //! normal. Points at the centre get an arbitrary normal.
+    Float sphereDistance(
+        const GePoint& p,
+        const GePoint& centre,
+        Float radius,
+        GeVector& normal
+    ) {
+        const GeVector offset( p - centre );
+        const Float length = offset.length();
+        if ( length > 0 ) {
+            normal = offset / length;
+        }
+        else {
+            normal = GeVector::zAxis();
+        }
+        return length - radius;
+    }
+}
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimCollider::BoundsTask freecloth/simulator/simCollider.cpp
+ *
+ * Bounds each thread's chunk of the vertices into its entries of
+ * Grid::_threadBounds, which start out holding the first vertex.
+ */
+class SimCollider::BoundsTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    BoundsTask( const GeMesh&, Grid& );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+
+    // ----- data members -----
+    const GeMesh&   _mesh;
+    Grid&           _grid;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimCollider::BinTask freecloth/simulator/simCollider.cpp
+ *
+ * Finds the cell of each vertex in a range, once the grid is set up.
+ */
+class SimCollider::BinTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    BinTask( const GeMesh&, Grid& );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+
+    // ----- data members -----
+    const GeMesh&   _mesh;
+    Grid&           _grid;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimCollider::ContactTask freecloth/simulator/simCollider.cpp
+ *
+ * Finds the contacts of the vertices of a range of Grid::_occupiedCells.
+ * Each vertex lies in a single cell, so threads never write the same
+ * contact.
+ */
+class SimCollider::ContactTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    ContactTask(
+        const SimCollider&,
+        const GeMesh&,
+        Float margin,
+        const Grid&,
+        std::vector<Contact>&
+    );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+
+    // ----- data members -----
+    const SimCollider& _collider;
+    const GeMesh&   _mesh;
+    Float           _margin;
+    const Grid&     _grid;
+    std::vector<Contact>& _contacts;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimCollider::Obstacle
+
+//------------------------------------------------------------------------------
+
+SimCollider::Obstacle SimCollider::Obstacle::plane(
+    const GePoint& point,
+    const GeVector& normal
+) {
+    Obstacle obstacle;
+    obstacle._type = OBSTACLE_PLANE;
+    obstacle._point = point;
+    obstacle._normal = normal.getUnit();
+    return obstacle;
+}
+
+//------------------------------------------------------------------------------
+
+SimCollider::Obstacle SimCollider::Obstacle::sphere(
+    const GePoint& centre,
+    Float radius
+) {
+    DGFX_ASSERT( radius >= 0 );
+    Obstacle obstacle;
+    obstacle._type = OBSTACLE_SPHERE;
+    obstacle._point = centre;
+    obstacle._radius = radius;
+    return obstacle;
+}
+
+//------------------------------------------------------------------------------
+
+SimCollider::Obstacle SimCollider::Obstacle::capsule(
+    const GePoint& end0,
+    const GePoint& end1,
+    Float radius
+) {
+    DGFX_ASSERT( radius >= 0 );
+    Obstacle obstacle;
+    obstacle._type = OBSTACLE_CAPSULE;
+    obstacle._point = end0;
+    obstacle._end = end1;
+    obstacle._radius = radius;
+    return obstacle;
+}
+
+//------------------------------------------------------------------------------
+
+SimCollider::Obstacle SimCollider::Obstacle::box(
+    const GePoint& centre,
+    const GeMatrix3& orientation,
+    const GeVector& halfExtents
+) {
+    DGFX_ASSERT(
+        halfExtents._x >= 0 && halfExtents._y >= 0 && halfExtents._z >= 0
+    );
+    Obstacle obstacle;
+    obstacle._type = OBSTACLE_BOX;
+    obstacle._point = centre;
+    obstacle._orientation = orientation;
+    obstacle._halfExtents = halfExtents;
+    return obstacle;
+}
+
+//------------------------------------------------------------------------------
+
+SimCollider::Obstacle::Obstacle()
+  : _type( OBSTACLE_SPHERE ),
+    _point( GePoint::ZERO ),
+    _end( GePoint::ZERO ),
+    _normal( GeVector::zAxis() ),
+    _radius( 1 ),
+    _orientation( GeMatrix3::identity() ),
+    _halfExtents( GeVector::zero() )
+{
+}
+
+//------------------------------------------------------------------------------
+
+Float SimCollider::Obstacle::calcDistance(
+    const GePoint& p,
+    GeVector& normal
+) const {
+    switch ( _type ) {
+        case OBSTACLE_PLANE: {
+            normal = _normal;
+            return ( p - _point ).dot( _normal );
+        }
+
+        case OBSTACLE_SPHERE: {
+            return sphereDistance( p, _point, _radius, normal );
+        }
+
+        case OBSTACLE_CAPSULE: {
+            // Distance from the nearest point of the segment.
+            const GeVector axis( _end - _point );
+            const Float length2 = axis.dot( axis );
+            Float t = 0;
+            if ( length2 > 0 ) {
+                t = ( p - _point ).dot( axis ) / length2;
+                t = std::max( Float( 0 ), std::min( Float( 1 ), t ) );
+            }
+            return sphereDistance( p, _point + t * axis, _radius, normal );
+        }
+
+        case OBSTACLE_BOX: {
+            // Work in the box's frame, where it's axis-aligned.
+            const GeVector local( ( p - _point ) * _orientation );
+            GeVector outside( GeVector::zero() );
+            UInt32 nearest = 0;
+            Float depth = 0;
+            for ( UInt32 i = 0; i < 3; ++i ) {
+                const Float a = BaMath::abs( local[ i ] ) - _halfExtents[ i ];
+                if ( a > 0 ) {
+                    outside[ i ] = local[ i ] < 0 ? -a : a;
+                }
+                if ( i == 0 || a > depth ) {
+                    depth = a;
+                    nearest = i;
+                }
+            }
+            const Float length = outside.length();
+            if ( length > 0 ) {
+                normal = _orientation * ( outside / length );
+                return length;
+            }
+            // Inside: the nearest face is the one that's least deep.
+            GeVector axis( GeVector::zero() );
+            axis[ nearest ] = local[ nearest ] < 0 ? -1 : 1;
+            normal = _orientation * axis;
+            return depth;
+        }
+    }
+    DGFX_ASSERT( false );
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimCollider::Obstacle::calcBounds( GePoint& min, GePoint& max ) const
+{
+    switch ( _type ) {
+        case OBSTACLE_PLANE: {
+            return false;
+        }
+
+        case OBSTACLE_SPHERE: {
+            const GeVector r( _radius, _radius, _radius );
+            min = _point - r;
+            max = _point + r;
+        } break;
+
+        case OBSTACLE_CAPSULE: {
+            const GeVector r( _radius, _radius, _radius );
+            for ( UInt32 i = 0; i < 3; ++i ) {
+                min[ i ] = std::min( _point[ i ], _end[ i ] );
+                max[ i ] = std::max( _point[ i ], _end[ i ] );
+            }
+            min -= r;
+            max += r;
+        } break;
+
+        case OBSTACLE_BOX: {
+            GeVector r;
+            for ( UInt32 i = 0; i < 3; ++i ) {
+                r[ i ] = 0;
+                for ( UInt32 j = 0; j < 3; ++j ) {
+                    r[ i ] += BaMath::abs( _orientation( i, j ) ) *
+                        _halfExtents[ j ];
+                }
+            }
+            min = _point - r;
+            max = _point + r;
+        } break;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+SimCollider::ObstacleType SimCollider::Obstacle::getType() const
+{
+    return _type;
+}
+
+//------------------------------------------------------------------------------
+
+const GePoint& SimCollider::Obstacle::getPoint() const
+{
+    return _point;
+}
+
+//------------------------------------------------------------------------------
+
+const GePoint& SimCollider::Obstacle::getEnd() const
+{
+    return _end;
+}
+
+//------------------------------------------------------------------------------
+
+const GeVector& SimCollider::Obstacle::getNormal() const
+{
+    return _normal;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimCollider::Obstacle::getRadius() const
+{
+    return _radius;
+}
+
+//------------------------------------------------------------------------------
+
+const GeMatrix3& SimCollider::Obstacle::getOrientation() const
+{
+    return _orientation;
+}
+
+//------------------------------------------------------------------------------
+
+const GeVector& SimCollider::Obstacle::getHalfExtents() const
+{
+    return _halfExtents;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimCollider::Grid
+
+//------------------------------------------------------------------------------
+
+SimCollider::Grid::Grid()
+  : _origin( GePoint::ZERO ),
+    _cellSize( 1 )
+{
+    _dims[ 0 ] = _dims[ 1 ] = _dims[ 2 ] = 1;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimCollider::Grid::getNbOccupiedCells() const
+{
+    return _occupiedCells.size();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimCollider::BoundsTask
+
+//------------------------------------------------------------------------------
+
+SimCollider::BoundsTask::BoundsTask( const GeMesh& mesh, Grid& grid )
+  : _mesh( mesh ),
+    _grid( grid )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::BoundsTask::run(
+    UInt32 begin,
+    UInt32 end,
+    UInt32 threadIndex
+) {
+    GePoint min( _grid._threadBounds[ 2 * threadIndex ] );
+    GePoint max( _grid._threadBounds[ 2 * threadIndex + 1 ] );
+    for ( UInt32 v = begin; v < end; ++v ) {
+        const GePoint& p = _mesh.getVertex( v );
+        for ( UInt32 i = 0; i < 3; ++i ) {
+            min[ i ] = std::min( min[ i ], p[ i ] );
+            max[ i ] = std::max( max[ i ], p[ i ] );
+        }
+    }
+    _grid._threadBounds[ 2 * threadIndex ] = min;
+    _grid._threadBounds[ 2 * threadIndex + 1 ] = max;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimCollider::BinTask
+
+//------------------------------------------------------------------------------
+
+SimCollider::BinTask::BinTask( const GeMesh& mesh, Grid& grid )
+  : _mesh( mesh ),
+    _grid( grid )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::BinTask::run( UInt32 begin, UInt32 end, UInt32 )
+{
+    const Float scale = 1 / _grid._cellSize;
+    for ( UInt32 v = begin; v < end; ++v ) {
+        const GeVector offset( _mesh.getVertex( v ) - _grid._origin );
+        UInt32 cell = 0;
+        for ( UInt32 i = 0; i < 3; ++i ) {
+            // Rounding can put the highest vertices one cell too far.
+            const UInt32 c = std::min(
+                static_cast<UInt32>( offset[ i ] * scale ),
+                _grid._dims[ i ] - 1
+            );
+            cell = cell * _grid._dims[ i ] + c;
+        }
+        _grid._vertexCells[ v ] = cell;
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimCollider::ContactTask
+
+//------------------------------------------------------------------------------
+
+SimCollider::ContactTask::ContactTask(
+    const SimCollider& collider,
+    const GeMesh& mesh,
+    Float margin,
+    const Grid& grid,
+    std::vector<Contact>& contacts
+) : _collider( collider ),
+    _mesh( mesh ),
+    _margin( margin ),
+    _grid( grid ),
+    _contacts( contacts )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::ContactTask::run( UInt32 begin, UInt32 end, UInt32 )
+{
+    const Grid& grid = _grid;
+    const UInt32 nbObstacles = _collider._obstacles.size();
+    const Float cellReach = grid._cellSize * HALF_DIAGONAL + _margin;
+    for ( UInt32 k = begin; k < end; ++k ) {
+        const UInt32 cell = grid._occupiedCells[ k ];
+        const UInt32 first = grid._cellStarts[ cell ];
+        const UInt32 last = grid._cellStarts[ cell + 1 ];
+        UInt32 j;
+        for ( j = first; j < last; ++j ) {
+            _contacts[ grid._cellVertices[ j ] ]._obstacle = OBSTACLE_INVALID;
+        }
+
+        Int32 coords[ 3 ];
+        UInt32 rest = cell;
+        for ( Int32 i = 2; i >= 0; --i ) {
+            coords[ i ] = rest % grid._dims[ i ];
+            rest /= grid._dims[ i ];
+        }
+        const GePoint centre(
+            grid._origin._x + ( coords[ 0 ] + .5f ) * grid._cellSize,
+            grid._origin._y + ( coords[ 1 ] + .5f ) * grid._cellSize,
+            grid._origin._z + ( coords[ 2 ] + .5f ) * grid._cellSize
+        );
+
+        for ( UInt32 o = 0; o < nbObstacles; ++o ) {
+            const Int32* range = &grid._obstacleCells[ 6 * o ];
+            if ( coords[ 0 ] < range[ 0 ] || coords[ 0 ] > range[ 1 ] ||
+                coords[ 1 ] < range[ 2 ] || coords[ 1 ] > range[ 3 ] ||
+                coords[ 2 ] < range[ 4 ] || coords[ 2 ] > range[ 5 ]
+            ) {
+                continue;
+            }
+            // Signed distances change no faster than the point moves, so
+            // no vertex of the cell is within the margin if the centre is
+            // this far away.
+            const Obstacle& obstacle = _collider._obstacles[ o ];
+            GeVector normal;
+            if ( obstacle.calcDistance( centre, normal ) > cellReach ) {
+                continue;
+            }
+            for ( j = first; j < last; ++j ) {
+                const UInt32 v = grid._cellVertices[ j ];
+                const Float distance = obstacle.calcDistance(
+                    _mesh.getVertex( v ), normal
+                );
+                Contact& contact = _contacts[ v ];
+                if ( distance <= _margin && (
+                    contact._obstacle == OBSTACLE_INVALID ||
+                    distance < contact._distance
+                ) ) {
+                    contact._obstacle = o;
+                    contact._distance = distance;
+                    contact._normal = normal;
+                }
+            }
+        }
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimCollider
+
+//------------------------------------------------------------------------------
+
+SimCollider::SimCollider()
+  : _thickness( DEFAULT_THICKNESS )
+{
+}
+
+//------------------------------------------------------------------------------
+
+SimCollider::~SimCollider()
+{
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimCollider::addObstacle( const Obstacle& obstacle )
+{
+    _obstacles.push_back( obstacle );
+    return _obstacles.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::setObstacle( UInt32 index, const Obstacle& obstacle )
+{
+    DGFX_ASSERT( index < _obstacles.size() );
+    _obstacles[ index ] = obstacle;
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::removeAllObstacles()
+{
+    _obstacles.clear();
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimCollider::getNbObstacles() const
+{
+    return _obstacles.size();
+}
+
+//------------------------------------------------------------------------------
+
+const SimCollider::Obstacle& SimCollider::getObstacle( UInt32 index ) const
+{
+    DGFX_ASSERT( index < _obstacles.size() );
+    return _obstacles[ index ];
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::setThickness( Float thickness )
+{
+    DGFX_ASSERT( thickness >= 0 );
+    _thickness = thickness;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimCollider::getThickness() const
+{
+    return _thickness;
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::detect(
+    const GeMesh& mesh,
+    Float margin,
+    SimThreadPool& threadPool,
+    Grid& grid,
+    std::vector<Contact>& contacts
+) const {
+    const UInt32 N = mesh.getNbVertices();
+    contacts.resize( N );
+    if ( N == 0 ) {
+        return;
+    }
+    if ( _obstacles.empty() ) {
+        for ( UInt32 v = 0; v < N; ++v ) {
+            contacts[ v ]._obstacle = OBSTACLE_INVALID;
+        }
+        return;
+    }
+
+    grid._threadBounds.assign(
+        2 * threadPool.getNbThreads(), mesh.getVertex( 0 )
+    );
+    BoundsTask boundsTask( mesh, grid );
+    threadPool.run( boundsTask, N );
+    setupGrid( N, margin, grid );
+
+    grid._vertexCells.resize( N );
+    BinTask binTask( mesh, grid );
+    threadPool.run( binTask, N );
+    sortVertices( grid );
+
+    ContactTask contactTask( *this, mesh, margin, grid, contacts );
+    threadPool.run( contactTask, grid._occupiedCells.size() );
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::setupGrid(
+    UInt32 nbVertices,
+    Float margin,
+    Grid& grid
+) const {
+    GePoint min( grid._threadBounds[ 0 ] );
+    GePoint max( grid._threadBounds[ 1 ] );
+    UInt32 i;
+    for ( UInt32 t = 1; 2 * t < grid._threadBounds.size(); ++t ) {
+        for ( i = 0; i < 3; ++i ) {
+            min[ i ] = std::min( min[ i ], grid._threadBounds[ 2 * t ][ i ] );
+            max[ i ] = std::max(
+                max[ i ], grid._threadBounds[ 2 * t + 1 ][ i ]
+            );
+        }
+    }
+
+    // Cubic cells, sized for VERTICES_PER_CELL, as if the vertices were
+    // spread evenly over the box. Cloth is often flat, or nearly so, so
+    // axes that are thinner than a cell are ignored.
+    const GeVector extents( max - min );
+    Float sorted[ 3 ] = { extents._x, extents._y, extents._z };
+    std::sort( sorted, sorted + 3 );
+    const Float nbCells = std::max(
+        Float( 1 ), nbVertices / VERTICES_PER_CELL
+    );
+    Float size = std::pow(
+        sorted[ 0 ] * sorted[ 1 ] * sorted[ 2 ] / nbCells, Float( 1 ) / 3
+    );
+    if ( ! ( size < sorted[ 0 ] ) ) {
+        size = BaMath::sqrt( sorted[ 1 ] * sorted[ 2 ] / nbCells );
+        if ( ! ( size < sorted[ 1 ] ) ) {
+            size = sorted[ 2 ] / nbCells;
+        }
+    }
+    if ( ! ( size > 0 ) ) {
+        // All of the vertices coincide.
+        size = 1;
+    }
+    grid._origin = min;
+    grid._cellSize = size;
+    for ( i = 0; i < 3; ++i ) {
+        grid._dims[ i ] = BaMath::floorUInt32( extents[ i ] / size ) + 1;
+    }
+
+    // Cells that each obstacle might reach. Unbounded obstacles reach all.
+    const Float scale = 1 / size;
+    grid._obstacleCells.resize( 6 * _obstacles.size() );
+    for ( UInt32 o = 0; o < _obstacles.size(); ++o ) {
+        Int32* range = &grid._obstacleCells[ 6 * o ];
+        GePoint obstacleMin, obstacleMax;
+        if ( ! _obstacles[ o ].calcBounds( obstacleMin, obstacleMax ) ) {
+            for ( i = 0; i < 3; ++i ) {
+                range[ 2 * i ] = 0;
+                range[ 2 * i + 1 ] = grid._dims[ i ] - 1;
+            }
+            continue;
+        }
+        for ( i = 0; i < 3; ++i ) {
+            // Clamped to just outside the grid, to stay within Int32.
+            const Float outside = Float( grid._dims[ i ] + 1 );
+            const Float low = ( obstacleMin[ i ] - margin - min[ i ] ) * scale;
+            const Float high = ( obstacleMax[ i ] + margin - min[ i ] ) * scale;
+            range[ 2 * i ] = BaMath::floorInt32(
+                std::max( Float( -1 ), std::min( outside, low ) )
+            );
+            range[ 2 * i + 1 ] = BaMath::floorInt32(
+                std::max( Float( -1 ), std::min( outside, high ) )
+            );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimCollider::sortVertices( Grid& grid ) const
+{
+    // Counting sort, which keeps the vertices of each cell in order.
+    const UInt32 nbCells = grid._dims[ 0 ] * grid._dims[ 1 ] * grid._dims[ 2 ];
+    const UInt32 N = grid._vertexCells.size();
+    grid._cellStarts.assign( nbCells + 1, 0 );
+    UInt32 c, v;
+    for ( v = 0; v < N; ++v ) {
+        ++grid._cellStarts[ grid._vertexCells[ v ] + 1 ];
+    }
+    grid._occupiedCells.clear();
+    for ( c = 0; c < nbCells; ++c ) {
+        if ( grid._cellStarts[ c + 1 ] > 0 ) {
+            grid._occupiedCells.push_back( c );
+        }
+        grid._cellStarts[ c + 1 ] += grid._cellStarts[ c ];
+    }
+    grid._cellVertices.resize( N );
+    for ( v = 0; v < N; ++v ) {
+        grid._cellVertices[ grid._cellStarts[ grid._vertexCells[ v ] ]++ ] = v;
+    }
+    // The starts were advanced to the ends; shift them back.
+    for ( c = nbCells; c > 0; --c ) {
+        grid._cellStarts[ c ] = grid._cellStarts[ c - 1 ];
+    }
+    grid._cellStarts[ 0 ] = 0;
+}
+
+FREECLOTH_NAMESPACE_END
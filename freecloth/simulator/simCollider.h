@@ -0,0 +1,291 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#ifndef freecloth_sim_simCollider_h
+#define freecloth_sim_simCollider_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_geom_gePoint_h
+#include <freecloth/geom/gePoint.h>
+#endif
+
+#ifndef freecloth_geom_geVector_h
+#include <freecloth/geom/geVector.h>
+#endif
+
+#ifndef freecloth_geom_geMatrix3_h
+#include <freecloth/geom/geMatrix3.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+#ifndef freecloth_base_vector
+#include <freecloth/base/vector>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class GeMesh;
+class SimThreadPool;
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimCollider freecloth/simulator/simCollider.h
+ * \brief Analytic obstacles for the cloth to collide with.
+ *
+ * A collider holds any number of rigid obstacles: infinite planes,
+ * spheres, capsules and oriented boxes. Each is described exactly, by its
+ * signed distance function, so contacts are found without tessellating
+ * anything. Obstacles may be moved between steps, but are treated as being
+ * at rest within each step.
+ *
+ * detect() finds, for each vertex of a mesh, the nearest obstacle surface
+ * within a given margin. The vertices are first binned into a uniform grid
+ * sized to the mesh's bounding box, so that each obstacle is only tested
+ * against the vertices of the cells it might reach: whole cells are
+ * culled by the distance to their centres. The binning and the tests are
+ * split over a thread pool, and the cost is linear in the number of
+ * vertices, for a fixed number of obstacles.
+ *
+ * SimSimulator turns the contacts into constraints, as described in
+ * [BarWit98] section 5: the vertex may move freely in the tangent plane of
+ * the obstacle, but its velocity along the normal is set so that it stops
+ * getThickness() away from the surface.
+ *
+ * detect() doesn't change the collider, so a collider may be shared by
+ * simulators stepped concurrently, as long as the obstacles aren't changed
+ * while they step. The grid is kept by the caller, in a Grid.
+ */
+class SimCollider : public RCBase
+{
+public:
+    // ----- types and enumerations -----
+
+    enum ObstacleType {
+        OBSTACLE_PLANE,
+        OBSTACLE_SPHERE,
+        OBSTACLE_CAPSULE,
+        OBSTACLE_BOX
+    };
+    enum { OBSTACLE_INVALID = ~0U };
+
+    // ----- classes -----
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class Obstacle freecloth/simulator/simCollider.h
+     * \brief A single analytic obstacle.
+     */
+    class Obstacle
+    {
+    public:
+        // ----- static member functions -----
+
+        //! Named constructor: the half space below the plane through point,
+        //! with the given outward normal.
+        static Obstacle plane( const GePoint& point, const GeVector& normal );
+        //! Named constructor: a solid sphere.
+        static Obstacle sphere( const GePoint& centre, Float radius );
+        //! Named constructor: the points within radius of the segment
+        //! [ end0, end1 ].
+        static Obstacle capsule(
+            const GePoint& end0,
+            const GePoint& end1,
+            Float radius
+        );
+        //! Named constructor: a solid box, with the given half extents
+        //! along the columns of orientation, which must be a rotation.
+        static Obstacle box(
+            const GePoint& centre,
+            const GeMatrix3& orientation,
+            const GeVector& halfExtents
+        );
+
+        // ----- member functions -----
+
+        //! A unit sphere at the origin.
+        Obstacle();
+        // Default copy constructor is fine.
+        // Default assignment operator is fine.
+
+        //! Signed distance from the surface to p, negative inside. The
+        //! outward unit normal of the surface at the nearest point is
+        //! returned in normal.
+        Float calcDistance( const GePoint& p, GeVector& normal ) const;
+        //! Axis-aligned bounding box. Returns false, leaving min and max
+        //! alone, if the obstacle is unbounded.
+        bool calcBounds( GePoint& min, GePoint& max ) const;
+
+        //@{
+        //! Accessor. The point is the point on a plane, the centre of a
+        //! sphere or box, or the first end of a capsule, and the end is
+        //! the second end of a capsule.
+        ObstacleType getType() const;
+        const GePoint& getPoint() const;
+        const GePoint& getEnd() const;
+        const GeVector& getNormal() const;
+        Float getRadius() const;
+        const GeMatrix3& getOrientation() const;
+        const GeVector& getHalfExtents() const;
+        //@}
+
+    private:
+        // ----- data members -----
+
+        ObstacleType    _type;
+        GePoint         _point;
+        GePoint         _end;
+        //! Unit normal of a plane.
+        GeVector        _normal;
+        Float           _radius;
+        GeMatrix3       _orientation;
+        GeVector        _halfExtents;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class Contact freecloth/simulator/simCollider.h
+     * \brief Nearest obstacle to a vertex, as found by detect().
+     */
+    class Contact
+    {
+    public:
+        // ----- data members -----
+
+        //! Index of the obstacle, or OBSTACLE_INVALID if none is within
+        //! the margin, in which case the other members are undefined.
+        UInt32          _obstacle;
+        //! Signed distance from the obstacle's surface.
+        Float           _distance;
+        //! Outward unit normal of the obstacle's surface.
+        GeVector        _normal;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class Grid freecloth/simulator/simCollider.h
+     * \brief Workspace of detect(): the vertices of a mesh, binned into a
+     * uniform grid.
+     *
+     * The grid is rebuilt by every call, but its storage is kept, so keep
+     * one per mesh to avoid allocating on each step.
+     */
+    class Grid
+    {
+    public:
+        // ----- member functions -----
+
+        Grid();
+        //! Number of cells holding at least one vertex, in the last
+        //! detect().
+        UInt32 getNbOccupiedCells() const;
+
+    private:
+        // ----- friends -----
+
+        friend class SimCollider;
+
+        // ----- data members -----
+
+        //! Corner of the first cell, and the size of each.
+        GePoint         _origin;
+        Float           _cellSize;
+        //! Number of cells along each axis.
+        UInt32          _dims[ 3 ];
+        //! Bounding box of each thread's vertices, min then max.
+        std::vector<GePoint> _threadBounds;
+        //! Cell of each vertex, in x-major order.
+        std::vector<UInt32> _vertexCells;
+        //! The vertices of cell c are _cellVertices[ _cellStarts[ c ] ..
+        //! _cellStarts[ c + 1 ] ).
+        std::vector<UInt32> _cellStarts, _cellVertices;
+        std::vector<UInt32> _occupiedCells;
+        //! Range of cells reached by each obstacle, as the lowest and
+        //! highest cell along each axis.
+        std::vector<Int32> _obstacleCells;
+    };
+
+    // ----- member functions -----
+
+    SimCollider();
+    virtual ~SimCollider();
+
+    //! Add an obstacle, and return its index.
+    UInt32 addObstacle( const Obstacle& );
+    //! Replace an obstacle, to move it.
+    void setObstacle( UInt32 index, const Obstacle& );
+    void removeAllObstacles();
+    UInt32 getNbObstacles() const;
+    const Obstacle& getObstacle( UInt32 index ) const;
+
+    //! Distance that contacts keep the cloth vertices from the obstacles'
+    //! surfaces. Defaults to 5mm.
+    void setThickness( Float );
+    Float getThickness() const;
+
+    //! Find the nearest obstacle to each vertex of the mesh, among those
+    //! within margin of it, and store it in contacts, which is resized to
+    //! the number of vertices. The work is split over the pool, and grid
+    //! holds the binning.
+    void detect(
+        const GeMesh&,
+        Float margin,
+        SimThreadPool&,
+        Grid& grid,
+        std::vector<Contact>& contacts
+    ) const;
+
+private:
+    // ----- classes -----
+
+    //! Find the bounds of a range of vertices.
+    class BoundsTask;
+    //! Find the cell of a range of vertices.
+    class BinTask;
+    //! Test a range of occupied cells against the obstacles.
+    class ContactTask;
+    friend class BoundsTask;
+    friend class BinTask;
+    friend class ContactTask;
+
+    // ----- member functions -----
+
+    //! Size the grid to the vertices' bounds, once they're known, and
+    //! find the cells reached by each obstacle.
+    void setupGrid( UInt32 nbVertices, Float margin, Grid& ) const;
+    //! Sort the vertices by cell, once each one's cell is known.
+    void sortVertices( Grid& ) const;
+
+    // ----- data members -----
+
+    std::vector<Obstacle> _obstacles;
+    Float           _thickness;
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif
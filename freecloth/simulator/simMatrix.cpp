@@ -17,6 +17,7 @@
 // Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 #include <freecloth/simulator/simMatrix.h>
+#include <freecloth/simulator/simMatrixKernels.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 // LOCAL DECLARATIONS
@@ -32,53 +33,158 @@ SimMatrix& SimMatrix::operator+=( const SimMatrix& rhs )
 {
     DGFX_ASSERT( nbRows() == rhs.nbRows() );
     DGFX_ASSERT( nbColumns() == rhs.nbColumns() );
-    RowIterator r1;
-    RowConstIterator r2;
-    for( r1 = beginRow(), r2 = rhs.beginRow(); r1 != endRow(); ++r1, ++r2 ) {
-        ColumnIterator c1 = r1->beginColumn();
-        ColumnConstIterator c2;
-        for( c2 = r2->beginColumn(); c2 != r2->endColumn(); ++c2 ) {
-            while ( c1 != r1->endColumn() && c1->_column < c2->_column ) {
-                ++c1;
-            }
-            if ( c1 == r1->endColumn() ) {
-                r1->_columns.push_back( *c2 );
-                continue;
-            } else if ( c2->_column < c1->_column ) {
-                r1->_columns.insert( c1, *c2 );
-                continue;
-            }
-            DGFX_ASSERT( c1->_column == c2->_column );
-            c1->_data += c2->_data;
-        }
+    // Matrices are only ever combined with others of the same pattern, so
+    // this is a straight elementwise sum.
+    DGFX_ASSERT( _pattern == rhs._pattern );
+    BlockContainer::iterator b1;
+    BlockContainer::const_iterator b2;
+    for (
+        b1 = _blocks.begin(), b2 = rhs._blocks.begin();
+        b1 != _blocks.end();
+        ++b1, ++b2
+    ) {
+        *b1 += *b2;
     }
     return *this;
 }
 
 //------------------------------------------------------------------------------
 
+void SimMatrix::setCombination(
+    Float a,
+    const SimMatrix& A,
+    Float b,
+    const SimMatrix& B,
+    const SimMatrix& C
+) {
+    DGFX_ASSERT( A._pattern == B._pattern && A._pattern == C._pattern );
+    if ( _pattern != A._pattern ) {
+        _pattern = A._pattern;
+        _blocks.resize( A._blocks.size() );
+    }
+    // Same operation order as ( A * a + B * b ) + C, so that the results
+    // match the operator form exactly.
+    for ( UInt32 k = 0; k < _blocks.size(); ++k ) {
+        GeMatrix3 m( A._blocks[ k ] );
+        m *= a;
+        GeMatrix3 n( B._blocks[ k ] );
+        n *= b;
+        m += n;
+        m += C._blocks[ k ];
+        _blocks[ k ] = m;
+    }
+}
+
+//------------------------------------------------------------------------------
+
 void SimMatrix::multiply(
     SimVector& destV,
     const SimMatrix& srcM,
     const SimVector& srcV
 ) {
     DGFX_ASSERT( srcM.nbColumns() == srcV.size() );
-    if ( destV.size() != srcM.nbRows() ) {
-        destV = SimVector::zero( srcM.nbRows() );
+    const UInt32 nbRows = srcM.nbRows();
+    if ( destV.size() != nbRows ) {
+        destV = SimVector( nbRows );
+    }
+    if ( nbRows == 0 ) {
+        return;
+    }
+    DGFX_ASSERT( &destV != &srcV );
+    SimMatrixKernels::getMultiply()(
+        nbRows,
+        srcM._pattern->getRowStarts(),
+        srcM._pattern->getColumns(),
+        &srcM._blocks[ 0 ],
+        &srcV[ 0 ],
+        &destV[ 0 ]
+    );
+}
+
+//------------------------------------------------------------------------------
+
+void SimMatrix::multiplyDiagonal(
+    SimVector& destV,
+    const SimMatrix& srcM,
+    const SimVector& srcV
+) {
+    DGFX_ASSERT( srcM.nbColumns() == srcV.size() );
+    const UInt32 nbRows = srcM.nbRows();
+    if ( destV.size() != nbRows ) {
+        destV = SimVector( nbRows );
     }
-    else {
-        destV.clear();
+    for ( UInt32 row = 0; row < nbRows; ++row ) {
+        const UInt32 slot = srcM._pattern->getDiagonalSlot( row );
+        if ( slot == Pattern::SLOT_INVALID ) {
+            destV[ row ] = GeVector::zero();
+        }
+        else {
+            destV[ row ] = srcM._blocks[ slot ] * srcV[ row ];
+        }
     }
-    for ( RowConstIterator rit = srcM.beginRow(); rit != srcM.endRow(); ++rit ){
-        UInt32 row = rit - srcM.beginRow();
-        GeVector& v = destV[ row ];
-        ColumnConstIterator c;
-        for ( c = rit->beginColumn(); c != rit->endColumn(); ++c ) {
-            v += c->_data * srcV[ c->_column ];
+}
+
+//------------------------------------------------------------------------------
+
+void SimMatrix::multiplyCombined(
+    SimVector& destV,
+    Float a,
+    const SimMatrix& A,
+    Float b,
+    const SimMatrix& B,
+    const SimMatrix& D,
+    const SimVector& srcV
+) {
+    DGFX_ASSERT( A.getPattern() == B.getPattern() );
+    DGFX_ASSERT( A.nbColumns() == srcV.size() );
+    DGFX_ASSERT( D.nbRows() == A.nbRows() );
+    const UInt32 nbRows = A.nbRows();
+    if ( destV.size() != nbRows ) {
+        destV = SimVector( nbRows );
+    }
+    if ( nbRows == 0 ) {
+        return;
+    }
+    const UInt32* rowStarts = A._pattern->getRowStarts();
+    const UInt32* columns = A._pattern->getColumns();
+    const GeMatrix3* blocksA = &A._blocks[ 0 ];
+    const GeMatrix3* blocksB = &B._blocks[ 0 ];
+    for ( UInt32 row = 0; row < nbRows; ++row ) {
+        const UInt32 diagSlot = A._pattern->getDiagonalSlot( row );
+        const UInt32 dSlot = D._pattern->getDiagonalSlot( row );
+        DGFX_ASSERT( diagSlot != Pattern::SLOT_INVALID ||
+            dSlot == Pattern::SLOT_INVALID );
+        GeVector v( GeVector::zero() );
+        for ( UInt32 k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k ) {
+            // Combine the blocks first, so that the result matches the
+            // product with an assembled matrix exactly.
+            GeMatrix3 m( blocksA[ k ] * a );
+            m += blocksB[ k ] * b;
+            if ( k == diagSlot && dSlot != Pattern::SLOT_INVALID ) {
+                m += D._blocks[ dSlot ];
+            }
+            v += m * srcV[ columns[ k ] ];
         }
+        destV[ row ] = v;
     }
 }
 
+//------------------------------------------------------------------------------
+
+GeMatrix3 SimMatrix::getCombinedDiagonal(
+    UInt32 row,
+    Float a,
+    const SimMatrix& A,
+    Float b,
+    const SimMatrix& B,
+    const SimMatrix& D
+) {
+    GeMatrix3 m( A( row, row ) * a );
+    m += B( row, row ) * b;
+    m += D( row, row );
+    return m;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // GLOBAL FUNCTIONS
@@ -92,7 +198,7 @@ std::ostream& operator<<( std::ostream& out, const SimMatrix& m )
     for ( UInt32 r = 0; r < m.nbRows(); ++r ) {
         out << "  ";
         for ( UInt32 c = 0; c < m.nbColumns(); ++c ) {
-            out << m[ r ][ c ] << " ";
+            out << m( r, c ) << " ";
         }
         out << std::endl;
     }
@@ -27,8 +27,8 @@
 #include <freecloth/geom/geMatrix3.h>
 #endif
 
-#ifndef freecloth_base_list
-#include <freecloth/base/list>
+#ifndef freecloth_sim_simMatrixPattern_h
+#include <freecloth/simulator/simMatrixPattern.h>
 #endif
 
 #ifndef freecloth_base_vector
@@ -47,8 +47,11 @@ class SimVector;
  * \class SimMatrix freecloth/simulator/simMatrix.h
  * \brief Sparse matrix class.
  *
- * Uses compressed row storage format, with each entry being a
- * 3x3 GeMatrix3 matrix.
+ * Uses block compressed row storage, with each entry being a
+ * 3x3 GeMatrix3 matrix. The positions of the entries are defined by a
+ * SimMatrixPattern, which is fixed at construction and usually shared
+ * between several matrices; the blocks themselves are stored contiguously,
+ * in pattern slot order. Entries cannot be added after construction.
  *
  * This implements the bare minimum necessary for the cloth simulation class,
  * and is not really intended as a general purpose sparse matrix class.
@@ -62,59 +65,21 @@ class SimVector;
  *   debug mode. In the end, given maintenance issues and the difficulty of
  *   setting up Boost, this was abandoned to make the library easier to
  *   compile.
+ *
+ * Rows were also formerly stored as linked lists of blocks, allowing entries
+ * to be inserted on the fly. This was abandoned for performance reasons:
+ * each lookup was a linear search, and the matrix-vector product spent most
+ * of its time chasing pointers.
  */
 
 class SimMatrix
 {
 public:
-    // ----- classes -----
-
-    // FIXME 2003/04/23: out-of-line these classes. At present, MSVC6 cannot
-    // handle out-of-line nested classes.
-
-    ////////////////////////////////////////////////////////////////////////////
-    /*!
-     * \class Element freecloth/simulator/simMatrix.h
-     * \brief Entry in a sparse matrix.
-     */
-    class Element {
-    public:
-        Element( const GeMatrix3& data, UInt32 column );
-        GeMatrix3 _data;
-        UInt32 _column;
-    };
-
     // ----- types and enumerations -----
-    typedef std::list<Element> ColumnContainer;
-    typedef ColumnContainer::iterator ColumnIterator;
-    typedef ColumnContainer::const_iterator ColumnConstIterator;
-
-    // ----- classes -----
-    ////////////////////////////////////////////////////////////////////////////
-    /*!
-     * \class Row freecloth/simulator/simMatrix.h
-     * \brief Row in a sparse matrix.
-     */
-    class Row {
-    public:
-        ColumnContainer _columns;
-
-        ColumnIterator beginColumn();
-        ColumnIterator endColumn();
-        ColumnConstIterator beginColumn() const;
-        ColumnConstIterator endColumn() const;
-
-        const GeMatrix3& operator[]( UInt32 column ) const;
-        // Will insert a new entry into row if one does not exist.
-        GeMatrix3& operator[]( UInt32 column );
-    };
 
+    typedef SimMatrixPattern Pattern;
+    typedef std::vector<GeMatrix3> BlockContainer;
 
-    // ----- types and enumerations -----
-    typedef std::vector<Row> RowContainer;
-    typedef RowContainer::iterator RowIterator;
-    typedef RowContainer::const_iterator RowConstIterator;
-    
     // ----- static member functions -----
     
     static void multiply(
@@ -122,41 +87,84 @@ public:
         const SimMatrix& srcM,
         const SimVector& srcV
     );
+    //! Multiply by the block diagonal of srcM only, ignoring all other
+    //! blocks. Useful for matrices that are known to be block diagonal
+    //! (e.g., mass, preconditioners) but that share a full pattern.
+    static void multiplyDiagonal(
+        SimVector& destV,
+        const SimMatrix& srcM,
+        const SimVector& srcV
+    );
+    //! Compute destV = ( a * A + b * B + diag( D ) ) * srcV in a single
+    //! pass, without forming the combined matrix. A and B must share the
+    //! same pattern; only the diagonal blocks of D are used.
+    static void multiplyCombined(
+        SimVector& destV,
+        Float a,
+        const SimMatrix& A,
+        Float b,
+        const SimMatrix& B,
+        const SimMatrix& D,
+        const SimVector& srcV
+    );
+    //! Diagonal block of row r of ( a * A + b * B + diag( D ) ), as used by
+    //! multiplyCombined().
+    static GeMatrix3 getCombinedDiagonal(
+        UInt32 row,
+        Float a,
+        const SimMatrix& A,
+        Float b,
+        const SimMatrix& B,
+        const SimMatrix& D
+    );
     
     // ----- member functions -----
     
     SimMatrix();
-    SimMatrix( UInt32 nbRows, UInt32 nbColumns );
+    //! Create a zero matrix with the given pattern.
+    explicit SimMatrix( const RCShdPtr<Pattern>& );
     // Default copy constructor is fine.
 
     UInt32 nbRows() const;
     UInt32 nbColumns() const;
-    RowIterator beginRow();
-    RowIterator endRow();
-    RowConstIterator beginRow() const;
-    RowConstIterator endRow() const;
+    const RCShdPtr<Pattern>& getPattern() const;
 
     // Default assignment operator is fine.
-    const Row& operator[]( UInt32 row ) const;
-    Row& operator[]( UInt32 row );
+    //! Returns zero for blocks outside the pattern.
     const GeMatrix3& operator()( UInt32 row, UInt32 col ) const;
-    // Will insert a new entry into matrix if one does not exist.
+    //! The block must be in the pattern.
     GeMatrix3& operator()( UInt32 row, UInt32 col );
+    //@{
+    //! Direct access to the block in the given pattern slot.
+    const GeMatrix3& getBlock( UInt32 slot ) const;
+    GeMatrix3& getBlock( UInt32 slot );
+    //@}
+
+    //! Set all blocks to zero, retaining the pattern.
+    void clear();
+
     SimMatrix& operator*=( Float );
+    //! rhs must share the same pattern.
     SimMatrix& operator+=( const SimMatrix& );
+    //! Set *this = a * A + b * B + C in a single pass. A, B and C must
+    //! share the same pattern. The existing blocks are reused if *this
+    //! already has that pattern, so no temporaries are allocated.
+    void setCombination(
+        Float a,
+        const SimMatrix& A,
+        Float b,
+        const SimMatrix& B,
+        const SimMatrix& C
+    );
     SimVector operator*( const SimVector& ) const;
     SimMatrix operator*( Float ) const;
     SimMatrix operator+( const SimMatrix& ) const;
 
-    // ----- static data members -----
-
 private:
-    // ----- member functions -----
-
     // ----- data members -----
 
-    UInt32 _nbRows, _nbColumns;
-    RowContainer _rows;
+    RCShdPtr<Pattern> _pattern;
+    BlockContainer _blocks;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
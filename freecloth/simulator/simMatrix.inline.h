@@ -20,186 +20,99 @@
 #define freecloth_simulator_simMatrix_inline_h
 
 #include <freecloth/simulator/simVector.h>
+#include <freecloth/base/algorithm>
 
 FREECLOTH_NAMESPACE_START
 
-////////////////////////////////////////////////////////////////////////////////
-// CLASS SimMatrix::Element
-
-//------------------------------------------------------------------------------
-
-inline SimMatrix::Element::Element( const GeMatrix3& data, UInt32 column )
-  : _data( data ),
-    _column( column )
-{
-}
-
-////////////////////////////////////////////////////////////////////////////////
-// CLASS SimMatrix::Row
-
-//------------------------------------------------------------------------------
-
-inline SimMatrix::ColumnIterator SimMatrix::Row::beginColumn()
-{
-    return _columns.begin();
-}
-
-//------------------------------------------------------------------------------
-
-inline SimMatrix::ColumnIterator SimMatrix::Row::endColumn()
-{
-    return _columns.end();
-}
-
-//------------------------------------------------------------------------------
-
-inline SimMatrix::ColumnConstIterator SimMatrix::Row::beginColumn() const
-{
-    return _columns.begin();
-}
-
-//------------------------------------------------------------------------------
-
-inline SimMatrix::ColumnConstIterator SimMatrix::Row::endColumn() const
-{
-    return _columns.end();
-}
-
-//------------------------------------------------------------------------------
-
-inline GeMatrix3& SimMatrix::Row::operator[] ( UInt32 col )
-{
-    // FIXME: need a way to assert this
-    //DGFX_ASSERT( col < nbColumns() );
-    ColumnIterator cit( beginColumn() );
-    while( cit != endColumn() && cit->_column < col ) {
-        ++cit;
-    }
-    if ( cit == endColumn() || cit->_column != col ) {
-        cit = _columns.insert( cit, Element( GeMatrix3::zero(), col ) );
-    }
-    DGFX_ASSERT( cit != endColumn() && cit->_column == col );
-    return cit->_data;
-}
-
-//------------------------------------------------------------------------------
-
-inline const GeMatrix3& SimMatrix::Row::operator[] ( UInt32 col ) const
-{
-    // FIXME: need a way to assert this
-    //DGFX_ASSERT( col < nbColumns() );
-    ColumnConstIterator cit( beginColumn() );
-    while( cit != endColumn() && cit->_column < col ) {
-        ++cit;
-    }
-    if ( cit == endColumn() || cit->_column != col ) {
-        static const GeMatrix3 zero( GeMatrix3::zero() );
-        return zero;
-    }
-    return cit->_data;
-}
-
-
 ////////////////////////////////////////////////////////////////////////////////
 // CLASS SimMatrix
 
 //------------------------------------------------------------------------------
 
 inline SimMatrix::SimMatrix()
-  : _nbRows( 0 ),
-    _nbColumns( 0 )
 {}
 
 //------------------------------------------------------------------------------
 
-inline SimMatrix::SimMatrix( UInt32 nbRows, UInt32 nbColumns )
-  : _nbRows( nbRows ),
-    _nbColumns( nbColumns ),
-    _rows( nbRows )
+inline SimMatrix::SimMatrix( const RCShdPtr<Pattern>& pattern )
+  : _pattern( pattern ),
+    _blocks( pattern->nbBlocks(), GeMatrix3::zero() )
 {}
 
 //------------------------------------------------------------------------------
 
 inline UInt32 SimMatrix::nbRows() const
 {
-    return _nbRows;
+    return _pattern.isNull() ? 0 : _pattern->nbRows();
 }
 
 //------------------------------------------------------------------------------
 
 inline UInt32 SimMatrix::nbColumns() const
 {
-    return _nbColumns;
+    return _pattern.isNull() ? 0 : _pattern->nbColumns();
 }
 
 //------------------------------------------------------------------------------
 
-inline SimMatrix::RowIterator SimMatrix::beginRow()
+inline const RCShdPtr<SimMatrix::Pattern>& SimMatrix::getPattern() const
 {
-    return _rows.begin();
+    return _pattern;
 }
 
 //------------------------------------------------------------------------------
 
-inline SimMatrix::RowIterator SimMatrix::endRow()
-{
-    return _rows.end();
-}
-
-//------------------------------------------------------------------------------
-
-inline SimMatrix::RowConstIterator SimMatrix::beginRow() const
-{
-    return _rows.begin();
-}
-
-//------------------------------------------------------------------------------
-
-inline SimMatrix::RowConstIterator SimMatrix::endRow() const
+inline GeMatrix3& SimMatrix::operator() ( UInt32 row, UInt32 col )
 {
-    return _rows.end();
+    DGFX_ASSERT( row < nbRows() && col < nbColumns() );
+    const UInt32 slot = _pattern->findSlot( row, col );
+    DGFX_ASSERT( slot != Pattern::SLOT_INVALID );
+    return _blocks[ slot ];
 }
 
 //------------------------------------------------------------------------------
 
-inline SimMatrix::Row& SimMatrix::operator[] ( UInt32 row )
+inline const GeMatrix3& SimMatrix::operator() ( UInt32 row, UInt32 col ) const
 {
-    DGFX_ASSERT( row < nbRows() );
-    return _rows[ row ];
+    DGFX_ASSERT( row < nbRows() && col < nbColumns() );
+    const UInt32 slot = _pattern->findSlot( row, col );
+    if ( slot == Pattern::SLOT_INVALID ) {
+        static const GeMatrix3 zero( GeMatrix3::zero() );
+        return zero;
+    }
+    return _blocks[ slot ];
 }
 
 //------------------------------------------------------------------------------
 
-inline const SimMatrix::Row& SimMatrix::operator[] ( UInt32 row ) const
+inline GeMatrix3& SimMatrix::getBlock( UInt32 slot )
 {
-    DGFX_ASSERT( row < nbRows() );
-    return _rows[ row ];
+    DGFX_ASSERT( slot < _blocks.size() );
+    return _blocks[ slot ];
 }
 
 //------------------------------------------------------------------------------
 
-inline GeMatrix3& SimMatrix::operator() ( UInt32 row, UInt32 col )
+inline const GeMatrix3& SimMatrix::getBlock( UInt32 slot ) const
 {
-    DGFX_ASSERT( row < nbRows() );
-    return operator[]( row )[ col ];
+    DGFX_ASSERT( slot < _blocks.size() );
+    return _blocks[ slot ];
 }
 
 //------------------------------------------------------------------------------
 
-inline const GeMatrix3& SimMatrix::operator() ( UInt32 row, UInt32 col ) const
+inline void SimMatrix::clear()
 {
-    DGFX_ASSERT( row < nbRows() );
-    return operator[]( row )[ col ];
+    std::fill( _blocks.begin(), _blocks.end(), GeMatrix3::zero() );
 }
 
 //------------------------------------------------------------------------------
 
 inline SimMatrix& SimMatrix::operator*=( Float rhs )
 {
-    for( RowIterator r = beginRow(); r != endRow(); ++r ) {
-        for( ColumnIterator c = r->beginColumn(); c != r->endColumn(); ++c ) {
-            c->_data *= rhs;
-        }
+    BlockContainer::iterator b;
+    for ( b = _blocks.begin(); b != _blocks.end(); ++b ) {
+        *b *= rhs;
     }
     return *this;
 }
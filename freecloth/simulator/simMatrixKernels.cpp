@@ -0,0 +1,1582 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simMatrixKernels.h>
+#include <freecloth/geom/geMatrix3.h>
+#include <freecloth/geom/geVector.h>
+#include <freecloth/base/algorithm>
+
+// SIMD kernels need per-function target attributes and the CPU feature
+// builtins, available from gcc 6 and clang.
+#if ( defined( __x86_64__ ) || defined( __i386__ ) ) && \
+    ( defined( __clang__ ) || ( defined( __GNUC__ ) && __GNUC__ >= 6 ) )
+#define SIM_KERNELS_X86 1
+#define SIM_NOINLINE __attribute__(( noinline ))
+#include <immintrin.h>
+#else
+#define SIM_KERNELS_X86 0
+#define SIM_NOINLINE
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    using namespace freecloth;
+
+    //! Distance, in blocks, at which source vector entries are prefetched.
+    const UInt32 PREFETCH_DISTANCE = 8;
+
+    //! Instruction set in use. Chosen during static initialization, before
+    //! any simulator threads start, so that it is never written while they
+    //! read it.
+    SimMatrixKernels::Isa theIsa = SimMatrixKernels::getBestIsa();
+
+//------------------------------------------------------------------------------
+
+    //! m = a * A + b * B, plus D if given, in the same operation order as
+    //! SimMatrix::setCombination(), so that the blocks match an assembled
+    //! matrix exactly.
+    inline void combineBlockInline(
+        Float a,
+        const GeMatrix3& A,
+        Float b,
+        const GeMatrix3& B,
+        const GeMatrix3* D,
+        GeMatrix3& m
+    ) {
+        m = A;
+        m *= a;
+        GeMatrix3 n( B );
+        n *= b;
+        m += n;
+        if ( D != 0 ) {
+            m += *D;
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    typedef void ( *CombineBlockFn )(
+        Float a,
+        const GeMatrix3& A,
+        Float b,
+        const GeMatrix3& B,
+        const GeMatrix3* D,
+        GeMatrix3& m
+    );
+
+//------------------------------------------------------------------------------
+
+    //! combineBlockInline(), kept out of line, so that it can't be
+    //! contracted into multiply-adds once inlined into the FMA kernels.
+    SIM_NOINLINE void combineBlock(
+        Float a,
+        const GeMatrix3& A,
+        Float b,
+        const GeMatrix3& B,
+        const GeMatrix3* D,
+        GeMatrix3& m
+    ) {
+        combineBlockInline( a, A, b, B, D, m );
+    }
+
+#if SIM_KERNELS_X86
+
+//------------------------------------------------------------------------------
+
+    //! combineBlock() in VEX encoding, for the AVX-512 kernels, which keep
+    //! 512-bit registers live across the call; legacy SSE code would pay a
+    //! transition penalty on every call. No FMA, so nothing is contracted.
+    __attribute__(( target( "avx2" ) ))
+    SIM_NOINLINE void combineBlockVex(
+        Float a,
+        const GeMatrix3& A,
+        Float b,
+        const GeMatrix3& B,
+        const GeMatrix3* D,
+        GeMatrix3& m
+    ) {
+        combineBlockInline( a, A, b, B, D, m );
+    }
+
+#endif
+
+//------------------------------------------------------------------------------
+
+    //! Block source for the symmetric kernels: the stored blocks.
+    class PlainBlocks
+    {
+    public:
+        explicit PlainBlocks( const GeMatrix3* blocks )
+          : _blocks( blocks )
+        {
+        }
+        //! Block in slot k, which is on the diagonal if diagonal is true.
+        //! tmp may be used to hold it.
+        const GeMatrix3& get( UInt32 k, bool, GeMatrix3& ) const
+        {
+            return _blocks[ k ];
+        }
+
+    private:
+        const GeMatrix3* _blocks;
+    };
+
+//------------------------------------------------------------------------------
+
+    //! Block source for the symmetric kernels: the blocks of
+    //! a * A + b * B + diag( D ), combined as they're read.
+    class CombinedBlocks
+    {
+    public:
+        CombinedBlocks(
+            Float a,
+            const GeMatrix3* blocksA,
+            Float b,
+            const GeMatrix3* blocksB,
+            const GeMatrix3* blocksD,
+            CombineBlockFn combine = combineBlock
+        ) : _a( a ),
+            _blocksA( blocksA ),
+            _b( b ),
+            _blocksB( blocksB ),
+            _blocksD( blocksD ),
+            _combine( combine )
+        {
+        }
+        const GeMatrix3& get( UInt32 k, bool diagonal, GeMatrix3& tmp ) const
+        {
+            _combine(
+                _a,
+                _blocksA[ k ],
+                _b,
+                _blocksB[ k ],
+                diagonal ? &_blocksD[ k ] : 0,
+                tmp
+            );
+            return tmp;
+        }
+
+    private:
+        Float _a;
+        const GeMatrix3* _blocksA;
+        Float _b;
+        const GeMatrix3* _blocksB;
+        const GeMatrix3* _blocksD;
+        CombineBlockFn _combine;
+    };
+
+//------------------------------------------------------------------------------
+
+    void multiplyScalar(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        for ( UInt32 row = 0; row < nbRows; ++row ) {
+            GeVector v( GeVector::zero() );
+            for ( UInt32 k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k )
+            {
+                v += blocks[ k ] * src[ columns[ k ] ];
+            }
+            dest[ row ] = v;
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    // The symmetric kernels are templates over the source of their
+    // blocks, so that the combined products share their arithmetic.
+
+    template<class Blocks>
+    void symmetricScalar(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const Blocks& blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        UInt32 row;
+        for ( row = 0; row < nbRows; ++row ) {
+            dest[ row ] = GeVector::zero();
+        }
+        for ( row = 0; row < nbRows; ++row ) {
+            const GeVector& xr = src[ row ];
+            GeVector v( GeVector::zero() );
+            for ( UInt32 k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k )
+            {
+                const UInt32 col = columns[ k ];
+                GeMatrix3 tmp;
+                const GeMatrix3& m = blocks.get( k, col == row, tmp );
+                v += m * src[ col ];
+                if ( col != row ) {
+                    dest[ col ] += xr * m;
+                }
+            }
+            dest[ row ] += v;
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    template<class Blocks>
+    void symmetricRowsScalar(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const Blocks& blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        GeMatrix3 tmp;
+        for ( UInt32 row = rowBegin; row < rowEnd; ++row ) {
+            // Same operation order as symmetricScalar: transposed blocks
+            // from earlier rows first, then this row's blocks.
+            GeVector t( GeVector::zero() );
+            UInt32 k;
+            for ( k = columnStarts[ row ]; k < columnStarts[ row + 1 ]; ++k )
+            {
+                t += src[ columnRows[ k ] ] *
+                    blocks.get( columnSlots[ k ], false, tmp );
+            }
+            GeVector v( GeVector::zero() );
+            for ( k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k ) {
+                const UInt32 col = columns[ k ];
+                v += blocks.get( k, col == row, tmp ) * src[ col ];
+            }
+            t += v;
+            dest[ row ] = t;
+        }
+    }
+
+#if SIM_KERNELS_X86
+
+    // Blocks are 9 floats in column-major order, and vectors are 3 floats,
+    // packed contiguously. Column c of a block is loaded from offset 3c;
+    // the last column is loaded from offset 5 and shifted down a lane, to
+    // avoid reading past the end of the block array. The fourth lane of
+    // each result is garbage and is discarded.
+
+//------------------------------------------------------------------------------
+
+    __attribute__(( target( "sse4.2" ) ))
+    inline void storeVector( GeVector& dest, __m128 v )
+    {
+        float tmp[ 4 ];
+        _mm_storeu_ps( tmp, v );
+        dest = GeVector( tmp[ 0 ], tmp[ 1 ], tmp[ 2 ] );
+    }
+
+//------------------------------------------------------------------------------
+
+    __attribute__(( target( "sse4.2" ) ))
+    void multiplySse42(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* b = reinterpret_cast<const float*>( blocks );
+        const float* x = reinterpret_cast<const float*>( src );
+        const UInt32 nbBlocks = rowStarts[ nbRows ];
+        for ( UInt32 row = 0; row < nbRows; ++row ) {
+            __m128 acc = _mm_setzero_ps();
+            for ( UInt32 k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k )
+            {
+                if ( k + PREFETCH_DISTANCE < nbBlocks ) {
+                    _mm_prefetch(
+                        reinterpret_cast<const char*>(
+                            x + 3 * columns[ k + PREFETCH_DISTANCE ]
+                        ),
+                        _MM_HINT_T0
+                    );
+                }
+                const float* bk = b + 9 * k;
+                const float* xk = x + 3 * columns[ k ];
+                __m128 c2 = _mm_loadu_ps( bk + 5 );
+                c2 = _mm_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+                // Same operation order as GeMatrix3::operator*.
+                __m128 v = _mm_mul_ps(
+                    _mm_loadu_ps( bk ), _mm_set1_ps( xk[ 0 ] )
+                );
+                v = _mm_add_ps( v, _mm_mul_ps(
+                    _mm_loadu_ps( bk + 3 ), _mm_set1_ps( xk[ 1 ] )
+                ) );
+                v = _mm_add_ps( v, _mm_mul_ps( c2, _mm_set1_ps( xk[ 2 ] ) ) );
+                acc = _mm_add_ps( acc, v );
+            }
+            storeVector( dest[ row ], acc );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Add the first three lanes of v to dest[ i ], where dest has n
+    //! entries. The fourth lane of v must be zero.
+    __attribute__(( target( "sse4.2" ) ))
+    inline void addVector( float* dest, UInt32 i, UInt32 n, __m128 v )
+    {
+        float* d = dest + 3 * i;
+        if ( i + 1 < n ) {
+            // The fourth lane overlaps the next entry, which is unchanged.
+            _mm_storeu_ps( d, _mm_add_ps( _mm_loadu_ps( d ), v ) );
+        }
+        else {
+            float tmp[ 4 ];
+            _mm_storeu_ps( tmp, v );
+            d[ 0 ] += tmp[ 0 ];
+            d[ 1 ] += tmp[ 1 ];
+            d[ 2 ] += tmp[ 2 ];
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Transposed block product: lane j is column j of the block dotted
+    //! with xr, whose fourth lane must be zero.
+    __attribute__(( target( "sse4.2" ) ))
+    inline __m128 transposeProduct(
+        __m128 c0,
+        __m128 c1,
+        __m128 c2,
+        __m128 xr
+    ) {
+        const __m128 p01 = _mm_hadd_ps(
+            _mm_mul_ps( c0, xr ), _mm_mul_ps( c1, xr )
+        );
+        const __m128 p2 = _mm_hadd_ps(
+            _mm_mul_ps( c2, xr ), _mm_setzero_ps()
+        );
+        return _mm_hadd_ps( p01, p2 );
+    }
+
+//------------------------------------------------------------------------------
+
+    template<class Blocks>
+    __attribute__(( target( "sse4.2" ) ))
+    void symmetricSse42(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const Blocks& blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* x = reinterpret_cast<const float*>( src );
+        float* y = reinterpret_cast<float*>( dest );
+        const UInt32 nbBlocks = rowStarts[ nbRows ];
+        std::fill( y, y + 3 * nbRows, 0.f );
+        for ( UInt32 row = 0; row < nbRows; ++row ) {
+            const __m128 xr = _mm_setr_ps(
+                x[ 3 * row ], x[ 3 * row + 1 ], x[ 3 * row + 2 ], 0.f
+            );
+            __m128 acc = _mm_setzero_ps();
+            for ( UInt32 k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k )
+            {
+                if ( k + PREFETCH_DISTANCE < nbBlocks ) {
+                    _mm_prefetch(
+                        reinterpret_cast<const char*>(
+                            x + 3 * columns[ k + PREFETCH_DISTANCE ]
+                        ),
+                        _MM_HINT_T0
+                    );
+                }
+                const UInt32 col = columns[ k ];
+                GeMatrix3 tmp;
+                const float* bk = reinterpret_cast<const float*>(
+                    &blocks.get( k, col == row, tmp )
+                );
+                const float* xk = x + 3 * col;
+                const __m128 c0 = _mm_loadu_ps( bk );
+                const __m128 c1 = _mm_loadu_ps( bk + 3 );
+                __m128 c2 = _mm_loadu_ps( bk + 5 );
+                c2 = _mm_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+                __m128 v = _mm_mul_ps( c0, _mm_set1_ps( xk[ 0 ] ) );
+                v = _mm_add_ps( v, _mm_mul_ps( c1, _mm_set1_ps( xk[ 1 ] ) ) );
+                v = _mm_add_ps( v, _mm_mul_ps( c2, _mm_set1_ps( xk[ 2 ] ) ) );
+                acc = _mm_add_ps( acc, v );
+                if ( col != row ) {
+                    addVector(
+                        y, col, nbRows, transposeProduct( c0, c1, c2, xr )
+                    );
+                }
+            }
+            // Discard the garbage fourth lane.
+            addVector(
+                y, row, nbRows, _mm_blend_ps( acc, _mm_setzero_ps(), 8 )
+            );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Sum of the transposed blocks of column row, times the matching
+    //! source entries, in row order. The fourth lane is zero.
+    template<class Blocks>
+    __attribute__(( target( "sse4.2" ) ))
+    inline __m128 gatherTransposes(
+        UInt32 row,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const Blocks& blocks,
+        const float* x
+    ) {
+        __m128 t = _mm_setzero_ps();
+        GeMatrix3 tmp;
+        for ( UInt32 k = columnStarts[ row ]; k < columnStarts[ row + 1 ]; ++k )
+        {
+            const float* bk = reinterpret_cast<const float*>(
+                &blocks.get( columnSlots[ k ], false, tmp )
+            );
+            const float* xk = x + 3 * columnRows[ k ];
+            const __m128 xr = _mm_setr_ps( xk[ 0 ], xk[ 1 ], xk[ 2 ], 0.f );
+            __m128 c2 = _mm_loadu_ps( bk + 5 );
+            c2 = _mm_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+            t = _mm_add_ps( t, transposeProduct(
+                _mm_loadu_ps( bk ), _mm_loadu_ps( bk + 3 ), c2, xr
+            ) );
+        }
+        return t;
+    }
+
+//------------------------------------------------------------------------------
+
+    template<class Blocks>
+    __attribute__(( target( "sse4.2" ) ))
+    void symmetricRowsSse42(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const Blocks& blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* x = reinterpret_cast<const float*>( src );
+        GeMatrix3 tmp;
+        for ( UInt32 row = rowBegin; row < rowEnd; ++row ) {
+            const __m128 t = gatherTransposes(
+                row, columnStarts, columnSlots, columnRows, blocks, x
+            );
+            __m128 acc = _mm_setzero_ps();
+            for ( UInt32 k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k )
+            {
+                const UInt32 col = columns[ k ];
+                const float* bk = reinterpret_cast<const float*>(
+                    &blocks.get( k, col == row, tmp )
+                );
+                const float* xk = x + 3 * col;
+                __m128 c2 = _mm_loadu_ps( bk + 5 );
+                c2 = _mm_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+                __m128 v = _mm_mul_ps(
+                    _mm_loadu_ps( bk ), _mm_set1_ps( xk[ 0 ] )
+                );
+                v = _mm_add_ps( v, _mm_mul_ps(
+                    _mm_loadu_ps( bk + 3 ), _mm_set1_ps( xk[ 1 ] )
+                ) );
+                v = _mm_add_ps( v, _mm_mul_ps( c2, _mm_set1_ps( xk[ 2 ] ) ) );
+                acc = _mm_add_ps( acc, v );
+            }
+            storeVector( dest[ row ], _mm_add_ps( t, acc ) );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Single block product for the AVX kernels' remainder loops.
+    __attribute__(( target( "avx2,fma" ) ))
+    inline __m128 fmaddBlock( const float* bk, const float* xk, __m128 acc )
+    {
+        __m128 c2 = _mm_loadu_ps( bk + 5 );
+        c2 = _mm_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+        acc = _mm_fmadd_ps( _mm_loadu_ps( bk ), _mm_broadcast_ss( xk ), acc );
+        acc = _mm_fmadd_ps(
+            _mm_loadu_ps( bk + 3 ), _mm_broadcast_ss( xk + 1 ), acc
+        );
+        return _mm_fmadd_ps( c2, _mm_broadcast_ss( xk + 2 ), acc );
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Concatenate two 128-bit registers.
+    __attribute__(( target( "avx2,fma" ) ))
+    inline __m256 combine( __m128 lo, __m128 hi )
+    {
+        return _mm256_insertf128_ps( _mm256_castps128_ps256( lo ), hi, 1 );
+    }
+
+//------------------------------------------------------------------------------
+
+    __attribute__(( target( "avx2,fma" ) ))
+    void multiplyAvx2(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* b = reinterpret_cast<const float*>( blocks );
+        const float* x = reinterpret_cast<const float*>( src );
+        const UInt32 nbBlocks = rowStarts[ nbRows ];
+        for ( UInt32 row = 0; row < nbRows; ++row ) {
+            const UInt32 end = rowStarts[ row + 1 ];
+            UInt32 k = rowStarts[ row ];
+            // Two blocks at a time, one per 128-bit half.
+            __m256 acc2 = _mm256_setzero_ps();
+            for ( ; k + 2 <= end; k += 2 ) {
+                if ( k + PREFETCH_DISTANCE + 1 < nbBlocks ) {
+                    _mm_prefetch(
+                        reinterpret_cast<const char*>(
+                            x + 3 * columns[ k + PREFETCH_DISTANCE ]
+                        ),
+                        _MM_HINT_T0
+                    );
+                    _mm_prefetch(
+                        reinterpret_cast<const char*>(
+                            x + 3 * columns[ k + PREFETCH_DISTANCE + 1 ]
+                        ),
+                        _MM_HINT_T0
+                    );
+                }
+                const float* bk = b + 9 * k;
+                const float* xa = x + 3 * columns[ k ];
+                const float* xb = x + 3 * columns[ k + 1 ];
+                __m256 c0 = combine(
+                    _mm_loadu_ps( bk ), _mm_loadu_ps( bk + 9 )
+                );
+                __m256 c1 = combine(
+                    _mm_loadu_ps( bk + 3 ), _mm_loadu_ps( bk + 12 )
+                );
+                __m256 c2 = combine(
+                    _mm_loadu_ps( bk + 5 ), _mm_loadu_ps( bk + 14 )
+                );
+                c2 = _mm256_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+                acc2 = _mm256_fmadd_ps(
+                    c0,
+                    combine( _mm_broadcast_ss( xa ), _mm_broadcast_ss( xb ) ),
+                    acc2
+                );
+                acc2 = _mm256_fmadd_ps(
+                    c1,
+                    combine(
+                        _mm_broadcast_ss( xa + 1 ), _mm_broadcast_ss( xb + 1 )
+                    ),
+                    acc2
+                );
+                acc2 = _mm256_fmadd_ps(
+                    c2,
+                    combine(
+                        _mm_broadcast_ss( xa + 2 ), _mm_broadcast_ss( xb + 2 )
+                    ),
+                    acc2
+                );
+            }
+            __m128 acc = _mm_add_ps(
+                _mm256_castps256_ps128( acc2 ),
+                _mm256_extractf128_ps( acc2, 1 )
+            );
+            for ( ; k < end; ++k ) {
+                acc = fmaddBlock( b + 9 * k, x + 3 * columns[ k ], acc );
+            }
+            storeVector( dest[ row ], acc );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    template<class Blocks>
+    __attribute__(( target( "avx2,fma" ) ))
+    void symmetricAvx2(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const Blocks& blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* x = reinterpret_cast<const float*>( src );
+        float* y = reinterpret_cast<float*>( dest );
+        const UInt32 nbBlocks = rowStarts[ nbRows ];
+        std::fill( y, y + 3 * nbRows, 0.f );
+        for ( UInt32 row = 0; row < nbRows; ++row ) {
+            const __m128 xr = _mm_setr_ps(
+                x[ 3 * row ], x[ 3 * row + 1 ], x[ 3 * row + 2 ], 0.f
+            );
+            __m128 acc = _mm_setzero_ps();
+            for ( UInt32 k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k )
+            {
+                if ( k + PREFETCH_DISTANCE < nbBlocks ) {
+                    _mm_prefetch(
+                        reinterpret_cast<const char*>(
+                            x + 3 * columns[ k + PREFETCH_DISTANCE ]
+                        ),
+                        _MM_HINT_T0
+                    );
+                }
+                const UInt32 col = columns[ k ];
+                GeMatrix3 tmp;
+                const float* bk = reinterpret_cast<const float*>(
+                    &blocks.get( k, col == row, tmp )
+                );
+                const float* xk = x + 3 * col;
+                const __m128 c0 = _mm_loadu_ps( bk );
+                const __m128 c1 = _mm_loadu_ps( bk + 3 );
+                __m128 c2 = _mm_loadu_ps( bk + 5 );
+                c2 = _mm_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+                acc = _mm_fmadd_ps( c0, _mm_broadcast_ss( xk ), acc );
+                acc = _mm_fmadd_ps( c1, _mm_broadcast_ss( xk + 1 ), acc );
+                acc = _mm_fmadd_ps( c2, _mm_broadcast_ss( xk + 2 ), acc );
+                if ( col != row ) {
+                    addVector(
+                        y, col, nbRows, transposeProduct( c0, c1, c2, xr )
+                    );
+                }
+            }
+            addVector(
+                y, row, nbRows, _mm_blend_ps( acc, _mm_setzero_ps(), 8 )
+            );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    template<class Blocks>
+    __attribute__(( target( "avx2,fma" ) ))
+    void symmetricRowsAvx2(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const Blocks& blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* x = reinterpret_cast<const float*>( src );
+        GeMatrix3 tmp;
+        for ( UInt32 row = rowBegin; row < rowEnd; ++row ) {
+            const __m128 t = gatherTransposes(
+                row, columnStarts, columnSlots, columnRows, blocks, x
+            );
+            __m128 acc = _mm_setzero_ps();
+            for ( UInt32 k = rowStarts[ row ]; k < rowStarts[ row + 1 ]; ++k )
+            {
+                const UInt32 col = columns[ k ];
+                acc = fmaddBlock(
+                    reinterpret_cast<const float*>(
+                        &blocks.get( k, col == row, tmp )
+                    ),
+                    x + 3 * col,
+                    acc
+                );
+            }
+            storeVector( dest[ row ], _mm_add_ps( t, acc ) );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Concatenate four 128-bit registers.
+    __attribute__(( target( "avx512f,avx2,fma" ) ))
+    inline __m512 combine(
+        __m128 v0,
+        __m128 v1,
+        __m128 v2,
+        __m128 v3
+    ) {
+        __m512 r = _mm512_castps128_ps512( v0 );
+        r = _mm512_insertf32x4( r, v1, 1 );
+        r = _mm512_insertf32x4( r, v2, 2 );
+        return _mm512_insertf32x4( r, v3, 3 );
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Broadcast component i of four vectors, one per 128-bit quarter.
+    __attribute__(( target( "avx512f,avx2,fma" ) ))
+    inline __m512 broadcast( const float* const xk[ 4 ], UInt32 i )
+    {
+        return combine(
+            _mm_broadcast_ss( xk[ 0 ] + i ),
+            _mm_broadcast_ss( xk[ 1 ] + i ),
+            _mm_broadcast_ss( xk[ 2 ] + i ),
+            _mm_broadcast_ss( xk[ 3 ] + i )
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    __attribute__(( target( "avx512f,avx2,fma" ) ))
+    void multiplyAvx512(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* b = reinterpret_cast<const float*>( blocks );
+        const float* x = reinterpret_cast<const float*>( src );
+        const UInt32 nbBlocks = rowStarts[ nbRows ];
+        for ( UInt32 row = 0; row < nbRows; ++row ) {
+            const UInt32 end = rowStarts[ row + 1 ];
+            UInt32 k = rowStarts[ row ];
+            // Four blocks at a time, one per 128-bit quarter.
+            __m512 acc4 = _mm512_setzero_ps();
+            for ( ; k + 4 <= end; k += 4 ) {
+                UInt32 i;
+                if ( k + PREFETCH_DISTANCE + 3 < nbBlocks ) {
+                    for ( i = 0; i < 4; ++i ) {
+                        _mm_prefetch(
+                            reinterpret_cast<const char*>(
+                                x + 3 * columns[ k + PREFETCH_DISTANCE + i ]
+                            ),
+                            _MM_HINT_T0
+                        );
+                    }
+                }
+                const float* bk = b + 9 * k;
+                const float* xk[ 4 ];
+                for ( i = 0; i < 4; ++i ) {
+                    xk[ i ] = x + 3 * columns[ k + i ];
+                }
+                __m512 c0 = combine(
+                    _mm_loadu_ps( bk ), _mm_loadu_ps( bk + 9 ),
+                    _mm_loadu_ps( bk + 18 ), _mm_loadu_ps( bk + 27 )
+                );
+                __m512 c1 = combine(
+                    _mm_loadu_ps( bk + 3 ), _mm_loadu_ps( bk + 12 ),
+                    _mm_loadu_ps( bk + 21 ), _mm_loadu_ps( bk + 30 )
+                );
+                __m512 c2 = combine(
+                    _mm_loadu_ps( bk + 5 ), _mm_loadu_ps( bk + 14 ),
+                    _mm_loadu_ps( bk + 23 ), _mm_loadu_ps( bk + 32 )
+                );
+                c2 = _mm512_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+                acc4 = _mm512_fmadd_ps( c0, broadcast( xk, 0 ), acc4 );
+                acc4 = _mm512_fmadd_ps( c1, broadcast( xk, 1 ), acc4 );
+                acc4 = _mm512_fmadd_ps( c2, broadcast( xk, 2 ), acc4 );
+            }
+            const __m256 acc2 = _mm256_add_ps(
+                _mm512_castps512_ps256( acc4 ),
+                _mm256_castpd_ps(
+                    _mm512_extractf64x4_pd( _mm512_castps_pd( acc4 ), 1 )
+                )
+            );
+            __m128 acc = _mm_add_ps(
+                _mm256_castps256_ps128( acc2 ),
+                _mm256_extractf128_ps( acc2, 1 )
+            );
+            for ( ; k < end; ++k ) {
+                acc = fmaddBlock( b + 9 * k, x + 3 * columns[ k ], acc );
+            }
+            storeVector( dest[ row ], acc );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Product of the blocks of row with the source vector x, four blocks at
+    //! a time, one per 128-bit quarter. If y isn't null, also add the
+    //! transposed product of each off-diagonal block with the row's source
+    //! entry into y, which has nbRows entries, as symmetricSse42 does. The
+    //! fourth lane of the result is garbage.
+    template<class Blocks>
+    __attribute__(( target( "avx512f,avx2,fma" ) ))
+    inline __m128 rowProductAvx512(
+        UInt32 row,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const Blocks& blocks,
+        const float* x,
+        float* y,
+        UInt32 nbRows
+    ) {
+        // Columns of four consecutive blocks, picked out of overlapping
+        // 16-float loads; the fourth lane of each quarter repeats the
+        // third.
+        const __m512i i0 = _mm512_setr_epi32(
+            0, 1, 2, 2, 9, 10, 11, 11, 18, 19, 20, 20, 27, 28, 29, 29
+        );
+        const __m512i i1 = _mm512_setr_epi32(
+            3, 4, 5, 5, 12, 13, 14, 14, 17, 18, 19, 19, 26, 27, 28, 28
+        );
+        const __m512i i2 = _mm512_setr_epi32(
+            2, 3, 4, 4, 11, 12, 13, 13, 20, 21, 22, 22, 29, 30, 31, 31
+        );
+        const __m128 xr = _mm_setr_ps(
+            x[ 3 * row ], x[ 3 * row + 1 ], x[ 3 * row + 2 ], 0.f
+        );
+        const UInt32 end = rowStarts[ row + 1 ];
+        UInt32 k = rowStarts[ row ];
+        GeMatrix3 tmp[ 4 ];
+        __m512 acc4 = _mm512_setzero_ps();
+        for ( ; k + 4 <= end; k += 4 ) {
+            // get() returns either the stored block or the temporary, so
+            // four consecutive slots are contiguous either way.
+            const float* bk = reinterpret_cast<const float*>(
+                &blocks.get( k, columns[ k ] == row, tmp[ 0 ] )
+            );
+            UInt32 i;
+            for ( i = 1; i < 4; ++i ) {
+                blocks.get( k + i, columns[ k + i ] == row, tmp[ i ] );
+            }
+            const __m512 b0 = _mm512_loadu_ps( bk );
+            const __m512 b4 = _mm512_loadu_ps( bk + 4 );
+            const __m512 b20 = _mm512_loadu_ps( bk + 20 );
+            const __m512 c0 = _mm512_permutex2var_ps(
+                b0, i0, _mm512_loadu_ps( bk + 16 )
+            );
+            const __m512 c1 = _mm512_permutex2var_ps( b0, i1, b20 );
+            const __m512 c2 = _mm512_permutex2var_ps( b4, i2, b20 );
+
+            // Source entries, one per quarter. Masked loads don't read
+            // past the entries, even at the end of the vector.
+            __m512 xk = _mm512_maskz_loadu_ps( 0x0007, x + 3 * columns[ k ] );
+            xk = _mm512_mask_loadu_ps(
+                xk, 0x0070, x + 3 * columns[ k + 1 ] - 4
+            );
+            xk = _mm512_mask_loadu_ps(
+                xk, 0x0700, x + 3 * columns[ k + 2 ] - 8
+            );
+            xk = _mm512_mask_loadu_ps(
+                xk, 0x7000, x + 3 * columns[ k + 3 ] - 12
+            );
+            acc4 = _mm512_fmadd_ps( c0, _mm512_permute_ps( xk, 0x00 ), acc4 );
+            acc4 = _mm512_fmadd_ps( c1, _mm512_permute_ps( xk, 0x55 ), acc4 );
+            acc4 = _mm512_fmadd_ps( c2, _mm512_permute_ps( xk, 0xaa ), acc4 );
+
+            if ( y != 0 ) {
+                for ( i = 0; i < 4; ++i ) {
+                    const UInt32 col = columns[ k + i ];
+                    if ( col != row ) {
+                        const float* b = bk + 9 * i;
+                        __m128 c2i = _mm_loadu_ps( b + 5 );
+                        c2i = _mm_shuffle_ps(
+                            c2i, c2i, _MM_SHUFFLE( 3, 3, 2, 1 )
+                        );
+                        addVector( y, col, nbRows, transposeProduct(
+                            _mm_loadu_ps( b ), _mm_loadu_ps( b + 3 ), c2i, xr
+                        ) );
+                    }
+                }
+            }
+        }
+        const __m256 acc2 = _mm256_add_ps(
+            _mm512_castps512_ps256( acc4 ),
+            _mm256_castpd_ps(
+                _mm512_extractf64x4_pd( _mm512_castps_pd( acc4 ), 1 )
+            )
+        );
+        __m128 acc = _mm_add_ps(
+            _mm256_castps256_ps128( acc2 ),
+            _mm256_extractf128_ps( acc2, 1 )
+        );
+        for ( ; k < end; ++k ) {
+            const UInt32 col = columns[ k ];
+            const float* bk = reinterpret_cast<const float*>(
+                &blocks.get( k, col == row, tmp[ 0 ] )
+            );
+            acc = fmaddBlock( bk, x + 3 * col, acc );
+            if ( y != 0 && col != row ) {
+                __m128 c2 = _mm_loadu_ps( bk + 5 );
+                c2 = _mm_shuffle_ps( c2, c2, _MM_SHUFFLE( 3, 3, 2, 1 ) );
+                addVector( y, col, nbRows, transposeProduct(
+                    _mm_loadu_ps( bk ), _mm_loadu_ps( bk + 3 ), c2, xr
+                ) );
+            }
+        }
+        return acc;
+    }
+
+//------------------------------------------------------------------------------
+
+    // The AVX-512 symmetric kernels share rowProductAvx512(), so that the
+    // scattering and row-range products give identical results, as the
+    // narrower ones do.
+
+    template<class Blocks>
+    __attribute__(( target( "avx512f,avx2,fma" ) ))
+    void symmetricAvx512(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const Blocks& blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* x = reinterpret_cast<const float*>( src );
+        float* y = reinterpret_cast<float*>( dest );
+        std::fill( y, y + 3 * nbRows, 0.f );
+        for ( UInt32 row = 0; row < nbRows; ++row ) {
+            const __m128 acc = rowProductAvx512(
+                row, rowStarts, columns, blocks, x, y, nbRows
+            );
+            addVector(
+                y, row, nbRows, _mm_blend_ps( acc, _mm_setzero_ps(), 8 )
+            );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    template<class Blocks>
+    __attribute__(( target( "avx512f,avx2,fma" ) ))
+    void symmetricRowsAvx512(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const Blocks& blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        const float* x = reinterpret_cast<const float*>( src );
+        for ( UInt32 row = rowBegin; row < rowEnd; ++row ) {
+            const __m128 t = gatherTransposes(
+                row, columnStarts, columnSlots, columnRows, blocks, x
+            );
+            const __m128 acc = rowProductAvx512(
+                row, rowStarts, columns, blocks, x, 0, 0
+            );
+            storeVector( dest[ row ], _mm_add_ps( t, acc ) );
+        }
+    }
+
+#endif
+
+    // Kernel table entries for the symmetric and combined products.
+
+//------------------------------------------------------------------------------
+
+    void multiplySymmetricScalar(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricScalar(
+            nbRows, rowStarts, columns, PlainBlocks( blocks ), src, dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplySymmetricRowsScalar(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricRowsScalar(
+            rowBegin,
+            rowEnd,
+            rowStarts,
+            columns,
+            columnStarts,
+            columnSlots,
+            columnRows,
+            PlainBlocks( blocks ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplyCombinedScalar(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricScalar(
+            nbRows,
+            rowStarts,
+            columns,
+            CombinedBlocks( a, blocksA, b, blocksB, blocksD ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplyCombinedRowsScalar(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricRowsScalar(
+            rowBegin,
+            rowEnd,
+            rowStarts,
+            columns,
+            columnStarts,
+            columnSlots,
+            columnRows,
+            CombinedBlocks( a, blocksA, b, blocksB, blocksD ),
+            src,
+            dest
+        );
+    }
+
+#if SIM_KERNELS_X86
+
+//------------------------------------------------------------------------------
+
+    void multiplySymmetricSse42(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricSse42(
+            nbRows, rowStarts, columns, PlainBlocks( blocks ), src, dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplySymmetricRowsSse42(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricRowsSse42(
+            rowBegin,
+            rowEnd,
+            rowStarts,
+            columns,
+            columnStarts,
+            columnSlots,
+            columnRows,
+            PlainBlocks( blocks ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplyCombinedSse42(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricSse42(
+            nbRows,
+            rowStarts,
+            columns,
+            CombinedBlocks( a, blocksA, b, blocksB, blocksD ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplyCombinedRowsSse42(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricRowsSse42(
+            rowBegin,
+            rowEnd,
+            rowStarts,
+            columns,
+            columnStarts,
+            columnSlots,
+            columnRows,
+            CombinedBlocks( a, blocksA, b, blocksB, blocksD ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplySymmetricAvx2(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricAvx2(
+            nbRows, rowStarts, columns, PlainBlocks( blocks ), src, dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplySymmetricRowsAvx2(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricRowsAvx2(
+            rowBegin,
+            rowEnd,
+            rowStarts,
+            columns,
+            columnStarts,
+            columnSlots,
+            columnRows,
+            PlainBlocks( blocks ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplyCombinedAvx2(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricAvx2(
+            nbRows,
+            rowStarts,
+            columns,
+            CombinedBlocks( a, blocksA, b, blocksB, blocksD ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplyCombinedRowsAvx2(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricRowsAvx2(
+            rowBegin,
+            rowEnd,
+            rowStarts,
+            columns,
+            columnStarts,
+            columnSlots,
+            columnRows,
+            CombinedBlocks( a, blocksA, b, blocksB, blocksD ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplySymmetricAvx512(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricAvx512(
+            nbRows, rowStarts, columns, PlainBlocks( blocks ), src, dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplySymmetricRowsAvx512(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricRowsAvx512(
+            rowBegin,
+            rowEnd,
+            rowStarts,
+            columns,
+            columnStarts,
+            columnSlots,
+            columnRows,
+            PlainBlocks( blocks ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplyCombinedAvx512(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricAvx512(
+            nbRows,
+            rowStarts,
+            columns,
+            CombinedBlocks(
+                a, blocksA, b, blocksB, blocksD, combineBlockVex
+            ),
+            src,
+            dest
+        );
+    }
+
+//------------------------------------------------------------------------------
+
+    void multiplyCombinedRowsAvx512(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    ) {
+        symmetricRowsAvx512(
+            rowBegin,
+            rowEnd,
+            rowStarts,
+            columns,
+            columnStarts,
+            columnSlots,
+            columnRows,
+            CombinedBlocks(
+                a, blocksA, b, blocksB, blocksD, combineBlockVex
+            ),
+            src,
+            dest
+        );
+    }
+
+#endif
+}
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimMatrixKernels
+
+//------------------------------------------------------------------------------
+
+bool SimMatrixKernels::isSupported( Isa isa )
+{
+#if SIM_KERNELS_X86
+    __builtin_cpu_init();
+#endif
+    // The SIMD kernels treat blocks and vectors as packed float arrays.
+    if ( sizeof( GeMatrix3 ) != 9 * sizeof( float ) ||
+        sizeof( GeVector ) != 3 * sizeof( float )
+    ) {
+        return isa == ISA_SCALAR;
+    }
+    switch ( isa ) {
+        case ISA_SCALAR:
+            return true;
+#if SIM_KERNELS_X86
+        case ISA_SSE42:
+            return __builtin_cpu_supports( "sse4.2" );
+        case ISA_AVX2:
+            return __builtin_cpu_supports( "avx2" ) &&
+                __builtin_cpu_supports( "fma" );
+        case ISA_AVX512:
+            return __builtin_cpu_supports( "avx512f" ) &&
+                __builtin_cpu_supports( "fma" );
+#endif
+        default:
+            return false;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::Isa SimMatrixKernels::getBestIsa()
+{
+    Int32 isa;
+    for ( isa = NB_ISAS - 1; isa > ISA_SCALAR; --isa ) {
+        if ( isSupported( Isa( isa ) ) ) {
+            break;
+        }
+    }
+    return Isa( isa );
+}
+
+//------------------------------------------------------------------------------
+
+const char* SimMatrixKernels::getIsaName( Isa isa )
+{
+    switch ( isa ) {
+        case ISA_SCALAR:    return "scalar";
+        case ISA_SSE42:     return "sse4.2";
+        case ISA_AVX2:      return "avx2";
+        case ISA_AVX512:    return "avx512";
+        default:            return "unknown";
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::Isa SimMatrixKernels::getIsa()
+{
+    return theIsa;
+}
+
+//------------------------------------------------------------------------------
+
+void SimMatrixKernels::setIsa( Isa isa )
+{
+    DGFX_ASSERT( isSupported( isa ) );
+    theIsa = isa;
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplyKernel SimMatrixKernels::getMultiply()
+{
+    return getMultiply( getIsa() );
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplyKernel SimMatrixKernels::getMultiply( Isa isa )
+{
+    switch ( isa ) {
+#if SIM_KERNELS_X86
+        case ISA_SSE42:     return multiplySse42;
+        case ISA_AVX2:      return multiplyAvx2;
+        case ISA_AVX512:    return multiplyAvx512;
+#endif
+        default:            return multiplyScalar;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplySymmetricKernel
+SimMatrixKernels::getMultiplySymmetric()
+{
+    return getMultiplySymmetric( getIsa() );
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplySymmetricKernel
+SimMatrixKernels::getMultiplySymmetric( Isa isa )
+{
+    switch ( isa ) {
+#if SIM_KERNELS_X86
+        case ISA_SSE42:     return multiplySymmetricSse42;
+        case ISA_AVX2:      return multiplySymmetricAvx2;
+        case ISA_AVX512:    return multiplySymmetricAvx512;
+#endif
+        default:            return multiplySymmetricScalar;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplySymmetricRowsKernel
+SimMatrixKernels::getMultiplySymmetricRows()
+{
+    return getMultiplySymmetricRows( getIsa() );
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplySymmetricRowsKernel
+SimMatrixKernels::getMultiplySymmetricRows( Isa isa )
+{
+    switch ( isa ) {
+#if SIM_KERNELS_X86
+        case ISA_SSE42:     return multiplySymmetricRowsSse42;
+        case ISA_AVX2:      return multiplySymmetricRowsAvx2;
+        case ISA_AVX512:    return multiplySymmetricRowsAvx512;
+#endif
+        default:            return multiplySymmetricRowsScalar;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplyCombinedKernel
+SimMatrixKernels::getMultiplyCombined()
+{
+    return getMultiplyCombined( getIsa() );
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplyCombinedKernel
+SimMatrixKernels::getMultiplyCombined( Isa isa )
+{
+    switch ( isa ) {
+#if SIM_KERNELS_X86
+        case ISA_SSE42:     return multiplyCombinedSse42;
+        case ISA_AVX2:      return multiplyCombinedAvx2;
+        case ISA_AVX512:    return multiplyCombinedAvx512;
+#endif
+        default:            return multiplyCombinedScalar;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplyCombinedRowsKernel
+SimMatrixKernels::getMultiplyCombinedRows()
+{
+    return getMultiplyCombinedRows( getIsa() );
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixKernels::MultiplyCombinedRowsKernel
+SimMatrixKernels::getMultiplyCombinedRows( Isa isa )
+{
+    switch ( isa ) {
+#if SIM_KERNELS_X86
+        case ISA_SSE42:     return multiplyCombinedRowsSse42;
+        case ISA_AVX2:      return multiplyCombinedRowsAvx2;
+        case ISA_AVX512:    return multiplyCombinedRowsAvx512;
+#endif
+        default:            return multiplyCombinedRowsScalar;
+    }
+}
+
+FREECLOTH_NAMESPACE_END
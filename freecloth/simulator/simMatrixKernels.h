@@ -0,0 +1,183 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#ifndef freecloth_sim_simMatrixKernels_h
+#define freecloth_sim_simMatrixKernels_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class GeMatrix3;
+class GeVector;
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimMatrixKernels freecloth/simulator/simMatrixKernels.h
+ * \brief Low-level kernels for block sparse matrix operations.
+ *
+ * The block sparse matrix-vector product dominates the cost of each PCG
+ * iteration. Several implementations of it are provided, one for each
+ * supported instruction set, and the best one for the host CPU is chosen
+ * at run time. On compilers or platforms without SIMD support, only the
+ * scalar kernel is available.
+ *
+ * The SIMD kernels process the three columns of each 3x3 block as vector
+ * registers, and the wider ones handle several blocks of a row at once.
+ * Symmetric products also apply the transpose of each off-diagonal block.
+ * Their AVX-512 variants take four blocks of a row at once, like the
+ * general product, but apply the transposes one block at a time.
+ * Row-range variants of the symmetric product gather the transposed blocks
+ * through the pattern's column index, so that disjoint row ranges can be
+ * computed by different threads.
+ * Combined products, for a * A + b * B + diag( D ) without forming it,
+ * share the symmetric kernels' arithmetic: each block is combined as it's
+ * read, so that matrix-free solves round exactly as assembled ones do.
+ * The source vector entries needed later in the row are prefetched, since
+ * they are gathered from arbitrary columns. The SSE kernel gives exactly
+ * the same results as the scalar one; the AVX kernels use fused
+ * multiply-adds, and so differ in the last bits.
+ */
+class SimMatrixKernels
+{
+public:
+    // ----- types and enumerations -----
+
+    enum Isa {
+        ISA_SCALAR,
+        ISA_SSE42,
+        ISA_AVX2,
+        ISA_AVX512,
+
+        NB_ISAS
+    };
+
+    //! Compute dest[ r ] = sum over slots k of row r of
+    //! blocks[ k ] * src[ columns[ k ] ], in block-compressed-row form.
+    //! See SimMatrixPattern for details.
+    typedef void (*MultiplyKernel)(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    );
+
+    //! As for MultiplyKernel, but for a symmetric matrix stored as its upper
+    //! triangle: each off-diagonal block k also contributes
+    //! transpose( blocks[ k ] ) * src[ r ] to dest[ columns[ k ] ].
+    typedef MultiplyKernel MultiplySymmetricKernel;
+
+    //! Compute rows [ rowBegin, rowEnd ) of the MultiplySymmetricKernel
+    //! product, reading the transposed blocks of each row through the
+    //! column index (see SimMatrixPattern). Only those rows of dest are
+    //! written. The result is identical to that of the
+    //! MultiplySymmetricKernel for the same instruction set.
+    typedef void (*MultiplySymmetricRowsKernel)(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        const GeMatrix3* blocks,
+        const GeVector* src,
+        GeVector* dest
+    );
+
+    //! As for MultiplySymmetricKernel, but for the matrix
+    //! a * A + b * B + diag( D ), without forming it. A, B and D share the
+    //! same pattern, and only the diagonal blocks of D are used. Each block
+    //! is combined in the same operation order as
+    //! SimMatrix::setCombination(), so the result is identical to that of
+    //! the MultiplySymmetricKernel on the assembled matrix.
+    typedef void (*MultiplyCombinedKernel)(
+        UInt32 nbRows,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    );
+
+    //! Row-range version of MultiplyCombinedKernel, as for
+    //! MultiplySymmetricRowsKernel.
+    typedef void (*MultiplyCombinedRowsKernel)(
+        UInt32 rowBegin,
+        UInt32 rowEnd,
+        const UInt32* rowStarts,
+        const UInt32* columns,
+        const UInt32* columnStarts,
+        const UInt32* columnSlots,
+        const UInt32* columnRows,
+        Float a,
+        const GeMatrix3* blocksA,
+        Float b,
+        const GeMatrix3* blocksB,
+        const GeMatrix3* blocksD,
+        const GeVector* src,
+        GeVector* dest
+    );
+
+    // ----- static member functions -----
+
+    //! True if the kernel was compiled in and the host CPU supports it.
+    static bool isSupported( Isa );
+    //! Best supported instruction set for this CPU.
+    static Isa getBestIsa();
+    static const char* getIsaName( Isa );
+
+    //! Instruction set in use. Defaults to getBestIsa().
+    static Isa getIsa();
+    //! Override the instruction set, e.g. for benchmarking. Must be
+    //! supported, and not called while any simulator is stepping.
+    static void setIsa( Isa );
+
+    //! Block sparse matrix-vector product for the current instruction set.
+    static MultiplyKernel getMultiply();
+    static MultiplyKernel getMultiply( Isa );
+    //! Symmetric block sparse matrix-vector product for the current
+    //! instruction set.
+    static MultiplySymmetricKernel getMultiplySymmetric();
+    static MultiplySymmetricKernel getMultiplySymmetric( Isa );
+    //! Row-range symmetric product for the current instruction set.
+    static MultiplySymmetricRowsKernel getMultiplySymmetricRows();
+    static MultiplySymmetricRowsKernel getMultiplySymmetricRows( Isa );
+    //! Combined symmetric product for the current instruction set.
+    static MultiplyCombinedKernel getMultiplyCombined();
+    static MultiplyCombinedKernel getMultiplyCombined( Isa );
+    //! Row-range combined product for the current instruction set.
+    static MultiplyCombinedRowsKernel getMultiplyCombinedRows();
+    static MultiplyCombinedRowsKernel getMultiplyCombinedRows( Isa );
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif
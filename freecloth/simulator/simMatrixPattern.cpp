@@ -0,0 +1,195 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <freecloth/simulator/simMatrixPattern.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/geom/geMeshWingedEdge.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    using namespace freecloth;
+
+//------------------------------------------------------------------------------
+
+    //! Add a block for every pair of the given vertices.
+    void addAllPairs(
+        SimMatrixPattern::BlockList& blocks,
+        const GeMesh::VertexId* vids,
+        UInt32 nbVids
+    ) {
+        for ( UInt32 m = 0; m < nbVids; ++m ) {
+            for ( UInt32 n = 0; n < nbVids; ++n ) {
+                blocks.push_back(
+                    SimMatrixPattern::Block( vids[ m ], vids[ n ] )
+                );
+            }
+        }
+    }
+}
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimMatrixPattern
+
+//------------------------------------------------------------------------------
+
+RCShdPtr<SimMatrixPattern> SimMatrixPattern::createFromMesh(
+    const GeMeshWingedEdge& meshwe
+) {
+    const GeMesh& mesh = meshwe.getMesh();
+    const UInt32 N = mesh.getNbVertices();
+
+    BlockList blocks;
+    blocks.reserve( N + mesh.getNbFaces() * 9 + meshwe.getNbHalfEdges() * 8 );
+
+    UInt32 i;
+    for ( i = 0; i < N; ++i ) {
+        blocks.push_back( Block( i, i ) );
+    }
+
+    // Stretch and shear forces couple the vertices of each face.
+    GeMesh::FaceConstIterator fi;
+    for ( fi = mesh.beginFace(); fi != mesh.endFace(); ++fi ) {
+        GeMesh::VertexId vid[ 3 ];
+        for ( i = 0; i < 3; ++i ) {
+            vid[ i ] = fi->getVertexId( i );
+        }
+        addAllPairs( blocks, vid, 3 );
+    }
+
+    // Bend forces couple the four vertices of the two faces adjacent to each
+    // interior edge. Vertex order matches SimSimulator::calcBend.
+    GeMeshWingedEdge::EdgeIterator ei;
+    for ( ei = meshwe.beginEdge(); ei != meshwe.endEdge(); ++ei ) {
+        if ( ! ei->hasTwin() ) {
+            continue;
+        }
+        GeMesh::VertexId vid[ 4 ];
+        vid[ 0 ] = ei->getPrevHalfEdge().getOriginVertexId();
+        vid[ 1 ] = ei->getOriginVertexId();
+        vid[ 2 ] = ei->getNextHalfEdge().getOriginVertexId();
+        vid[ 3 ] =
+            ei->getTwinHalfEdge().getPrevHalfEdge().getOriginVertexId();
+        addAllPairs( blocks, vid, 4 );
+    }
+
+    return RCShdPtr<SimMatrixPattern>( new SimMatrixPattern( N, N, blocks ) );
+}
+
+//------------------------------------------------------------------------------
+
+RCShdPtr<SimMatrixPattern> SimMatrixPattern::createUpperTriangle(
+    const SimMatrixPattern& full
+) {
+    BlockList blocks;
+    blocks.reserve( ( full.nbBlocks() + full.nbRows() ) / 2 );
+    for ( UInt32 row = 0; row < full.nbRows(); ++row ) {
+        const UInt32 end = full.getRowEnd( row );
+        for ( UInt32 k = full.getRowBegin( row ); k < end; ++k ) {
+            if ( full.getColumn( k ) >= row ) {
+                blocks.push_back( Block( row, full.getColumn( k ) ) );
+            }
+        }
+    }
+    return RCShdPtr<SimMatrixPattern>(
+        new SimMatrixPattern( full.nbRows(), full.nbColumns(), blocks )
+    );
+}
+
+//------------------------------------------------------------------------------
+
+bool SimMatrixPattern::isUpperTriangle() const
+{
+    for ( UInt32 row = 0; row < nbRows(); ++row ) {
+        // Columns are sorted, so only the first block of each row matters.
+        if ( getRowBegin( row ) != getRowEnd( row ) &&
+            getColumn( getRowBegin( row ) ) < row
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+SimMatrixPattern::SimMatrixPattern(
+    UInt32 nbRows,
+    UInt32 nbColumns,
+    const BlockList& blocks
+) : _nbRows( nbRows ),
+    _nbColumns( nbColumns )
+{
+    BlockList sorted( blocks );
+    std::sort( sorted.begin(), sorted.end() );
+    sorted.erase( std::unique( sorted.begin(), sorted.end() ), sorted.end() );
+
+    _rowStarts.resize( nbRows + 1 );
+    _columns.resize( sorted.size() );
+    _diagonalSlots.resize( nbRows );
+    std::fill(
+        _diagonalSlots.begin(), _diagonalSlots.end(), UInt32( SLOT_INVALID )
+    );
+
+    UInt32 row = 0;
+    _rowStarts[ 0 ] = 0;
+    for ( UInt32 slot = 0; slot < sorted.size(); ++slot ) {
+        const Block& b = sorted[ slot ];
+        DGFX_ASSERT( b.first < nbRows && b.second < nbColumns );
+        while ( row < b.first ) {
+            _rowStarts[ ++row ] = slot;
+        }
+        _columns[ slot ] = b.second;
+        if ( b.first == b.second ) {
+            _diagonalSlots[ row ] = slot;
+        }
+    }
+    while ( row < nbRows ) {
+        _rowStarts[ ++row ] = sorted.size();
+    }
+
+    // Column index, by counting sort. Visiting slots in row order leaves
+    // each column's entries sorted by row.
+    _columnStarts.assign( nbColumns + 1, 0 );
+    UInt32 slot;
+    for ( slot = 0; slot < sorted.size(); ++slot ) {
+        if ( sorted[ slot ].first != sorted[ slot ].second ) {
+            ++_columnStarts[ sorted[ slot ].second + 1 ];
+        }
+    }
+    UInt32 col;
+    for ( col = 0; col < nbColumns; ++col ) {
+        _columnStarts[ col + 1 ] += _columnStarts[ col ];
+    }
+    _columnSlots.resize( _columnStarts[ nbColumns ] );
+    _columnRows.resize( _columnStarts[ nbColumns ] );
+    std::vector<UInt32> next( _columnStarts );
+    for ( slot = 0; slot < sorted.size(); ++slot ) {
+        const Block& b = sorted[ slot ];
+        if ( b.first != b.second ) {
+            const UInt32 i = next[ b.second ]++;
+            _columnSlots[ i ] = slot;
+            _columnRows[ i ] = b.first;
+        }
+    }
+}
+
+FREECLOTH_NAMESPACE_END
@@ -0,0 +1,166 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_sim_simMatrixPattern_h
+#define freecloth_sim_simMatrixPattern_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+#ifndef freecloth_resmgt_rcShdPtr_h
+#include <freecloth/resmgt/rcShdPtr.h>
+#endif
+
+#ifndef freecloth_base_vector
+#include <freecloth/base/vector>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class GeMeshWingedEdge;
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimMatrixPattern freecloth/simulator/simMatrixPattern.h
+ * \brief Immutable sparsity pattern for block sparse matrices.
+ *
+ * Stores the positions of the non-zero 3x3 blocks of a SimMatrix in
+ * block-compressed-row form: the blocks of each row are stored contiguously,
+ * sorted by column. A block's index within this ordering is its "slot", and
+ * SimMatrix stores its values in a flat array indexed by slot.
+ *
+ * A column index is also kept: the off-diagonal slots of each column,
+ * sorted by row. It lets the products of symmetric matrices stored as
+ * their upper triangle be evaluated a row at a time, gathering the
+ * transposed blocks instead of scattering them.
+ *
+ * For cloth, the pattern depends only upon the mesh topology, so it is
+ * built once with createFromMesh() and shared by all matrices used in the
+ * simulation. Matrices sharing a pattern can be added together with a
+ * straight array operation.
+ */
+class SimMatrixPattern : public RCBase
+{
+public:
+    // ----- types and enumerations -----
+
+    //! (row, column) position of a block
+    typedef std::pair<UInt32, UInt32> Block;
+    typedef std::vector<Block> BlockList;
+
+    enum { SLOT_INVALID = ~0U };
+
+    // ----- static member functions -----
+
+    //! Named constructor: build the pattern needed for cloth simulation
+    //! of the given mesh. Every pair of vertices sharing a face, and every
+    //! pair of vertices in the four-vertex stencil of an interior edge (as
+    //! used by bend forces) will have a block in the pattern. The diagonal
+    //! is always included.
+    static RCShdPtr<SimMatrixPattern> createFromMesh( const GeMeshWingedEdge& );
+    //! Named constructor: keep only the blocks on or above the diagonal of
+    //! the given pattern, for use by symmetric matrices.
+    static RCShdPtr<SimMatrixPattern> createUpperTriangle(
+        const SimMatrixPattern&
+    );
+
+    // ----- member functions -----
+
+    //! Build a pattern from an arbitrary list of blocks. Duplicates are
+    //! allowed, and the list need not be sorted.
+    SimMatrixPattern(
+        UInt32 nbRows,
+        UInt32 nbColumns,
+        const BlockList& blocks
+    );
+
+    UInt32 nbRows() const;
+    UInt32 nbColumns() const;
+    UInt32 nbBlocks() const;
+
+    //@{
+    //! The slots for row r lie in [ getRowBegin( r ), getRowEnd( r ) ).
+    UInt32 getRowBegin( UInt32 row ) const;
+    UInt32 getRowEnd( UInt32 row ) const;
+    //@}
+    UInt32 getColumn( UInt32 slot ) const;
+    //@{
+    //! Entries [ getColumnBegin( c ), getColumnEnd( c ) ) of the column
+    //! index hold the off-diagonal blocks of column c.
+    UInt32 getColumnBegin( UInt32 col ) const;
+    UInt32 getColumnEnd( UInt32 col ) const;
+    //@}
+    //! Find the slot for the given block, or SLOT_INVALID if the block is
+    //! not in the pattern.
+    UInt32 findSlot( UInt32 row, UInt32 col ) const;
+    //! Slot of the diagonal block of row r, or SLOT_INVALID.
+    UInt32 getDiagonalSlot( UInt32 row ) const;
+    //! True if there are no blocks below the diagonal.
+    bool isUpperTriangle() const;
+
+    //@{
+    //! Raw arrays, for use by tight loops.
+    const UInt32* getRowStarts() const;
+    const UInt32* getColumns() const;
+    //! Size nbColumns + 1; the column index equivalent of getRowStarts().
+    const UInt32* getColumnStarts() const;
+    //! Slot of each column index entry.
+    const UInt32* getColumnSlots() const;
+    //! Row of each column index entry.
+    const UInt32* getColumnRows() const;
+    //@}
+
+private:
+    // ----- member functions -----
+
+    // Patterns are shared, not copied.
+    SimMatrixPattern( const SimMatrixPattern& );
+    SimMatrixPattern& operator=( const SimMatrixPattern& );
+
+    // ----- data members -----
+
+    UInt32 _nbRows, _nbColumns;
+    //! Size nbRows + 1. Row r occupies slots [ _rowStarts[r], _rowStarts[r+1] )
+    std::vector<UInt32> _rowStarts;
+    //! Size nbBlocks. Column of each slot.
+    std::vector<UInt32> _columns;
+    //! Size nbRows. Slot of each diagonal block.
+    std::vector<UInt32> _diagonalSlots;
+    //! Size nbColumns + 1. Column c occupies entries
+    //! [ _columnStarts[c], _columnStarts[c+1] ) of the column index.
+    std::vector<UInt32> _columnStarts;
+    //@{
+    //! Column index: slot and row of each off-diagonal block, by column.
+    std::vector<UInt32> _columnSlots;
+    std::vector<UInt32> _columnRows;
+    //@}
+};
+
+FREECLOTH_NAMESPACE_END
+
+#include <freecloth/simulator/simMatrixPattern.inline.h>
+
+#endif
@@ -0,0 +1,150 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_simulator_simMatrixPattern_inline_h
+#define freecloth_simulator_simMatrixPattern_inline_h
+
+#include <freecloth/base/algorithm>
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimMatrixPattern
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::nbRows() const
+{
+    return _nbRows;
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::nbColumns() const
+{
+    return _nbColumns;
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::nbBlocks() const
+{
+    return _columns.size();
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::getRowBegin( UInt32 row ) const
+{
+    DGFX_ASSERT( row < nbRows() );
+    return _rowStarts[ row ];
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::getRowEnd( UInt32 row ) const
+{
+    DGFX_ASSERT( row < nbRows() );
+    return _rowStarts[ row + 1 ];
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::getColumn( UInt32 slot ) const
+{
+    DGFX_ASSERT( slot < nbBlocks() );
+    return _columns[ slot ];
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::getColumnBegin( UInt32 col ) const
+{
+    DGFX_ASSERT( col < nbColumns() );
+    return _columnStarts[ col ];
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::getColumnEnd( UInt32 col ) const
+{
+    DGFX_ASSERT( col < nbColumns() );
+    return _columnStarts[ col + 1 ];
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::findSlot( UInt32 row, UInt32 col ) const
+{
+    DGFX_ASSERT( row < nbRows() );
+    const UInt32* begin = getColumns() + _rowStarts[ row ];
+    const UInt32* end = getColumns() + _rowStarts[ row + 1 ];
+    const UInt32* c = std::lower_bound( begin, end, col );
+    if ( c == end || *c != col ) {
+        return SLOT_INVALID;
+    }
+    return c - getColumns();
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimMatrixPattern::getDiagonalSlot( UInt32 row ) const
+{
+    DGFX_ASSERT( row < nbRows() );
+    return _diagonalSlots[ row ];
+}
+
+//------------------------------------------------------------------------------
+
+inline const UInt32* SimMatrixPattern::getRowStarts() const
+{
+    return &_rowStarts[ 0 ];
+}
+
+//------------------------------------------------------------------------------
+
+inline const UInt32* SimMatrixPattern::getColumns() const
+{
+    // Pattern may legitimately be empty; avoid indexing an empty vector.
+    return _columns.empty() ? 0 : &_columns[ 0 ];
+}
+
+//------------------------------------------------------------------------------
+
+inline const UInt32* SimMatrixPattern::getColumnStarts() const
+{
+    return &_columnStarts[ 0 ];
+}
+
+//------------------------------------------------------------------------------
+
+inline const UInt32* SimMatrixPattern::getColumnSlots() const
+{
+    return _columnSlots.empty() ? 0 : &_columnSlots[ 0 ];
+}
+
+//------------------------------------------------------------------------------
+
+inline const UInt32* SimMatrixPattern::getColumnRows() const
+{
+    return _columnRows.empty() ? 0 : &_columnRows[ 0 ];
+}
+
+FREECLOTH_NAMESPACE_END
+
+#endif
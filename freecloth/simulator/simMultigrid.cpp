@@ -0,0 +1,662 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simMultigrid.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/geom/geMatrix3.h>
+#include <freecloth/base/algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    using namespace freecloth;
+
+    //! Levels are coarsened until they have no more than this many
+    //! vertices, and are then solved directly.
+    const UInt32 COARSEST_NB_VERTICES = 64;
+    //! Coarsening stops if a level would keep more than this fraction of
+    //! the vertices of the level above.
+    const Float MIN_COARSENING = .9f;
+    //! Jacobi sweeps before and after each coarse correction.
+    const UInt32 NB_SMOOTHING_SWEEPS = 2;
+    //! Jacobi damping factor.
+    const Float JACOBI_DAMPING = .67f;
+    //! Pivots below this fraction of their original diagonal entry are
+    //! treated as zero by choleskyFactor().
+    const Float PIVOT_TOLERANCE = 1e-5f;
+
+    enum { VERTEX_INVALID = ~0U };
+
+    //! How a fine block contributes to the Galerkin coarse matrix.
+    enum CoarseMode {
+        //! Added as is.
+        COARSE_DIRECT,
+        //! The fine block maps below the coarse diagonal; its transpose
+        //! is added.
+        COARSE_TRANSPOSE,
+        //! An off-diagonal fine block within a single coarse vertex, which
+        //! stands for itself and its transpose.
+        COARSE_SYMMETRIC
+    };
+
+//------------------------------------------------------------------------------
+
+    //! In-place Cholesky factorization of the dense, symmetric positive
+    //! semi-definite, row-major n x n matrix a, into the lower triangle.
+    //! Directions with null pivots are removed, by zeroing their column
+    //! of the factor, so that choleskySolve() gives them a zero result.
+    void choleskyFactor( Float* a, UInt32 n )
+    {
+        for ( UInt32 k = 0; k < n; ++k ) {
+            Float* rowK = a + k * n;
+            const Float original = rowK[ k ];
+            Float pivot = original;
+            UInt32 j;
+            for ( j = 0; j < k; ++j ) {
+                pivot -= rowK[ j ] * rowK[ j ];
+            }
+            if ( ! ( pivot > PIVOT_TOLERANCE * original ) ) {
+                for ( UInt32 i = k; i < n; ++i ) {
+                    a[ i * n + k ] = 0;
+                }
+                continue;
+            }
+            const Float l = BaMath::sqrt( pivot );
+            rowK[ k ] = l;
+            for ( UInt32 i = k + 1; i < n; ++i ) {
+                Float* rowI = a + i * n;
+                Float sum = rowI[ k ];
+                for ( j = 0; j < k; ++j ) {
+                    sum -= rowI[ j ] * rowK[ j ];
+                }
+                rowI[ k ] = sum / l;
+            }
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Solve L L^T x = x in place, given the factor from choleskyFactor().
+    void choleskySolve( const Float* l, UInt32 n, Float* x )
+    {
+        Int32 i;
+        UInt32 j;
+        for ( i = 0; i < Int32( n ); ++i ) {
+            const Float* rowI = l + i * n;
+            if ( rowI[ i ] == 0 ) {
+                x[ i ] = 0;
+                continue;
+            }
+            Float sum = x[ i ];
+            for ( j = 0; j < UInt32( i ); ++j ) {
+                sum -= rowI[ j ] * x[ j ];
+            }
+            x[ i ] = sum / rowI[ i ];
+        }
+        for ( i = n - 1; i >= 0; --i ) {
+            if ( l[ i * n + i ] == 0 ) {
+                x[ i ] = 0;
+                continue;
+            }
+            Float sum = x[ i ];
+            for ( j = i + 1; j < n; ++j ) {
+                sum -= l[ j * n + i ] * x[ j ];
+            }
+            x[ i ] = sum / l[ i * n + i ];
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Inverse of the symmetric part of a positive semi-definite block,
+    //! ignoring its null directions.
+    GeMatrix3 invertSemiDefinite( const GeMatrix3& a )
+    {
+        Float l[ 9 ];
+        UInt32 i, j;
+        for ( i = 0; i < 3; ++i ) for ( j = 0; j < 3; ++j ) {
+            l[ i * 3 + j ] = ( a( i, j ) + a( j, i ) ) * .5f;
+        }
+        choleskyFactor( l, 3 );
+        GeMatrix3 inv;
+        for ( j = 0; j < 3; ++j ) {
+            Float x[ 3 ] = { 0, 0, 0 };
+            x[ j ] = 1;
+            choleskySolve( l, 3, x );
+            for ( i = 0; i < 3; ++i ) {
+                inv( i, j ) = x[ i ];
+            }
+        }
+        return inv;
+    }
+
+//------------------------------------------------------------------------------
+
+    typedef SimMatrixPattern::Block Edge;
+    //! Ordering for edge collapses: shortest first, ties broken by index so
+    //! that the hierarchy is reproducible.
+    typedef std::pair<Float, UInt32> EdgeKey;
+
+    //! Collapse the shortest edges of the graph first, each vertex at most
+    //! once. The positions, weights and edges are replaced by those of the
+    //! collapsed graph, and the vertex each old vertex collapsed into is
+    //! stored in collapsed.
+    void collapseEdges(
+        std::vector<GePoint>& positions,
+        std::vector<UInt32>& weights,
+        std::vector<Edge>& edges,
+        std::vector<UInt32>& collapsed
+    ) {
+        const UInt32 N = positions.size();
+        std::vector<EdgeKey> order( edges.size() );
+        UInt32 e, i;
+        for ( e = 0; e < edges.size(); ++e ) {
+            order[ e ] = EdgeKey(
+                GeVector(
+                    positions[ edges[ e ].first ],
+                    positions[ edges[ e ].second ]
+                ).length(),
+                e
+            );
+        }
+        std::sort( order.begin(), order.end() );
+        std::vector<UInt32> partners( N, UInt32( VERTEX_INVALID ) );
+        for ( e = 0; e < order.size(); ++e ) {
+            const Edge& edge = edges[ order[ e ].second ];
+            if ( partners[ edge.first ] == VERTEX_INVALID &&
+                partners[ edge.second ] == VERTEX_INVALID
+            ) {
+                partners[ edge.first ] = edge.second;
+                partners[ edge.second ] = edge.first;
+            }
+        }
+
+        // Number the new vertices in order of their first old vertex, to
+        // keep some locality.
+        collapsed.assign( N, UInt32( VERTEX_INVALID ) );
+        UInt32 nbCollapsed = 0;
+        for ( i = 0; i < N; ++i ) {
+            if ( collapsed[ i ] == VERTEX_INVALID ) {
+                collapsed[ i ] = nbCollapsed;
+                if ( partners[ i ] != VERTEX_INVALID ) {
+                    collapsed[ partners[ i ] ] = nbCollapsed;
+                }
+                ++nbCollapsed;
+            }
+        }
+
+        std::vector<GePoint> newPositions( nbCollapsed );
+        std::vector<UInt32> newWeights( nbCollapsed, 0 );
+        for ( i = 0; i < N; ++i ) {
+            const UInt32 c = collapsed[ i ];
+            const UInt32 w = newWeights[ c ] + weights[ i ];
+            // Weighted centroid of the collapsed vertices.
+            newPositions[ c ] = newWeights[ c ] == 0 ?
+                positions[ i ] :
+                GePoint(
+                    newPositions[ c ], positions[ i ],
+                    Float( newWeights[ c ] ) / w
+                );
+            newWeights[ c ] = w;
+        }
+        std::vector<Edge> newEdges;
+        newEdges.reserve( edges.size() );
+        for ( e = 0; e < edges.size(); ++e ) {
+            const UInt32 a = collapsed[ edges[ e ].first ];
+            const UInt32 b = collapsed[ edges[ e ].second ];
+            if ( a != b ) {
+                newEdges.push_back(
+                    Edge( std::min( a, b ), std::max( a, b ) )
+                );
+            }
+        }
+        std::sort( newEdges.begin(), newEdges.end() );
+        newEdges.erase(
+            std::unique( newEdges.begin(), newEdges.end() ), newEdges.end()
+        );
+
+        positions.swap( newPositions );
+        weights.swap( newWeights );
+        edges.swap( newEdges );
+    }
+}
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimMultigrid::Level
+ *
+ * Operator and work vectors for one level of the hierarchy.
+ */
+class SimMultigrid::Level
+{
+public:
+    // ----- data members -----
+
+    //! System matrix.
+    SimSymMatrix    _A;
+    //! Inverse of the diagonal blocks of _A, for smoothing.
+    std::vector<GeMatrix3> _Dinv;
+    //! Vertex of the next coarser level that each vertex collapses into.
+    //! Empty on the coarsest level.
+    std::vector<UInt32> _coarseVertices;
+    //@{
+    //! For each slot of _A, the slot of the next coarser level's matrix
+    //! that it's added into, and how.
+    std::vector<UInt32> _coarseSlots;
+    std::vector<UInt8> _coarseModes;
+    //@}
+    //! Solution, right-hand side, and A * _x.
+    SimVector       _x, _b, _r;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimMultigrid::SmoothTask
+ *
+ * Computes a range of rows of a Jacobi sweep: either the product with the
+ * current solution, or the update of the solution from that product.
+ */
+class SimMultigrid::SmoothTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    SmoothTask( SimMultigrid&, UInt32 level, bool zeroGuess, bool multiply );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+
+    // ----- data members -----
+    SimMultigrid&   _multigrid;
+    UInt32          _level;
+    bool            _zeroGuess;
+    //! If set, compute _r = _A * _x; otherwise, update _x.
+    bool            _multiply;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimMultigrid::SmoothTask
+//
+
+//------------------------------------------------------------------------------
+
+SimMultigrid::SmoothTask::SmoothTask(
+    SimMultigrid& multigrid,
+    UInt32 level,
+    bool zeroGuess,
+    bool multiply
+) : _multigrid( multigrid ),
+    _level( level ),
+    _zeroGuess( zeroGuess ),
+    _multiply( multiply )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::SmoothTask::run( UInt32 begin, UInt32 end, UInt32 )
+{
+    if ( _multiply ) {
+        Level& level = *_multigrid._levels[ _level ];
+        SimSymMatrix::multiplyRows( level._r, level._A, level._x, begin, end );
+    }
+    else {
+        _multigrid.smoothRows( _level, _zeroGuess, begin, end );
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimMultigrid
+//
+
+//------------------------------------------------------------------------------
+
+SimMultigrid::SimMultigrid(
+    const GeMesh& mesh,
+    const RCShdPtr<SimMatrixPattern>& pattern
+) : _threadPool( new SimThreadPool( 1 ) )
+{
+    DGFX_ASSERT( pattern->isUpperTriangle() );
+    DGFX_ASSERT( pattern->nbRows() == mesh.getNbVertices() );
+
+    // Vertex positions and weights (number of fine vertices) of the
+    // current level, and its edges.
+    UInt32 N = mesh.getNbVertices();
+    std::vector<GePoint> positions( N );
+    std::vector<UInt32> weights( N, 1 );
+    std::vector<Edge> edges;
+    UInt32 i;
+    for ( i = 0; i < N; ++i ) {
+        positions[ i ] = mesh.hasTexture() ?
+            mesh.getTextureVertex( i ) : mesh.getVertex( i );
+    }
+    GeMesh::FaceConstIterator fi;
+    for ( fi = mesh.beginFace(); fi != mesh.endFace(); ++fi ) {
+        for ( UInt32 m = 0; m < 3; ++m ) {
+            const UInt32 a = fi->getVertexId( m );
+            const UInt32 b = fi->getVertexId( ( m + 1 ) % 3 );
+            edges.push_back( Edge( std::min( a, b ), std::max( a, b ) ) );
+        }
+    }
+    std::sort( edges.begin(), edges.end() );
+    edges.erase( std::unique( edges.begin(), edges.end() ), edges.end() );
+
+    _levels.push_back( new Level );
+    _levels.back()->_A = SimSymMatrix( pattern );
+
+    while ( N > COARSEST_NB_VERTICES && ! edges.empty() ) {
+        std::vector<UInt32> coarseVertices;
+        collapseEdges( positions, weights, edges, coarseVertices );
+        const UInt32 nbCoarse = positions.size();
+        if ( nbCoarse > MIN_COARSENING * N ) {
+            break;
+        }
+
+        // The Galerkin product P^T A P has a block wherever some fine block
+        // connects the two coarse vertices.
+        Level& fine = *_levels.back();
+        const SimMatrixPattern& finePattern = *fine._A.getPattern();
+        SimMatrixPattern::BlockList blocks;
+        blocks.reserve( finePattern.nbBlocks() );
+        UInt32 slot;
+        for ( i = 0; i < N; ++i ) {
+            const UInt32 end = finePattern.getRowEnd( i );
+            for ( slot = finePattern.getRowBegin( i ); slot < end; ++slot ) {
+                const UInt32 a = coarseVertices[ i ];
+                const UInt32 b =
+                    coarseVertices[ finePattern.getColumn( slot ) ];
+                blocks.push_back( SimMatrixPattern::Block(
+                    std::min( a, b ), std::max( a, b )
+                ) );
+            }
+        }
+        RCShdPtr<SimMatrixPattern> coarsePattern(
+            new SimMatrixPattern( nbCoarse, nbCoarse, blocks )
+        );
+        fine._coarseSlots.resize( finePattern.nbBlocks() );
+        fine._coarseModes.resize( finePattern.nbBlocks() );
+        for ( i = 0; i < N; ++i ) {
+            const UInt32 end = finePattern.getRowEnd( i );
+            for ( slot = finePattern.getRowBegin( i ); slot < end; ++slot ) {
+                const UInt32 j = finePattern.getColumn( slot );
+                const UInt32 a = coarseVertices[ i ];
+                const UInt32 b = coarseVertices[ j ];
+                fine._coarseSlots[ slot ] = coarsePattern->findSlot(
+                    std::min( a, b ), std::max( a, b )
+                );
+                fine._coarseModes[ slot ] = UInt8(
+                    a < b ? COARSE_DIRECT :
+                    a > b ? COARSE_TRANSPOSE :
+                    i == j ? COARSE_DIRECT : COARSE_SYMMETRIC
+                );
+            }
+        }
+        fine._coarseVertices.swap( coarseVertices );
+
+        _levels.push_back( new Level );
+        _levels.back()->_A = SimSymMatrix( coarsePattern );
+        N = nbCoarse;
+    }
+
+    for ( i = 0; i < _levels.size(); ++i ) {
+        Level& level = *_levels[ i ];
+        const UInt32 n = level._A.nbRows();
+        level._Dinv.resize( n );
+        level._x = SimVector( n );
+        level._b = SimVector( n );
+        level._r = SimVector( n );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimMultigrid::~SimMultigrid()
+{
+    for ( UInt32 i = 0; i < _levels.size(); ++i ) {
+        delete _levels[ i ];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::setThreadPool( const RCShdPtr<SimThreadPool>& threadPool )
+{
+    _threadPool = threadPool;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimMultigrid::getNbLevels() const
+{
+    return _levels.size();
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimMultigrid::getNbVertices( UInt32 level ) const
+{
+    DGFX_ASSERT( level < _levels.size() );
+    return _levels[ level ]->_A.nbRows();
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::setOperator( const SimSymMatrix& A )
+{
+    DGFX_ASSERT( A.getPattern() == _levels[ 0 ]->_A.getPattern() );
+    _levels[ 0 ]->_A = A;
+    for ( UInt32 l = 0; l < _levels.size(); ++l ) {
+        Level& level = *_levels[ l ];
+        if ( l + 1 < _levels.size() ) {
+            for ( UInt32 i = 0; i < level._Dinv.size(); ++i ) {
+                level._Dinv[ i ] = invertSemiDefinite( level._A( i, i ) );
+            }
+            restrictOperator( l );
+        }
+    }
+    factorCoarsest();
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::apply( SimVector& dest, const SimVector& src )
+{
+    Level& finest = *_levels[ 0 ];
+    DGFX_ASSERT( src.size() == finest._b.size() );
+    finest._b = src;
+    cycle( 0 );
+    dest = finest._x;
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::restrictOperator( UInt32 l )
+{
+    const Level& fine = *_levels[ l ];
+    SimSymMatrix& coarseA = _levels[ l + 1 ]->_A;
+    coarseA.clear();
+    const UInt32 nbBlocks = fine._A.getPattern()->nbBlocks();
+    for ( UInt32 slot = 0; slot < nbBlocks; ++slot ) {
+        const GeMatrix3& block = fine._A.getBlock( slot );
+        GeMatrix3& coarse = coarseA.getBlock( fine._coarseSlots[ slot ] );
+        switch ( fine._coarseModes[ slot ] ) {
+            case COARSE_DIRECT: {
+                coarse += block;
+            } break;
+            case COARSE_TRANSPOSE: {
+                coarse += block.getTranspose();
+            } break;
+            case COARSE_SYMMETRIC: {
+                coarse += block;
+                coarse += block.getTranspose();
+            } break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::factorCoarsest()
+{
+    const SimSymMatrix& A = _levels.back()->_A;
+    const SimMatrixPattern& pattern = *A.getPattern();
+    const UInt32 n = A.nbRows() * 3;
+    _coarseFactor.assign( n * n, 0 );
+    _coarseWork.resize( n );
+    for ( UInt32 row = 0; row < A.nbRows(); ++row ) {
+        const UInt32 end = pattern.getRowEnd( row );
+        for ( UInt32 slot = pattern.getRowBegin( row ); slot < end; ++slot ) {
+            const UInt32 col = pattern.getColumn( slot );
+            const GeMatrix3& block = A.getBlock( slot );
+            for ( UInt32 i = 0; i < 3; ++i ) for ( UInt32 j = 0; j < 3; ++j ) {
+                const UInt32 r = row * 3 + i;
+                const UInt32 c = col * 3 + j;
+                if ( row == col ) {
+                    // Diagonal blocks may be slightly asymmetric.
+                    _coarseFactor[ r * n + c ] =
+                        ( block( i, j ) + block( j, i ) ) * .5f;
+                }
+                else {
+                    _coarseFactor[ r * n + c ] = block( i, j );
+                    _coarseFactor[ c * n + r ] = block( i, j );
+                }
+            }
+        }
+    }
+    if ( n > 0 ) {
+        choleskyFactor( &_coarseFactor[ 0 ], n );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::solveCoarsest()
+{
+    Level& level = *_levels.back();
+    const UInt32 N = level._b.size();
+    if ( N == 0 ) {
+        return;
+    }
+    UInt32 i;
+    for ( i = 0; i < N; ++i ) {
+        _coarseWork[ i * 3 ] = level._b[ i ]._x;
+        _coarseWork[ i * 3 + 1 ] = level._b[ i ]._y;
+        _coarseWork[ i * 3 + 2 ] = level._b[ i ]._z;
+    }
+    choleskySolve( &_coarseFactor[ 0 ], N * 3, &_coarseWork[ 0 ] );
+    for ( i = 0; i < N; ++i ) {
+        level._x[ i ] = GeVector(
+            _coarseWork[ i * 3 ],
+            _coarseWork[ i * 3 + 1 ],
+            _coarseWork[ i * 3 + 2 ]
+        );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::cycle( UInt32 l )
+{
+    if ( l + 1 == _levels.size() ) {
+        solveCoarsest();
+        return;
+    }
+    Level& level = *_levels[ l ];
+    Level& coarse = *_levels[ l + 1 ];
+    const UInt32 N = level._b.size();
+    UInt32 i, k;
+
+    for ( k = 0; k < NB_SMOOTHING_SWEEPS; ++k ) {
+        smooth( l, k == 0 );
+    }
+
+    // Restrict the residual, correct, and prolong the correction.
+    multiply( l );
+    for ( i = 0; i < coarse._b.size(); ++i ) {
+        coarse._b[ i ] = GeVector::zero();
+    }
+    for ( i = 0; i < N; ++i ) {
+        coarse._b[ level._coarseVertices[ i ] ] += level._b[ i ];
+        coarse._b[ level._coarseVertices[ i ] ] -= level._r[ i ];
+    }
+    cycle( l + 1 );
+    for ( i = 0; i < N; ++i ) {
+        level._x[ i ] += coarse._x[ level._coarseVertices[ i ] ];
+    }
+
+    for ( k = 0; k < NB_SMOOTHING_SWEEPS; ++k ) {
+        smooth( l, false );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::smooth( UInt32 l, bool zeroGuess )
+{
+    Level& level = *_levels[ l ];
+    const UInt32 N = level._b.size();
+    if ( ! zeroGuess ) {
+        multiply( l );
+    }
+    SmoothTask task( *this, l, zeroGuess, false );
+    _threadPool->run( task, N );
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::multiply( UInt32 l )
+{
+    Level& level = *_levels[ l ];
+    // As for the PCG sweeps, a single thread is better off with the
+    // scattering product. Both give identical results.
+    if ( _threadPool->getNbThreads() == 1 ) {
+        SimSymMatrix::multiply( level._r, level._A, level._x );
+        return;
+    }
+    SmoothTask task( *this, l, false, true );
+    _threadPool->run( task, level._x.size() );
+}
+
+//------------------------------------------------------------------------------
+
+void SimMultigrid::smoothRows(
+    UInt32 l,
+    bool zeroGuess,
+    UInt32 rowBegin,
+    UInt32 rowEnd
+) {
+    Level& level = *_levels[ l ];
+    UInt32 i;
+    if ( zeroGuess ) {
+        for ( i = rowBegin; i < rowEnd; ++i ) {
+            level._x[ i ] =
+                JACOBI_DAMPING * ( level._Dinv[ i ] * level._b[ i ] );
+        }
+        return;
+    }
+    for ( i = rowBegin; i < rowEnd; ++i ) {
+        level._x[ i ] += JACOBI_DAMPING *
+            ( level._Dinv[ i ] * ( level._b[ i ] - level._r[ i ] ) );
+    }
+}
+
+FREECLOTH_NAMESPACE_END
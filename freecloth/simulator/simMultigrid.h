@@ -0,0 +1,157 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#ifndef freecloth_sim_simMultigrid_h
+#define freecloth_sim_simMultigrid_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_sim_simSymMatrix_h
+#include <freecloth/simulator/simSymMatrix.h>
+#endif
+
+#ifndef freecloth_sim_simVector_h
+#include <freecloth/simulator/simVector.h>
+#endif
+
+#ifndef freecloth_sim_simThreadPool_h
+#include <freecloth/simulator/simThreadPool.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+#ifndef freecloth_resmgt_rcShdPtr_h
+#include <freecloth/resmgt/rcShdPtr.h>
+#endif
+
+#ifndef freecloth_base_vector
+#include <freecloth/base/vector>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class GeMesh;
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimMultigrid freecloth/simulator/simMultigrid.h
+ * \brief Multigrid V-cycle for symmetric block sparse systems on a mesh.
+ *
+ * The level hierarchy is built once from the mesh, by repeatedly
+ * collapsing the shortest edges of the rest shape: each pass matches
+ * every vertex with at most one neighbour, so the vertex count roughly
+ * halves per level, alternating directions on regular grids. Each coarse
+ * vertex stands for a group of fine vertices, and interpolation simply
+ * copies a coarse value to every vertex in its group.
+ *
+ * Coarse operators are formed from the fine system matrix by the Galerkin
+ * product P^T A P, so only the finest matrix need be supplied, with
+ * setOperator(), whenever it changes. Smoothing is by damped block Jacobi,
+ * and the coarsest level is solved directly.
+ *
+ * apply() runs a single V-cycle from a zero initial guess. The cycle is a
+ * symmetric positive definite operator whenever A is, so it may be used
+ * as a conjugate gradient preconditioner. Constraints are handled by the
+ * caller, by supplying the filtered system S A S + ( I - S ): groups of
+ * fully constrained vertices then give singular coarse blocks, which are
+ * treated as having no effect.
+ */
+class SimMultigrid : public RCBase
+{
+public:
+    // ----- member functions -----
+
+    //! Build the hierarchy for systems over the vertices of the mesh,
+    //! with the given upper triangular pattern. Edge lengths are measured
+    //! in texture space, which gives the rest shape, if the mesh has
+    //! texture co-ordinates.
+    SimMultigrid(
+        const GeMesh&,
+        const RCShdPtr<SimMatrixPattern>& pattern
+    );
+    virtual ~SimMultigrid();
+
+    //! Threads for smoothing. By default, a single thread is used.
+    void setThreadPool( const RCShdPtr<SimThreadPool>& );
+
+    //! Number of levels, including the finest.
+    UInt32 getNbLevels() const;
+    //! Number of vertices in the given level; level 0 is the finest.
+    UInt32 getNbVertices( UInt32 level ) const;
+
+    //! Specify the finest system matrix, which must use the pattern
+    //! given at construction, and compute the coarse operators.
+    void setOperator( const SimSymMatrix& );
+    //! dest = one V-cycle approximation to A^-1 src.
+    void apply( SimVector& dest, const SimVector& src );
+
+private:
+    // ----- classes -----
+
+    class Level;
+    //! Runs a smoothing sweep over a range of rows.
+    class SmoothTask;
+
+    // ----- member functions -----
+
+    // Hierarchies are shared, not copied.
+    SimMultigrid( const SimMultigrid& );
+    SimMultigrid& operator=( const SimMultigrid& );
+
+    //! Compute level l + 1's operator from level l's.
+    void restrictOperator( UInt32 l );
+    //! Factor the dense matrix of the coarsest level.
+    void factorCoarsest();
+    //! Solve the coarsest level, from its _b into its _x.
+    void solveCoarsest();
+    //! Run the V-cycle from level l downwards, from its _b into its _x.
+    void cycle( UInt32 l );
+    //! Compute _r = _A * _x on level l.
+    void multiply( UInt32 l );
+    //! One damped Jacobi sweep on level l. If zeroGuess is set, _x is
+    //! taken to be zero.
+    void smooth( UInt32 l, bool zeroGuess );
+    //! Rows [ rowBegin, rowEnd ) of the sweep.
+    void smoothRows(
+        UInt32 l,
+        bool zeroGuess,
+        UInt32 rowBegin,
+        UInt32 rowEnd
+    );
+
+    // ----- data members -----
+
+    std::vector<Level*> _levels;
+    RCShdPtr<SimThreadPool> _threadPool;
+    //! Lower Cholesky factor of the coarsest matrix, dense and row-major.
+    std::vector<Float> _coarseFactor;
+    //! Work vector for solveCoarsest().
+    std::vector<Float> _coarseWork;
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif
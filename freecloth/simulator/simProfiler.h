@@ -0,0 +1,110 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_sim_simProfiler_h
+#define freecloth_sim_simProfiler_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_base_baTime_h
+#include <freecloth/base/baTime.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimProfiler freecloth/simulator/simProfiler.h
+ * \brief High resolution timing and hardware event counts.
+ *
+ * Samples pair a reading of BaTime's clock with hardware counts. A
+ * SimProfiler object opens the counters for the thread that constructs it,
+ * where the platform allows it: on Linux, through perf_event_open().
+ * Counters only cover that thread, not the workers of any thread pool it
+ * drives, and can only be read from it. Without them, or on any other
+ * thread, hasCounters() is false and the counts read as zero; the clock is
+ * always available.
+ */
+class SimProfiler : public RCBase
+{
+public:
+    // ----- types and enumerations -----
+
+    //! Hardware events counted.
+    enum Counter {
+        //! CPU cycles.
+        COUNTER_CYCLES,
+        //! Last level cache misses.
+        COUNTER_CACHE_MISSES,
+
+        NB_COUNTERS
+    };
+
+    // ----- classes -----
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class Sample freecloth/simulator/simProfiler.h
+     * \brief Clock and counter readings at one instant.
+     */
+    class Sample
+    {
+    public:
+        // ----- data members -----
+        BaTime::Instant _time;
+        UInt64          _counts[ NB_COUNTERS ];
+    };
+
+    // ----- member functions -----
+
+    //! Open the counters for the calling thread.
+    SimProfiler();
+    virtual ~SimProfiler();
+
+    //! True if the counters could be opened, and this is their thread.
+    bool hasCounters() const;
+    //! Read the clock and the counters.
+    void sample( Sample& ) const;
+
+private:
+    // ----- classes -----
+
+    //! Platform-specific counters.
+    class Impl;
+
+    // ----- member functions -----
+
+    // Profilers own counters, and are shared, not copied.
+    SimProfiler( const SimProfiler& );
+    SimProfiler& operator=( const SimProfiler& );
+
+    // ----- data members -----
+
+    //! Null without counters.
+    Impl*           _impl;
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif
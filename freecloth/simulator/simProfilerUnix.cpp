@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <freecloth/simulator/simProfiler.h>
+#include <freecloth/base/baTime.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <string.h>
+#endif
+
+#if defined( __linux__ ) && defined( __NR_perf_event_open )
+#define FREECLOTH_PERF_EVENTS 1
+#else
+#define FREECLOTH_PERF_EVENTS 0
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimProfiler::Impl
+
+/*!
+ * One perf event per counter, opened for the calling thread on any CPU,
+ * and read with read(). The thread is remembered, since the counts mean
+ * nothing when read from any other.
+ */
+class SimProfiler::Impl
+{
+public:
+    // ----- member functions -----
+
+    Impl();
+    ~Impl();
+
+    //! True if every counter was opened.
+    bool isOpen() const;
+    //! True if called from the thread that opened the counters.
+    bool isOwnerThread() const;
+    void read( UInt64 counts[ NB_COUNTERS ] ) const;
+
+private:
+    // ----- data members -----
+
+    int             _fds[ NB_COUNTERS ];
+    pthread_t       _owner;
+};
+
+//------------------------------------------------------------------------------
+
+SimProfiler::Impl::Impl()
+  : _owner( ::pthread_self() )
+{
+    UInt32 i;
+    for ( i = 0; i < NB_COUNTERS; ++i ) {
+        _fds[ i ] = -1;
+    }
+#if FREECLOTH_PERF_EVENTS
+    const unsigned long long configs[ NB_COUNTERS ] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    for ( i = 0; i < NB_COUNTERS; ++i ) {
+        ::perf_event_attr attr;
+        ::memset( &attr, 0, sizeof( attr ) );
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof( attr );
+        attr.config = configs[ i ];
+        // Unprivileged processes may only count their own user time, under
+        // the usual perf_event_paranoid setting.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        _fds[ i ] = ::syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+        if ( _fds[ i ] < 0 ) {
+            break;
+        }
+    }
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+SimProfiler::Impl::~Impl()
+{
+    for ( UInt32 i = 0; i < NB_COUNTERS; ++i ) {
+        if ( _fds[ i ] >= 0 ) {
+            ::close( _fds[ i ] );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool SimProfiler::Impl::isOpen() const
+{
+    for ( UInt32 i = 0; i < NB_COUNTERS; ++i ) {
+        if ( _fds[ i ] < 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimProfiler::Impl::isOwnerThread() const
+{
+    return ::pthread_equal( _owner, ::pthread_self() ) != 0;
+}
+
+//------------------------------------------------------------------------------
+
+void SimProfiler::Impl::read( UInt64 counts[ NB_COUNTERS ] ) const
+{
+    for ( UInt32 i = 0; i < NB_COUNTERS; ++i ) {
+        UInt64 count;
+        if ( ::read( _fds[ i ], &count, sizeof( count ) ) != sizeof( count ) ) {
+            count = 0;
+        }
+        counts[ i ] = count;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimProfiler
+
+//------------------------------------------------------------------------------
+
+SimProfiler::SimProfiler()
+  : _impl( new Impl )
+{
+    if ( ! _impl->isOpen() ) {
+        delete _impl;
+        _impl = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimProfiler::~SimProfiler()
+{
+    delete _impl;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimProfiler::hasCounters() const
+{
+    return _impl != 0 && _impl->isOwnerThread();
+}
+
+//------------------------------------------------------------------------------
+
+void SimProfiler::sample( Sample& s ) const
+{
+    if ( hasCounters() ) {
+        _impl->read( s._counts );
+    }
+    else {
+        for ( UInt32 i = 0; i < NB_COUNTERS; ++i ) {
+            s._counts[ i ] = 0;
+        }
+    }
+    s._time = BaTime::getTime();
+}
+
+FREECLOTH_NAMESPACE_END
@@ -0,0 +1,69 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <freecloth/simulator/simProfiler.h>
+#include <freecloth/base/baTime.h>
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimProfiler::Impl
+
+/*!
+ * Hardware counters need a kernel driver on Windows, so none are opened,
+ * and no Impl is ever created.
+ */
+class SimProfiler::Impl
+{
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimProfiler
+
+//------------------------------------------------------------------------------
+
+SimProfiler::SimProfiler()
+  : _impl( 0 )
+{
+}
+
+//------------------------------------------------------------------------------
+
+SimProfiler::~SimProfiler()
+{
+    delete _impl;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimProfiler::hasCounters() const
+{
+    return _impl != 0;
+}
+
+//------------------------------------------------------------------------------
+
+void SimProfiler::sample( Sample& s ) const
+{
+    for ( UInt32 i = 0; i < NB_COUNTERS; ++i ) {
+        s._counts[ i ] = 0;
+    }
+    s._time = BaTime::getTime();
+}
+
+FREECLOTH_NAMESPACE_END
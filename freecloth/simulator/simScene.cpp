@@ -0,0 +1,197 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <freecloth/simulator/simScene.h>
+#include <freecloth/simulator/simSimulator.h>
+#include <freecloth/simulator/simCollider.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/geom/geMeshBuilder.h>
+#include <freecloth/base/baMath.h>
+#include <freecloth/base/algorithm>
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimScene
+
+//------------------------------------------------------------------------------
+
+RCShdPtr<GeMesh> SimScene::createRectMesh(
+    Float size,
+    UInt32 nbRows,
+    UInt32 nbCols
+) {
+    GeMeshBuilder builder;
+    UInt32 r, c;
+    builder.preallocVertices( (nbRows + 1) * (nbCols + 1 ) );
+    builder.preallocTextureVertices( (nbRows + 1) * (nbCols + 1 ) );
+    builder.preallocFaces( nbRows * nbCols );
+    for ( r = 0; r <= nbRows; ++r ) {
+        for ( c = 0; c <= nbCols; ++c ) {
+            builder.addVertex(
+                GePoint( c * size / nbCols, r * size / nbRows, 0 )
+            );
+            builder.addTextureVertex(
+                GePoint( c * size / nbCols, r * size / nbRows, 0 )
+            );
+        }
+    }
+    const UInt32 rstride=nbCols+1;
+    for( r = 0; r < nbRows; ++r ) {
+        for ( c = 0; c < nbCols; ++c ) {
+            builder.addFace(
+                r*rstride + c, r*rstride + c+1, (r+1)*rstride + c,
+                r*rstride + c, r*rstride + c+1, (r+1)*rstride + c
+            );
+            builder.addFace(
+                (r+1)*rstride + c, r*rstride + c+1, (r+1)*rstride + c+1,
+                (r+1)*rstride + c, r*rstride + c+1, (r+1)*rstride + c+1
+            );
+        }
+    }
+    return builder.createMesh();
+}
+
+//------------------------------------------------------------------------------
+
+void SimScene::setConstraints(
+    SimSimulator& simulator,
+    ConstraintType constraints,
+    UInt32 nbPatches
+) {
+    const UInt32 N = nbPatches;
+    simulator.removeAllConstraints();
+    switch ( constraints ) {
+        case CON_NONE: {
+        } break;
+
+        case CON_CENTRE: {
+            simulator.setPosConstraintFull( (N+1)*(N/2) + N/2 );
+        } break;
+
+        case CON_CORNERS4: {
+            simulator.setPosConstraintFull( 0 );
+            simulator.setPosConstraintFull( N );
+            simulator.setPosConstraintFull( N*(N+1) );
+            simulator.setPosConstraintFull( (N+1)*(N+1)-1 );
+        } break;
+
+        case CON_CORNERS3a: {
+            simulator.setPosConstraintFull( N );
+            simulator.setPosConstraintFull( N*(N+1) );
+            simulator.setPosConstraintFull( (N+1)*(N+1)-1 );
+        } break;
+
+        case CON_CORNERS3b: {
+            simulator.setPosConstraintFull( 0 );
+            simulator.setPosConstraintFull( N*(N+1) );
+            simulator.setPosConstraintFull( (N+1)*(N+1)-1 );
+        } break;
+
+        case CON_CORNERS1c: {
+            simulator.setPosConstraintFull( N*(N+1) );
+        } break;
+
+        case CON_CORNERS1d: {
+            simulator.setPosConstraintFull( (N+1)*(N+1)-1 );
+        } break;
+
+        case CON_CORNERYANK: {
+            simulator.setPosConstraintFull( (N+1)*(N+1)-1 );
+            simulator.setVelConstraint(
+                (N+1)*(N+1)-1, -.1f * GeVector::xAxis()
+            );
+        } break;
+
+        case CON_TABLE_SQUARE: {
+            const UInt32 C = BaMath::roundUInt32( std::max( 1.f, N*5/11.f ) );
+            const UInt32 x = (N-C)/2;
+            for (UInt32 i = 0; i <= C; ++i ) for ( UInt32 j = 0; j <= C; ++j ) {
+                simulator.setPosConstraintFull( (x + i)*(N+1) + x + j );
+            }
+        } break;
+
+        case CON_TABLE_CIRCLE: {
+            const Float r = 7/11.f;
+            for (UInt32 i = 0; i <= N; ++i ) for ( UInt32 j = 0; j <= N; ++j ) {
+                Float x = 2*i/static_cast<Float>( N ) - 1;
+                Float y = 2*j/static_cast<Float>( N ) - 1;
+                if ( x*x + y*y < r*r ) {
+                    simulator.setPosConstraintFull( i*(N+1) + j );
+                }
+            }
+        } break;
+
+        default: {
+            DGFX_ASSERT( false );
+        } break;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+RCShdPtr<SimCollider> SimScene::createCollider(
+    ObstacleType obstacles,
+    Float clothSize,
+    Float thickness
+) {
+    if ( obstacles == OBS_NONE ) {
+        return RCShdPtr<SimCollider>();
+    }
+    // Centred below the cloth, which hangs in the z = 0 plane.
+    const Float s = clothSize;
+    const GePoint centre( s / 2, s / 2, -.35f * s );
+    RCShdPtr<SimCollider> collider( new SimCollider );
+    collider->setThickness( thickness );
+    switch ( obstacles ) {
+        case OBS_FLOOR: {
+            collider->addObstacle( SimCollider::Obstacle::plane(
+                GePoint( 0, 0, -.5f * s ), GeVector::zAxis()
+            ) );
+        } break;
+
+        case OBS_SPHERE: {
+            collider->addObstacle(
+                SimCollider::Obstacle::sphere( centre, .25f * s )
+            );
+        } break;
+
+        case OBS_CAPSULE: {
+            collider->addObstacle( SimCollider::Obstacle::capsule(
+                centre - .4f * s * GeVector::yAxis(),
+                centre + .4f * s * GeVector::yAxis(),
+                .15f * s
+            ) );
+        } break;
+
+        case OBS_BOX: {
+            collider->addObstacle( SimCollider::Obstacle::box(
+                centre,
+                GeMatrix3::rotation( GeVector::zAxis(), M_PI / 6 ),
+                GeVector( .25f * s, .25f * s, .1f * s )
+            ) );
+        } break;
+
+        default: {
+            DGFX_ASSERT( false );
+        } break;
+    }
+    return collider;
+}
+
+FREECLOTH_NAMESPACE_END
@@ -0,0 +1,110 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_sim_simScene_h
+#define freecloth_sim_simScene_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_resmgt_rcShdPtr_h
+#include <freecloth/resmgt/rcShdPtr.h>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class GeMesh;
+class SimCollider;
+class SimSimulator;
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimScene freecloth/simulator/simScene.h
+ * \brief Preset scenes for a square sheet of cloth.
+ *
+ * The applications all simulate a square sheet, made by createRectMesh(),
+ * held by one of a few constraint presets and dropped onto one of a few
+ * obstacle presets. The presets are defined here, so that each application
+ * sets up the same scene for the same choice.
+ */
+class SimScene
+{
+public:
+    // ----- types and enumerations -----
+
+    //! Constraint IDs
+    enum ConstraintType {
+        CON_NONE,
+
+        CON_CENTRE,
+        CON_CORNERS4,
+        CON_CORNERS3a,
+        CON_CORNERS3b,
+        CON_CORNERS1c,
+        CON_CORNERS1d,
+        CON_CORNERYANK,
+        CON_TABLE_SQUARE,
+        CON_TABLE_CIRCLE,
+
+        NB_CONSTRAINTS
+    };
+
+    //! Obstacle scene IDs, placed below the cloth.
+    enum ObstacleType {
+        OBS_NONE,
+
+        OBS_FLOOR,
+        OBS_SPHERE,
+        OBS_CAPSULE,
+        OBS_BOX,
+
+        NB_OBSTACLES
+    };
+
+    // ----- static member functions -----
+
+    //! A size x size sheet in the z = 0 plane, with nbRows x nbCols patches
+    //! of two triangles each. Texture coordinates match vertex positions.
+    static RCShdPtr<GeMesh> createRectMesh(
+        Float size,
+        UInt32 nbRows,
+        UInt32 nbCols
+    );
+    //! Replace the simulator's constraints with the given preset, for a
+    //! mesh from createRectMesh() with nbPatches rows and columns.
+    static void setConstraints(
+        SimSimulator&,
+        ConstraintType,
+        UInt32 nbPatches
+    );
+    //! The given obstacle preset, scaled to a sheet from createRectMesh()
+    //! of the given size. Null for OBS_NONE.
+    static RCShdPtr<SimCollider> createCollider(
+        ObstacleType,
+        Float clothSize,
+        Float thickness
+    );
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif
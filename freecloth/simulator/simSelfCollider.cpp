@@ -0,0 +1,1109 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simSelfCollider.h>
+#include <freecloth/simulator/simThreadPool.h>
+#include <freecloth/simulator/simVector.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/geom/geMeshWingedEdge.h>
+#include <freecloth/base/baMath.h>
+#include <freecloth/base/algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    using namespace freecloth;
+
+    //! Thickness given to new self-colliders, in metres.
+    const Float DEFAULT_THICKNESS = .002f;
+    //! Most rounds of detection and response in each filter().
+    const UInt32 MAX_PASSES = 4;
+    //! The traversal is split into about this many node pairs per thread,
+    //! so that uneven pairs balance out.
+    const UInt32 FRONT_PER_THREAD = 32;
+    //! Levels of the hierarchy with fewer nodes than this are refitted
+    //! without waking the thread pool.
+    const UInt32 MIN_PARALLEL_NODES = 256;
+    //! Bisections of each root of the coplanarity cubic, in [ 0, 1 ].
+    const UInt32 NB_BISECTIONS = 24;
+    //! As for contacts in SimSimulator: pushing overlapping primitives
+    //! apart within a single step would get more violent as the step
+    //! shrinks, so the push is spread over at least this long, in seconds.
+    const Float RELAXATION_TIME = .01f;
+    //! Impacts whose free vertices all carry less than this barycentric
+    //! weight are skipped: the contact point sits on constrained vertices,
+    //! and moving it would take unbounded velocities elsewhere.
+    const Float MIN_FREE_WEIGHT = .1f;
+
+//------------------------------------------------------------------------------
+
+    //! Orders face indices by one coordinate of their centroids.
+    class CentroidLess
+    {
+    public:
+        CentroidLess( const std::vector<GePoint>& centroids, UInt32 axis )
+          : _centroids( centroids ),
+            _axis( axis )
+        {
+        }
+        bool operator()( UInt32 a, UInt32 b ) const
+        {
+            return _centroids[ a ][ _axis ] < _centroids[ b ][ _axis ];
+        }
+
+    private:
+        const std::vector<GePoint>& _centroids;
+        UInt32 _axis;
+    };
+
+//------------------------------------------------------------------------------
+
+    //! Nearest point to p of the triangle abc, as barycentric coordinates.
+    //! See Ericson, Real-Time Collision Detection, section 5.1.5.
+    void closestOnTriangle(
+        const GePoint& p,
+        const GePoint& a,
+        const GePoint& b,
+        const GePoint& c,
+        Float bary[ 3 ]
+    ) {
+        const GeVector ab( b - a ), ac( c - a ), ap( p - a );
+        const Float d1 = ab.dot( ap ), d2 = ac.dot( ap );
+        if ( d1 <= 0 && d2 <= 0 ) {
+            bary[ 0 ] = 1; bary[ 1 ] = 0; bary[ 2 ] = 0;
+            return;
+        }
+        const GeVector bp( p - b );
+        const Float d3 = ab.dot( bp ), d4 = ac.dot( bp );
+        if ( d3 >= 0 && d4 <= d3 ) {
+            bary[ 0 ] = 0; bary[ 1 ] = 1; bary[ 2 ] = 0;
+            return;
+        }
+        const Float vc = d1 * d4 - d3 * d2;
+        if ( vc <= 0 && d1 >= 0 && d3 <= 0 ) {
+            const Float v = d1 / ( d1 - d3 );
+            bary[ 0 ] = 1 - v; bary[ 1 ] = v; bary[ 2 ] = 0;
+            return;
+        }
+        const GeVector cp( p - c );
+        const Float d5 = ab.dot( cp ), d6 = ac.dot( cp );
+        if ( d6 >= 0 && d5 <= d6 ) {
+            bary[ 0 ] = 0; bary[ 1 ] = 0; bary[ 2 ] = 1;
+            return;
+        }
+        const Float vb = d5 * d2 - d1 * d6;
+        if ( vb <= 0 && d2 >= 0 && d6 <= 0 ) {
+            const Float w = d2 / ( d2 - d6 );
+            bary[ 0 ] = 1 - w; bary[ 1 ] = 0; bary[ 2 ] = w;
+            return;
+        }
+        const Float va = d3 * d6 - d5 * d4;
+        if ( va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0 ) {
+            const Float w = ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) );
+            bary[ 0 ] = 0; bary[ 1 ] = 1 - w; bary[ 2 ] = w;
+            return;
+        }
+        const Float denom = 1 / ( va + vb + vc );
+        bary[ 1 ] = vb * denom;
+        bary[ 2 ] = vc * denom;
+        bary[ 0 ] = 1 - bary[ 1 ] - bary[ 2 ];
+    }
+
+//------------------------------------------------------------------------------
+
+    Float clampUnit( Float x )
+    {
+        return std::min( std::max( x, Float( 0 ) ), Float( 1 ) );
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Nearest points of the segments [ p0, p1 ] and [ q0, q1 ], as the
+    //! parameters s and t along each. See Ericson, section 5.1.9.
+    void closestOnSegments(
+        const GePoint& p0,
+        const GePoint& p1,
+        const GePoint& q0,
+        const GePoint& q1,
+        Float& s,
+        Float& t
+    ) {
+        const GeVector d1( p1 - p0 ), d2( q1 - q0 ), r( p0 - q0 );
+        const Float a = d1.dot( d1 ), e = d2.dot( d2 ), f = d2.dot( r );
+        if ( a <= 0 && e <= 0 ) {
+            s = t = 0;
+            return;
+        }
+        if ( a <= 0 ) {
+            s = 0;
+            t = clampUnit( f / e );
+            return;
+        }
+        const Float c = d1.dot( r );
+        if ( e <= 0 ) {
+            t = 0;
+            s = clampUnit( -c / a );
+            return;
+        }
+        const Float b = d1.dot( d2 );
+        const Float denom = a * e - b * b;
+        s = denom > 0 ? clampUnit( ( b * f - c * e ) / denom ) : 0;
+        t = ( b * s + f ) / e;
+        if ( t < 0 ) {
+            t = 0;
+            s = clampUnit( -c / a );
+        }
+        else if ( t > 1 ) {
+            t = 1;
+            s = clampUnit( ( b - c ) / a );
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Coefficients, in increasing order, of the cubic in t
+    //! ( x0 + t dx0 ) x ( x1 + t dx1 ) . ( x2 + t dx2 ), which vanishes when
+    //! the three vectors are coplanar.
+    void calcCoplanarity(
+        const GeVector x[ 3 ],
+        const GeVector dx[ 3 ],
+        Float c[ 4 ]
+    ) {
+        const GeVector x01( x[ 0 ].cross( x[ 1 ] ) );
+        const GeVector d01( dx[ 0 ].cross( dx[ 1 ] ) );
+        const GeVector m01(
+            dx[ 0 ].cross( x[ 1 ] ) + x[ 0 ].cross( dx[ 1 ] )
+        );
+        c[ 0 ] = x01.dot( x[ 2 ] );
+        c[ 1 ] = m01.dot( x[ 2 ] ) + x01.dot( dx[ 2 ] );
+        c[ 2 ] = d01.dot( x[ 2 ] ) + m01.dot( dx[ 2 ] );
+        c[ 3 ] = d01.dot( dx[ 2 ] );
+    }
+
+//------------------------------------------------------------------------------
+
+    //! True if the boxes swept by the first nbFirst of the points p, as they
+    //! move by dp, and by the rest of them, are at least thickness apart.
+    bool sweptApart(
+        const GePoint p[ 4 ],
+        const GeVector dp[ 4 ],
+        UInt32 nbFirst,
+        Float thickness
+    ) {
+        for ( UInt32 a = 0; a < 3; ++a ) {
+            Float min[ 2 ] = { p[ 0 ][ a ], p[ nbFirst ][ a ] };
+            Float max[ 2 ] = { min[ 0 ], min[ 1 ] };
+            for ( UInt32 k = 0; k < 4; ++k ) {
+                const UInt32 side = k < nbFirst ? 0 : 1;
+                const Float x0 = p[ k ][ a ];
+                const Float x1 = x0 + dp[ k ][ a ];
+                min[ side ] = std::min( min[ side ], std::min( x0, x1 ) );
+                max[ side ] = std::max( max[ side ], std::max( x0, x1 ) );
+            }
+            if ( min[ 0 ] - max[ 1 ] >= thickness ||
+                min[ 1 ] - max[ 0 ] >= thickness
+            ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+//------------------------------------------------------------------------------
+
+    Float evalCubic( const Float c[ 4 ], Float t )
+    {
+        return ( ( c[ 3 ] * t + c[ 2 ] ) * t + c[ 1 ] ) * t + c[ 0 ];
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Roots in [ 0, 1 ] of the cubic with coefficients c, in increasing
+    //! order. The interval is split at the turning points, so that the
+    //! cubic is monotonic on each piece, and each piece that changes sign
+    //! is bisected.
+    UInt32 findRoots( const Float c[ 4 ], Float roots[ 4 ] )
+    {
+        Float splits[ 4 ];
+        UInt32 nbSplits = 0;
+        splits[ nbSplits++ ] = 0;
+        const Float qa = 3 * c[ 3 ], qb = 2 * c[ 2 ], qc = c[ 1 ];
+        Float turns[ 2 ];
+        UInt32 nbTurns = 0;
+        if ( qa != 0 ) {
+            const Float disc = qb * qb - 4 * qa * qc;
+            if ( disc >= 0 ) {
+                const Float root = BaMath::sqrt( disc );
+                turns[ 0 ] = ( -qb - root ) / ( 2 * qa );
+                turns[ 1 ] = ( -qb + root ) / ( 2 * qa );
+                if ( turns[ 0 ] > turns[ 1 ] ) {
+                    std::swap( turns[ 0 ], turns[ 1 ] );
+                }
+                nbTurns = 2;
+            }
+        }
+        else if ( qb != 0 ) {
+            turns[ 0 ] = -qc / qb;
+            nbTurns = 1;
+        }
+        UInt32 i;
+        for ( i = 0; i < nbTurns; ++i ) {
+            if ( turns[ i ] > 0 && turns[ i ] < 1 ) {
+                splits[ nbSplits++ ] = turns[ i ];
+            }
+        }
+        splits[ nbSplits++ ] = 1;
+
+        UInt32 nbRoots = 0;
+        Float lo = 0;
+        Float flo = evalCubic( c, lo );
+        if ( flo == 0 ) {
+            roots[ nbRoots++ ] = 0;
+        }
+        for ( i = 1; i < nbSplits; ++i ) {
+            const Float hi = splits[ i ];
+            const Float fhi = evalCubic( c, hi );
+            if ( fhi == 0 ) {
+                roots[ nbRoots++ ] = hi;
+            }
+            else if ( flo != 0 && ( flo < 0 ) != ( fhi < 0 ) ) {
+                Float a = lo, b = hi, fa = flo;
+                for ( UInt32 k = 0; k < NB_BISECTIONS; ++k ) {
+                    const Float m = .5f * ( a + b );
+                    const Float fm = evalCubic( c, m );
+                    if ( ( fm < 0 ) == ( fa < 0 ) ) {
+                        a = m;
+                        fa = fm;
+                    }
+                    else {
+                        b = m;
+                    }
+                }
+                roots[ nbRoots++ ] = .5f * ( a + b );
+            }
+            lo = hi;
+            flo = fhi;
+        }
+        return nbRoots;
+    }
+}
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSelfCollider::RefitTask freecloth/simulator/simSelfCollider.cpp
+ *
+ * Refits a range of the nodes of one level, whose children on the next
+ * level have already been refitted.
+ */
+class SimSelfCollider::RefitTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    RefitTask(
+        SimSelfCollider&,
+        const std::vector<GePoint>& x0,
+        Float h,
+        const SimVector& v
+    );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+
+    // ----- data members -----
+    SimSelfCollider& _collider;
+    const std::vector<GePoint>& _x0;
+    Float           _h;
+    const SimVector& _v;
+    //! First node of the level being refitted.
+    UInt32          _levelStart;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSelfCollider::TraverseTask freecloth/simulator/simSelfCollider.cpp
+ *
+ * Traverses a range of the node pairs of the front, depth first, and
+ * tests the leaf pairs found, into the thread's impacts.
+ */
+class SimSelfCollider::TraverseTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    TraverseTask(
+        SimSelfCollider&,
+        const std::vector<GePoint>& x0,
+        Float h,
+        const SimVector& v
+    );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+
+    // ----- data members -----
+    SimSelfCollider& _collider;
+    const std::vector<GePoint>& _x0;
+    Float           _h;
+    const SimVector& _v;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSelfCollider::Impact
+
+//------------------------------------------------------------------------------
+
+bool SimSelfCollider::Impact::operator<( const Impact& rhs ) const
+{
+    if ( _type != rhs._type ) {
+        return _type < rhs._type;
+    }
+    return std::lexicographical_compare(
+        _vertices, _vertices + 4, rhs._vertices, rhs._vertices + 4
+    );
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSelfCollider::RefitTask
+
+//------------------------------------------------------------------------------
+
+SimSelfCollider::RefitTask::RefitTask(
+    SimSelfCollider& collider,
+    const std::vector<GePoint>& x0,
+    Float h,
+    const SimVector& v
+) : _collider( collider ),
+    _x0( x0 ),
+    _h( h ),
+    _v( v ),
+    _levelStart( 0 )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimSelfCollider::RefitTask::run( UInt32 begin, UInt32 end, UInt32 )
+{
+    const Float reach = .5f * _collider._thickness;
+    std::vector<GePoint>& bounds = _collider._bounds;
+    const UInt32 last = _levelStart + end;
+    for ( UInt32 node = _levelStart + begin; node < last; ++node ) {
+        GePoint min, max;
+        const UInt32 face = _collider._nodeFaces[ node ];
+        if ( face != FACE_INVALID ) {
+            const UInt32* vertices = &_collider._faceVertices[ 3 * face ];
+            min = max = _x0[ vertices[ 0 ] ];
+            for ( UInt32 k = 0; k < 3; ++k ) {
+                const GePoint& p0 = _x0[ vertices[ k ] ];
+                const GePoint p1( p0 + _h * _v[ vertices[ k ] ] );
+                for ( UInt32 i = 0; i < 3; ++i ) {
+                    min[ i ] = std::min(
+                        min[ i ], std::min( p0[ i ], p1[ i ] )
+                    );
+                    max[ i ] = std::max(
+                        max[ i ], std::max( p0[ i ], p1[ i ] )
+                    );
+                }
+            }
+            for ( UInt32 i = 0; i < 3; ++i ) {
+                min[ i ] -= reach;
+                max[ i ] += reach;
+            }
+        }
+        else {
+            const UInt32 child = _collider._nodeChildren[ node ];
+            min = bounds[ 2 * child ];
+            max = bounds[ 2 * child + 1 ];
+            const GePoint& min1 = bounds[ 2 * child + 2 ];
+            const GePoint& max1 = bounds[ 2 * child + 3 ];
+            for ( UInt32 i = 0; i < 3; ++i ) {
+                min[ i ] = std::min( min[ i ], min1[ i ] );
+                max[ i ] = std::max( max[ i ], max1[ i ] );
+            }
+        }
+        bounds[ 2 * node ] = min;
+        bounds[ 2 * node + 1 ] = max;
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSelfCollider::TraverseTask
+
+//------------------------------------------------------------------------------
+
+SimSelfCollider::TraverseTask::TraverseTask(
+    SimSelfCollider& collider,
+    const std::vector<GePoint>& x0,
+    Float h,
+    const SimVector& v
+) : _collider( collider ),
+    _x0( x0 ),
+    _h( h ),
+    _v( v )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimSelfCollider::TraverseTask::run(
+    UInt32 begin,
+    UInt32 end,
+    UInt32 threadIndex
+) {
+    const SimSelfCollider& collider = _collider;
+    // Work on local copies, so that threads don't share cache lines on every
+    // push and pop; swapping keeps the storage for the next run.
+    std::vector<UInt32> stack;
+    std::vector<Impact> impacts;
+    stack.swap( _collider._threadStacks[ threadIndex ] );
+    impacts.swap( _collider._threadImpacts[ threadIndex ] );
+    for ( UInt32 k = begin; k < end; ++k ) {
+        stack.push_back( collider._front[ 2 * k ] );
+        stack.push_back( collider._front[ 2 * k + 1 ] );
+        while ( ! stack.empty() ) {
+            const UInt32 node1 = stack.back();
+            stack.pop_back();
+            const UInt32 node0 = stack.back();
+            stack.pop_back();
+            if ( collider.expand( node0, node1, stack ) ) {
+                collider.testFaces(
+                    collider._nodeFaces[ node0 ],
+                    collider._nodeFaces[ node1 ],
+                    _x0,
+                    _h,
+                    _v,
+                    impacts
+                );
+            }
+        }
+    }
+    stack.swap( _collider._threadStacks[ threadIndex ] );
+    impacts.swap( _collider._threadImpacts[ threadIndex ] );
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSelfCollider
+
+//------------------------------------------------------------------------------
+
+SimSelfCollider::SimSelfCollider( const GeMeshWingedEdge& meshwe )
+  : _thickness( DEFAULT_THICKNESS )
+{
+    const GeMesh& mesh = meshwe.getMesh();
+    const UInt32 F = mesh.getNbFaces();
+    DGFX_ASSERT( F > 0 );
+    _faceVertices.resize( 3 * F );
+    _faceOwnership.assign( F, 0 );
+    std::vector<GePoint> centroids( F );
+
+    GeMesh::FaceConstIterator fi;
+    for ( fi = mesh.beginFace(); fi != mesh.endFace(); ++fi ) {
+        const UInt32 face = fi->getFaceId();
+        DGFX_ASSERT( fi->getNbVertices() == 3 );
+        GeVector sum( GeVector::zero() );
+        for ( UInt32 k = 0; k < 3; ++k ) {
+            _faceVertices[ 3 * face + k ] = fi->getVertexId( k );
+            sum += fi->getVertex( k ) - GePoint::ZERO;
+        }
+        centroids[ face ] = GePoint::ZERO + sum / 3;
+    }
+
+    // Each vertex is owned by the first of its faces, and each edge by the
+    // face of the half edge that represents it.
+    UInt32 k;
+    for ( UInt32 v = 0; v < mesh.getNbVertices(); ++v ) {
+        GeMeshWingedEdge::VertexFaceIterator vfi( meshwe.beginVertexFace( v ) );
+        if ( vfi == meshwe.endVertexFace( v ) ) {
+            continue;
+        }
+        const UInt32 face = vfi->getFaceId();
+        for ( k = 0; k < 3; ++k ) {
+            if ( _faceVertices[ 3 * face + k ] == v ) {
+                _faceOwnership[ face ] |= 1 << k;
+            }
+        }
+    }
+    GeMeshWingedEdge::EdgeIterator ei;
+    for ( ei = meshwe.beginEdge(); ei != meshwe.endEdge(); ++ei ) {
+        const UInt32 face = ei->getFaceId();
+        const UInt32 origin = ei->getOriginVertexId();
+        const UInt32 tip = ei->getTipVertexId();
+        for ( k = 0; k < 3; ++k ) {
+            const UInt32 a = _faceVertices[ 3 * face + k ];
+            const UInt32 b = _faceVertices[ 3 * face + ( k + 1 ) % 3 ];
+            if ( ( a == origin && b == tip ) || ( a == tip && b == origin ) ) {
+                _faceOwnership[ face ] |= 1 << ( k + 3 );
+            }
+        }
+    }
+
+    buildHierarchy( centroids );
+}
+
+//------------------------------------------------------------------------------
+
+SimSelfCollider::~SimSelfCollider()
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimSelfCollider::buildHierarchy( const std::vector<GePoint>& centroids )
+{
+    const UInt32 F = centroids.size();
+    std::vector<UInt32> order( F );
+    UInt32 i;
+    for ( i = 0; i < F; ++i ) {
+        order[ i ] = i;
+    }
+    // Node n covers order[ ranges[ 2n ] .. ranges[ 2n + 1 ] ). Nodes are
+    // appended as their parents are split, so they come out breadth first.
+    std::vector<UInt32> ranges;
+    std::vector<UInt32> levels;
+    ranges.reserve( 4 * F );
+    levels.reserve( 2 * F );
+    _nodeFaces.clear();
+    _nodeChildren.clear();
+    _nodeFaces.reserve( 2 * F );
+    _nodeChildren.reserve( 2 * F );
+
+    ranges.push_back( 0 );
+    ranges.push_back( F );
+    levels.push_back( 0 );
+    _nodeFaces.push_back( FACE_INVALID );
+    _nodeChildren.push_back( 0 );
+    for ( UInt32 node = 0; node < _nodeFaces.size(); ++node ) {
+        const UInt32 begin = ranges[ 2 * node ];
+        const UInt32 end = ranges[ 2 * node + 1 ];
+        if ( end - begin == 1 ) {
+            _nodeFaces[ node ] = order[ begin ];
+            continue;
+        }
+        // Split along the longest side of the centroids' bounds.
+        GePoint min( centroids[ order[ begin ] ] ), max( min );
+        for ( i = begin + 1; i < end; ++i ) {
+            const GePoint& c = centroids[ order[ i ] ];
+            for ( UInt32 a = 0; a < 3; ++a ) {
+                min[ a ] = std::min( min[ a ], c[ a ] );
+                max[ a ] = std::max( max[ a ], c[ a ] );
+            }
+        }
+        const GeVector extent( max - min );
+        UInt32 axis = 0;
+        if ( extent[ 1 ] > extent[ axis ] ) {
+            axis = 1;
+        }
+        if ( extent[ 2 ] > extent[ axis ] ) {
+            axis = 2;
+        }
+        const UInt32 mid = begin + ( end - begin ) / 2;
+        std::nth_element(
+            order.begin() + begin,
+            order.begin() + mid,
+            order.begin() + end,
+            CentroidLess( centroids, axis )
+        );
+        _nodeChildren[ node ] = _nodeFaces.size();
+        for ( UInt32 c = 0; c < 2; ++c ) {
+            ranges.push_back( c == 0 ? begin : mid );
+            ranges.push_back( c == 0 ? mid : end );
+            levels.push_back( levels[ node ] + 1 );
+            _nodeFaces.push_back( FACE_INVALID );
+            _nodeChildren.push_back( 0 );
+        }
+    }
+
+    _levelStarts.clear();
+    for ( i = 0; i < levels.size(); ++i ) {
+        if ( i == 0 || levels[ i ] != levels[ i - 1 ] ) {
+            _levelStarts.push_back( i );
+        }
+    }
+    _levelStarts.push_back( levels.size() );
+    _bounds.resize( 2 * _nodeFaces.size() );
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSelfCollider::getNbNodes() const
+{
+    return _nodeFaces.size();
+}
+
+//------------------------------------------------------------------------------
+
+void SimSelfCollider::setThickness( Float thickness )
+{
+    _thickness = thickness;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimSelfCollider::getThickness() const
+{
+    return _thickness;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSelfCollider::filter(
+    const std::vector<GePoint>& x0,
+    Float h,
+    const std::vector<Float>& inverseMasses,
+    SimThreadPool& threadPool,
+    SimVector& v
+) {
+    const UInt32 nbThreads = threadPool.getNbThreads();
+    _threadStacks.resize( nbThreads );
+    _threadImpacts.resize( nbThreads );
+    UInt32 nbImpulses = 0;
+    for ( UInt32 pass = 0; pass < MAX_PASSES; ++pass ) {
+        RefitTask refitTask( *this, x0, h, v );
+        for ( UInt32 l = _levelStarts.size() - 1; l-- > 0; ) {
+            const UInt32 nbNodes = _levelStarts[ l + 1 ] - _levelStarts[ l ];
+            refitTask._levelStart = _levelStarts[ l ];
+            if ( nbNodes < MIN_PARALLEL_NODES ) {
+                refitTask.run( 0, nbNodes, 0 );
+            }
+            else {
+                threadPool.run( refitTask, nbNodes );
+            }
+        }
+
+        // Expand the root's self pair breadth first, until there's enough
+        // to share out. Leaf pairs found on the way are kept as they are.
+        UInt32 t;
+        for ( t = 0; t < nbThreads; ++t ) {
+            _threadImpacts[ t ].clear();
+        }
+        _front.clear();
+        _front.push_back( 0 );
+        _front.push_back( 0 );
+        std::vector<UInt32>& pairs = _threadStacks[ 0 ];
+        UInt32 first = 0;
+        while ( first < _front.size() &&
+            _front.size() - first < 2 * nbThreads * FRONT_PER_THREAD
+        ) {
+            const UInt32 node0 = _front[ first ];
+            const UInt32 node1 = _front[ first + 1 ];
+            pairs.clear();
+            if ( expand( node0, node1, pairs ) ) {
+                testFaces(
+                    _nodeFaces[ node0 ],
+                    _nodeFaces[ node1 ],
+                    x0,
+                    h,
+                    v,
+                    _threadImpacts[ 0 ]
+                );
+            }
+            _front.insert( _front.end(), pairs.begin(), pairs.end() );
+            first += 2;
+        }
+        _front.erase( _front.begin(), _front.begin() + first );
+        pairs.clear();
+        TraverseTask traverseTask( *this, x0, h, v );
+        threadPool.runDynamic( traverseTask, _front.size() / 2 );
+
+        _impacts.clear();
+        for ( t = 0; t < nbThreads; ++t ) {
+            _impacts.insert(
+                _impacts.end(),
+                _threadImpacts[ t ].begin(),
+                _threadImpacts[ t ].end()
+            );
+        }
+        std::sort( _impacts.begin(), _impacts.end() );
+
+        // Inelastic impulses along the normal, just enough to keep the
+        // separation at the thickness by the end of the step. Once none
+        // is needed, the velocities are final.
+        const UInt32 nbEarlierImpulses = nbImpulses;
+        for ( UInt32 i = 0; i < _impacts.size(); ++i ) {
+            const Impact& impact = _impacts[ i ];
+            const GeVector& n = impact._normal;
+            Float speed = 0;
+            Float denom = 0;
+            Float maxInverseMass = 0;
+            UInt32 k;
+            for ( k = 0; k < 4; ++k ) {
+                const UInt32 vertex = impact._vertices[ k ];
+                speed += impact._weights[ k ] * v[ vertex ].dot( n );
+                denom += impact._weights[ k ] * impact._weights[ k ] *
+                    inverseMasses[ vertex ];
+                maxInverseMass = std::max(
+                    maxInverseMass, inverseMasses[ vertex ]
+                );
+            }
+            const Float gap = _thickness - impact._distance;
+            const Float target = gap / (
+                gap > 0 ? std::max( h, RELAXATION_TIME ) : h
+            );
+            if ( speed >= target || denom <= MIN_FREE_WEIGHT *
+                MIN_FREE_WEIGHT * maxInverseMass
+            ) {
+                continue;
+            }
+            const Float impulse = ( target - speed ) / denom;
+            for ( k = 0; k < 4; ++k ) {
+                const UInt32 vertex = impact._vertices[ k ];
+                v[ vertex ] += n * (
+                    impulse * impact._weights[ k ] * inverseMasses[ vertex ]
+                );
+            }
+            ++nbImpulses;
+        }
+        if ( nbImpulses == nbEarlierImpulses ) {
+            break;
+        }
+    }
+    return nbImpulses;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimSelfCollider::overlap( UInt32 node0, UInt32 node1 ) const
+{
+    const GePoint& min0 = _bounds[ 2 * node0 ];
+    const GePoint& max0 = _bounds[ 2 * node0 + 1 ];
+    const GePoint& min1 = _bounds[ 2 * node1 ];
+    const GePoint& max1 = _bounds[ 2 * node1 + 1 ];
+    for ( UInt32 i = 0; i < 3; ++i ) {
+        if ( min0[ i ] > max1[ i ] || min1[ i ] > max0[ i ] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimSelfCollider::expand(
+    UInt32 node0,
+    UInt32 node1,
+    std::vector<UInt32>& pairs
+) const {
+    const bool leaf0 = _nodeFaces[ node0 ] != FACE_INVALID;
+    const bool leaf1 = _nodeFaces[ node1 ] != FACE_INVALID;
+    if ( node0 == node1 ) {
+        // A node against itself: its children against themselves and
+        // each other.
+        if ( ! leaf0 ) {
+            const UInt32 child = _nodeChildren[ node0 ];
+            pairs.push_back( child );
+            pairs.push_back( child );
+            pairs.push_back( child + 1 );
+            pairs.push_back( child + 1 );
+            pairs.push_back( child );
+            pairs.push_back( child + 1 );
+        }
+        return false;
+    }
+    if ( ! overlap( node0, node1 ) ) {
+        return false;
+    }
+    if ( leaf0 && leaf1 ) {
+        return true;
+    }
+    // Descend the higher, and so usually larger, of the two.
+    if ( ! leaf0 && ( leaf1 || node0 < node1 ) ) {
+        const UInt32 child = _nodeChildren[ node0 ];
+        pairs.push_back( child );
+        pairs.push_back( node1 );
+        pairs.push_back( child + 1 );
+        pairs.push_back( node1 );
+    }
+    else {
+        const UInt32 child = _nodeChildren[ node1 ];
+        pairs.push_back( node0 );
+        pairs.push_back( child );
+        pairs.push_back( node0 );
+        pairs.push_back( child + 1 );
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSelfCollider::testFaces(
+    UInt32 face0,
+    UInt32 face1,
+    const std::vector<GePoint>& x0,
+    Float h,
+    const SimVector& v,
+    std::vector<Impact>& impacts
+) const {
+    const UInt32* vertices0 = &_faceVertices[ 3 * face0 ];
+    const UInt32* vertices1 = &_faceVertices[ 3 * face1 ];
+    const UInt32 owned0 = _faceOwnership[ face0 ];
+    const UInt32 owned1 = _faceOwnership[ face1 ];
+    UInt32 j, k;
+    for ( k = 0; k < 3; ++k ) {
+        if ( ( owned0 & ( 1 << k ) ) != 0 &&
+            std::find( vertices1, vertices1 + 3, vertices0[ k ] ) ==
+                vertices1 + 3
+        ) {
+            testVertexFace( vertices0[ k ], vertices1, x0, h, v, impacts );
+        }
+        if ( ( owned1 & ( 1 << k ) ) != 0 &&
+            std::find( vertices0, vertices0 + 3, vertices1[ k ] ) ==
+                vertices0 + 3
+        ) {
+            testVertexFace( vertices1[ k ], vertices0, x0, h, v, impacts );
+        }
+    }
+    for ( k = 0; k < 3; ++k ) {
+        if ( ( owned0 & ( 8 << k ) ) == 0 ) {
+            continue;
+        }
+        const UInt32 a0 = vertices0[ k ];
+        const UInt32 a1 = vertices0[ ( k + 1 ) % 3 ];
+        for ( j = 0; j < 3; ++j ) {
+            if ( ( owned1 & ( 8 << j ) ) == 0 ) {
+                continue;
+            }
+            const UInt32 b0 = vertices1[ j ];
+            const UInt32 b1 = vertices1[ ( j + 1 ) % 3 ];
+            if ( a0 != b0 && a0 != b1 && a1 != b0 && a1 != b1 ) {
+                testEdgeEdge( a0, a1, b0, b1, x0, h, v, impacts );
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSelfCollider::testVertexFace(
+    UInt32 vertex,
+    const UInt32 face[ 3 ],
+    const std::vector<GePoint>& x0,
+    Float h,
+    const SimVector& v,
+    std::vector<Impact>& impacts
+) const {
+    Impact impact;
+    impact._type = IMPACT_VERTEX_FACE;
+    impact._vertices[ 0 ] = vertex;
+    impact._vertices[ 1 ] = face[ 0 ];
+    impact._vertices[ 2 ] = face[ 1 ];
+    impact._vertices[ 3 ] = face[ 2 ];
+    GePoint p[ 4 ];
+    GeVector dp[ 4 ];
+    UInt32 k;
+    for ( k = 0; k < 4; ++k ) {
+        p[ k ] = x0[ impact._vertices[ k ] ];
+        dp[ k ] = h * v[ impact._vertices[ k ] ];
+    }
+    if ( sweptApart( p, dp, 1, _thickness ) ) {
+        return;
+    }
+    Float bary[ 3 ];
+
+    // Already close at the start of the step.
+    closestOnTriangle( p[ 0 ], p[ 1 ], p[ 2 ], p[ 3 ], bary );
+    GeVector offset(
+        p[ 0 ] - GePoint::ZERO - bary[ 0 ] * ( p[ 1 ] - GePoint::ZERO ) -
+        bary[ 1 ] * ( p[ 2 ] - GePoint::ZERO ) -
+        bary[ 2 ] * ( p[ 3 ] - GePoint::ZERO )
+    );
+    Float distance = offset.length();
+    if ( distance < _thickness ) {
+        if ( distance > 0 ) {
+            impact._normal = offset / distance;
+        }
+        else {
+            impact._normal = ( p[ 2 ] - p[ 1 ] ).cross( p[ 3 ] - p[ 1 ] );
+            if ( impact._normal.length() == 0 ) {
+                return;
+            }
+            impact._normal = impact._normal.getUnit();
+        }
+        impact._weights[ 0 ] = 1;
+        for ( k = 0; k < 3; ++k ) {
+            impact._weights[ k + 1 ] = -bary[ k ];
+        }
+        impact._distance = distance;
+        impacts.push_back( impact );
+        return;
+    }
+
+    // Coplanar, and close, during the step. Failing that, close at the
+    // end of it.
+    GeVector x[ 3 ], dx[ 3 ];
+    for ( k = 0; k < 3; ++k ) {
+        x[ k ] = p[ ( k + 2 ) % 4 ] - p[ 1 ];
+        dx[ k ] = dp[ ( k + 2 ) % 4 ] - dp[ 1 ];
+    }
+    Float c[ 4 ];
+    calcCoplanarity( x, dx, c );
+    Float roots[ 5 ];
+    UInt32 nbRoots = findRoots( c, roots );
+    roots[ nbRoots++ ] = 1;
+    for ( UInt32 r = 0; r < nbRoots; ++r ) {
+        GePoint pt[ 4 ];
+        for ( k = 0; k < 4; ++k ) {
+            pt[ k ] = p[ k ] + roots[ r ] * dp[ k ];
+        }
+        closestOnTriangle( pt[ 0 ], pt[ 1 ], pt[ 2 ], pt[ 3 ], bary );
+        offset = pt[ 0 ] - GePoint::ZERO -
+            bary[ 0 ] * ( pt[ 1 ] - GePoint::ZERO ) -
+            bary[ 1 ] * ( pt[ 2 ] - GePoint::ZERO ) -
+            bary[ 2 ] * ( pt[ 3 ] - GePoint::ZERO );
+        distance = offset.length();
+        if ( distance >= _thickness ) {
+            continue;
+        }
+        // The face normal, towards the side the vertex started on.
+        GeVector n( ( pt[ 2 ] - pt[ 1 ] ).cross( pt[ 3 ] - pt[ 1 ] ) );
+        if ( n.length() == 0 ) {
+            continue;
+        }
+        n = n.getUnit();
+        impact._weights[ 0 ] = 1;
+        for ( k = 0; k < 3; ++k ) {
+            impact._weights[ k + 1 ] = -bary[ k ];
+        }
+        Float start = 0;
+        for ( k = 0; k < 4; ++k ) {
+            start += impact._weights[ k ] * n.dot( p[ k ] - GePoint::ZERO );
+        }
+        if ( start < 0 ) {
+            n = -n;
+            start = -start;
+        }
+        impact._normal = n;
+        impact._distance = start;
+        impacts.push_back( impact );
+        return;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSelfCollider::testEdgeEdge(
+    UInt32 edge0V0,
+    UInt32 edge0V1,
+    UInt32 edge1V0,
+    UInt32 edge1V1,
+    const std::vector<GePoint>& x0,
+    Float h,
+    const SimVector& v,
+    std::vector<Impact>& impacts
+) const {
+    Impact impact;
+    impact._type = IMPACT_EDGE_EDGE;
+    impact._vertices[ 0 ] = edge0V0;
+    impact._vertices[ 1 ] = edge0V1;
+    impact._vertices[ 2 ] = edge1V0;
+    impact._vertices[ 3 ] = edge1V1;
+    GePoint p[ 4 ];
+    GeVector dp[ 4 ];
+    UInt32 k;
+    for ( k = 0; k < 4; ++k ) {
+        p[ k ] = x0[ impact._vertices[ k ] ];
+        dp[ k ] = h * v[ impact._vertices[ k ] ];
+    }
+    if ( sweptApart( p, dp, 2, _thickness ) ) {
+        return;
+    }
+    Float s, t;
+
+    // Already close at the start of the step.
+    closestOnSegments( p[ 0 ], p[ 1 ], p[ 2 ], p[ 3 ], s, t );
+    GeVector offset(
+        ( p[ 0 ] + s * ( p[ 1 ] - p[ 0 ] ) ) -
+        ( p[ 2 ] + t * ( p[ 3 ] - p[ 2 ] ) )
+    );
+    Float distance = offset.length();
+    if ( distance < _thickness ) {
+        if ( distance > 0 ) {
+            impact._normal = offset / distance;
+        }
+        else {
+            impact._normal = ( p[ 1 ] - p[ 0 ] ).cross( p[ 3 ] - p[ 2 ] );
+            if ( impact._normal.length() == 0 ) {
+                return;
+            }
+            impact._normal = impact._normal.getUnit();
+        }
+        impact._weights[ 0 ] = 1 - s;
+        impact._weights[ 1 ] = s;
+        impact._weights[ 2 ] = t - 1;
+        impact._weights[ 3 ] = -t;
+        impact._distance = distance;
+        impacts.push_back( impact );
+        return;
+    }
+
+    // Coplanar, and close, during the step. Failing that, close at the
+    // end of it.
+    GeVector x[ 3 ], dx[ 3 ];
+    for ( k = 0; k < 3; ++k ) {
+        x[ k ] = p[ k + 1 ] - p[ 0 ];
+        dx[ k ] = dp[ k + 1 ] - dp[ 0 ];
+    }
+    Float c[ 4 ];
+    calcCoplanarity( x, dx, c );
+    Float roots[ 5 ];
+    UInt32 nbRoots = findRoots( c, roots );
+    roots[ nbRoots++ ] = 1;
+    for ( UInt32 r = 0; r < nbRoots; ++r ) {
+        GePoint pt[ 4 ];
+        for ( k = 0; k < 4; ++k ) {
+            pt[ k ] = p[ k ] + roots[ r ] * dp[ k ];
+        }
+        closestOnSegments( pt[ 0 ], pt[ 1 ], pt[ 2 ], pt[ 3 ], s, t );
+        offset = ( pt[ 0 ] + s * ( pt[ 1 ] - pt[ 0 ] ) ) -
+            ( pt[ 2 ] + t * ( pt[ 3 ] - pt[ 2 ] ) );
+        distance = offset.length();
+        if ( distance >= _thickness ) {
+            continue;
+        }
+        // Perpendicular to both edges, towards the side the first edge
+        // started on. Nearly parallel edges use the offset instead.
+        GeVector n( ( pt[ 1 ] - pt[ 0 ] ).cross( pt[ 3 ] - pt[ 2 ] ) );
+        if ( n.length() <= distance * ( pt[ 1 ] - pt[ 0 ] ).length() ) {
+            n = offset;
+        }
+        if ( n.length() == 0 ) {
+            continue;
+        }
+        n = n.getUnit();
+        impact._weights[ 0 ] = 1 - s;
+        impact._weights[ 1 ] = s;
+        impact._weights[ 2 ] = t - 1;
+        impact._weights[ 3 ] = -t;
+        Float start = 0;
+        for ( k = 0; k < 4; ++k ) {
+            start += impact._weights[ k ] * n.dot( p[ k ] - GePoint::ZERO );
+        }
+        if ( start < 0 ) {
+            n = -n;
+            start = -start;
+        }
+        impact._normal = n;
+        impact._distance = start;
+        impacts.push_back( impact );
+        return;
+    }
+}
+
+FREECLOTH_NAMESPACE_END
@@ -0,0 +1,257 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#ifndef freecloth_sim_simSelfCollider_h
+#define freecloth_sim_simSelfCollider_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_geom_gePoint_h
+#include <freecloth/geom/gePoint.h>
+#endif
+
+#ifndef freecloth_geom_geVector_h
+#include <freecloth/geom/geVector.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+#ifndef freecloth_base_vector
+#include <freecloth/base/vector>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class GeMeshWingedEdge;
+class SimThreadPool;
+class SimVector;
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSelfCollider freecloth/simulator/simSelfCollider.h
+ * \brief Collisions between the faces of a single mesh.
+ *
+ * Self-collisions are found between a vertex and a face that doesn't
+ * contain it, and between two edges that don't share a vertex. Each such
+ * pair is tested once: a vertex or edge is owned by a single one of its
+ * faces, found from the winged-edge structure, and only the primitives
+ * owned by the two faces of a candidate pair are tested.
+ *
+ * Candidate pairs come from a bounding volume hierarchy over the faces.
+ * Its shape depends only upon the mesh topology, and is built once, at
+ * construction, by splitting the faces of the unstretched mesh at the
+ * median. Each step only refits the boxes, bottom up, to the swept
+ * positions of the faces over the step. The nodes are stored breadth
+ * first, so that each level can be refitted in parallel, and the tree is
+ * then traversed against itself in parallel, from a front of node pairs
+ * handed out to the threads.
+ *
+ * Each pair is tested both for proximity at the start of the step and
+ * continuously over it, as in [BriFedAnd02]: the times at which the
+ * vertex and face, or the two edges, become coplanar are the roots of a
+ * cubic, and the primitives collide if they're close at one of those
+ * times. So cloth can't pass through itself within a step, however fast
+ * it moves.
+ *
+ * filter() responds with inelastic impulses on the velocities, which
+ * SimSimulator applies after solving for them. Impulses are applied one
+ * collision at a time, in a fixed order, and the detection is repeated a
+ * few times, until no impulse is needed, since one impulse can cause
+ * another collision. Collisions that remain after the last pass are left
+ * alone, as are those at which only constrained vertices could move the
+ * colliding points.
+ *
+ * The refitted boxes and the collisions found are kept between calls, so
+ * a self-collider may only be used by one simulator at a time.
+ *
+ * References:
+ * - [BriFedAnd02] R. Bridson, R. Fedkiw and J. Anderson. Robust Treatment
+ *    of Collisions, Contact and Friction for Cloth Animation. SIGGRAPH
+ *    Conference Proceedings, 2002, 594-603.
+ */
+class SimSelfCollider : public RCBase
+{
+public:
+    // ----- member functions -----
+
+    //! Build the hierarchy over the faces of the winged-edge structure's
+    //! mesh, which must be triangular.
+    explicit SimSelfCollider( const GeMeshWingedEdge& );
+    virtual ~SimSelfCollider();
+
+    //! Number of nodes in the hierarchy.
+    UInt32 getNbNodes() const;
+
+    //! Distance that collisions keep between parts of the mesh. Defaults
+    //! to 2mm, and should be well below the edge lengths, since vertices
+    //! are only exempt from collisions with their own faces.
+    void setThickness( Float );
+    Float getThickness() const;
+
+    //! Change the velocities v of the vertices, which start the step at x0
+    //! and move at v for time h, so that no collisions occur over the
+    //! step. Vertices with a zero inverse mass are not moved. The work is
+    //! split over the pool, but the result doesn't depend upon the number
+    //! of threads. Returns the number of impulses applied.
+    UInt32 filter(
+        const std::vector<GePoint>& x0,
+        Float h,
+        const std::vector<Float>& inverseMasses,
+        SimThreadPool&,
+        SimVector& v
+    );
+
+private:
+    // ----- types and enumerations -----
+
+    enum {
+        //! Face of an internal node.
+        FACE_INVALID = ~0U
+    };
+
+    enum ImpactType {
+        IMPACT_VERTEX_FACE,
+        IMPACT_EDGE_EDGE
+    };
+
+    // ----- classes -----
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class Impact freecloth/simulator/simSelfCollider.h
+     *
+     * A collision found by the traversal. The relative position of the
+     * two primitives is the weighted sum of the positions of the four
+     * vertices: for a vertex and face, the vertex less the nearest point
+     * of the face, and for two edges, the nearest point of the first less
+     * that of the second.
+     */
+    class Impact
+    {
+    public:
+        // ----- member functions -----
+
+        //! Order by type, then vertices, for a result independent of the
+        //! traversal order.
+        bool operator<( const Impact& ) const;
+
+        // ----- data members -----
+
+        ImpactType      _type;
+        UInt32          _vertices[ 4 ];
+        Float           _weights[ 4 ];
+        //! Unit direction along which the primitives are kept apart.
+        GeVector        _normal;
+        //! Separation along the normal, at the start of the step.
+        Float           _distance;
+    };
+
+    //! Refit a range of the nodes of a single level.
+    class RefitTask;
+    //! Traverse a range of the front of node pairs.
+    class TraverseTask;
+    friend class RefitTask;
+    friend class TraverseTask;
+
+    // ----- member functions -----
+
+    // The hierarchy is shared, not copied.
+    SimSelfCollider( const SimSelfCollider& );
+    SimSelfCollider& operator=( const SimSelfCollider& );
+
+    //! Split the faces at the median of their centroids, breadth first.
+    void buildHierarchy( const std::vector<GePoint>& centroids );
+    bool overlap( UInt32 node0, UInt32 node1 ) const;
+    //! Expand the node pair by one level: either the node pair is a leaf
+    //! pair, which is returned, or its children are pushed onto pairs.
+    bool expand(
+        UInt32 node0,
+        UInt32 node1,
+        std::vector<UInt32>& pairs
+    ) const;
+    //! Test the primitives owned by two faces, and add the collisions to
+    //! impacts.
+    void testFaces(
+        UInt32 face0,
+        UInt32 face1,
+        const std::vector<GePoint>& x0,
+        Float h,
+        const SimVector& v,
+        std::vector<Impact>& impacts
+    ) const;
+    void testVertexFace(
+        UInt32 vertex,
+        const UInt32 face[ 3 ],
+        const std::vector<GePoint>& x0,
+        Float h,
+        const SimVector& v,
+        std::vector<Impact>& impacts
+    ) const;
+    void testEdgeEdge(
+        UInt32 edge0V0,
+        UInt32 edge0V1,
+        UInt32 edge1V0,
+        UInt32 edge1V1,
+        const std::vector<GePoint>& x0,
+        Float h,
+        const SimVector& v,
+        std::vector<Impact>& impacts
+    ) const;
+
+    // ----- data members -----
+
+    //! Three vertices per face.
+    std::vector<UInt32> _faceVertices;
+    //! Primitives owned by each face: bit k for its vertex k, and bit
+    //! k + 3 for its edge from vertex k to vertex k + 1.
+    std::vector<UInt8> _faceOwnership;
+    //@{
+    //! The face of each leaf node, or FACE_INVALID, and the first of the
+    //! two adjacent children of each internal node.
+    std::vector<UInt32> _nodeFaces;
+    std::vector<UInt32> _nodeChildren;
+    //@}
+    //! Level l of the hierarchy is nodes [ _levelStarts[ l ],
+    //! _levelStarts[ l + 1 ] ), and the children of a node are always on
+    //! the next level.
+    std::vector<UInt32> _levelStarts;
+    //! Swept bounds of each node, min then max, inflated by half the
+    //! thickness.
+    std::vector<GePoint> _bounds;
+    //! Node pairs for the threads to traverse, as consecutive indices.
+    std::vector<UInt32> _front;
+    //@{
+    //! Per-thread traversal stack and collisions.
+    std::vector< std::vector<UInt32> > _threadStacks;
+    std::vector< std::vector<Impact> > _threadImpacts;
+    //@}
+    std::vector<Impact> _impacts;
+    Float           _thickness;
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif
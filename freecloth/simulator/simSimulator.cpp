@@ -24,12 +24,6 @@
 #include <freecloth/base/baMath.h>
 #include <freecloth/base/baStringUtil.h>
 
-#ifdef NDEBUG
-    #define DO_DEBUG(x)
-#else
-    #define DO_DEBUG(x) x
-#endif
-
 // If set, avoid [BarWit98]'s assumption that stretch always keeps the
 // edge lengths to a fixed size. Not very sure that it works...
 #define DO_NORM             0
@@ -78,6 +72,27 @@ namespace {
     const bool DUMP_DISTS = false;
     const bool DUMP_FORCES = false;
 
+    //! Rows per chunk in the PCG sweeps. Fixed, so that dot products are
+    //! summed in the same order whatever the number of threads.
+    const UInt32 PCG_CHUNK_SIZE = 256;
+    //! Levels of the incomplete Cholesky preconditioner with fewer rows
+    //! than this are processed by the calling thread alone.
+    const UInt32 IC_MIN_PARALLEL_ROWS = 64;
+    //! First diagonal shift tried when the incomplete Cholesky
+    //! factorization breaks down, as a fraction of the diagonal.
+    const Float IC_INITIAL_SHIFT = 1e-3f;
+    //! Maximum number of times the shift is doubled.
+    const UInt32 IC_MAX_SHIFTS = 12;
+    //! [EisWal96] choice 2 parameters for the Newton corrections' PCG
+    //! tolerances, with alpha = 2.
+    const Float NEWTON_GAMMA = .9f;
+    const Float NEWTON_MAX_FORCING = .9f;
+    //! Contacts push vertices that are closer than the collider's thickness
+    //! back out over no less than this time, in seconds. Pushing them out
+    //! in a single step would take ever larger velocities as the adaptive
+    //! strategies shrink the timestep, and make the step fail again.
+    const Float CONTACT_RELAXATION_TIME = .01f;
+
 
 
 
@@ -98,6 +113,126 @@ namespace {
         return GeVector();
     }
 
+//------------------------------------------------------------------------------
+
+    //! Length of the vector filtered by S, as per [BarWit98] section 5.3.
+    Float filteredLength(
+        const std::vector<GeMatrix3>& S,
+        const SimVector& a
+    ) {
+        DGFX_ASSERT( S.size() == a.size() );
+        Float sum = 0;
+        for ( UInt32 i = 0; i < a.size(); ++i ) {
+            sum += ( S[ i ] * a[ i ] ).squaredLength();
+        }
+        return BaMath::sqrt( sum );
+    }
+
+
+//------------------------------------------------------------------------------
+
+    //! Greedy colouring of elements which each touch nbVids vertices, so
+    //! that no two elements of the same colour share a vertex. vids holds
+    //! the vertices of element e at [ e * nbVids, ( e + 1 ) * nbVids ).
+    //! On return, order lists the elements sorted by colour, and colour c
+    //! occupies [ colourStarts[ c ], colourStarts[ c + 1 ] ) of order.
+    //! Elements keep their relative order within a colour.
+    void colourElements(
+        const std::vector<UInt32>& vids,
+        UInt32 nbVids,
+        UInt32 nbVertices,
+        std::vector<UInt32>& order,
+        std::vector<UInt32>& colourStarts
+    ) {
+        const UInt32 nbElements = vids.size() / nbVids;
+        // Colours already used by the elements around each vertex.
+        std::vector< std::vector<UInt32> > vertexColours( nbVertices );
+        // forbidden[ c ] == e + 1 if colour c is unavailable to element e.
+        std::vector<UInt32> forbidden;
+        std::vector<UInt32> colours( nbElements );
+        UInt32 nbColours = 0;
+        UInt32 e, m, k;
+
+        for ( e = 0; e < nbElements; ++e ) {
+            const UInt32* ev = &vids[ e * nbVids ];
+            for ( m = 0; m < nbVids; ++m ) {
+                const std::vector<UInt32>& vc = vertexColours[ ev[ m ] ];
+                for ( k = 0; k < vc.size(); ++k ) {
+                    forbidden[ vc[ k ] ] = e + 1;
+                }
+            }
+            UInt32 c = 0;
+            while ( c < nbColours && forbidden[ c ] == e + 1 ) {
+                ++c;
+            }
+            if ( c == nbColours ) {
+                ++nbColours;
+                forbidden.push_back( 0 );
+            }
+            colours[ e ] = c;
+            for ( m = 0; m < nbVids; ++m ) {
+                vertexColours[ ev[ m ] ].push_back( c );
+            }
+        }
+
+        // Counting sort by colour.
+        colourStarts.assign( nbColours + 1, 0 );
+        for ( e = 0; e < nbElements; ++e ) {
+            ++colourStarts[ colours[ e ] + 1 ];
+        }
+        for ( k = 0; k < nbColours; ++k ) {
+            colourStarts[ k + 1 ] += colourStarts[ k ];
+        }
+        std::vector<UInt32> next( colourStarts );
+        order.resize( nbElements );
+        for ( e = 0; e < nbElements; ++e ) {
+            order[ next[ colours[ e ] ]++ ] = e;
+        }
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Invert a 3x3 block. Returns false if the block isn't safely
+    //! positive definite enough to invert, judged by its determinant
+    //! relative to the scale of its entries. GeMatrix3::getInverse() uses an
+    //! absolute tolerance, which is too coarse for small masses.
+    bool invertBlock( const GeMatrix3& a, GeMatrix3& inv )
+    {
+        const GeMatrix3 cof(
+            a(1,1) * a(2,2) - a(1,2) * a(2,1),
+            a(0,2) * a(2,1) - a(0,1) * a(2,2),
+            a(0,1) * a(1,2) - a(0,2) * a(1,1),
+
+            a(1,2) * a(2,0) - a(1,0) * a(2,2),
+            a(0,0) * a(2,2) - a(0,2) * a(2,0),
+            a(0,2) * a(1,0) - a(0,0) * a(1,2),
+
+            a(1,0) * a(2,1) - a(1,1) * a(2,0),
+            a(0,1) * a(2,0) - a(0,0) * a(2,1),
+            a(0,0) * a(1,1) - a(0,1) * a(1,0)
+        );
+        const Float det =
+            a(0,0) * cof(0,0) + a(0,1) * cof(1,0) + a(0,2) * cof(2,0);
+        Float scale = 0;
+        for ( UInt32 i = 0; i < 3; ++i ) {
+            scale = std::max( scale, BaMath::abs( a( i, i ) ) );
+        }
+        if ( ! ( det > 1e-6f * scale * scale * scale ) ) {
+            return false;
+        }
+        inv = cof * ( 1.f / det );
+        return true;
+    }
+
+//------------------------------------------------------------------------------
+
+    //! Test the leading minors of a symmetric 3x3 block. Together with
+    //! invertBlock()'s determinant test, this establishes that the block
+    //! is positive definite.
+    bool hasPositiveMinors( const GeMatrix3& a )
+    {
+        return a(0,0) > 0 && a(0,0) * a(1,1) - a(0,1) * a(1,0) > 0;
+    }
 
 //------------------------------------------------------------------------------
 
@@ -265,6 +400,54 @@ private:
 };
 
 
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSimulator::ColourTask freecloth/simulator/simSimulator.cpp
+ *
+ * Assembly task over a single colour class. runColoured() sets
+ * _colourBegin before each pass, and the task's item range is relative to
+ * it.
+ */
+class SimSimulator::ColourTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    explicit ColourTask( SimSimulator& );
+
+    // ----- data members -----
+    SimSimulator&   _sim;
+    UInt32          _colourBegin;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSimulator::StretchShearTask freecloth/simulator/simSimulator.cpp
+ *
+ * Calculates stretch and shear for a range of _faceOrder.
+ */
+class SimSimulator::StretchShearTask : public SimSimulator::ColourTask
+{
+public:
+    // ----- member functions -----
+    explicit StretchShearTask( SimSimulator& );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSimulator::BendTask freecloth/simulator/simSimulator.cpp
+ *
+ * Calculates bend for a range of _bendStencils.
+ */
+class SimSimulator::BendTask : public SimSimulator::ColourTask
+{
+public:
+    // ----- member functions -----
+    explicit BendTask( SimSimulator& );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // CLASS SimSimulator
 
@@ -273,9 +456,34 @@ private:
 SimSimulator::SimSimulator( const GeMesh& initialMesh )
   : _initialMesh( new GeMesh( initialMesh ) ),
     _rho( .01f ),
-    _h( .02f ),
-    _stretchLimit( .03f )
+    _timestep( BaTime::S / 50 ),
+    _h( BaTime::durationAsSeconds( _timestep ) ),
+    _nbContacts( 0 ),
+    _nbSelfCollisions( 0 ),
+    _stretchLimit( .03f ),
+    _threadPool( new SimThreadPool( 1 ) ),
+    _diagnostics( DIAGNOSTICS_NONE ),
+    _diagnosticsCacheValid( false ),
+    _newtonIterations( 1 ),
+    _newtonTolerance( 1e-2f ),
+    _newtonIteration( 0 ),
+    _newtonMoved( false ),
+    _newtonResidual( 0 ),
+    _newtonForcing( 0 ),
+    _newtonPCGSteps( 0 )
 {
+    // Mesh topology is fixed for the lifetime of the simulator, so the
+    // winged-edge structure and the matrix sparsity pattern need only be
+    // built once.
+    _initialMeshWingedEdge = RCShdPtr<GeMeshWingedEdge>(
+        new GeMeshWingedEdge( _initialMesh )
+    );
+    // The system is symmetric, so only the upper triangle is stored.
+    _pattern = SimMatrixPattern::createUpperTriangle(
+        *SimMatrixPattern::createFromMesh( *_initialMeshWingedEdge )
+    );
+    setupAssembly();
+    _modPCG.setThreadPool( _threadPool );
     rewind();
     setupMass();
     removeAllConstraints();
@@ -285,9 +493,6 @@ SimSimulator::SimSimulator( const GeMesh& initialMesh )
 
 void SimSimulator::rewind()
 {
-    _initialMeshWingedEdge = RCShdPtr<GeMeshWingedEdge>(
-        new GeMeshWingedEdge( _initialMesh )
-    );
     if ( DEBUG_REWIND ) {
         std::cout << "winged edges = " << _initialMeshWingedEdge << std::endl;
     }
@@ -297,35 +502,34 @@ void SimSimulator::rewind()
     _sd._v0 = SimVector( N );
     _sd._f0 = SimVector( N );
     _sd._lastDeltaV0 = SimVector::zero( N );
-    _df_dx = SimMatrix( N, N );
-    _df_dv = SimMatrix( N, N );
+    _df_dx = SymMatrix( _pattern );
+    _df_dv = SymMatrix( _pattern );
     _modPCG._b = SimVector( N );
-    _modPCG._A = SimMatrix( N, N );
+    if ( ! isMatrixFree() ) {
+        _modPCG._A = SymMatrix( _pattern );
+    }
     UInt32 i;
-    ForceType ftypes[] = { F_STRETCH, F_SHEAR, F_BEND };
     for( i = 0; i < 3; ++i ) {
-        UInt32 f( ftypes[ i ] );
-        _sd._f0i[ f ] = SimVector( N );
-        _sd._d0i[ f ] = SimVector( N );
-
         _sd._fenergy[ i ] = 0;
     }
-    _sd._f0i[ F_GRAVITY ] = SimVector( N );
-    _sd._f0i[ F_DRAG ] = SimVector( N );
-
-    for( i = 0; i < NB_FORCES; ++i ) {
-        _sd._trienergy[ i ].resize( _initialMesh->getNbFaces() );
-    }
+    setupDiagnostics( _sd );
+    // Nothing has been assembled yet.
+    _sd._diagnostics = DIAGNOSTICS_NONE;
     _sd._Cu.resize( _initialMesh->getNbFaces() );
     _sd._Cv.resize( _initialMesh->getNbFaces() );
     _faceUnitNormals.resize( _initialMesh->getNbFaces() );
     _faceNormalIMs.resize( _initialMesh->getNbFaces() );
     _sd._venergy = 0;
     _sd._energy = 0;
-    _sd._time = 0.f;
+    _sd._time = 0;
 
-    _savedVertices.resize( _initialMesh->getNbVertices() );
+    _savedVertices.assign( _mesh->beginVertex(), _mesh->endVertex() );
     _savedStepData = _sd;
+    _stepRolledBack = false;
+    _diagnosticsCacheValid = false;
+    _newtonIteration = 0;
+    _newtonPCGSteps = 0;
+    _stepStats.clear();
 
     calcFaceConsts();
 
@@ -334,14 +538,14 @@ void SimSimulator::rewind()
 
     _inStep = false;
     _stepSuccessFlag = true;
+    _maxStretchChange = 0;
 }
 
 //------------------------------------------------------------------------------
 
 void SimSimulator::setupMass()
 {
-    const UInt32 N = _mesh->getNbVertices();
-    _M = SimMatrix( N, N );
+    _M = TridiagMatrix( _pattern );
     _totalMass = 0;
 
     GeMesh::FaceConstIterator fi;
@@ -372,9 +576,9 @@ void SimSimulator::removeAllConstraints()
 {
     const UInt32 N = _mesh->getNbVertices();
     GeMesh::VertexId vid;
-    _modPCG._S.resize( N );
+    _S0.resize( N );
     for( vid = 0; vid < N; ++vid ) {
-        _modPCG._S[ vid ] = GeMatrix3::identity();
+        _S0[ vid ] = GeMatrix3::identity();
     }
     _z0 = SimVector( N );
     _z0.clear();
@@ -393,8 +597,8 @@ void SimSimulator::setPosConstraintPlane(
     DGFX_ASSERT( ! inStep() );
 
     GeVector pu( p.getUnit() );
-    DGFX_ASSERT( vid < _modPCG._S.size() );
-    _modPCG._S[ vid ] =
+    DGFX_ASSERT( vid < _S0.size() );
+    _S0[ vid ] =
         GeMatrix3::identity() - GeMatrix3::outerProduct( pu, pu );
 }
 
@@ -426,8 +630,8 @@ void SimSimulator::setPosConstraintLine(
     DGFX_ASSERT( BaMath::isEqual( qu.dot( vu ), 0 ) );
     DGFX_ASSERT( BaMath::isEqual( pu.dot( qu ), 0 ) );
 
-    DGFX_ASSERT( vid < _modPCG._S.size() );
-    _modPCG._S[ vid ] =
+    DGFX_ASSERT( vid < _S0.size() );
+    _S0[ vid ] =
         GeMatrix3::identity() - GeMatrix3::outerProduct( pu, pu ) -
         GeMatrix3::outerProduct( qu, qu );
 }
@@ -437,8 +641,8 @@ void SimSimulator::setPosConstraintLine(
 void SimSimulator::setPosConstraintFull( GeMesh::VertexId vid )
 {
     DGFX_ASSERT( ! inStep() );
-    DGFX_ASSERT( vid < _modPCG._S.size() );
-    _modPCG._S[ vid ] = GeMatrix3::zero();
+    DGFX_ASSERT( vid < _S0.size() );
+    _S0[ vid ] = GeMatrix3::zero();
 }
 
 //------------------------------------------------------------------------------
@@ -464,35 +668,207 @@ void SimSimulator::step()
 
 //------------------------------------------------------------------------------
 
-void SimSimulator::postSubStepsFinale()
+const SimSimulator::StepData& SimSimulator::getReportedStepData() const
 {
-    UInt32 i;
+    return _stepRolledBack ? _sd : _savedStepData;
+}
 
-    for( i = 0; i < NB_FORCES; ++i ) {
-        _sd._fenergy[ i ] = 0;
+//------------------------------------------------------------------------------
+
+const SimSimulator::StepData& SimSimulator::getReportedStepData(
+    Diagnostics needed
+) const {
+    const StepData& sd = getReportedStepData();
+    if ( sd._diagnostics >= needed ) {
+        return sd;
+    }
+    if ( ! _diagnosticsCacheValid ) {
+        if ( _stepRolledBack ) {
+            calcDiagnostics( *_mesh );
+        }
+        else {
+            // The reported step's positions are the saved ones.
+            GeMesh mesh( *_mesh );
+            GeMesh::VertexContainer vertices( _savedVertices );
+            mesh.swapVertices( vertices );
+            calcDiagnostics( mesh );
+        }
+        _diagnosticsCacheValid = true;
+    }
+    return _diagnosticsCache;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setupDiagnostics( StepData& sd ) const
+{
+    const UInt32 N = _initialMesh->getNbVertices();
+    const UInt32 F = _initialMesh->getNbFaces();
+    const bool full = ( _diagnostics == DIAGNOSTICS_FULL );
+    for ( UInt32 i = 0; i < NB_FORCES; ++i ) {
+        const UInt32 nbF0i = full ? N : 0;
+        const UInt32 nbD0i = ( full && i < F_GRAVITY ) ? N : 0;
+        const UInt32 nbTri =
+            ( _diagnostics != DIAGNOSTICS_NONE && i < F_GRAVITY ) ? F : 0;
+        if ( sd._f0i[ i ].size() != nbF0i ) {
+            sd._f0i[ i ] = SimVector::zero( nbF0i );
+        }
+        if ( sd._d0i[ i ].size() != nbD0i ) {
+            sd._d0i[ i ] = SimVector::zero( nbD0i );
+        }
+        if ( sd._trienergy[ i ].size() != nbTri ) {
+            // Swap with a fresh vector, so that the memory is released.
+            std::vector<Float>( nbTri, 0 ).swap( sd._trienergy[ i ] );
+        }
+    }
+    sd._diagnostics = _diagnostics;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::calcDiagnostics( const GeMesh& mesh ) const
+{
+    const StepData& sd = getReportedStepData();
+    StepData& dc = _diagnosticsCache;
+    const UInt32 N = mesh.getNbVertices();
+    const UInt32 F = mesh.getNbFaces();
+    UInt32 i, m;
+
+    dc = sd;
+    for ( i = 0; i < NB_FORCES; ++i ) {
+        dc._f0i[ i ] = SimVector::zero( N );
+        dc._d0i[ i ] = SimVector::zero( i < F_GRAVITY ? N : 0 );
+        dc._trienergy[ i ].assign( i < F_GRAVITY ? F : 0, 0 );
+    }
+    dc._diagnostics = DIAGNOSTICS_FULL;
+
+    // Stretch, shear and drag, as in calcStretch(), calcShear() and
+    // preSubSteps().
+    GeMesh::FaceConstIterator fi;
+    for ( fi = mesh.beginFace(); fi != mesh.endFace(); ++fi ) {
+        const GeMesh::FaceId fid( fi->getFaceId() );
+        GeMesh::VertexType x[ 3 ];
+        GeVector v0[ 3 ];
+        for ( m = 0; m < 3; ++m ) {
+            x[ m ] = mesh.getVertex( fi->getVertexId( m ) );
+            v0[ m ] = sd._v0[ fi->getVertexId( m ) ];
+        }
+        const FaceConsts& fc = _faceConsts[ fid ];
+        CommonVars cv;
+        cv.calc( fc, x );
+        StretchVars stv;
+        stv.calc( fc, cv, v0, _params._b_u, _params._b_v );
+        ShearVars shv;
+        shv.calc( fc, cv, v0 );
+
+        for ( m = 0; m < 3; ++m ) {
+            const UInt32 vid = fi->getVertexId( m );
+            dc._f0i[ F_STRETCH ][ vid ] += -_params._k_stretch * (
+                stv._dCu_dxm[ m ] * stv._Cu + stv._dCv_dxm[ m ] * stv._Cv
+            );
+            dc._d0i[ F_STRETCH ][ vid ] += -_params._k_stretch_damp * (
+                stv._dCu_dxm[ m ] * stv._dCu_dt
+                + stv._dCv_dxm[ m ] * stv._dCv_dt
+            );
+            dc._f0i[ F_SHEAR ][ vid ] +=
+                -_params._k_shear * shv._dC_dxm[ m ] * shv._C;
+            dc._d0i[ F_SHEAR ][ vid ] +=
+                -_params._k_shear_damp * shv._dC_dxm[ m ] * shv._dC_dt;
+        }
+        dc._trienergy[ F_STRETCH ][ fid ] = _params._k_stretch * .5 * (
+            stv._Cu * stv._Cu + stv._Cv * stv._Cv
+        );
+        dc._trienergy[ F_SHEAR ][ fid ] =
+            _params._k_shear * .5 * shv._C * shv._C;
+
+        const Float area( fi->calcArea() );
+        const GeVector normal( fi->calcNormal() );
+        for ( m = 0; m < fi->getNbVertices(); ++m ) {
+            const UInt32 vid( fi->getVertexId( m ) );
+            const Float vel( sd._v0[ vid ].dot( normal ) );
+            dc._f0i[ F_DRAG ][ vid ] +=
+                ( -_params._k_drag * vel * area ) * normal;
+        }
+    }
+
+    for ( i = 0; i < N; ++i ) {
+        dc._f0i[ F_GRAVITY ][ i ]._z = -_M( i, i )( 2, 2 ) * _params._g;
+    }
+
+    // Bend, as in calcBend().
+    std::vector<GeVector> unitNormals( F );
+    std::vector<Float> normalIMs( F );
+    for ( fi = mesh.beginFace(); fi != mesh.endFace(); ++fi ) {
+        const GeVector normal( fi->calcNonUnitNormal() );
+        normalIMs[ fi->getFaceId() ] = 1.f / normal.length();
+        unitNormals[ fi->getFaceId() ] =
+            normal * -normalIMs[ fi->getFaceId() ];
     }
+    for ( i = 0; i < _bendStencils.size(); ++i ) {
+        const BendStencil& bs = _bendStencils[ i ];
+        const GeMeshWingedEdge::HalfEdgeWrapper edge(
+            _initialMeshWingedEdge->getHalfEdge( bs._halfEdgeId )
+        );
+        GeMesh::VertexId vid[ 4 ];
+        BendVars bv;
+        const Float k = calcBendVars(
+            edge, mesh, sd._v0, unitNormals, normalIMs, vid, bv
+        );
+        for ( m = 0; m < 4; ++m ) {
+            dc._f0i[ F_BEND ][ vid[ m ] ] += -k * bv._dC_dxm[ m ] * bv._C;
+            dc._d0i[ F_BEND ][ vid[ m ] ] +=
+                -_params._k_bend_damp * bv._dC_dxm[ m ] * bv._dC_dt;
+        }
+        const Float E = .5 * k * bv._C * bv._C;
+        dc._trienergy[ F_BEND ][ edge.getFaceId() ] += E * .5;
+        dc._trienergy[ F_BEND ][ edge.getTwinHalfEdge().getFaceId() ] +=
+            E * .5;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::postSubStepsFinale()
+{
+    UInt32 i;
+    SimProfiler::Sample start;
+    startPhase( start );
 
      _sd._venergy = .5 * _sd._v0.dot( _M * _sd._v0 );
 
     // Clear all forces
     _sd._f0.clear();
 
-    // *= 0 is better than clear() here - it retains the sparsity pattern
-    // within the matrix, to avoid unnecessary reallocations after the first
-    // call to step().
-    _df_dx *= 0;
-    _df_dv *= 0;
+    // Clear all force derivatives. The sparsity pattern is retained.
+    _df_dx.clear();
+    _df_dv.clear();
+    _sd._diagnostics = _diagnostics;
     for( i = 0; i < NB_FORCES; ++i ) {
         _sd._f0i[ i ].clear();
         _sd._d0i[ i ].clear();
     }
+    // Bend energies are accumulated per edge, in preSubSteps().
+    std::fill(
+        _sd._trienergy[ F_BEND ].begin(), _sd._trienergy[ F_BEND ].end(), 0
+    );
+    calcStretchShear();
+    endPhase( PHASE_STRETCH_SHEAR, start );
+}
 
-    _stepSuccessFlag = true;
+//------------------------------------------------------------------------------
 
-    GeMesh::FaceConstIterator fi;
-    for( fi = _mesh->beginFace(); fi != _mesh->endFace(); ++fi ) {
-        calcStretchShear( *fi );
+void SimSimulator::calcStretchShear()
+{
+    AssemblyAccum acc;
+    acc.clear();
+    StretchShearTask task( *this );
+    runColoured( task, _faceColourStarts, acc );
+
+    for( UInt32 i = 0; i < NB_FORCES; ++i ) {
+        _sd._fenergy[ i ] = acc._fenergy[ i ];
     }
+    _stepSuccessFlag = acc._stepSuccess;
+    _maxStretchChange = acc._maxStretchChange;
 }
 
 //------------------------------------------------------------------------------
@@ -502,7 +878,8 @@ void SimSimulator::preSubSteps()
     DGFX_ASSERT( ! inStep() );
     if ( PRINT_STATS ) {
         std::cout << "****************************************" << std::endl;
-        std::cout << "Simulating at time " << _sd._time
+        std::cout << "Simulating at time "
+            << BaTime::instantAsSeconds( _sd._time )
             << " (h=" << _h << ")" << std::endl;
     }
 
@@ -510,6 +887,13 @@ void SimSimulator::preSubSteps()
     // this is for cases where mesh has changed substantially e.g., refinement,
     // change of stretch constant, etc. etc.
 
+    if ( ! _profiler.isNull() ) {
+        _stepStats.clear();
+        // Counters only see this thread, so they'd miss the workers' share
+        // of a multithreaded step.
+        _stepStats._hasCounters =
+            _profiler->hasCounters() && getNbThreads() == 1;
+    }
     if ( _doFinaleInPre ) {
         postSubStepsFinale();
         _doFinaleInPre = false;
@@ -517,7 +901,64 @@ void SimSimulator::preSubSteps()
     }
 
     _inStep = true;
+    _newtonIteration = 0;
+    _newtonMoved = false;
+    _newtonPCGSteps = 0;
+
+    calcRemainingForces();
+
+    _sd._energy = _sd._venergy + _sd._fenergy[ F_STRETCH ] +
+        _sd._fenergy[ F_SHEAR ] + _sd._fenergy[ F_BEND ];
+    if ( DEBUG_STEP ) {
+        for ( UInt32 i = 0; i < NB_FORCES; ++i ) {
+            const char* s[] = { "stretch","shear","bend","gravity","drag" };
+            std::cout << "f0[" << s[i] << "] = " << _sd._f0i[ i ] << std::endl;
+            std::cout << std::endl;
+            std::cout << "d0[" << s[i] << "] = " << _sd._d0i[ i ] << std::endl;
+            std::cout << std::endl;
+            std::cout << std::endl;
+        }
+        std::cout << "f0 = " << _sd._f0 << std::endl;
+        std::cout << "df_dx = " << _df_dx << std::endl;
+        std::cout << "df_dv = " << _df_dv << std::endl;
+    }
+
+    _modPCG._S = _S0;
+    _modPCG._z = _z0;
+    _modPCG._z *= _h;
+    _nbContacts = 0;
+    if ( ! _collider.isNull() ) {
+        applyContacts();
+    }
 
+    SimProfiler::Sample start;
+    startPhase( start );
+    // b = h * ( h * df_dx * v0 + f0 ), in place.
+    SimVector& b = _modPCG._b;
+    SymMatrix::multiply( b, _df_dx, _sd._v0 );
+    for ( UInt32 i = 0; i < b.size(); ++i ) {
+        b[ i ] = _h * ( _h * b[ i ] + _sd._f0[ i ] );
+    }
+
+    // Now, we're left with a system Ax=b, where x corresponds to deltav
+    
+    _modPCG._y = _sd._lastDeltaV0;
+    if ( _newtonIterations > 1 ) {
+        _newtonResidual = filteredLength( _modPCG._S, b );
+        _newtonForcing = getPCGTolerance();
+    }
+    setupSystem();
+    endPhase( PHASE_SYSTEM, start );
+    _modPCG.preStep();
+    endPhase( PHASE_PRECONDITIONER, start );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::calcRemainingForces()
+{
+    SimProfiler::Sample start;
+    startPhase( start );
     GeMesh::FaceConstIterator fi;
     for( fi = _mesh->beginFace(); fi != _mesh->endFace(); ++fi ) {
         // Calculate face normal information in preparation for bend
@@ -527,27 +968,21 @@ void SimSimulator::preSubSteps()
         _faceUnitNormals[ fi->getFaceId() ] =
             normal * -_faceNormalIMs[ fi->getFaceId() ];
     }
-    GeMeshWingedEdge::EdgeIterator ei;
-
-    for(
-        ei = _initialMeshWingedEdge->beginEdge();
-        ei != _initialMeshWingedEdge->endEdge();
-        ++ei
-    ) {
-        // Only do edges that aren't on the boundary.
-        if ( ei->hasTwin() ) {
-            calcBend( *ei );
-            if ( VERIFY_BEND ) {
-                verifyBend( *ei );
-            }
-        }
-    }
+    endPhase( PHASE_NORMALS, start );
+    // Only edges that aren't on the boundary have bend stencils.
+    AssemblyAccum acc;
+    acc.clear();
+    BendTask task( *this );
+    runColoured( task, _bendColourStarts, acc );
+    _sd._fenergy[ F_BEND ] += acc._fenergy[ F_BEND ];
 
     for( UInt32 i = 0; i < _mesh->getNbVertices(); ++i ) {
         const GeMatrix3& M = _M( i, i );
         Float gravity = -M( 2, 2 ) * _params._g;
         _sd._f0[ i ]._z += gravity;
-        DO_DEBUG( _sd._f0i[ F_GRAVITY ][ i ]._z = gravity );
+        if ( _diagnostics == DIAGNOSTICS_FULL ) {
+            _sd._f0i[ F_GRAVITY ][ i ]._z = gravity;
+        }
     }
 
     for ( fi = _mesh->beginFace(); fi != _mesh->endFace(); ++fi ) {
@@ -559,101 +994,305 @@ void SimSimulator::preSubSteps()
             Float vel( _sd._v0[ vid ].dot( normal ) );
             const GeVector force( ( -_params._k_drag * vel * area ) * normal );
             _sd._f0[ vid ] += force;
-            DO_DEBUG( _sd._f0i[ F_DRAG ][ vid ] += force );
+            if ( _diagnostics == DIAGNOSTICS_FULL ) {
+                _sd._f0i[ F_DRAG ][ vid ] += force;
+            }
             // FIXME: include df_dv component
         }
     }
+    endPhase( PHASE_BEND, start );
+}
 
-    _sd._energy = _sd._venergy + _sd._fenergy[ F_STRETCH ] +
-        _sd._fenergy[ F_SHEAR ] + _sd._fenergy[ F_BEND ];
-    if ( DEBUG_STEP ) {
-        for ( UInt32 i = 0; i < NB_FORCES; ++i ) {
-            const char* s[] = { "stretch","shear","bend","gravity","drag" };
-            std::cout << "f0[" << s[i] << "] = " << _sd._f0i[ i ] << std::endl;
-            std::cout << std::endl;
-            std::cout << "d0[" << s[i] << "] = " << _sd._d0i[ i ] << std::endl;
-            std::cout << std::endl;
-            std::cout << std::endl;
-        }
-        std::cout << "f0 = " << _sd._f0 << std::endl;
-        std::cout << "df_dx = " << _df_dx << std::endl;
-        std::cout << "df_dv = " << _df_dv << std::endl;
-    }
+//------------------------------------------------------------------------------
 
+void SimSimulator::setupSystem()
+{
     // Paper eq. (16)
-    // FIXME: do it more efficiently, without memory reallocations per-step
-    _modPCG._A = _df_dx * (-_h * _h) + _df_dv * -_h + _M;
-    _modPCG._b = _h * ( _h * _df_dx * _sd._v0 + _sd._f0 );
+    if ( isMatrixFree() ) {
+        _modPCG.setOperands( -_h * _h, _df_dx, -_h, _df_dv, _M );
+    }
+    else {
+        _modPCG._A.setCombination( -_h * _h, _df_dx, -_h, _df_dv, _M );
+    }
 
     if ( DEBUG_STEP ) {
-        std::cout << "A = " << _modPCG._A << std::endl;
+        if ( ! isMatrixFree() ) {
+            std::cout << "A = " << _modPCG._A << std::endl;
+        }
         std::cout << "b = " << _modPCG._b << std::endl;
     }
-
-    // Now, we're left with a system Ax=b, where x corresponds to deltav
-    
-    _modPCG._z = _h * _z0;
-    _modPCG._y = _sd._lastDeltaV0;
-    _modPCG.preStep();
 }
 
 //------------------------------------------------------------------------------
 
-bool SimSimulator::subStepsDone() const
+void SimSimulator::applyContacts()
 {
-    return _modPCG.done();
+    SimProfiler::Sample start;
+    startPhase( start );
+    const SimCollider& collider = *_collider;
+    const Float thickness = collider.getThickness();
+    const UInt32 N = _mesh->getNbVertices();
+    UInt32 i;
+
+    // Velocities at the end of the step are predicted explicitly from the
+    // forces. Only vertices within their predicted travel of an obstacle
+    // can reach it.
+    Float maxSpeed2 = 0;
+    for ( i = 0; i < N; ++i ) {
+        const GeVector v(
+            _sd._v0[ i ] + _sd._f0[ i ] * ( _h / _M( i, i )( 0, 0 ) )
+        );
+        maxSpeed2 = std::max( maxSpeed2, v.dot( v ) );
+    }
+    const Float margin = thickness + _h * BaMath::sqrt( maxSpeed2 );
+    collider.detect( *_mesh, margin, *_threadPool, _contactGrid, _contacts );
+
+    const GeMatrix3 identity( GeMatrix3::identity() );
+    for ( i = 0; i < N; ++i ) {
+        const SimCollider::Contact& contact = _contacts[ i ];
+        if ( contact._obstacle == SimCollider::OBSTACLE_INVALID ||
+            _S0[ i ] != identity || _z0[ i ] != GeVector::zero()
+        ) {
+            continue;
+        }
+        const GeVector& n = contact._normal;
+        const GeVector v(
+            _sd._v0[ i ] + _sd._f0[ i ] * ( _h / _M( i, i )( 0, 0 ) )
+        );
+        if ( contact._distance + _h * v.dot( n ) >= thickness ) {
+            continue;
+        }
+        // Fix the normal velocity so that the vertex ends the step at the
+        // thickness, or heads back out to it if it's already closer.
+        // Vertices moving away from the obstacle are released this way.
+        const Float gap = thickness - contact._distance;
+        const Float speed = gap / (
+            gap > 0 ? std::max( _h, CONTACT_RELAXATION_TIME ) : _h
+        );
+        _modPCG._S[ i ] = identity - GeMatrix3::outerProduct( n, n );
+        _modPCG._z[ i ] = n * ( speed - _sd._v0[ i ].dot( n ) );
+        ++_nbContacts;
+    }
+    endPhase( PHASE_COLLISION, start );
 }
 
 //------------------------------------------------------------------------------
 
-void SimSimulator::subStep()
+void SimSimulator::applySelfCollisions( const SimVector& deltaV )
 {
-    DGFX_ASSERT( inStep() );
-    _modPCG.step();
+    SimProfiler::Sample start;
+    startPhase( start );
+    const SimVector& v0 = _savedStepData._v0;
+    const UInt32 N = _mesh->getNbVertices();
+    if ( _selfDeltaV.size() != N ) {
+        _selfDeltaV = SimVector( N );
+    }
+    _inverseMasses.resize( N );
+    const GeMatrix3 identity( GeMatrix3::identity() );
+    UInt32 i;
+    for ( i = 0; i < N; ++i ) {
+        _selfDeltaV[ i ] = v0[ i ] + deltaV[ i ];
+        if ( _modPCG._S[ i ] != identity || _z0[ i ] != GeVector::zero() ) {
+            _inverseMasses[ i ] = 0;
+        }
+        else {
+            _inverseMasses[ i ] = 1 / _M( i, i )( 0, 0 );
+        }
+    }
+    _nbSelfCollisions = _selfCollider->filter(
+        _savedVertices, _h, _inverseMasses, *_threadPool, _selfDeltaV
+    );
+    for ( i = 0; i < N; ++i ) {
+        _selfDeltaV[ i ] -= v0[ i ];
+    }
+    endPhase( PHASE_SELF_COLLISION, start );
 }
 
 //------------------------------------------------------------------------------
 
-void SimSimulator::cancelStep()
+bool SimSimulator::subStepsDone() const
 {
-    DGFX_ASSERT( inStep() );
-    if ( PRINT_STATS ) {
-        std::cout << "Step cancelled" << std::endl;
-    }
-
-    _inStep = false;
-    // Force postSubStepsFinale to be done in the preSubSteps() stage
-    // next time.
-    _doFinaleInPre = true;
+    return _modPCG.done();
 }
 
 //------------------------------------------------------------------------------
 
-void SimSimulator::postSubSteps()
+void SimSimulator::subStep()
 {
-    DGFX_ASSERT( inStep() && subStepsDone() );
+    DGFX_ASSERT( inStep() );
+    const UInt32 nbSteps = _modPCG.getNbSteps();
+    SimProfiler::Sample start;
+    startPhase( start );
     _modPCG.step();
-    if ( DEBUG_STEP ) {
-        std::cout << "PCG Iterations = " << _modPCG.getNbSteps() << std::endl;
-        std::cout << "deltav = " << _modPCG.result() << std::endl;
-        std::cout << "Ax = " << _modPCG._A * _modPCG.result() << std::endl;
+    const Double seconds = endPhase( PHASE_PCG, start );
+    if ( ! _profiler.isNull() && _modPCG.getNbSteps() > nbSteps ) {
+        _stepStats._iterationTimes.push_back( Float( seconds ) );
+    }
+    if ( _modPCG.done() && _newtonIterations > 1 ) {
+        newtonStep();
     }
+}
 
-    // Save persistent data that will be destroyed by performing timestep.
-    _savedStepData = _sd;
-    std::copy(
-        _mesh->beginVertex(), _mesh->endVertex(), _savedVertices.begin()
+//------------------------------------------------------------------------------
+
+void SimSimulator::newtonStep()
+{
+    const SimVector& delta = _modPCG.result();
+    UInt32 i;
+    if ( _newtonIteration == 0 ) {
+        _newtonDeltaV = delta;
+    }
+    else {
+        for ( i = 0; i < delta.size(); ++i ) {
+            _newtonDeltaV[ i ] += delta[ i ];
+        }
+        if ( delta.length() <= _newtonTolerance * _newtonDeltaV.length() ) {
+            return;
+        }
+    }
+    if ( _newtonIteration + 1 >= _newtonIterations ) {
+        return;
+    }
+
+    // Relinearize at the new state. The start of step state is set aside
+    // as in postSubSteps().
+    SimProfiler::Sample start;
+    startPhase( start );
+    if ( ! _newtonMoved ) {
+        _sd.swap( _savedStepData );
+        _mesh->swapVertices( _savedVertices );
+        _newtonMoved = true;
+    }
+    advanceState( _newtonDeltaV );
+    endPhase( PHASE_COMMIT, start );
+    postSubStepsFinale();
+    calcRemainingForces();
+    startPhase( start );
+
+    // The residual of the implicit step, b = h * f - M * deltav. The
+    // correction solves A * x = b, as for eq. (16). M is diagonal.
+    SimVector& b = _modPCG._b;
+    for ( i = 0; i < b.size(); ++i ) {
+        b[ i ] = _h * _sd._f0[ i ] - _M( i, i ) * _newtonDeltaV[ i ];
+    }
+    const Float residual = filteredLength( _modPCG._S, b );
+    if ( _newtonIteration > 0 && residual >= _newtonResidual ) {
+        // The last correction made things worse; undo it, and stop.
+        for ( i = 0; i < delta.size(); ++i ) {
+            _newtonDeltaV[ i ] -= delta[ i ];
+        }
+        endPhase( PHASE_SYSTEM, start );
+        return;
+    }
+
+    // [EisWal96] choice 2, safeguarded against dropping too quickly.
+    const Float ratio = residual / _newtonResidual;
+    Float forcing = NEWTON_GAMMA * ratio * ratio;
+    const Float bound = NEWTON_GAMMA * _newtonForcing * _newtonForcing;
+    if ( bound > .1f ) {
+        forcing = std::max( forcing, bound );
+    }
+    forcing = std::min( forcing, NEWTON_MAX_FORCING );
+    forcing = std::max( forcing, getPCGTolerance() );
+    _newtonResidual = residual;
+    _newtonForcing = forcing;
+
+    // The constrained values have been met, so the correction must leave
+    // them alone.
+    _newtonPCGSteps += _modPCG.getNbSteps();
+    _modPCG._z.clear();
+    _modPCG._y.clear();
+    setupSystem();
+    endPhase( PHASE_SYSTEM, start );
+    _modPCG.preStep( forcing );
+    endPhase( PHASE_PRECONDITIONER, start );
+    ++_newtonIteration;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::advanceState( const SimVector& deltaV )
+{
+    GeMesh::VertexIterator vi;
+    UInt32 i;
+    for ( vi = _mesh->beginVertex(), i = 0; vi != _mesh->endVertex();
+        ++vi, ++i
+    ) {
+        _sd._v0[ i ] = _savedStepData._v0[ i ] + deltaV[ i ];
+        *vi = _savedVertices[ i ] + _h * _sd._v0[ i ];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::cancelStep()
+{
+    DGFX_ASSERT( inStep() );
+    if ( PRINT_STATS ) {
+        std::cout << "Step cancelled" << std::endl;
+    }
+    SimProfiler::Sample start;
+    startPhase( start );
+    if ( _newtonMoved ) {
+        _sd.swap( _savedStepData );
+        _mesh->swapVertices( _savedVertices );
+        _newtonMoved = false;
+    }
+    endPhase( PHASE_COMMIT, start );
+
+    _inStep = false;
+    // Force postSubStepsFinale to be done in the preSubSteps() stage
+    // next time.
+    _doFinaleInPre = true;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::postSubSteps()
+{
+    DGFX_ASSERT( inStep() && subStepsDone() );
+    SimProfiler::Sample start;
+    startPhase( start );
+    _modPCG.step();
+    endPhase( PHASE_PCG, start );
+    if ( DEBUG_STEP ) {
+        std::cout << "PCG Iterations = " << _modPCG.getNbSteps() << std::endl;
+        std::cout << "deltav = " << _modPCG.result() << std::endl;
+        SimVector Ax;
+        _modPCG.multiplyA( Ax, _modPCG.result() );
+        std::cout << "Ax = " << Ax << std::endl;
+    }
+
+    _diagnosticsCacheValid = false;
+
+    // Write the new state into the spare buffers, leaving the current
+    // state intact in _savedStepData and _savedVertices. Everything not set
+    // here is recomputed by postSubStepsFinale(). newtonStep() may have
+    // done so already.
+    if ( ! _newtonMoved ) {
+        _sd.swap( _savedStepData );
+        _mesh->swapVertices( _savedVertices );
+    }
+    _newtonMoved = false;
+    const StepData& old = _savedStepData;
+    const SimVector& deltaV = (
+        _newtonIterations > 1 ? _newtonDeltaV : _modPCG.result()
     );
 
     // Update data: this is the actual effect of the timestep.
-    _sd._lastDeltaV0 = _modPCG.result();
-    _sd._v0 += _modPCG.result();
-    GeMesh::VertexIterator vi;
-    UInt32 i = 0;
-    for ( vi = _mesh->beginVertex(), i; vi != _mesh->endVertex(); ++vi, ++i ) {
-        (*vi) += _h * _sd._v0[ i ];
+    _sd._time = old._time + _timestep;
+    _sd._energy = old._energy;
+    _sd._lastDeltaV0 = deltaV;
+    if ( _selfCollider.isNull() ) {
+        advanceState( deltaV );
+    }
+    else {
+        endPhase( PHASE_COMMIT, start );
+        applySelfCollisions( deltaV );
+        startPhase( start );
+        advanceState( _selfDeltaV );
     }
-    _sd._time += _h;
+    endPhase( PHASE_COMMIT, start );
 
     // Calculate next step's stretch/shear.
     postSubStepsFinale();
@@ -664,17 +1303,19 @@ void SimSimulator::postSubSteps()
         if ( PRINT_STATS ) {
             std::cout << "Step failed" << std::endl;
         }
-        // Revert to old data
-        _sd = _savedStepData;
-        std::copy(
-            _savedVertices.begin(), _savedVertices.end(), _mesh->beginVertex ()
-        );
+        // Revert to old data, discarding the new.
+        startPhase( start );
+        _sd.swap( _savedStepData );
+        _mesh->swapVertices( _savedVertices );
+        endPhase( PHASE_COMMIT, start );
+        _stepRolledBack = true;
 
         // Force postSubStepsFinale to be done in the preSubSteps() stage
         // next time.
         _doFinaleInPre = true;
         return;
     }
+    _stepRolledBack = false;
 
     if ( PRINT_STATS ) {
         std::cout.precision( 4 );
@@ -689,6 +1330,9 @@ void SimSimulator::postSubSteps()
             << " / bend: " << _sd._fenergy[ F_BEND ]
             //<< " / kinetic: " << _venergy
             << ")" << std::resetiosflags( std::ios::fixed ) << std::endl;
+        std::cout << "PCG iterations: " << _modPCG.getNbSteps()
+            << " (preconditioner: " << _modPCG.getPreconditionerTime()
+            << "s)" << std::endl;
         std::cout << std::endl;
     }
 
@@ -752,6 +1396,13 @@ bool SimSimulator::stepSucceeded() const
 
 //------------------------------------------------------------------------------
 
+Float SimSimulator::getMaxStretchChange() const
+{
+    return _maxStretchChange;
+}
+
+//------------------------------------------------------------------------------
+
 const GeMesh& SimSimulator::getMesh() const
 {
     return *_mesh;
@@ -766,9 +1417,68 @@ const RCShdPtr<GeMesh>& SimSimulator::getMeshPtr() const
 
 //------------------------------------------------------------------------------
 
+const GeMesh& SimSimulator::getInitialMesh() const
+{
+    return *_initialMesh;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::copyState( const SimSimulator& src )
+{
+    DGFX_ASSERT( ! inStep() && ! src.inStep() );
+    DGFX_ASSERT( src._mesh->getNbVertices() == _mesh->getNbVertices() );
+    DGFX_ASSERT( src._mesh->getNbFaces() == _mesh->getNbFaces() );
+
+    // Configuration. The setters rebuild what depends upon it, so only
+    // call them on a change.
+    _params = src._params;
+    if ( _rho != src._rho ) {
+        setDensity( src._rho );
+    }
+    _timestep = src._timestep;
+    _h = src._h;
+    _S0 = src._S0;
+    _z0 = src._z0;
+    _collider = src._collider;
+    setSelfCollisionThickness( src.getSelfCollisionThickness() );
+    _stretchLimit = src._stretchLimit;
+    setPCGTolerance( src.getPCGTolerance() );
+    if ( isMatrixFree() != src.isMatrixFree() ) {
+        setMatrixFree( src.isMatrixFree() );
+    }
+    if ( getPreconditioner() != src.getPreconditioner() ) {
+        setPreconditioner( src.getPreconditioner() );
+    }
+    setMixedPrecision( src.isMixedPrecision() );
+    if ( _diagnostics != src._diagnostics ) {
+        setDiagnostics( src._diagnostics );
+    }
+    _newtonIterations = src._newtonIterations;
+    _newtonTolerance = src._newtonTolerance;
+
+    // State. The force derivatives for the next step belong to the other
+    // simulator's matrix pattern, so reassemble them rather than copy.
+    std::copy(
+        src._mesh->beginVertex(), src._mesh->endVertex(), _mesh->beginVertex()
+    );
+    _sd = src._sd;
+    _savedVertices = src._savedVertices;
+    _savedStepData = src._savedStepData;
+    _stepRolledBack = src._stepRolledBack;
+    _stepSuccessFlag = src._stepSuccessFlag;
+    _maxStretchChange = src._maxStretchChange;
+    _nbContacts = src._nbContacts;
+    _nbSelfCollisions = src._nbSelfCollisions;
+    _diagnosticsCacheValid = false;
+    _doFinaleInPre = true;
+}
+
+//------------------------------------------------------------------------------
+
 BaTime::Instant SimSimulator::getTime() const
 {
-    return BaTime::floatAsInstant( _sd._time );
+    return _sd._time;
 }
 
 //------------------------------------------------------------------------------
@@ -776,6 +1486,8 @@ BaTime::Instant SimSimulator::getTime() const
 void SimSimulator::setTimestep( BaTime::Duration h )
 {
     DGFX_ASSERT( ! inStep() );
+    DGFX_ASSERT( h > 0 );
+    _timestep = h;
     _h = BaTime::durationAsSeconds( h );
 }
 
@@ -806,17 +1518,161 @@ void SimSimulator::setStretchLimit( Float stretchLimit )
 
 //------------------------------------------------------------------------------
 
+void SimSimulator::setMatrixFree( bool matrixFree )
+{
+    DGFX_ASSERT( ! inStep() );
+    if ( matrixFree ) {
+        _modPCG.setOperatorMode( ModPCGSolver::OPERATOR_MATRIX_FREE );
+        // Release the assembled matrix; it won't be used.
+        _modPCG._A = SymMatrix();
+    }
+    else {
+        _modPCG.setOperatorMode( ModPCGSolver::OPERATOR_ASSEMBLED );
+        _modPCG._A = SymMatrix( _pattern );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setNbThreads( UInt32 nbThreads )
+{
+    DGFX_ASSERT( ! inStep() );
+    DGFX_ASSERT( nbThreads > 0 );
+    if ( nbThreads != getNbThreads() ) {
+        _threadPool = RCShdPtr<SimThreadPool>( new SimThreadPool( nbThreads ) );
+        _modPCG.setThreadPool( _threadPool );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setPreconditioner( Preconditioner preconditioner )
+{
+    DGFX_ASSERT( ! inStep() );
+    // The hierarchy depends only upon the mesh, so build it once, when
+    // first needed.
+    if ( preconditioner == PRECONDITIONER_MULTIGRID &&
+        _modPCG.getMultigrid().isNull()
+    ) {
+        _modPCG.setMultigrid( RCShdPtr<SimMultigrid>(
+            new SimMultigrid( *_initialMesh, _pattern )
+        ) );
+    }
+    // Likewise the ordering and symbolic factorization.
+    if ( preconditioner == PRECONDITIONER_LDLT &&
+        _modPCG.getFactorization().isNull()
+    ) {
+        _modPCG.setFactorization( RCShdPtr<SimSparseLDLT>(
+            new SimSparseLDLT( _pattern )
+        ) );
+    }
+    _modPCG.setPreconditioner( preconditioner );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setMixedPrecision( bool mixedPrecision )
+{
+    DGFX_ASSERT( ! inStep() );
+    _modPCG.setMixedPrecision( mixedPrecision );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setProfiling( bool profiling )
+{
+    DGFX_ASSERT( ! inStep() );
+    if ( ! profiling ) {
+        _profiler = RCShdPtr<SimProfiler>();
+    }
+    else if ( _profiler.isNull() ) {
+        _profiler = RCShdPtr<SimProfiler>( new SimProfiler );
+    }
+    _stepStats.clear();
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setDiagnostics( Diagnostics diagnostics )
+{
+    DGFX_ASSERT( ! inStep() );
+    DGFX_ASSERT( diagnostics < NB_DIAGNOSTICS );
+    const Diagnostics savedLevel = _savedStepData._diagnostics;
+    const Diagnostics level = _sd._diagnostics;
+    const bool raised = diagnostics > _diagnostics;
+    _diagnostics = diagnostics;
+    setupDiagnostics( _sd );
+    setupDiagnostics( _savedStepData );
+    // Breakdowns that were never assembled can't be reported.
+    _savedStepData._diagnostics = std::min( savedLevel, diagnostics );
+    _sd._diagnostics = std::min( level, diagnostics );
+    if ( raised ) {
+        // The next step's stretch/shear breakdowns, assembled by
+        // postSubStepsFinale(), were dropped; redo them.
+        _doFinaleInPre = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setNewtonIterations( UInt32 newtonIterations )
+{
+    DGFX_ASSERT( ! inStep() );
+    DGFX_ASSERT( newtonIterations > 0 );
+    _newtonIterations = newtonIterations;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setNewtonTolerance( Float newtonTolerance )
+{
+    DGFX_ASSERT( ! inStep() );
+    _newtonTolerance = newtonTolerance;
+}
+
+//------------------------------------------------------------------------------
+
 void SimSimulator::setParams( const Params& params )
 {
     DGFX_ASSERT( ! inStep() );
     _params = params;
+    _diagnosticsCacheValid = false;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setCollider( const RCShdPtr<SimCollider>& collider )
+{
+    DGFX_ASSERT( ! inStep() );
+    _collider = collider;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::setSelfCollisionThickness( Float thickness )
+{
+    DGFX_ASSERT( ! inStep() );
+    DGFX_ASSERT( thickness >= 0 );
+    if ( thickness == 0 ) {
+        _selfCollider = RCShdPtr<SimSelfCollider>();
+        _nbSelfCollisions = 0;
+        return;
+    }
+    // The hierarchy depends only upon the topology, so it's kept for the
+    // lifetime of the simulator once built.
+    if ( _selfCollider.isNull() ) {
+        _selfCollider = RCShdPtr<SimSelfCollider>(
+            new SimSelfCollider( *_initialMeshWingedEdge )
+        );
+    }
+    _selfCollider->setThickness( thickness );
 }
 
 //------------------------------------------------------------------------------
 
 BaTime::Duration SimSimulator::getTimestep() const
 {
-    return BaTime::floatAsDuration( _h );
+    return _timestep;
 }
 
 //------------------------------------------------------------------------------
@@ -828,6 +1684,118 @@ Float SimSimulator::getDensity() const
 
 //------------------------------------------------------------------------------
 
+bool SimSimulator::isMatrixFree() const
+{
+    return _modPCG.getOperatorMode() == ModPCGSolver::OPERATOR_MATRIX_FREE;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSimulator::getNbThreads() const
+{
+    return _threadPool->getNbThreads();
+}
+
+//------------------------------------------------------------------------------
+
+SimSimulator::Preconditioner SimSimulator::getPreconditioner() const
+{
+    return _modPCG.getPreconditioner();
+}
+
+//------------------------------------------------------------------------------
+
+bool SimSimulator::isMixedPrecision() const
+{
+    return _modPCG.isMixedPrecision();
+}
+
+//------------------------------------------------------------------------------
+
+bool SimSimulator::isProfiling() const
+{
+    return ! _profiler.isNull();
+}
+
+//------------------------------------------------------------------------------
+
+SimSimulator::Diagnostics SimSimulator::getDiagnostics() const
+{
+    return _diagnostics;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSimulator::getNewtonIterations() const
+{
+    return _newtonIterations;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimSimulator::getNewtonTolerance() const
+{
+    return _newtonTolerance;
+}
+
+//------------------------------------------------------------------------------
+
+const RCShdPtr<SimCollider>& SimSimulator::getCollider() const
+{
+    return _collider;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimSimulator::getSelfCollisionThickness() const
+{
+    return _selfCollider.isNull() ? 0 : _selfCollider->getThickness();
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSimulator::getNbContacts() const
+{
+    return _nbContacts;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSimulator::getNbSelfCollisions() const
+{
+    return _nbSelfCollisions;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSimulator::getNbPCGIterations() const
+{
+    return _newtonPCGSteps + _modPCG.getNbSteps();
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSimulator::getNbNewtonIterations() const
+{
+    return _newtonIteration + 1;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimSimulator::getPreconditionerTime() const
+{
+    return _modPCG.getPreconditionerTime();
+}
+
+//------------------------------------------------------------------------------
+
+const SimSimulator::StepStats& SimSimulator::getStepStats() const
+{
+    return _stepStats;
+}
+
+//------------------------------------------------------------------------------
+
 Float SimSimulator::getPCGTolerance() const
 {
     return _modPCG.getTolerance();
@@ -851,7 +1819,7 @@ const SimSimulator::Params& SimSimulator::getParams() const
 
 GeVector SimSimulator::getVelocity( GeMesh::VertexId vid ) const
 {
-    DGFX_ASSERT( vid < _savedStepData._v0.size() );
+    DGFX_ASSERT( vid < _sd._v0.size() );
     return _sd._v0[ vid ];
 }
 
@@ -859,8 +1827,8 @@ GeVector SimSimulator::getVelocity( GeMesh::VertexId vid ) const
 
 GeVector SimSimulator::getForce( GeMesh::VertexId vid ) const
 {
-    DGFX_ASSERT( vid < _savedStepData._f0.size() );
-    return _savedStepData._f0[ vid ];
+    DGFX_ASSERT( vid < getReportedStepData()._f0.size() );
+    return getReportedStepData()._f0[ vid ];
 }
 
 //------------------------------------------------------------------------------
@@ -868,8 +1836,9 @@ GeVector SimSimulator::getForce( GeMesh::VertexId vid ) const
 GeVector SimSimulator::getForce( ForceType type, GeMesh::VertexId vid ) const
 {
     DGFX_ASSERT( type < NB_FORCES );
-    DGFX_ASSERT( vid < _savedStepData._f0i[ type ].size() );
-    return _savedStepData._f0i[ type ][ vid ];
+    const StepData& sd = getReportedStepData( DIAGNOSTICS_FULL );
+    DGFX_ASSERT( vid < sd._f0i[ type ].size() );
+    return sd._f0i[ type ][ vid ];
 }
 
 //------------------------------------------------------------------------------
@@ -879,8 +1848,13 @@ GeVector SimSimulator::getDampingForce(
     GeMesh::VertexId vid
 ) const {
     DGFX_ASSERT( type < NB_FORCES );
-    DGFX_ASSERT( vid < _savedStepData._d0i[ type ].size() );
-    return _savedStepData._d0i[ type ][ vid ];
+    if ( type >= F_GRAVITY ) {
+        // Gravity and drag have no damping component.
+        return GeVector::zero();
+    }
+    const StepData& sd = getReportedStepData( DIAGNOSTICS_FULL );
+    DGFX_ASSERT( vid < sd._d0i[ type ].size() );
+    return sd._d0i[ type ][ vid ];
 }
 
 //------------------------------------------------------------------------------
@@ -888,7 +1862,7 @@ GeVector SimSimulator::getDampingForce(
 Float SimSimulator::getEnergy( ForceType type ) const
 {
     DGFX_ASSERT( type < NB_FORCES );
-    return _savedStepData._fenergy[ type ];
+    return getReportedStepData()._fenergy[ type ];
 }
 
 //------------------------------------------------------------------------------
@@ -896,8 +1870,9 @@ Float SimSimulator::getEnergy( ForceType type ) const
 Float SimSimulator::getTriEnergy( ForceType type, GeMesh::FaceId fid ) const
 {
     DGFX_ASSERT( type < F_GRAVITY );
-    DGFX_ASSERT( fid < _savedStepData._trienergy[ type ].size() );
-    return _savedStepData._trienergy[ type ][ fid ];
+    const StepData& sd = getReportedStepData( DIAGNOSTICS_ENERGIES );
+    DGFX_ASSERT( fid < sd._trienergy[ type ].size() );
+    return sd._trienergy[ type ][ fid ];
 }
 
 //------------------------------------------------------------------------------
@@ -910,14 +1885,73 @@ void SimSimulator::setMesh( const GeMesh& mesh )
     _mesh = RCShdPtr<GeMesh>( new GeMesh( mesh ) );
 }
 
+//------------------------------------------------------------------------------
+
+void SimSimulator::runKernel( Kernel kernel )
+{
+    DGFX_ASSERT( inStep() );
+    switch ( kernel ) {
+        case KERNEL_STRETCH_SHEAR: {
+            calcStretchShear();
+        } break;
+        case KERNEL_BEND: {
+            calcRemainingForces();
+        } break;
+        case KERNEL_PCG_SETUP: {
+            _modPCG.preStep();
+        } break;
+        case KERNEL_PCG_SOLVE: {
+            _modPCG.preStep();
+            while ( ! _modPCG.done() ) {
+                _modPCG.step();
+            }
+        } break;
+        default: {
+            DGFX_ASSERT( false );
+        } break;
+    }
+}
+
 
 
 //------------------------------------------------------------------------------
 
-void SimSimulator::calcFaceConsts()
+void SimSimulator::startPhase( SimProfiler::Sample& start ) const
 {
-    _faceConsts.resize( _initialMesh->getNbFaces() );
-    GeMesh::FaceConstIterator fi;
+    if ( ! _profiler.isNull() ) {
+        _profiler->sample( start );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+Double SimSimulator::endPhase( Phase phase, SimProfiler::Sample& start )
+{
+    if ( _profiler.isNull() ) {
+        return 0;
+    }
+    SimProfiler::Sample end;
+    _profiler->sample( end );
+    const Double seconds = BaTime::durationAsSeconds(
+        BaTime::getDuration( start._time, end._time )
+    );
+    _stepStats._time[ phase ] += seconds;
+    if ( _stepStats._hasCounters ) {
+        for ( UInt32 i = 0; i < SimProfiler::NB_COUNTERS; ++i ) {
+            _stepStats._counts[ phase ][ i ] +=
+                end._counts[ i ] - start._counts[ i ];
+        }
+    }
+    start = end;
+    return seconds;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::calcFaceConsts()
+{
+    _faceConsts.resize( _initialMesh->getNbFaces() );
+    GeMesh::FaceConstIterator fi;
     for( fi = _initialMesh->beginFace(); fi != _initialMesh->endFace(); ++fi ) {
         GeMesh::TextureVertexType tp[3];
         for( UInt32 m = 0; m < 3; ++m ) {
@@ -929,8 +1963,108 @@ void SimSimulator::calcFaceConsts()
 
 //------------------------------------------------------------------------------
 
+void SimSimulator::setupAssembly()
+{
+    const SimMatrixPattern& pattern = *_pattern;
+    UInt32 m, n;
+
+    // Vertices touched by each face and each bend stencil, for colouring.
+    std::vector<UInt32> faceVids, bendVids;
+
+    _faceStencils.resize( _initialMesh->getNbFaces() );
+    faceVids.resize( _initialMesh->getNbFaces() * 3 );
+    GeMesh::FaceConstIterator fi;
+    for( fi = _initialMesh->beginFace(); fi != _initialMesh->endFace(); ++fi ) {
+        for ( m = 0; m < 3; ++m ) {
+            faceVids[ fi->getFaceId() * 3 + m ] = fi->getVertexId( m );
+        }
+        FaceStencil& fs = _faceStencils[ fi->getFaceId() ];
+        for ( m = 0; m < 3; ++m ) for ( n = 0; n < 3; ++n ) {
+            // Blocks below the diagonal aren't stored, and get an invalid
+            // slot.
+            fs._slots[ m ][ n ] = pattern.findSlot(
+                fi->getVertexId( n ), fi->getVertexId( m )
+            );
+            DGFX_ASSERT(
+                fs._slots[ m ][ n ] != SimMatrixPattern::SLOT_INVALID ||
+                fi->getVertexId( n ) > fi->getVertexId( m )
+            );
+        }
+    }
+
+    std::vector<BendStencil> bendStencils;
+    GeMeshWingedEdge::EdgeIterator ei;
+    for(
+        ei = _initialMeshWingedEdge->beginEdge();
+        ei != _initialMeshWingedEdge->endEdge();
+        ++ei
+    ) {
+        if ( ! ei->hasTwin() ) {
+            continue;
+        }
+        // Same vertex ordering as calcBend().
+        GeMesh::VertexId vid[ 4 ];
+        vid[ 0 ] = ei->getPrevHalfEdge().getOriginVertexId();
+        vid[ 1 ] = ei->getOriginVertexId();
+        vid[ 2 ] = ei->getNextHalfEdge().getOriginVertexId();
+        vid[ 3 ] =
+            ei->getTwinHalfEdge().getPrevHalfEdge().getOriginVertexId();
+
+        BendStencil bs;
+        bs._halfEdgeId = ei->getHalfEdgeId();
+        for ( m = 0; m < 4; ++m ) for ( n = 0; n < 4; ++n ) {
+            bs._slots[ m ][ n ] = pattern.findSlot( vid[ n ], vid[ m ] );
+            DGFX_ASSERT(
+                bs._slots[ m ][ n ] != SimMatrixPattern::SLOT_INVALID ||
+                vid[ n ] > vid[ m ]
+            );
+        }
+        bendStencils.push_back( bs );
+        bendVids.insert( bendVids.end(), vid, vid + 4 );
+    }
+
+    // Faces and bend stencils are processed a colour at a time, so that
+    // concurrent scatters into f0 and the Jacobians never touch the same
+    // vertex. Bend energy is also spread to the edge's two faces, which
+    // consist of the stencil's own vertices.
+    const UInt32 N = _initialMesh->getNbVertices();
+    colourElements( faceVids, 3, N, _faceOrder, _faceColourStarts );
+
+    std::vector<UInt32> bendOrder;
+    colourElements( bendVids, 4, N, bendOrder, _bendColourStarts );
+    _bendStencils.resize( bendStencils.size() );
+    for ( m = 0; m < bendOrder.size(); ++m ) {
+        _bendStencils[ m ] = bendStencils[ bendOrder[ m ] ];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::runColoured(
+    ColourTask& task,
+    const std::vector<UInt32>& colourStarts,
+    AssemblyAccum& acc
+) {
+    const UInt32 nbThreads = getNbThreads();
+    _threadAccums.resize( nbThreads );
+    UInt32 i;
+    for ( i = 0; i < nbThreads; ++i ) {
+        _threadAccums[ i ].clear();
+    }
+    for ( UInt32 c = 0; c + 1 < colourStarts.size(); ++c ) {
+        task._colourBegin = colourStarts[ c ];
+        _threadPool->run( task, colourStarts[ c + 1 ] - colourStarts[ c ] );
+    }
+    for ( i = 0; i < nbThreads; ++i ) {
+        acc += _threadAccums[ i ];
+    }
+}
+
+//------------------------------------------------------------------------------
+
 void SimSimulator::calcStretchShear(
-    const GeMesh::FaceWrapper& face
+    const GeMesh::FaceWrapper& face,
+    AssemblyAccum& acc
 ) {
     UInt32 m;
 
@@ -954,24 +2088,26 @@ void SimSimulator::calcStretchShear(
         cv.debugOutput( std::cout );
     }
 
-    calcStretch( face, fc, cv, v0 );
+    calcStretch( face, fc, cv, v0, acc );
     if ( VERIFY_STRETCH ) {
         verifyStretch( fc, cv, x, v0 );
     }
 
     // FIXME: keep individual Cu/Cv terms per-triangle. Maybe.
-    if (
+    const Float stretchChange = std::max(
         BaMath::abs(
             _savedStepData._Cu[ face.getFaceId() ] - _sd._Cu[ face.getFaceId() ]
-        ) > _stretchLimit ||
+        ),
         BaMath::abs(
             _savedStepData._Cv[ face.getFaceId() ] - _sd._Cv[ face.getFaceId() ]
-        ) > _stretchLimit
-    ) {
-        _stepSuccessFlag = false;
+        )
+    );
+    if ( stretchChange > _stretchLimit ) {
+        acc._stepSuccess = false;
     }
+    acc._maxStretchChange = std::max( acc._maxStretchChange, stretchChange );
 
-    calcShear( face, fc, cv, v0 );
+    calcShear( face, fc, cv, v0, acc );
     if ( VERIFY_SHEAR ) {
         verifyShear( fc, cv, x, v0 );
     }
@@ -987,7 +2123,8 @@ void SimSimulator::calcStretch(
     const GeMesh::FaceWrapper& face,
     const FaceConsts& fc,
     const CommonVars& cv,
-    const GeVector v0[ 3 ]
+    const GeVector v0[ 3 ],
+    AssemblyAccum& acc
 ) {
     UInt32 m,n;
 
@@ -1007,7 +2144,9 @@ void SimSimulator::calcStretch(
             stv._dCu_dxm[ m ] * stv._Cu + stv._dCv_dxm[ m ] * stv._Cv
         );
         _sd._f0[ vid ] += val;
-        DO_DEBUG( _sd._f0i[ F_STRETCH ][ vid ] += val );
+        if ( _diagnostics == DIAGNOSTICS_FULL ) {
+            _sd._f0i[ F_STRETCH ][ vid ] += val;
+        }
         if ( DEBUG_STRETCH ) {
             std::cout << "f0[stretch][ " << m << " ] = " << val << std::endl;
         }
@@ -1018,14 +2157,19 @@ void SimSimulator::calcStretch(
         );
         _sd._f0[ vid ] += val;
 
-        DO_DEBUG( _sd._d0i[ F_STRETCH ][ vid ] += val );
+        if ( _diagnostics == DIAGNOSTICS_FULL ) {
+            _sd._d0i[ F_STRETCH ][ vid ] += val;
+        }
         if ( DEBUG_STRETCH ) {
             std::cout << "d0[stretch][ " << m << " ] = " << val << std::endl;
         }
     }
+    const FaceStencil& fs = _faceStencils[ face.getFaceId() ];
     for ( m = 0; m < 3; ++m ) for ( n = 0; n < 3; ++n ) {
-        UInt32 vidm = face.getVertexId( m );
-        UInt32 vidn = face.getVertexId( n );
+        // Only the upper triangle is stored.
+        if ( fs._slots[ m ][ n ] == SimMatrixPattern::SLOT_INVALID ) {
+            continue;
+        }
         GeMatrix3 val;
 
         // As per [BarWit98] eq. (8)
@@ -1035,7 +2179,7 @@ void SimSimulator::calcStretch(
             + stv._d2Cu_dxmdxn[ m ][ n ] * stv._Cu
             + stv._d2Cv_dxmdxn[ m ][ n ] * stv._Cv
         );
-        _df_dx[ vidn ][ vidm ] += val;
+        _df_dx.getBlock( fs._slots[ m ][ n ] ) += val;
         if ( DEBUG_STRETCH ) {
             std::cout << "df_dx[stretch][ " << m << " ][ " << n << " ] = "
                 << val << std::endl;
@@ -1045,7 +2189,7 @@ void SimSimulator::calcStretch(
             stv._d2Cu_dxmdxn[ m ][ n ] * stv._dCu_dt
             + stv._d2Cv_dxmdxn[ m ][ n ] * stv._dCv_dt
         );
-        _df_dx[ vidn ][ vidm ] += val;
+        _df_dx.getBlock( fs._slots[ m ][ n ] ) += val;
         if ( DEBUG_STRETCH ) {
             std::cout << "dd_dx[stretch][ " << m << " ][ " << n << " ] = "
                 << val << std::endl;
@@ -1055,7 +2199,7 @@ void SimSimulator::calcStretch(
             GeMatrix3::outerProduct( stv._dCu_dxm[m], stv._dCu_dxm[n] )
             + GeMatrix3::outerProduct( stv._dCv_dxm[m], stv._dCv_dxm[n] )
         );
-        _df_dv[ vidn ][ vidm ] += val;
+        _df_dv.getBlock( fs._slots[ m ][ n ] ) += val;
         if ( DEBUG_STRETCH ) {
             std::cout << "dd_dv[stretch][ " << m << " ][ " << n << " ] = "
                 << val << std::endl;
@@ -1064,10 +2208,12 @@ void SimSimulator::calcStretch(
 
     Float E =
         _params._k_stretch * .5 * ( stv._Cu * stv._Cu + stv._Cv * stv._Cv );
-    _sd._trienergy[ F_STRETCH ][ face.getFaceId() ] = E;
+    if ( _diagnostics != DIAGNOSTICS_NONE ) {
+        _sd._trienergy[ F_STRETCH ][ face.getFaceId() ] = E;
+    }
     _sd._Cu[ face.getFaceId() ] = stv._Cu / fc._alpha;
     _sd._Cv[ face.getFaceId() ] = stv._Cv / fc._alpha;
-    _sd._fenergy[ F_STRETCH ] += E;
+    acc._fenergy[ F_STRETCH ] += E;
 
     if ( DEBUG_STRETCH ) {
         std::cout << std::endl;
@@ -1080,7 +2226,8 @@ void SimSimulator::calcShear(
     const GeMesh::FaceWrapper& face,
     const FaceConsts& fc,
     const CommonVars& cv,
-    const GeVector v0[ 3 ]
+    const GeVector v0[ 3 ],
+    AssemblyAccum& acc
 ) {
     UInt32 m,n;
 
@@ -1097,7 +2244,9 @@ void SimSimulator::calcShear(
 
         val = -_params._k_shear * shv._dC_dxm[ m ] * shv._C;
         _sd._f0[ vid ] += val;
-        DO_DEBUG( _sd._f0i[ F_SHEAR ][ vid ] += val );
+        if ( _diagnostics == DIAGNOSTICS_FULL ) {
+            _sd._f0i[ F_SHEAR ][ vid ] += val;
+        }
         if ( DEBUG_SHEAR ) {
             std::cout << "f0[shear][ " << m << " ] = " << val << std::endl;
         }
@@ -1106,20 +2255,25 @@ void SimSimulator::calcShear(
             * shv._dC_dxm[ m ] * shv._dC_dt;
         _sd._f0[ vid ] += val;
 
-        DO_DEBUG( _sd._d0i[ F_SHEAR ][ vid ] += val );
+        if ( _diagnostics == DIAGNOSTICS_FULL ) {
+            _sd._d0i[ F_SHEAR ][ vid ] += val;
+        }
         if ( DEBUG_SHEAR ) {
             std::cout << "d0[shear][ " << m << " ] = " << val << std::endl;
         }
     }
+    const FaceStencil& fs = _faceStencils[ face.getFaceId() ];
     for ( m = 0; m < 3; ++m ) for ( n = 0; n < 3; ++n ) {
-        UInt32 vidm = face.getVertexId( m );
-        UInt32 vidn = face.getVertexId( n );
+        // Only the upper triangle is stored.
+        if ( fs._slots[ m ][ n ] == SimMatrixPattern::SLOT_INVALID ) {
+            continue;
+        }
         GeMatrix3 val;
         val = -_params._k_shear * (
             GeMatrix3::outerProduct( shv._dC_dxm[ m ], shv._dC_dxm[ n ] )
             + ( shv._d2C_dxmdxn[ m ][ n ] * shv._C ) * GeMatrix3::identity()
         );
-        _df_dx[ vidn ][ vidm ] += val;
+        _df_dx.getBlock( fs._slots[ m ][ n ] ) += val;
         if ( DEBUG_SHEAR ) {
             std::cout << "df_dx[shear][ " << m << " ][ " << n << " ] = "
                 << val << std::endl;
@@ -1127,7 +2281,7 @@ void SimSimulator::calcShear(
 
         val = GeMatrix3::identity() * ( -_params._k_shear_damp
             * shv._d2C_dxmdxn[ m ][ n ] * shv._dC_dt );
-        _df_dx[ vidn ][ vidm ] += val;
+        _df_dx.getBlock( fs._slots[ m ][ n ] ) += val;
         if ( DEBUG_SHEAR ) {
             std::cout << "dd_dx[shear][ " << m << " ][ " << n << " ] = "
                 << val << std::endl;
@@ -1135,7 +2289,7 @@ void SimSimulator::calcShear(
 
         val = -_params._k_shear_damp
             * GeMatrix3::outerProduct( shv._dC_dxm[ m ], shv._dC_dxm[ n ] );
-        _df_dv[ vidn ][ vidm ] += val;
+        _df_dv.getBlock( fs._slots[ m ][ n ] ) += val;
 
         if ( DEBUG_SHEAR ) {
             std::cout << "dd_dv[shear][ " << m << " ][ " << n << " ] = "
@@ -1144,8 +2298,10 @@ void SimSimulator::calcShear(
     }
 
     Float E = _params._k_shear * .5 * shv._C * shv._C;
-    _sd._trienergy[ F_SHEAR ][ face.getFaceId() ] = E;
-    _sd._fenergy[ F_SHEAR ] += E;
+    if ( _diagnostics != DIAGNOSTICS_NONE ) {
+        _sd._trienergy[ F_SHEAR ][ face.getFaceId() ] = E;
+    }
+    acc._fenergy[ F_SHEAR ] += E;
 
     if ( DEBUG_SHEAR ) {
         std::cout << std::endl;
@@ -1154,16 +2310,21 @@ void SimSimulator::calcShear(
 
 //------------------------------------------------------------------------------
 
-void SimSimulator::calcBend(
-    const GeMeshWingedEdge::HalfEdgeWrapper& edge
-) {
-    UInt32 m, n;
+Float SimSimulator::calcBendVars(
+    const GeMeshWingedEdge::HalfEdgeWrapper& edge,
+    const GeMesh& mesh,
+    const SimVector& v0,
+    const std::vector<GeVector>& unitNormals,
+    const std::vector<Float>& normalIMs,
+    GeMesh::VertexId vid[ 4 ],
+    BendVars& bv
+) const {
+    UInt32 m;
 
     GeMeshWingedEdge::HalfEdgeWrapper he_next( edge.getNextHalfEdge() );
     GeMeshWingedEdge::HalfEdgeWrapper he_prev( edge.getPrevHalfEdge() );
     GeMeshWingedEdge::HalfEdgeWrapper he_twin( edge.getTwinHalfEdge() );
 
-    GeMesh::VertexId vid[ 4 ];
     vid[ 0 ] = he_prev.getOriginVertexId();
     vid[ 1 ] = edge.getOriginVertexId();
     vid[ 2 ] = he_next.getOriginVertexId();
@@ -1172,9 +2333,9 @@ void SimSimulator::calcBend(
     GeMesh::TextureVertexType tv[ 4 ];
     GeVector v[ 4 ];
     for( m = 0; m < 4; ++m ) {
-        x[ m ] = _mesh->getVertex( vid[ m ] );
+        x[ m ] = mesh.getVertex( vid[ m ] );
         tv[ m ] = _initialMesh->getTextureVertex( vid[ m ] );
-        v[ m ] = _sd._v0[ vid[ m ] ];
+        v[ m ] = v0[ vid[ m ] ];
     }
 
     const Float du = tv[ 1 ]._x - tv[ 2 ]._x;
@@ -1183,13 +2344,12 @@ void SimSimulator::calcBend(
         _params._k_bend_u * du*du + _params._k_bend_v * dv*dv ) /
         (du*du + dv*dv);
 
-    BendVars bv;
     GeMesh::FaceId fidA( edge.getFaceId() );
     GeMesh::FaceId fidB( he_twin.getFaceId() );
-    bv._nhatA = _faceUnitNormals[ fidA ];
-    bv._nAim = _faceNormalIMs[ fidA ];
-    bv._nhatB = _faceUnitNormals[ fidB ];
-    bv._nBim = _faceNormalIMs[ fidB ];
+    bv._nhatA = unitNormals[ fidA ];
+    bv._nAim = normalIMs[ fidA ];
+    bv._nhatB = unitNormals[ fidB ];
+    bv._nBim = normalIMs[ fidB ];
     bv.calc( x, v );
     if ( DEBUG_BEND ) {
         std::cout << "x0 = " << x[0] << "  x1 = " << x[1]
@@ -1197,6 +2357,23 @@ void SimSimulator::calcBend(
         std::cout << "k = " << k << std::endl;
         bv.debugOutput( std::cout );
     }
+    return k;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::calcBend(
+    const GeMeshWingedEdge::HalfEdgeWrapper& edge,
+    const BendStencil& stencil,
+    AssemblyAccum& acc
+) {
+    UInt32 m, n;
+
+    GeMesh::VertexId vid[ 4 ];
+    BendVars bv;
+    const Float k = calcBendVars(
+        edge, *_mesh, _sd._v0, _faceUnitNormals, _faceNormalIMs, vid, bv
+    );
 
     // Same finale as stretch/shear
     for ( m = 0; m < 4; ++m ) {
@@ -1204,7 +2381,9 @@ void SimSimulator::calcBend(
 
         val = -k * bv._dC_dxm[ m ] * bv._C;
         _sd._f0[ vid[ m ] ] += val;
-        DO_DEBUG( _sd._f0i[ F_BEND ][ vid[ m ] ] += val );
+        if ( _diagnostics == DIAGNOSTICS_FULL ) {
+            _sd._f0i[ F_BEND ][ vid[ m ] ] += val;
+        }
         if ( DEBUG_BEND ) {
             std::cout << "f0[bend][ " << m << " ] = " << val << std::endl;
         }
@@ -1212,7 +2391,9 @@ void SimSimulator::calcBend(
         val = -_params._k_bend_damp * bv._dC_dxm[ m ] * bv._dC_dt;
         _sd._f0[ vid[ m ] ] += val;
 
-        DO_DEBUG( _sd._d0i[ F_BEND ][ vid[ m ] ] += val );
+        if ( _diagnostics == DIAGNOSTICS_FULL ) {
+            _sd._d0i[ F_BEND ][ vid[ m ] ] += val;
+        }
         if ( DEBUG_BEND ) {
             std::cout << "d0[bend][ " << m << " ] = " << val << std::endl;
         }
@@ -1220,17 +2401,24 @@ void SimSimulator::calcBend(
 
     Float E = .5 * k * bv._C * bv._C;
     // Spread energy to both triangles for debugging
-    _sd._trienergy[ F_BEND ][ edge.getFaceId() ] += E * .5;
-    _sd._trienergy[ F_BEND ][ he_twin.getFaceId() ] += E * .5;
-    _sd._fenergy[ F_BEND ] += E;
+    if ( _diagnostics != DIAGNOSTICS_NONE ) {
+        _sd._trienergy[ F_BEND ][ edge.getFaceId() ] += E * .5;
+        _sd._trienergy[ F_BEND ][ edge.getTwinHalfEdge().getFaceId() ] +=
+            E * .5;
+    }
+    acc._fenergy[ F_BEND ] += E;
 
     for ( m = 0; m < 4; ++m ) for ( n = 0; n < 4; ++n ) {
+        // Only the upper triangle is stored.
+        if ( stencil._slots[ m ][ n ] == SimMatrixPattern::SLOT_INVALID ) {
+            continue;
+        }
         GeMatrix3 val;
         val = -k * (
             GeMatrix3::outerProduct( bv._dC_dxm[ m ], bv._dC_dxm[ n ] )
             + bv._d2C_dxmdxn[ m ][ n ] * bv._C
         );
-        _df_dx[ vid[ n ] ][ vid[ m ] ] += val;
+        _df_dx.getBlock( stencil._slots[ m ][ n ] ) += val;
         if ( DEBUG_BEND ) {
             std::cout << "df_dx[bend][ " << m << " ][ " << n << " ] = "
                 << val << std::endl;
@@ -1238,7 +2426,7 @@ void SimSimulator::calcBend(
 
         val = -_params._k_bend_damp
             * bv._d2C_dxmdxn[ m ][ n ] * bv._dC_dt;
-        _df_dx[ vid[ n ] ][ vid[ m ] ] += val;
+        _df_dx.getBlock( stencil._slots[ m ][ n ] ) += val;
         if ( DEBUG_BEND ) {
             std::cout << "dd_dx[bend][ " << m << " ][ " << n << " ] = "
                 << val << std::endl;
@@ -1246,7 +2434,7 @@ void SimSimulator::calcBend(
 
         val = -_params._k_bend_damp
             * GeMatrix3::outerProduct( bv._dC_dxm[ m ], bv._dC_dxm[ n ] );
-        _df_dv[ vid[ n ] ][ vid[ m ] ] += val;
+        _df_dv.getBlock( stencil._slots[ m ][ n ] ) += val;
 
         if ( DEBUG_BEND ) {
             std::cout << "dd_dv[bend][ " << m << " ][ " << n << " ] = "
@@ -1738,6 +2926,176 @@ void SimSimulator::verifyBend(
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::StepData
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::StepData::swap( StepData& rhs )
+{
+    std::swap( _time, rhs._time );
+    _f0.swap( rhs._f0 );
+    _v0.swap( rhs._v0 );
+    _lastDeltaV0.swap( rhs._lastDeltaV0 );
+    for ( UInt32 i = 0; i < NB_FORCES; ++i ) {
+        _f0i[ i ].swap( rhs._f0i[ i ] );
+        _d0i[ i ].swap( rhs._d0i[ i ] );
+        std::swap( _fenergy[ i ], rhs._fenergy[ i ] );
+        _trienergy[ i ].swap( rhs._trienergy[ i ] );
+    }
+    std::swap( _energy, rhs._energy );
+    std::swap( _venergy, rhs._venergy );
+    _Cu.swap( rhs._Cu );
+    _Cv.swap( rhs._Cv );
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::StepStats
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::StepStats::clear()
+{
+    for ( UInt32 i = 0; i < NB_PHASES; ++i ) {
+        _time[ i ] = 0;
+        for ( UInt32 j = 0; j < SimProfiler::NB_COUNTERS; ++j ) {
+            _counts[ i ][ j ] = 0;
+        }
+    }
+    _hasCounters = false;
+    _iterationTimes.clear();
+}
+
+//------------------------------------------------------------------------------
+
+SimSimulator::StepStats& SimSimulator::StepStats::operator+=(
+    const StepStats& rhs
+) {
+    for ( UInt32 i = 0; i < NB_PHASES; ++i ) {
+        _time[ i ] += rhs._time[ i ];
+        for ( UInt32 j = 0; j < SimProfiler::NB_COUNTERS; ++j ) {
+            _counts[ i ][ j ] += rhs._counts[ i ][ j ];
+        }
+    }
+    _hasCounters = _hasCounters || rhs._hasCounters;
+    return *this;
+}
+
+//------------------------------------------------------------------------------
+
+Double SimSimulator::StepStats::getTotalTime() const
+{
+    Double total = 0;
+    for ( UInt32 i = 0; i < NB_PHASES; ++i ) {
+        total += _time[ i ];
+    }
+    return total;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::AssemblyAccum
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::AssemblyAccum::clear()
+{
+    for ( UInt32 i = 0; i < NB_FORCES; ++i ) {
+        _fenergy[ i ] = 0;
+    }
+    _stepSuccess = true;
+    _maxStretchChange = 0;
+}
+
+//------------------------------------------------------------------------------
+
+SimSimulator::AssemblyAccum& SimSimulator::AssemblyAccum::operator+=(
+    const AssemblyAccum& rhs
+) {
+    for ( UInt32 i = 0; i < NB_FORCES; ++i ) {
+        _fenergy[ i ] += rhs._fenergy[ i ];
+    }
+    _stepSuccess = _stepSuccess && rhs._stepSuccess;
+    _maxStretchChange = std::max( _maxStretchChange, rhs._maxStretchChange );
+    return *this;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::ColourTask
+
+//------------------------------------------------------------------------------
+
+SimSimulator::ColourTask::ColourTask( SimSimulator& sim )
+  : _sim( sim ),
+    _colourBegin( 0 )
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::StretchShearTask
+
+//------------------------------------------------------------------------------
+
+SimSimulator::StretchShearTask::StretchShearTask( SimSimulator& sim )
+  : ColourTask( sim )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::StretchShearTask::run(
+    UInt32 begin,
+    UInt32 end,
+    UInt32 threadIndex
+) {
+    // Sum locally, so that threads don't share cache lines per face.
+    AssemblyAccum acc;
+    acc.clear();
+    const GeMesh& mesh = *_sim._mesh;
+    for ( UInt32 i = _colourBegin + begin; i < _colourBegin + end; ++i ) {
+        _sim.calcStretchShear( mesh.getFace( _sim._faceOrder[ i ] ), acc );
+    }
+    _sim._threadAccums[ threadIndex ] += acc;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::BendTask
+
+//------------------------------------------------------------------------------
+
+SimSimulator::BendTask::BendTask( SimSimulator& sim )
+  : ColourTask( sim )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::BendTask::run(
+    UInt32 begin,
+    UInt32 end,
+    UInt32 threadIndex
+) {
+    AssemblyAccum acc;
+    acc.clear();
+    const GeMeshWingedEdge& meshwe = *_sim._initialMeshWingedEdge;
+    for ( UInt32 i = _colourBegin + begin; i < _colourBegin + end; ++i ) {
+        const BendStencil& bs = _sim._bendStencils[ i ];
+        const GeMeshWingedEdge::HalfEdgeWrapper edge(
+            meshwe.getHalfEdge( bs._halfEdgeId )
+        );
+        _sim.calcBend( edge, bs, acc );
+        if ( VERIFY_BEND ) {
+            _sim.verifyBend( edge );
+        }
+    }
+    _sim._threadAccums[ threadIndex ] += acc;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 // CLASS SimSimulator::FaceConsts
 
@@ -2649,13 +4007,136 @@ void SimSimulator::BendVars::debugOutput( std::ostream& os )
 
 
 ////////////////////////////////////////////////////////////////////////////////
-// CLASS SimSimulator::ModPCGSolver
+/*!
+ * \class SimSimulator::ModPCGSolver::PassTask
+ *
+ * Runs a sweep of the PCG iteration over a range of row chunks, storing
+ * the partial dot product of each chunk.
+ */
+class SimSimulator::ModPCGSolver::PassTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    PassTask( ModPCGSolver&, Pass );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+
+    // ----- data members -----
+    ModPCGSolver&   _solver;
+    Pass            _pass;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::ModPCGSolver::PassTask
+//
+
+//------------------------------------------------------------------------------
+
+SimSimulator::ModPCGSolver::PassTask::PassTask(
+    ModPCGSolver& solver,
+    Pass pass
+) : _solver( solver ),
+    _pass( pass )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::PassTask::run(
+    UInt32 begin,
+    UInt32 end,
+    UInt32
+) {
+    const UInt32 N = _solver._b.size();
+    for ( UInt32 chunk = begin; chunk < end; ++chunk ) {
+        const UInt32 rowBegin = chunk * PCG_CHUNK_SIZE;
+        const UInt32 rowEnd = std::min( rowBegin + PCG_CHUNK_SIZE, N );
+        _solver._chunkSums[ chunk ] =
+            _solver.runPassRows( _pass, rowBegin, rowEnd );
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSimulator::ModPCGSolver::LevelTask
+ *
+ * Applies a row operation of the incomplete Cholesky preconditioner to a
+ * range of the rows of a single dependency level.
+ */
+class SimSimulator::ModPCGSolver::LevelTask : public SimThreadPool::Task
+{
+public:
+    // ----- member functions -----
+    LevelTask( ModPCGSolver&, LevelOp, const UInt32* rows );
+    virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex );
+
+    // ----- data members -----
+    ModPCGSolver&   _solver;
+    LevelOp         _op;
+    //! Rows of the level.
+    const UInt32*   _rows;
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::ModPCGSolver::LevelTask
 //
 
 //------------------------------------------------------------------------------
 
+SimSimulator::ModPCGSolver::LevelTask::LevelTask(
+    ModPCGSolver& solver,
+    LevelOp op,
+    const UInt32* rows
+) : _solver( solver ),
+    _op( op ),
+    _rows( rows )
+{
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::LevelTask::run(
+    UInt32 begin,
+    UInt32 end,
+    UInt32
+) {
+    for ( UInt32 i = begin; i < end; ++i ) {
+        _solver.runLevelRow( _op, _rows[ i ] );
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSimulator::ModPCGSolver
+
+//------------------------------------------------------------------------------
+
 SimSimulator::ModPCGSolver::ModPCGSolver()
- : _tolerance( 1e-2f )
+ : _preconditioner( PRECONDITIONER_DIAGONAL ),
+   _icShift( 0 ),
+   _levelDest( 0 ),
+   _levelSrc( 0 ),
+   _preconditionerTime( 0 ),
+   _done( false ),
+   _nbSteps( 0 ),
+   _tolerance( 1e-2f ),
+   _stepTolerance( 1e-2f ),
+   _relativeTolerance( false ),
+   _mixedPrecision( false ),
+   _operatorMode( OPERATOR_ASSEMBLED ),
+   _dxCoeff( 0 ),
+   _dvCoeff( 0 ),
+   _df_dx( 0 ),
+   _df_dv( 0 ),
+   _mass( 0 ),
+   _alpha( 0 ),
+   _beta( 0 ),
+   _threadPool( new SimThreadPool( 1 ) ),
+   _multiplyDest( 0 ),
+   _multiplySrc( 0 ),
+   _productReady( false )
 {
 }
 
@@ -2682,6 +4163,13 @@ UInt32 SimSimulator::ModPCGSolver::getNbSteps() const
 
 //------------------------------------------------------------------------------
 
+Float SimSimulator::ModPCGSolver::getPreconditionerTime() const
+{
+    return _preconditionerTime;
+}
+
+//------------------------------------------------------------------------------
+
 void SimSimulator::ModPCGSolver::setTolerance( Float tolerance )
 {
     _tolerance = tolerance;
@@ -2696,8 +4184,344 @@ Float SimSimulator::ModPCGSolver::getTolerance() const
 
 //------------------------------------------------------------------------------
 
+void SimSimulator::ModPCGSolver::setMixedPrecision( bool mixedPrecision )
+{
+    _mixedPrecision = mixedPrecision;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimSimulator::ModPCGSolver::isMixedPrecision() const
+{
+    return _mixedPrecision;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::setOperatorMode( OperatorMode mode )
+{
+    _operatorMode = mode;
+}
+
+//------------------------------------------------------------------------------
+
+SimSimulator::ModPCGSolver::OperatorMode
+SimSimulator::ModPCGSolver::getOperatorMode() const
+{
+    return _operatorMode;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::setPreconditioner(
+    Preconditioner preconditioner
+) {
+    DGFX_ASSERT( preconditioner < NB_PRECONDITIONERS );
+    _preconditioner = preconditioner;
+}
+
+//------------------------------------------------------------------------------
+
+SimSimulator::Preconditioner
+SimSimulator::ModPCGSolver::getPreconditioner() const
+{
+    return _preconditioner;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::setOperands(
+    Float dxCoeff,
+    const SymMatrix& df_dx,
+    Float dvCoeff,
+    const SymMatrix& df_dv,
+    const TridiagMatrix& mass
+) {
+    _dxCoeff = dxCoeff;
+    _df_dx = &df_dx;
+    _dvCoeff = dvCoeff;
+    _df_dv = &df_dv;
+    _mass = &mass;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::multiplyA(
+    SimVector& dest,
+    const SimVector& src
+) {
+    DGFX_ASSERT( src.size() == _b.size() );
+    if ( dest.size() != src.size() ) {
+        dest = SimVector( src.size() );
+    }
+    _multiplyDest = &dest;
+    _multiplySrc = &src;
+    runPass( PASS_MULTIPLY );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::setThreadPool(
+    const RCShdPtr<SimThreadPool>& threadPool
+) {
+    _threadPool = threadPool;
+    if ( ! _multigrid.isNull() ) {
+        _multigrid->setThreadPool( threadPool );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::setMultigrid(
+    const RCShdPtr<SimMultigrid>& multigrid
+) {
+    _multigrid = multigrid;
+    if ( ! _multigrid.isNull() ) {
+        _multigrid->setThreadPool( _threadPool );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+const RCShdPtr<SimMultigrid>&
+SimSimulator::ModPCGSolver::getMultigrid() const
+{
+    return _multigrid;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::setFactorization(
+    const RCShdPtr<SimSparseLDLT>& factorization
+) {
+    _factorization = factorization;
+}
+
+//------------------------------------------------------------------------------
+
+const RCShdPtr<SimSparseLDLT>&
+SimSimulator::ModPCGSolver::getFactorization() const
+{
+    return _factorization;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::multiplyAFull(
+    SimVector& dest,
+    const SimVector& src
+) const {
+    if ( _operatorMode == OPERATOR_MATRIX_FREE ) {
+        DGFX_ASSERT( _df_dx != 0 && _df_dv != 0 && _mass != 0 );
+        SymMatrix::multiplyCombined(
+            dest, _dxCoeff, *_df_dx, _dvCoeff, *_df_dv, *_mass, src
+        );
+    }
+    else {
+        SymMatrix::multiply( dest, _A, src );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::multiplyARows(
+    SimVector& dest,
+    const SimVector& src,
+    UInt32 rowBegin,
+    UInt32 rowEnd
+) const {
+    if ( _operatorMode == OPERATOR_MATRIX_FREE ) {
+        DGFX_ASSERT( _df_dx != 0 && _df_dv != 0 && _mass != 0 );
+        SymMatrix::multiplyCombinedRows(
+            dest, _dxCoeff, *_df_dx, _dvCoeff, *_df_dv, *_mass, src,
+            rowBegin, rowEnd
+        );
+    }
+    else {
+        SymMatrix::multiplyRows( dest, _A, src, rowBegin, rowEnd );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+Double SimSimulator::ModPCGSolver::runPass( Pass pass )
+{
+    const UInt32 N = _b.size();
+    const UInt32 nbChunks = ( N + PCG_CHUNK_SIZE - 1 ) / PCG_CHUNK_SIZE;
+
+    // A single thread is better off with the scattering product, which
+    // reads each block only once. The results are identical.
+    _productReady = false;
+    if ( _threadPool->getNbThreads() == 1 || nbChunks < 2 ) {
+        if ( pass == PASS_MULTIPLY ) {
+            multiplyAFull( *_multiplyDest, *_multiplySrc );
+            return 0;
+        }
+        if ( pass == PASS_SEARCH ) {
+            multiplyAFull( _q, _c );
+            _productReady = true;
+        }
+    }
+
+    _chunkSums.resize( nbChunks );
+    PassTask task( *this, pass );
+    _threadPool->run( task, nbChunks );
+    Double sum = 0;
+    for ( UInt32 i = 0; i < nbChunks; ++i ) {
+        accumulate( sum, _chunkSums[ i ] );
+    }
+    return sum;
+}
+
+//------------------------------------------------------------------------------
+
+Double SimSimulator::ModPCGSolver::runPassRows(
+    Pass pass,
+    UInt32 rowBegin,
+    UInt32 rowEnd
+) {
+    Double sum = 0;
+    UInt32 i;
+    switch ( pass ) {
+        case PASS_MULTIPLY: {
+            multiplyARows( *_multiplyDest, *_multiplySrc, rowBegin, rowEnd );
+        } break;
+        case PASS_SEARCH: {
+            if ( ! _productReady ) {
+                multiplyARows( _q, _c, rowBegin, rowEnd );
+            }
+            for ( i = rowBegin; i < rowEnd; ++i ) {
+                _q[ i ] = _S[ i ] * _q[ i ];
+                accumulate( sum, _c[ i ], _q[ i ] );
+            }
+        } break;
+        case PASS_UPDATE: {
+            if ( ! isLocalPreconditioner() ) {
+                // The preconditioner needs all of _r first.
+                for ( i = rowBegin; i < rowEnd; ++i ) {
+                    _x[ i ] += _alpha * _c[ i ];
+                    _r[ i ] += -_alpha * _q[ i ];
+                }
+                break;
+            }
+            for ( i = rowBegin; i < rowEnd; ++i ) {
+                _x[ i ] += _alpha * _c[ i ];
+                _r[ i ] += -_alpha * _q[ i ];
+                _s[ i ] = _Pinv[ i ] * _r[ i ];
+                accumulate( sum, _r[ i ], _s[ i ] );
+            }
+        } break;
+        case PASS_RESIDUAL_DOT: {
+            for ( i = rowBegin; i < rowEnd; ++i ) {
+                accumulate( sum, _r[ i ], _s[ i ] );
+            }
+        } break;
+        case PASS_DIRECTION: {
+            for ( i = rowBegin; i < rowEnd; ++i ) {
+                GeVector c( _c[ i ] );
+                c *= _beta;
+                c += _s[ i ];
+                _c[ i ] = _S[ i ] * c;
+            }
+        } break;
+    }
+    return sum;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::accumulate( Double& sum, Double term ) const
+{
+    if ( _mixedPrecision ) {
+        sum += term;
+    }
+    else {
+        sum = Float( sum ) + Float( term );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::accumulate(
+    Double& sum,
+    const GeVector& a,
+    const GeVector& b
+) const {
+    if ( _mixedPrecision ) {
+        sum += a.dotDouble( b );
+    }
+    else {
+        sum = Float( sum ) + a.dot( b );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+Double SimSimulator::ModPCGSolver::dot(
+    const SimVector& a,
+    const SimVector& b
+) const {
+    return _mixedPrecision ? a.dotDouble( b ) : a.dot( b );
+}
+
+//------------------------------------------------------------------------------
+
+GeMatrix3 SimSimulator::ModPCGSolver::getDiagonalA( UInt32 row ) const
+{
+    if ( _operatorMode == OPERATOR_MATRIX_FREE ) {
+        return SymMatrix::getCombinedDiagonal(
+            row, _dxCoeff, *_df_dx, _dvCoeff, *_df_dv, *_mass
+        );
+    }
+    return _A( row, row );
+}
+
+//------------------------------------------------------------------------------
+
+GeMatrix3 SimSimulator::ModPCGSolver::getOffDiagonalA( UInt32 slot ) const
+{
+    if ( _operatorMode == OPERATOR_MATRIX_FREE ) {
+        // The mass matrix is diagonal.
+        return _df_dx->getBlock( slot ) * _dxCoeff +
+            _df_dv->getBlock( slot ) * _dvCoeff;
+    }
+    return _A.getBlock( slot );
+}
+
+//------------------------------------------------------------------------------
+
+GeMatrix3 SimSimulator::ModPCGSolver::getFilteredDiagonalA( UInt32 row ) const
+{
+    const GeMatrix3& S = _S[ row ];
+    const GeMatrix3 a( getDiagonalA( row ) );
+    return S * ( ( a + a.getTranspose() ) * .5f ) * S +
+        ( GeMatrix3::identity() - S );
+}
+
+//------------------------------------------------------------------------------
+
+GeMatrix3 SimSimulator::ModPCGSolver::getFilteredOffDiagonalA(
+    UInt32 slot,
+    UInt32 row,
+    UInt32 col
+) const {
+    return _S[ row ] * getOffDiagonalA( slot ) * _S[ col ];
+}
+
+//------------------------------------------------------------------------------
+
+bool SimSimulator::ModPCGSolver::isLocalPreconditioner() const
+{
+    return _preconditioner == PRECONDITIONER_DIAGONAL ||
+        _preconditioner == PRECONDITIONER_BLOCK_JACOBI;
+}
+
+//------------------------------------------------------------------------------
+
 void SimSimulator::ModPCGSolver::preStep()
 {
+    _stepTolerance = _tolerance;
+    _relativeTolerance = false;
     setupPreconditioner();
     setupCG();
     _nbSteps = 0;
@@ -2706,21 +4530,96 @@ void SimSimulator::ModPCGSolver::preStep()
 
 //------------------------------------------------------------------------------
 
-void SimSimulator::ModPCGSolver::setupPreconditioner()
+void SimSimulator::ModPCGSolver::preStep( Float tolerance )
 {
-    // FIXME: this assertion is failing... why?
-    //DGFX_ASSERT( isSymmetric( _A ) );
+    _stepTolerance = tolerance;
+    _relativeTolerance = true;
+    setupPreconditioner();
+    setupCG();
+    _nbSteps = 0;
+    _done = false;
+}
 
-    UInt32 N = _A.nbRows();
-    if ( _P.nbRows() != _A.nbRows() ) {
-        _P = SimMatrix( N, N );
-        _Pinv = SimMatrix( N, N );
+//------------------------------------------------------------------------------
 
+void SimSimulator::ModPCGSolver::setupPreconditioner()
+{
+    const BaTime::Instant start = BaTime::getTime();
+    const RCShdPtr<SimMatrixPattern>& pattern = (
+        _operatorMode == OPERATOR_MATRIX_FREE ?
+        _df_dx->getPattern() : _A.getPattern()
+    );
+    UInt32 N = pattern->nbRows();
+    _P.resize( N );
+    _Pinv.resize( N );
+    if ( _preconditioner == PRECONDITIONER_MULTIGRID ||
+        _preconditioner == PRECONDITIONER_LDLT
+    ) {
+        if ( _filteredA.getPattern() != pattern ) {
+            _filteredA = SymMatrix( pattern );
+        }
+        for ( UInt32 row = 0; row < N; ++row ) {
+            const UInt32 end = pattern->getRowEnd( row );
+            for ( UInt32 k = pattern->getRowBegin( row ); k < end; ++k ) {
+                const UInt32 col = pattern->getColumn( k );
+                _filteredA.getBlock( k ) = col == row ?
+                    getFilteredDiagonalA( row ) :
+                    getFilteredOffDiagonalA( k, row, col );
+            }
+        }
+        if ( _preconditioner == PRECONDITIONER_MULTIGRID ) {
+            DGFX_ASSERT( ! _multigrid.isNull() );
+            _multigrid->setOperator( _filteredA );
+        }
+        else {
+            DGFX_ASSERT( ! _factorization.isNull() );
+            _factorization->factor( _filteredA );
+        }
+        _preconditionerTime = BaTime::durationAsSeconds(
+            BaTime::getDuration( start, BaTime::getTime() )
+        );
+        return;
+    }
+    if ( _preconditioner == PRECONDITIONER_IC0 ) {
+        setupLevels( pattern );
+        _icF.resize( pattern->nbBlocks() );
+        _icBreakdowns.resize( N );
+        // Zero-fill factorizations of the bending terms, which aren't
+        // diagonally dominant, tend to break down on large meshes. In that
+        // case refactor with the diagonal scaled up, doubling the shift
+        // until the factorization succeeds. Start from half the previous
+        // step's shift, since consecutive systems are similar.
+        _icShift = _icShift < 2 * IC_INITIAL_SHIFT ? 0 : _icShift * .5f;
+        for ( UInt32 attempt = 0; ; ++attempt ) {
+            std::fill( _icBreakdowns.begin(), _icBreakdowns.end(), 0 );
+            runLevels( LEVEL_FACTOR, _icForwardStarts, _icForwardRows );
+            if ( attempt == IC_MAX_SHIFTS || std::find(
+                    _icBreakdowns.begin(), _icBreakdowns.end(), 1
+                ) == _icBreakdowns.end()
+            ) {
+                break;
+            }
+            _icShift = _icShift == 0 ? IC_INITIAL_SHIFT : _icShift * 2;
+        }
+        _preconditionerTime = BaTime::durationAsSeconds(
+            BaTime::getDuration( start, BaTime::getTime() )
+        );
+        return;
     }
     for ( UInt32 i = 0; i < N; ++i ) {
-        const GeMatrix3& a = _A( i, i );
-        GeMatrix3& p = _P( i, i );
-        GeMatrix3& pinv = _Pinv( i, i );
+        const GeMatrix3 a( getDiagonalA( i ) );
+        GeMatrix3& p = _P[ i ];
+        GeMatrix3& pinv = _Pinv[ i ];
+        if ( _preconditioner == PRECONDITIONER_BLOCK_JACOBI ) {
+            // Use the symmetric part, since the bend derivatives leave the
+            // blocks slightly asymmetric and PCG needs a symmetric
+            // preconditioner. Fall back to the diagonal if the block can't
+            // be inverted safely.
+            p = ( a + a.getTranspose() ) * .5f;
+            if ( invertBlock( p, pinv ) ) {
+                continue;
+            }
+        }
         p = GeMatrix3::zero();
         pinv = GeMatrix3::zero();
         for ( UInt32 j = 0; j < 3; ++j ) {
@@ -2731,6 +4630,217 @@ void SimSimulator::ModPCGSolver::setupPreconditioner()
             pinv( j, j ) = 1 / a( j, j );
         }
     }
+    _preconditionerTime = BaTime::durationAsSeconds(
+        BaTime::getDuration( start, BaTime::getTime() )
+    );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::setupLevels(
+    const RCShdPtr<SimMatrixPattern>& pattern
+) {
+    if ( _icPattern == pattern ) {
+        return;
+    }
+    _icPattern = pattern;
+    DGFX_ASSERT( pattern->isUpperTriangle() );
+    const UInt32 N = pattern->nbRows();
+    const UInt32* rowStarts = pattern->getRowStarts();
+    const UInt32* columns = pattern->getColumns();
+    const UInt32* columnStarts = pattern->getColumnStarts();
+    const UInt32* columnRows = pattern->getColumnRows();
+
+    // Row i of the forward substitution needs the rows above it in column
+    // i; row i of the backward substitution needs the columns to the right
+    // of it in row i.
+    std::vector<UInt32> forward( N ), backward( N );
+    UInt32 nbForward = 0, nbBackward = 0;
+    UInt32 i, k;
+    for ( i = 0; i < N; ++i ) {
+        UInt32 level = 0;
+        for ( k = columnStarts[ i ]; k < columnStarts[ i + 1 ]; ++k ) {
+            level = std::max( level, forward[ columnRows[ k ] ] + 1 );
+        }
+        forward[ i ] = level;
+        nbForward = std::max( nbForward, level + 1 );
+    }
+    for ( i = N; i-- > 0; ) {
+        UInt32 level = 0;
+        for ( k = rowStarts[ i ]; k < rowStarts[ i + 1 ]; ++k ) {
+            if ( columns[ k ] != i ) {
+                level = std::max( level, backward[ columns[ k ] ] + 1 );
+            }
+        }
+        backward[ i ] = level;
+        nbBackward = std::max( nbBackward, level + 1 );
+    }
+
+    // Counting sort of the rows by level.
+    const std::vector<UInt32>* levels[ 2 ] = { &forward, &backward };
+    const UInt32 nbLevels[ 2 ] = { nbForward, nbBackward };
+    std::vector<UInt32>* starts[ 2 ] = {
+        &_icForwardStarts, &_icBackwardStarts
+    };
+    std::vector<UInt32>* rows[ 2 ] = { &_icForwardRows, &_icBackwardRows };
+    for ( UInt32 d = 0; d < 2; ++d ) {
+        const std::vector<UInt32>& level = *levels[ d ];
+        std::vector<UInt32>& levelStarts = *starts[ d ];
+        levelStarts.assign( nbLevels[ d ] + 1, 0 );
+        for ( i = 0; i < N; ++i ) {
+            ++levelStarts[ level[ i ] + 1 ];
+        }
+        for ( k = 0; k < nbLevels[ d ]; ++k ) {
+            levelStarts[ k + 1 ] += levelStarts[ k ];
+        }
+        std::vector<UInt32> next( levelStarts );
+        rows[ d ]->resize( N );
+        for ( i = 0; i < N; ++i ) {
+            (*rows[ d ])[ next[ level[ i ] ]++ ] = i;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::runLevels(
+    LevelOp op,
+    const std::vector<UInt32>& levelStarts,
+    const std::vector<UInt32>& levelRows
+) {
+    const UInt32 nbLevels = levelStarts.size() - 1;
+    for ( UInt32 l = 0; l < nbLevels; ++l ) {
+        const UInt32 begin = levelStarts[ l ];
+        const UInt32 nbRows = levelStarts[ l + 1 ] - begin;
+        // Small levels aren't worth waking the workers for.
+        if ( nbRows < IC_MIN_PARALLEL_ROWS ) {
+            for ( UInt32 i = 0; i < nbRows; ++i ) {
+                runLevelRow( op, levelRows[ begin + i ] );
+            }
+        }
+        else {
+            LevelTask task( *this, op, &levelRows[ begin ] );
+            _threadPool->run( task, nbRows );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::runLevelRow( LevelOp op, UInt32 i )
+{
+    const SimMatrixPattern& pattern = *_icPattern;
+    const UInt32 rowBegin = pattern.getRowBegin( i );
+    const UInt32 rowEnd = pattern.getRowEnd( i );
+    const UInt32* columns = pattern.getColumns();
+    const UInt32* columnSlots = pattern.getColumnSlots();
+    const UInt32* columnRows = pattern.getColumnRows();
+    const UInt32 colBegin = pattern.getColumnBegin( i );
+    const UInt32 colEnd = pattern.getColumnEnd( i );
+    UInt32 k;
+
+    switch ( op ) {
+        case LEVEL_FACTOR: {
+            // Factor S A S + ( I - S ), which leaves the constrained
+            // directions alone, so that the preconditioner works within
+            // the space the filtered iteration is confined to.
+            GeMatrix3 d( getFilteredDiagonalA( i ) );
+            for ( k = 0; k < 3; ++k ) {
+                d( k, k ) *= 1 + _icShift;
+            }
+            const GeMatrix3 dInitial( d );
+            for ( k = rowBegin; k < rowEnd; ++k ) {
+                if ( columns[ k ] != i ) {
+                    _icF[ k ] = getFilteredOffDiagonalA( k, i, columns[ k ] );
+                }
+            }
+            // Eliminate each row above i with a block in column i, keeping
+            // only updates that fall within the pattern of row i.
+            for ( k = colBegin; k < colEnd; ++k ) {
+                const UInt32 rowK = columnRows[ k ];
+                const GeMatrix3& fki = _icF[ columnSlots[ k ] ];
+                const GeMatrix3 g( fki.getTranspose() * _Pinv[ rowK ] );
+                d -= g * fki;
+                UInt32 ik = rowBegin;
+                const UInt32 endK = pattern.getRowEnd( rowK );
+                for ( UInt32 kk = columnSlots[ k ] + 1; kk < endK; ++kk ) {
+                    while ( ik < rowEnd && columns[ ik ] < columns[ kk ] ) {
+                        ++ik;
+                    }
+                    if ( ik == rowEnd ) {
+                        break;
+                    }
+                    if ( columns[ ik ] == columns[ kk ] ) {
+                        _icF[ ik ] -= g * _icF[ kk ];
+                    }
+                }
+            }
+            // Incomplete factorizations can break down; drop the updates
+            // to a pivot that is no longer safely positive definite, and
+            // note it so that setupPreconditioner() can try again.
+            d = ( d + d.getTranspose() ) * .5f;
+            if ( ! hasPositiveMinors( d ) || ! invertBlock( d, _Pinv[ i ] ) ) {
+                _icBreakdowns[ i ] = 1;
+                d = dInitial;
+                if ( ! hasPositiveMinors( d ) ||
+                    ! invertBlock( d, _Pinv[ i ] )
+                ) {
+                    d = GeMatrix3::identity();
+                    _Pinv[ i ] = GeMatrix3::identity();
+                }
+            }
+            _P[ i ] = d;
+        } break;
+        case LEVEL_FORWARD: {
+            const SimVector& src = *_levelSrc;
+            SimVector& dest = *_levelDest;
+            GeVector sum( src[ i ] );
+            for ( k = colBegin; k < colEnd; ++k ) {
+                sum -= _icF[ columnSlots[ k ] ].getTranspose() *
+                    dest[ columnRows[ k ] ];
+            }
+            dest[ i ] = _Pinv[ i ] * sum;
+        } break;
+        case LEVEL_BACKWARD: {
+            SimVector& dest = *_levelDest;
+            GeVector sum( GeVector::zero() );
+            for ( k = rowBegin; k < rowEnd; ++k ) {
+                if ( columns[ k ] != i ) {
+                    sum += _icF[ k ] * dest[ columns[ k ] ];
+                }
+            }
+            dest[ i ] -= _Pinv[ i ] * sum;
+        } break;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSimulator::ModPCGSolver::applyPreconditioner(
+    SimVector& dest,
+    const SimVector& src
+) {
+    if ( dest.size() != src.size() ) {
+        dest = SimVector( src.size() );
+    }
+    if ( _preconditioner == PRECONDITIONER_MULTIGRID ) {
+        _multigrid->apply( dest, src );
+        return;
+    }
+    if ( _preconditioner == PRECONDITIONER_LDLT ) {
+        _factorization->solve( dest, src );
+        return;
+    }
+    if ( _preconditioner == PRECONDITIONER_IC0 ) {
+        _levelDest = &dest;
+        _levelSrc = &src;
+        runLevels( LEVEL_FORWARD, _icForwardStarts, _icForwardRows );
+        runLevels( LEVEL_BACKWARD, _icBackwardStarts, _icBackwardRows );
+        return;
+    }
+    for ( UInt32 i = 0; i < src.size(); ++i ) {
+        dest[ i ] = _Pinv[ i ] * src[ i ];
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -2740,20 +4850,66 @@ void SimSimulator::ModPCGSolver::setupCG()
     _x = _z;
     if ( DO_ASCHER_BOXERMAN ) {
         filterCompInPlace( _x );
-        _bhat = - ( _A * _x );
-        _bhat += _b;
+        multiplyA( _q, _x );
+    }
+    const UInt32 N = _b.size();
+    if ( _bhat.size() != N ) {
+        _bhat = SimVector( N );
+        _r = SimVector( N );
+        _s = SimVector( N );
+    }
+    UInt32 i;
+    for ( i = 0; i < N; ++i ) {
+        _bhat[ i ] = _S[ i ] * (
+            DO_ASCHER_BOXERMAN ? _b[ i ] - _q[ i ] : _b[ i ]
+        );
+    }
+    if ( _relativeTolerance ) {
+        // Measure bhat in the same norm as the residuals.
+        applyPreconditioner( _s, _bhat );
+        _delta0 = dot( _s, _bhat );
+    }
+    else if ( _preconditioner == PRECONDITIONER_MULTIGRID ||
+        _preconditioner == PRECONDITIONER_LDLT
+    ) {
+        // The V-cycle or factorization approximates the inverse of the
+        // filtered system.
+        SymMatrix::multiply( _s, _filteredA, _bhat );
+        _delta0 = dot( _s, _bhat );
+    }
+    else if ( _preconditioner == PRECONDITIONER_IC0 ) {
+        // bhat^T P bhat, with P = ( D + F )^T D^-1 ( D + F ).
+        _delta0 = 0;
+        for ( i = 0; i < _bhat.size(); ++i ) {
+            GeVector t( _P[ i ] * _bhat[ i ] );
+            const UInt32 end = _icPattern->getRowEnd( i );
+            for ( UInt32 k = _icPattern->getRowBegin( i ); k < end; ++k ) {
+                const UInt32 col = _icPattern->getColumn( k );
+                if ( col != i ) {
+                    t += _icF[ k ] * _bhat[ col ];
+                }
+            }
+            accumulate( _delta0, t, _Pinv[ i ] * t );
+        }
     }
     else {
-        _bhat = _b;
+        for ( i = 0; i < _bhat.size(); ++i ) {
+            _s[ i ] = _P[ i ] * _bhat[ i ];
+        }
+        _delta0 = dot( _s, _bhat );
     }
-    filterInPlace( _bhat );
-    _delta0 = ( _P * _bhat ).dot( _bhat );
     if ( DO_ASCHER_BOXERMAN ) {
-        _x += filter( _y );
+        for ( i = 0; i < N; ++i ) {
+            _x[ i ] += _S[ i ] * _y[ i ];
+        }
+    }
+    multiplyA( _q, _x );
+    for ( i = 0; i < N; ++i ) {
+        _r[ i ] = _S[ i ] * ( _b[ i ] - _q[ i ] );
     }
-    _r = filter( _b - _A * _x );
-    _c = filter( _Pinv * _r );
-    _deltaNew = _r.dot( _c );
+    applyPreconditioner( _c, _r );
+    filterInPlace( _c );
+    _deltaNew = dot( _r, _c );
 }
     
 //------------------------------------------------------------------------------
@@ -2817,23 +4973,24 @@ void SimSimulator::ModPCGSolver::step()
     if ( DEBUG_PCG ) {
         std::cout << "substep" << std::endl;
     }
-    if ( _deltaNew < _tolerance * _tolerance * _delta0 ) {
+    Double threshold = _stepTolerance * _stepTolerance * _delta0;
+    if ( ! _mixedPrecision ) {
+        threshold = Float( threshold );
+    }
+    if ( _deltaNew < threshold ) {
         _done = true;
         return;
     }
 
-    SimMatrix::multiply( _q, _A, _c );
-    filterInPlace( _q );
-    Float alpha = _deltaNew / _c.dot( _q );
-    _x.plusEqualsScaled( alpha, _c );
-    _r.plusEqualsScaled( -alpha, _q );
-
-    SimMatrix::multiply( _s, _Pinv, _r );
-    Float _deltaOld = _deltaNew;
-    _deltaNew = _r.dot( _s );
-    _c *= _deltaNew / _deltaOld;
-    _c += _s;
-    filterInPlace( _c );
+    _alpha = Float( _deltaNew / runPass( PASS_SEARCH ) );
+    const Double deltaOld = _deltaNew;
+    _deltaNew = runPass( PASS_UPDATE );
+    if ( ! isLocalPreconditioner() ) {
+        applyPreconditioner( _s, _r );
+        _deltaNew = runPass( PASS_RESIDUAL_DOT );
+    }
+    _beta = Float( _deltaNew / deltaOld );
+    runPass( PASS_DIRECTION );
     ++_nbSteps;
 }
 
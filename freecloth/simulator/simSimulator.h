@@ -27,10 +27,38 @@
 #include <freecloth/simulator/simMatrix.h>
 #endif
 
+#ifndef freecloth_sim_simSymMatrix_h
+#include <freecloth/simulator/simSymMatrix.h>
+#endif
+
 #ifndef freecloth_sim_simVector_h
 #include <freecloth/simulator/simVector.h>
 #endif
 
+#ifndef freecloth_sim_simThreadPool_h
+#include <freecloth/simulator/simThreadPool.h>
+#endif
+
+#ifndef freecloth_sim_simMultigrid_h
+#include <freecloth/simulator/simMultigrid.h>
+#endif
+
+#ifndef freecloth_sim_simSparseLDLT_h
+#include <freecloth/simulator/simSparseLDLT.h>
+#endif
+
+#ifndef freecloth_sim_simProfiler_h
+#include <freecloth/simulator/simProfiler.h>
+#endif
+
+#ifndef freecloth_sim_simCollider_h
+#include <freecloth/simulator/simCollider.h>
+#endif
+
+#ifndef freecloth_sim_simSelfCollider_h
+#include <freecloth/simulator/simSelfCollider.h>
+#endif
+
 #ifndef freecloth_base_algorithm
 #include <freecloth/base/algorithm>
 #endif
@@ -99,6 +127,8 @@ class GeMatrix3;
  * - [AscBox03] U. Ascher and E. Boxerman. On the modified conjugate gradient
  *    method in cloth simulation.
  *    http://www.cs.ubc.ca/spider/ascher/papers/ab.pdf
+ * - [EisWal96] S. Eisenstat and H. Walker. Choosing the forcing terms in an
+ *    inexact Newton method. SIAM J. Sci. Comput., 17(1), 1996.
  */
 
 // FIXME: the mesh should be allowed to have cylindrical or spherical
@@ -188,12 +218,145 @@ public:
         NB_FORCES
     };
 
+    //! Preconditioners for the PCG solve.
+    enum Preconditioner {
+        //! Inverse of the diagonal entries of the system matrix.
+        PRECONDITIONER_DIAGONAL,
+        //! Inverse of each vertex's 3x3 diagonal block of the system
+        //! matrix. Accounts for the strong coupling of x, y and z within
+        //! each vertex from stretch forces, at the cost of a full 3x3
+        //! product per vertex.
+        PRECONDITIONER_BLOCK_JACOBI,
+        //! Zero-fill incomplete Cholesky factorization over 3x3 blocks,
+        //! of the system matrix restricted by the constraint filter.
+        //! Much more effective for stiff cloth, but must be refactored
+        //! every step, and its triangular solves only parallelize across
+        //! the vertices of each dependency level.
+        PRECONDITIONER_IC0,
+        //! Multigrid V-cycle over a hierarchy of coarsened meshes; see
+        //! SimMultigrid. Iteration counts stay nearly constant as the mesh
+        //! is refined, which pays off on large meshes.
+        PRECONDITIONER_MULTIGRID,
+        //! Complete sparse LDL^T factorization of the filtered system; see
+        //! SimSparseLDLT. The ordering and pattern of the factor are worked
+        //! out once, from the mesh, and only the numeric factorization is
+        //! redone every step, so the cost per step is fixed. PCG then
+        //! finishes in an iteration or two, which only serve to mop up
+        //! rounding errors. Best for small and medium meshes, where fill
+        //! stays modest; the factorization isn't threaded.
+        PRECONDITIONER_LDLT,
+
+        NB_PRECONDITIONERS
+    };
+
+    //! Amount of per-force detail kept with each step, for getTriEnergy(),
+    //! getForce( ForceType, ... ) and getDampingForce(). Anything not kept
+    //! is computed on demand, when first asked for after a step.
+    enum Diagnostics {
+        //! Only the total energies are kept.
+        DIAGNOSTICS_NONE,
+        //! Per-triangle energies are kept as well.
+        DIAGNOSTICS_ENERGIES,
+        //! Per-triangle energies and the per-force breakdown of each
+        //! vertex's force are kept.
+        DIAGNOSTICS_FULL,
+
+        NB_DIAGNOSTICS
+    };
+
+    //! Parts of a step timed by StepStats. Assembly phases run whenever
+    //! the forces are evaluated: at the end of postSubSteps() for the
+    //! next step, and again for each extra Newton iteration.
+    enum Phase {
+        //! Face normals, ready for bend assembly.
+        PHASE_NORMALS,
+        //! Bend, gravity and drag forces and derivatives.
+        PHASE_BEND,
+        //! Contact detection against the collider's obstacles.
+        PHASE_COLLISION,
+        //! Clearing of the last forces, and stretch and shear forces and
+        //! derivatives.
+        PHASE_STRETCH_SHEAR,
+        //! Right hand side and matrix of [BarWit98] eq. (16).
+        PHASE_SYSTEM,
+        //! Preconditioner setup and initial residual of each linear solve.
+        PHASE_PRECONDITIONER,
+        //! PCG iterations.
+        PHASE_PCG,
+        //! Self-collision detection and impulses.
+        PHASE_SELF_COLLISION,
+        //! Writing the new state, or restoring the old one.
+        PHASE_COMMIT,
+
+        NB_PHASES
+    };
+
+    //! Parts of a step that runKernel() repeats.
+    enum Kernel {
+        //! Stretch and shear forces and derivatives, without the clearing
+        //! of the last forces that precedes them.
+        KERNEL_STRETCH_SHEAR,
+        //! Bend, gravity and drag forces and derivatives.
+        KERNEL_BEND,
+        //! Preconditioner setup and initial residual of the linear solve.
+        KERNEL_PCG_SETUP,
+        //! The whole linear solve.
+        KERNEL_PCG_SOLVE,
+
+        NB_KERNELS
+    };
+
+    // ----- classes -----
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class StepStats freecloth/simulator/simSimulator.h
+     * \brief Where the time of a step went, when profiling is enabled.
+     *
+     * Times are wall clock seconds, read from BaTime::getTime(). The
+     * hardware counts are those of the thread that enabled profiling, and
+     * are zero unless _hasCounters. They're only taken when that thread
+     * steps the simulator single-threaded, since the counters can't see
+     * any other thread's work.
+     */
+    class StepStats
+    {
+    public:
+        // ----- member functions -----
+
+        void clear();
+        //! Sum the phase times and counts, for totals over several steps.
+        //! _iterationTimes is left alone.
+        StepStats& operator+=( const StepStats& );
+        //! Sum of the phase times.
+        Double getTotalTime() const;
+
+        // ----- data members -----
+
+        Double          _time[ NB_PHASES ];
+        UInt64          _counts[ NB_PHASES ][ SimProfiler::NB_COUNTERS ];
+        bool            _hasCounters;
+        //! Time of each PCG iteration, over all the linear solves of the
+        //! step, in order.
+        std::vector<Float> _iterationTimes;
+    };
+
     // ----- member functions -----
 
     explicit SimSimulator( const GeMesh& initialMesh );
 
     const GeMesh& getMesh() const;
     const RCShdPtr<GeMesh>& getMeshPtr() const;
+    //! The mesh given at construction, which rewind() returns to.
+    const GeMesh& getInitialMesh() const;
+
+    //! Continue from where another simulator, created from the same
+    //! initial mesh, is between steps: copy its configuration, time,
+    //! positions and velocities. The thread count and profiling are kept.
+    //! The next step reassembles the stretch and shear forces, which the
+    //! other simulator may have already done, but gives the same results
+    //! as its next step would.
+    void copyState( const SimSimulator& );
 
     //! Rewind simulation time to zero, and return the mesh to its initial
     //! state.
@@ -220,6 +383,10 @@ public:
     bool inStep() const;
     //! Test if the last step succeeded. See getStretchLimit for details.
     bool stepSucceeded() const;
+    //! Largest change in Cu or Cv of any face over the last step, whether
+    //! or not it succeeded. The step failed if this exceeds the stretch
+    //! limit.
+    Float getMaxStretchChange() const;
 
     //! Retrieve the current simulation time.
     BaTime::Instant getTime() const;
@@ -231,6 +398,63 @@ public:
     void setDensity( Float rho );
     void setPCGTolerance( Float );
     void setStretchLimit( Float );
+    //! Select matrix-free solving: if enabled, the system matrix of
+    //! [BarWit98] eq. (16) is never assembled, and its products are
+    //! evaluated directly from the force derivatives instead. This saves
+    //! memory and per-step copying, at the cost of slightly more work per
+    //! PCG iteration. Disabled by default. Results are identical, for
+    //! each SimMatrixKernels instruction set: the products go through the
+    //! same kernels.
+    void setMatrixFree( bool );
+    //! Number of threads used for force and Jacobian assembly and for the
+    //! linear solve, including the calling thread. Defaults to 1. The
+    //! simulation doesn't depend upon the thread count; energy totals may
+    //! differ in the last bits, since they're summed per thread.
+    void setNbThreads( UInt32 );
+    //! Select the PCG preconditioner. Defaults to PRECONDITIONER_DIAGONAL.
+    void setPreconditioner( Preconditioner );
+    //! Select mixed precision PCG: vectors and matrices are stored in
+    //! Float, but the residual norms and step lengths are reduced in
+    //! double precision. This matters for tight PCG tolerances, where
+    //! single precision sums stall convergence. Disabled by default.
+    void setMixedPrecision( bool );
+    //! Enable per-phase timing of each step, and hardware counts where
+    //! available; see getStepStats(). Counters are opened for the calling
+    //! thread, and are only read when that thread steps the simulator with
+    //! a single thread. Disabled by default.
+    void setProfiling( bool );
+    //! Select the per-force detail kept with each step. Defaults to
+    //! DIAGNOSTICS_NONE, which neither stores nor assembles the breakdowns;
+    //! raise it if they're queried after every step.
+    void setDiagnostics( Diagnostics );
+    //! Maximum number of Newton iterations per step. Defaults to 1, which
+    //! takes the single linearized solve of [BarWit98] eq. (16). With more,
+    //! the forces and their derivatives are re-evaluated at the new state
+    //! and the step is corrected, until the correction is small relative
+    //! to the velocity change (see setNewtonTolerance()), or stops
+    //! reducing the residual. The PCG tolerance of each correction is
+    //! chosen as per [EisWal96], so that the early corrections are loose
+    //! and the later ones tight, but never tighter than getPCGTolerance().
+    //! This keeps each step closer to the implicit Euler solution, which
+    //! can allow larger steps before the stretch limit is exceeded.
+    void setNewtonIterations( UInt32 );
+    //! Relative size of the correction below which the Newton iterations
+    //! stop. Defaults to 1e-2.
+    void setNewtonTolerance( Float );
+    //! Obstacles for the cloth to collide with, or null, the default, for
+    //! none. Contacts are found at the start of each step, and constrain
+    //! the vertex like setPosConstraintPlane(), with a velocity along the
+    //! normal that brings it to rest the collider's thickness away from
+    //! the surface. Vertices with constraints of their own are left alone.
+    //! The collider may be shared, and its obstacles moved between steps.
+    void setCollider( const RCShdPtr<SimCollider>& );
+    //! Distance kept between parts of the cloth that don't share a vertex,
+    //! or zero, the default, to let the cloth pass through itself. Once
+    //! the velocities of a step are solved for, its motion is checked for
+    //! self-collisions by a SimSelfCollider, and the velocities are
+    //! corrected with impulses. Constrained vertices, including those in
+    //! contact with obstacles, aren't moved by the impulses.
+    void setSelfCollisionThickness( Float );
     //@}
 
     //@{
@@ -238,10 +462,38 @@ public:
     BaTime::Duration getTimestep() const;
     const Params& getParams() const;
     Float getDensity() const;
+    bool isMatrixFree() const;
+    UInt32 getNbThreads() const;
+    Preconditioner getPreconditioner() const;
+    bool isMixedPrecision() const;
+    bool isProfiling() const;
+    Diagnostics getDiagnostics() const;
+    UInt32 getNewtonIterations() const;
+    Float getNewtonTolerance() const;
+    const RCShdPtr<SimCollider>& getCollider() const;
+    Float getSelfCollisionThickness() const;
     //@}
+    //! Number of vertices constrained by contacts in the last step.
+    UInt32 getNbContacts() const;
+    //! Number of self-collision impulses applied in the last step.
+    UInt32 getNbSelfCollisions() const;
     //! Accessor. The PCG tolerance determines the accuracy for solving the
     //! non-linear system in each timestep.
     Float getPCGTolerance() const;
+    //! Number of PCG iterations taken by the last step's linear solves.
+    UInt32 getNbPCGIterations() const;
+    //! Number of linear solves taken by the last step. Always 1, unless
+    //! getNewtonIterations() is larger.
+    UInt32 getNbNewtonIterations() const;
+    //! Time spent building the preconditioner for the last step, in
+    //! seconds. Mostly of interest for PRECONDITIONER_IC0, to weigh its
+    //! factorization cost against the iterations it saves.
+    Float getPreconditionerTime() const;
+    //! Phase times of the last step, from preSubSteps() to postSubSteps()
+    //! or cancelStep(), or of the step in progress. The stretch and shear
+    //! assembly at the end of postSubSteps() is for the next step, but is
+    //! counted in this one. Empty unless isProfiling().
+    const StepStats& getStepStats() const;
     //! Accessor. The stretch limit determines the success/failure of each
     //! time step. If the Cu or Cv value for any triangle (excluding the
     //! alpha term) exceeds the stretch limit, the preceeding timestep is
@@ -269,23 +521,27 @@ public:
     GeVector getForce( GeMesh::VertexId vid ) const;
     Float getEnergy( ForceType ) const;
     Float getTriEnergy( ForceType, GeMesh::FaceId ) const;
-    // The final two will only work in debug builds.
     GeVector getForce( ForceType type, GeMesh::VertexId vid ) const;
     GeVector getDampingForce( ForceType type, GeMesh::VertexId vid ) const;
     //@}
 
     //! Only exposed for debugging purposes.
     void setMesh( const GeMesh& );
+    //! Only exposed for benchmarking. Repeat the given part of the step in
+    //! progress, after preSubSteps(), to time it in isolation. Forces add
+    //! up over the repeats, so the step can't be finished afterwards.
+    void runKernel( Kernel );
 
 private:
 
     // ----- types and enumerations -----
 
-    // FIXME: implement custom matrix classes for these some time, if it
-    // helps the performance much.
+    // FIXME: implement a custom matrix class for the tridiagonal case some
+    // time, if it helps the performance much. At present, all of the
+    // symmetric matrices share a single upper triangular block pattern.
     typedef SimMatrix Matrix;
-    typedef SimMatrix SymMatrix;
-    typedef SimMatrix TridiagMatrix;
+    typedef SimSymMatrix SymMatrix;
+    typedef SimSymMatrix TridiagMatrix;
 
     // ----- classes -----
 
@@ -322,6 +578,62 @@ private:
         Float _detInv;
     };
 
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class FaceStencil freecloth/simulator/simSimulator.h
+     *
+     * Per-face matrix slots, precomputed for efficiency. _slots[ m ][ n ]
+     * is the slot in the shared sparsity pattern of the block coupling the
+     * face's vertices n (row) and m (column). Blocks below the diagonal
+     * are not stored, and have SimMatrixPattern::SLOT_INVALID.
+     */
+    class FaceStencil
+    {
+    public:
+        // ----- data members -----
+        UInt32 _slots[ 3 ][ 3 ];
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class BendStencil freecloth/simulator/simSimulator.h
+     *
+     * Per-interior-edge matrix slots for the bend condition, precomputed for
+     * efficiency. Slots are laid out as for FaceStencil, using the vertex
+     * ordering of calcBend().
+     */
+    class BendStencil
+    {
+    public:
+        // ----- data members -----
+        GeMeshWingedEdge::HalfEdgeId _halfEdgeId;
+        UInt32 _slots[ 4 ][ 4 ];
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class AssemblyAccum freecloth/simulator/simSimulator.h
+     *
+     * Results of force assembly that aren't per-vertex or per-face, and so
+     * are summed separately by each thread and reduced afterwards.
+     */
+    class AssemblyAccum
+    {
+    public:
+        // ----- member functions -----
+
+        void clear();
+        AssemblyAccum& operator+=( const AssemblyAccum& );
+
+        // ----- data members -----
+
+        Float           _fenergy[ NB_FORCES ];
+        //! False if any face exceeded the stretch limit.
+        bool            _stepSuccess;
+        //! Largest change in Cu or Cv of any face.
+        Float           _maxStretchChange;
+    };
+
     //@{
     //! Internal class used for calculation of forces
     class CommonVars;
@@ -329,6 +641,13 @@ private:
     class ShearVars;
     class BendVars;
     //@}
+
+    //@{
+    //! Internal class used for parallel assembly
+    class ColourTask;
+    class StretchShearTask;
+    class BendTask;
+    //@}
     
     ////////////////////////////////////////////////////////////////////////////
     /*!
@@ -340,23 +659,86 @@ private:
      *
      * We use the notation of [BarWit98], but implement the method
      * described by [AscBox03].
+     *
+     * The system matrix A can either be assembled explicitly into _A, or
+     * left implicit as A = M + b_v df_dv + b_x df_dx, with products
+     * evaluated on the fly from the force derivatives. The latter avoids
+     * storing A at all.
+     *
+     * Each iteration makes three fused sweeps over the vertices: the
+     * product with A together with the filter and a dot product; the
+     * solution, residual and preconditioner updates together with the
+     * other dot product; and the search direction update. Sweeps are split
+     * into fixed-size chunks of rows, which are shared out across the
+     * thread pool. Dot products are summed per chunk and then in chunk
+     * order, so the result doesn't depend upon the number of threads.
      */
     class ModPCGSolver
     {
     public:
+        // ----- types and enumerations -----
+
+        enum OperatorMode {
+            //! A is assembled explicitly into _A by the client.
+            OPERATOR_ASSEMBLED,
+            //! A is never formed; see setOperands().
+            OPERATOR_MATRIX_FREE
+        };
+
         // ----- member functions -----
 
         ModPCGSolver();
         void preStep();
+        //! As preStep(), but solve until the preconditioned norm of the
+        //! residual is reduced to the given fraction of that of b, as for
+        //! an inexact Newton method [EisWal96]. preStep() uses the
+        //! [BarWit98] criterion, which compares b and the residual in
+        //! different norms.
+        void preStep( Float tolerance );
         void step();
         bool done() const;
         const SimVector& result() const;
         UInt32 getNbSteps() const;
+        //! Seconds spent in setupPreconditioner() by the last preStep().
+        Float getPreconditionerTime() const;
 
         //! Specify the tolerance.
         void setTolerance( Float );
         //! Access the tolerance
         Float getTolerance() const;
+        //! Select mixed precision: vectors stay in Float, but the dot
+        //! products driving the iteration are reduced in Double.
+        void setMixedPrecision( bool );
+        bool isMixedPrecision() const;
+
+        void setOperatorMode( OperatorMode );
+        OperatorMode getOperatorMode() const;
+        void setPreconditioner( Preconditioner );
+        Preconditioner getPreconditioner() const;
+        //! Specify the implicit system matrix for OPERATOR_MATRIX_FREE mode,
+        //! as A = mass + dvCoeff * df_dv + dxCoeff * df_dx. The matrices are
+        //! referenced, not copied, and must remain valid until the solve is
+        //! complete. Only the diagonal blocks of mass are used.
+        void setOperands(
+            Float dxCoeff,
+            const SymMatrix& df_dx,
+            Float dvCoeff,
+            const SymMatrix& df_dv,
+            const TridiagMatrix& mass
+        );
+        //! Compute dest = A * src, in either mode.
+        void multiplyA( SimVector& dest, const SimVector& src );
+        //! Threads for the per-iteration sweeps. By default, a single
+        //! thread is used.
+        void setThreadPool( const RCShdPtr<SimThreadPool>& );
+        //! Hierarchy for PRECONDITIONER_MULTIGRID, which must be built for
+        //! the pattern of A.
+        void setMultigrid( const RCShdPtr<SimMultigrid>& );
+        const RCShdPtr<SimMultigrid>& getMultigrid() const;
+        //! Factorization for PRECONDITIONER_LDLT, which must be analysed
+        //! for the pattern of A.
+        void setFactorization( const RCShdPtr<SimSparseLDLT>& );
+        const RCShdPtr<SimSparseLDLT>& getFactorization() const;
 
         // ----- data members -----
         
@@ -371,9 +753,90 @@ private:
         SimVector       _y;
 
     private:
+        // ----- types and enumerations -----
+
+        //! Fused sweeps over the rows of the system. See runPass().
+        enum Pass {
+            //! *_multiplyDest = A * *_multiplySrc
+            PASS_MULTIPLY,
+            //! _q = filter( A * _c ); sums _c . _q
+            PASS_SEARCH,
+            //! _x += _alpha * _c; _r -= _alpha * _q; _s = _Pinv * _r;
+            //! sums _r . _s. Unless isLocalPreconditioner(), _s is left
+            //! alone and nothing is summed; see PASS_RESIDUAL_DOT.
+            PASS_UPDATE,
+            //! sums _r . _s
+            PASS_RESIDUAL_DOT,
+            //! _c = filter( _beta * _c + _s )
+            PASS_DIRECTION
+        };
+
+        //! Row operations of the incomplete Cholesky preconditioner,
+        //! applied a dependency level at a time. See runLevels().
+        enum LevelOp {
+            //! Compute row i of the factor.
+            LEVEL_FACTOR,
+            //! Forward substitution: *_levelDest = ( D + F )^-T *_levelSrc
+            LEVEL_FORWARD,
+            //! Backward substitution, in place:
+            //! *_levelDest = ( D + F )^-1 D *_levelDest
+            LEVEL_BACKWARD
+        };
+
+        // ----- classes -----
+
+        //! Runs a Pass over a range of chunks.
+        class PassTask;
+        //! Runs a LevelOp over a range of the rows of one level.
+        class LevelTask;
+
         // ----- member functions -----
 
+        //! Run the pass over all rows, and return the sum of its dot
+        //! product, if any.
+        Double runPass( Pass );
+        //! Run the pass over rows [ rowBegin, rowEnd ), and return the
+        //! partial sum of its dot product.
+        Double runPassRows( Pass, UInt32 rowBegin, UInt32 rowEnd );
+        //@{
+        //! sum += term, or sum += a . b. Unless isMixedPrecision(), the
+        //! arithmetic is done in Float, and sum always holds a Float value.
+        void accumulate( Double& sum, Double term ) const;
+        void accumulate(
+            Double& sum,
+            const GeVector& a,
+            const GeVector& b
+        ) const;
+        //@}
+        //! a . b, in Double if isMixedPrecision().
+        Double dot( const SimVector& a, const SimVector& b ) const;
+        //! Compute all rows of dest = A * src in a single call.
+        void multiplyAFull( SimVector& dest, const SimVector& src ) const;
+        //! Compute rows [ rowBegin, rowEnd ) of dest = A * src. dest must
+        //! already have the right size.
+        void multiplyARows(
+            SimVector& dest,
+            const SimVector& src,
+            UInt32 rowBegin,
+            UInt32 rowEnd
+        ) const;
+
         void setupPreconditioner();
+        //! Recompute the dependency levels of the incomplete Cholesky
+        //! factor, if the pattern has changed.
+        void setupLevels( const RCShdPtr<SimMatrixPattern>& );
+        //! Run the operation over every row, one level at a time. Levels
+        //! are listed by levelStarts, with the rows of level l stored in
+        //! levelRows[ levelStarts[ l ] .. levelStarts[ l + 1 ] ).
+        void runLevels(
+            LevelOp,
+            const std::vector<UInt32>& levelStarts,
+            const std::vector<UInt32>& levelRows
+        );
+        //! Apply the operation to one row.
+        void runLevelRow( LevelOp, UInt32 row );
+        //! dest = P^-1 * src, for the current preconditioner.
+        void applyPreconditioner( SimVector& dest, const SimVector& src );
         void setupCG();
         //! [BarWit98]'s filter method (also [AscBox03]'s S filter method)
         SimVector filter( const SimVector& ) const;
@@ -383,18 +846,96 @@ private:
         void filterInPlace( SimVector& ) const;
         void filterCompInPlace( SimVector& ) const;
 
+        //! Diagonal block of A, in either mode.
+        GeMatrix3 getDiagonalA( UInt32 row ) const;
+        //! Off-diagonal block of A stored in the given slot of the upper
+        //! triangle pattern, in either mode.
+        GeMatrix3 getOffDiagonalA( UInt32 slot ) const;
+        //@{
+        //! Blocks of S A S + ( I - S ), the system restricted to the
+        //! unconstrained directions. The diagonal is symmetrized.
+        GeMatrix3 getFilteredDiagonalA( UInt32 row ) const;
+        GeMatrix3 getFilteredOffDiagonalA(
+            UInt32 slot,
+            UInt32 row,
+            UInt32 col
+        ) const;
+        //@}
+        //! True if the preconditioner acts on each vertex separately, so
+        //! that it can be applied within the PCG sweeps.
+        bool isLocalPreconditioner() const;
+
         // ----- data members -----
         
-        SimMatrix       _P, _Pinv;
+        Preconditioner  _preconditioner;
+        //! Per-vertex preconditioner blocks and their inverses. For
+        //! PRECONDITIONER_IC0, these are the pivot blocks D of the factor.
+        std::vector<GeMatrix3> _P, _Pinv;
+        //! Strictly upper triangular blocks F of the incomplete Cholesky
+        //! factorization P = ( D + F )^T D^-1 ( D + F ), indexed by slot
+        //! of the pattern of A.
+        std::vector<GeMatrix3> _icF;
+        //! Pattern that the levels below were computed for.
+        RCShdPtr<SimMatrixPattern> _icPattern;
+        //@{
+        //! Dependency levels for forward and backward substitution. Every
+        //! row in a level depends only upon rows of earlier levels, so the
+        //! rows of a level may be processed concurrently.
+        std::vector<UInt32> _icForwardStarts, _icForwardRows;
+        std::vector<UInt32> _icBackwardStarts, _icBackwardRows;
+        //@}
+        //! Set for each row whose pivot broke down in the last
+        //! factorization.
+        std::vector<UInt8> _icBreakdowns;
+        //! Current diagonal shift, as a fraction of the diagonal.
+        Float           _icShift;
+        //@{
+        //! Operands for LEVEL_FORWARD and LEVEL_BACKWARD.
+        SimVector*      _levelDest;
+        const SimVector* _levelSrc;
+        //@}
+        Float           _preconditionerTime;
+        RCShdPtr<SimMultigrid> _multigrid;
+        RCShdPtr<SimSparseLDLT> _factorization;
+        //! S A S + ( I - S ), for PRECONDITIONER_MULTIGRID and
+        //! PRECONDITIONER_LDLT.
+        SymMatrix       _filteredA;
         bool            _done;
         UInt32          _nbSteps;
         Float           _tolerance;
+        //! Tolerance of the current solve, and whether it's relative to
+        //! the residual norm; see preStep( Float ).
+        Float           _stepTolerance;
+        bool            _relativeTolerance;
+        bool            _mixedPrecision;
+
+        OperatorMode    _operatorMode;
+        //@{
+        //! Operands for OPERATOR_MATRIX_FREE mode.
+        Float           _dxCoeff, _dvCoeff;
+        const SymMatrix* _df_dx;
+        const SymMatrix* _df_dv;
+        const TridiagMatrix* _mass;
+        //@}
 
         SimVector       _x, _bhat, _r, _c;
-        Float           _delta0, _deltaNew;
+        Double          _delta0, _deltaNew;
         
         // Temporaries within step()
         SimVector       _q, _s;
+        Float           _alpha, _beta;
+
+        RCShdPtr<SimThreadPool> _threadPool;
+        //@{
+        //! Operands for PASS_MULTIPLY.
+        SimVector*      _multiplyDest;
+        const SimVector* _multiplySrc;
+        //@}
+        //! Set if PASS_SEARCH's product has already been computed for all
+        //! rows, by multiplyAFull().
+        bool            _productReady;
+        //! Partial dot product of each chunk in the current pass.
+        std::vector<Double> _chunkSums;
     };
 
 
@@ -405,20 +946,29 @@ private:
      * Simple utility class to hold important data. This data is updated
      * during each step, and can be queried by the user between steps.
      * It is given its own class to help with adaptive time stepping, where
-     * we have to restore all of this data if a timestep fails.
+     * we have to restore all of this data if a timestep fails. Two copies
+     * are kept, and swapped as steps are taken and rolled back.
      */
     class StepData
     {
     public:
+        // ----- member functions -----
+
+        //! Exchange contents with another instance, without copying.
+        void swap( StepData& );
+
         // ----- data members -----
         
         //! Current time
-        Float           _time;
+        BaTime::Instant _time;
         SimVector       _f0;
         SimVector       _v0;
         SimVector       _lastDeltaV0;
+        //! Level of detail of the breakdowns below. Arrays beyond that
+        //! level are empty.
+        Diagnostics     _diagnostics;
         //@{
-        //! For debugging
+        //! For debugging. Only kept at DIAGNOSTICS_FULL.
         SimVector       _f0i[ NB_FORCES ];
         SimVector       _d0i[ NB_FORCES ];
         //@}
@@ -429,7 +979,8 @@ private:
         Float           _fenergy[ NB_FORCES ];
         //! Kinetic energy of cloth
         Float           _venergy;
-        //! Energy of cloth divided up into categories and triangles
+        //! Energy of cloth divided up into categories and triangles. Only
+        //! kept at DIAGNOSTICS_ENERGIES and above.
         std::vector<Float> _trienergy[ NB_FORCES ];
         std::vector<Float> _Cu,_Cv;
     };
@@ -441,36 +992,112 @@ private:
     //! and the density parameter, as per [BarWit98] section 2.2.
     void setupMass();
 
+    //! Step data reported by the accessors: that of the last successful
+    //! step, or the restored state after a failed one.
+    const StepData& getReportedStepData() const;
+    //! As getReportedStepData(), but with breakdowns to at least the given
+    //! level, computing them on demand if they weren't kept.
+    const StepData& getReportedStepData( Diagnostics ) const;
+    //! Size the breakdown arrays of the step data for _diagnostics,
+    //! releasing those that aren't needed.
+    void setupDiagnostics( StepData& ) const;
+    //! Compute all breakdowns of the reported step into
+    //! _diagnosticsCache, for positions x. The force kernels fill these in
+    //! as they go; this repeats their force computations without the
+    //! derivatives.
+    void calcDiagnostics( const GeMesh& x ) const;
     //! Code executed at the end of postSubSteps(). This does the step setup
     //! (temporary clearing) and stretch/shear calculation. In the normal
     //! scheme of things, this would be the start of preSubSteps(), but we
     //! need to do stretch calculation to test and see if the timestep
     //! succeeded or not, and roll back if necessary.
     void postSubStepsFinale();
+    //! Calculate the stretch and shear forces and derivatives of every
+    //! face, adding them to the cleared ones of postSubStepsFinale().
+    void calcStretchShear();
+    //! Calculate the bend, gravity and drag forces and derivatives, adding
+    //! them to those of postSubStepsFinale().
+    void calcRemainingForces();
+    //! Set up the matrix of [BarWit98] eq. (16) from the force
+    //! derivatives, ready for _modPCG.preStep().
+    void setupSystem();
+    //! Find the contacts with the collider's obstacles, and add their
+    //! constraints to _modPCG's, as per [BarWit98] section 5. Needs this
+    //! step's forces, to predict which vertices reach an obstacle.
+    void applyContacts();
+    //! Correct the velocity change deltaV of the step for self-collisions,
+    //! into _selfDeltaV.
+    void applySelfCollisions( const SimVector& deltaV );
+    //! Write the state after the velocity change deltaV into _sd and
+    //! _mesh, from the start of step state in _savedStepData and
+    //! _savedVertices.
+    void advanceState( const SimVector& deltaV );
+    //! Called by subStep() when a linear solve is done, if more than one
+    //! Newton iteration is allowed. Adds the solution into _newtonDeltaV,
+    //! and unless the iterations are done, relinearizes at the new state
+    //! and starts the next solve.
+    void newtonStep();
+    //! Start timing a phase from now into start, if profiling.
+    void startPhase( SimProfiler::Sample& start ) const;
+    //! Add the time and counts since start to the phase, and restart start
+    //! for the next phase. Returns the seconds elapsed, or zero if not
+    //! profiling.
+    Double endPhase( Phase, SimProfiler::Sample& start );
     //! Precompute values that don't change over time.
     void calcFaceConsts();
+    //! Symbolic assembly: find the matrix slots written by each face and
+    //! each interior edge, so that numeric assembly needs no searching.
+    //! Only depends upon the mesh topology.
+    void setupAssembly();
+    //! Run the task over each colour class in turn, as listed by
+    //! colourStarts. Elements of a single colour share no vertices, so
+    //! they can be assembled concurrently without locking. The per-thread
+    //! results are then reduced into acc.
+    void runColoured(
+        ColourTask&,
+        const std::vector<UInt32>& colourStarts,
+        AssemblyAccum& acc
+    );
     //! Calculate the stretch and shear conditions.
     void calcStretchShear(
-        const GeMesh::FaceWrapper& face
+        const GeMesh::FaceWrapper& face,
+        AssemblyAccum& acc
     );
     //! Calculate the stretch condition and its derivatives.
     void calcStretch(
         const GeMesh::FaceWrapper& face,
         const FaceConsts& fc,
         const CommonVars& cv,
-        const GeVector v0[ 3 ]
+        const GeVector v0[ 3 ],
+        AssemblyAccum& acc
     );
     //! Calculate the shear condition and its derivatives.
     void calcShear(
         const GeMesh::FaceWrapper& face,
         const FaceConsts& fc,
         const CommonVars& cv,
-        const GeVector v0[ 3 ]
+        const GeVector v0[ 3 ],
+        AssemblyAccum& acc
     );
     //! Calculate the bend condition and its derivatives.
     void calcBend(
-        const GeMeshWingedEdge::HalfEdgeWrapper& edge
+        const GeMeshWingedEdge::HalfEdgeWrapper& edge,
+        const BendStencil& stencil,
+        AssemblyAccum& acc
     );
+    //! Evaluate the bend condition variables for the interior edge, for
+    //! the positions of mesh, velocities v0 and the given face normal
+    //! data (see _faceUnitNormals). Fills in the edge's vertices, in the
+    //! order used by calcBend(), and returns the bend stiffness.
+    Float calcBendVars(
+        const GeMeshWingedEdge::HalfEdgeWrapper& edge,
+        const GeMesh& mesh,
+        const SimVector& v0,
+        const std::vector<GeVector>& unitNormals,
+        const std::vector<Float>& normalIMs,
+        GeMesh::VertexId vid[ 4 ],
+        BendVars& bv
+    ) const;
     //! Verify variables common to stretch/shear conditions.
     void verifyCommon();
     //! Verify the stretch condition and its derivatives.
@@ -501,6 +1128,10 @@ private:
     RCShdPtr<GeMeshWingedEdge> _initialMeshWingedEdge;
     //@} 
 
+    //! Sparsity pattern shared by all matrices in the simulation, built
+    //! from the mesh topology. Duration: class lifetime.
+    RCShdPtr<SimMatrixPattern> _pattern;
+
     //! Duration: updated after each step.
     RCShdPtr<GeMesh> _mesh;
     //! Duration: updated after each step.
@@ -510,10 +1141,33 @@ private:
     Params          _params;
     //! Density of cloth ( kg / m^2 ). Duration: user-defined, per-step.
     Float           _rho;
-    //! Timestep, measured in seconds. Duration: user-defined, per-step.
+    //! Timestep, exactly, and in seconds for the calculations. Duration:
+    //! user-defined, per-step.
+    BaTime::Duration _timestep;
     Float           _h;
+    //! Position constraints, to which contacts are added at each step.
+    //! Duration: user-defined, per-step.
+    std::vector<GeMatrix3> _S0;
     //! Velocity constraints. Duration: user-defined, per-step.
     SimVector       _z0;
+    //! Null if there are no obstacles. Duration: user-defined, per-step.
+    RCShdPtr<SimCollider> _collider;
+    //! Vertex binning and nearest obstacles found by applyContacts().
+    //! Duration: temporary used during preStep().
+    SimCollider::Grid _contactGrid;
+    std::vector<SimCollider::Contact> _contacts;
+    //! Vertices constrained by contacts. Duration: updated after each
+    //! step.
+    UInt32          _nbContacts;
+    //! Null unless self-collisions are enabled. Duration: user-defined,
+    //! per-step.
+    RCShdPtr<SimSelfCollider> _selfCollider;
+    //! Velocity change corrected by applySelfCollisions(), and the inverse
+    //! masses it uses. Duration: temporary used during postSubSteps().
+    SimVector       _selfDeltaV;
+    std::vector<Float> _inverseMasses;
+    //! Self-collision impulses. Duration: updated after each step.
+    UInt32          _nbSelfCollisions;
     //! Maximum stretch allowed in a successful step. Duration: user-defined,
     //! per-step.
     Float _stretchLimit;
@@ -522,6 +1176,9 @@ private:
     bool            _inStep;
     //! Step success flag. Duration: updated after each step.
     bool            _stepSuccessFlag;
+    //! Largest stretch change of the step. Duration: updated after each
+    //! step.
+    Float           _maxStretchChange;
 
 
     //! Mass per particle. Duration: class lifetime.
@@ -536,6 +1193,25 @@ private:
     //! Face constants. Used for optimisation of stretch/shear calculation.
     //! Duration: class lifetime.
     std::vector<FaceConsts> _faceConsts;
+    //! Matrix slots for each face. Duration: class lifetime.
+    std::vector<FaceStencil> _faceStencils;
+    //! Matrix slots for each interior edge, sorted by colour. Duration:
+    //! class lifetime.
+    std::vector<BendStencil> _bendStencils;
+    //! Colour class c of _bendStencils is [ _bendColourStarts[ c ],
+    //! _bendColourStarts[ c + 1 ] ). Duration: class lifetime.
+    std::vector<UInt32> _bendColourStarts;
+    //! Face ids, sorted by colour. Duration: class lifetime.
+    std::vector<GeMesh::FaceId> _faceOrder;
+    //! Colour class c of _faceOrder is [ _faceColourStarts[ c ],
+    //! _faceColourStarts[ c + 1 ] ). Duration: class lifetime.
+    std::vector<UInt32> _faceColourStarts;
+
+    //! Threads for assembly. Duration: user-defined, per-step.
+    RCShdPtr<SimThreadPool> _threadPool;
+    //! One accumulator per thread. Duration: temporary used during
+    //! assembly.
+    std::vector<AssemblyAccum> _threadAccums;
 
     //! Unit face normals. Used for optimisation of bend calculation.
     //! Duration: temporary used during preStep().
@@ -544,18 +1220,57 @@ private:
     //! calculation. Duration: temporary used during preStep().
     std::vector<Float>    _faceNormalIMs;
 
-    //! Saved data, restored if a timestep fails
+    //! Vertex positions at the start of the last step. The new positions
+    //! are written into the mesh's spare buffer, and the two are swapped
+    //! back if the step fails, so nothing is copied.
     std::vector<GePoint>  _savedVertices;
-    //! Saved data, restored if a timestep fails. Effectively, this contains
-    //! the step data for the last successful step.
+    //! Step data at the start of the last step, buffered with _sd as for
+    //! _savedVertices. Effectively, this contains the step data for the
+    //! last successful step, unless _stepRolledBack is set.
     StepData              _savedStepData;
+    //! Set if the last step failed, leaving _savedStepData holding the
+    //! discarded step's data.
+    bool                  _stepRolledBack;
+
+    //! Breakdowns kept with each step. Duration: user-defined, per-step.
+    Diagnostics           _diagnostics;
+    //! Breakdowns computed on demand for the reported step, if
+    //! _diagnosticsCacheValid. Duration: until the next step.
+    mutable StepData      _diagnosticsCache;
+    mutable bool          _diagnosticsCacheValid;
 
     //! If set, the postSubStepsFinale() routine will be called at the start
     //! of preSubSteps() instead of at the end of postSubSteps().
     bool                 _doFinaleInPre;
 
+    //! Newton iteration limit and tolerance. Duration: user-defined,
+    //! per-step.
+    UInt32          _newtonIterations;
+    Float           _newtonTolerance;
+    //! Linear solves started so far in this step, after the first.
+    //! Duration: updated after each step.
+    UInt32          _newtonIteration;
+    //! Set once newtonStep() has moved the state into _sd and _mesh, as
+    //! postSubSteps() does. Duration: temporary used during step
+    //! calculation.
+    bool            _newtonMoved;
+    //! Velocity change so far in this step, norm of the last system's
+    //! (filtered) right hand side, and last PCG tolerance. Duration:
+    //! temporary used during step calculation.
+    SimVector       _newtonDeltaV;
+    Float           _newtonResidual;
+    Float           _newtonForcing;
+    //! PCG iterations taken by this step's earlier solves. Duration:
+    //! updated after each step.
+    UInt32          _newtonPCGSteps;
+
     //! Duration: temporary used during step calculation.
     ModPCGSolver    _modPCG;
+
+    //! Null unless profiling. Duration: user-defined, per-step.
+    RCShdPtr<SimProfiler> _profiler;
+    //! Duration: updated after each step.
+    StepStats       _stepStats;
 };
 
 FREECLOTH_NAMESPACE_END
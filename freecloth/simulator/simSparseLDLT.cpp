@@ -0,0 +1,551 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <freecloth/simulator/simSparseLDLT.h>
+#include <freecloth/simulator/simMatrixPattern.h>
+#include <freecloth/geom/geMatrix3.h>
+#include <freecloth/base/algorithm>
+#include <freecloth/base/set>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    using namespace freecloth;
+
+    //! Pivots below this fraction of their original diagonal entry are
+    //! treated as zero by factor().
+    const Float PIVOT_TOLERANCE = 1e-6f;
+    //! Entries of the unit lower triangular factor smaller than this are
+    //! dropped. Their effect is far below rounding error, but left in, the
+    //! fill far from the diagonal decays into denormal numbers, which are
+    //! very slow to compute with on most processors.
+    const Float NEGLIGIBLE_ENTRY = 1e-12f;
+
+    enum { VERTEX_INVALID = ~0U };
+
+    //! Vertices awaiting elimination, by degree and then by index.
+    typedef std::set< std::pair<UInt32, UInt32> > DegreeQueue;
+}
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSparseLDLT
+
+//------------------------------------------------------------------------------
+
+SimSparseLDLT::SimSparseLDLT( const RCShdPtr<SimMatrixPattern>& pattern )
+  : _pattern( pattern ),
+    _nbPerturbedPivots( 0 )
+{
+    DGFX_ASSERT( pattern->isUpperTriangle() );
+    DGFX_ASSERT( pattern->nbRows() == pattern->nbColumns() );
+    orderMinimumDegree();
+    analyse();
+}
+
+//------------------------------------------------------------------------------
+
+SimSparseLDLT::~SimSparseLDLT()
+{
+}
+
+//------------------------------------------------------------------------------
+
+const RCShdPtr<SimMatrixPattern>& SimSparseLDLT::getPattern() const
+{
+    return _pattern;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSparseLDLT::getNbSupernodes() const
+{
+    return _superStarts.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSparseLDLT::getFactorSize() const
+{
+    return _values.size();
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimSparseLDLT::getNbPerturbedPivots() const
+{
+    return _nbPerturbedPivots;
+}
+
+//------------------------------------------------------------------------------
+
+void SimSparseLDLT::orderMinimumDegree()
+{
+    const SimMatrixPattern& pattern = *_pattern;
+    const UInt32 N = pattern.nbRows();
+    std::vector< std::vector<UInt32> > adjacent( N );
+    UInt32 i, k;
+    for ( i = 0; i < N; ++i ) {
+        const UInt32 end = pattern.getRowEnd( i );
+        for ( k = pattern.getRowBegin( i ); k < end; ++k ) {
+            const UInt32 j = pattern.getColumn( k );
+            if ( j != i ) {
+                adjacent[ i ].push_back( j );
+                adjacent[ j ].push_back( i );
+            }
+        }
+    }
+    DegreeQueue queue;
+    for ( i = 0; i < N; ++i ) {
+        std::sort( adjacent[ i ].begin(), adjacent[ i ].end() );
+        adjacent[ i ].erase(
+            std::unique( adjacent[ i ].begin(), adjacent[ i ].end() ),
+            adjacent[ i ].end()
+        );
+        queue.insert( std::make_pair( adjacent[ i ].size(), i ) );
+    }
+
+    // Eliminate the vertex of least degree, joining its neighbours into a
+    // clique, until none are left. Ties go to the lowest index, so the
+    // ordering is reproducible.
+    _perm.resize( N );
+    _invPerm.resize( N );
+    std::vector<UInt32> merged;
+    for ( UInt32 step = 0; step < N; ++step ) {
+        const UInt32 v = queue.begin()->second;
+        queue.erase( queue.begin() );
+        _perm[ step ] = v;
+        _invPerm[ v ] = step;
+        const std::vector<UInt32>& neighbours = adjacent[ v ];
+        for ( k = 0; k < neighbours.size(); ++k ) {
+            const UInt32 u = neighbours[ k ];
+            std::vector<UInt32>& adjacentU = adjacent[ u ];
+            queue.erase( std::make_pair( adjacentU.size(), u ) );
+            merged.resize( adjacentU.size() + neighbours.size() );
+            const std::vector<UInt32>::iterator mergedEnd = std::set_union(
+                adjacentU.begin(), adjacentU.end(),
+                neighbours.begin(), neighbours.end(),
+                merged.begin()
+            );
+            adjacentU.clear();
+            std::vector<UInt32>::const_iterator mi;
+            for ( mi = merged.begin(); mi != mergedEnd; ++mi ) {
+                if ( *mi != u && *mi != v ) {
+                    adjacentU.push_back( *mi );
+                }
+            }
+            queue.insert( std::make_pair( adjacentU.size(), u ) );
+        }
+        std::vector<UInt32>().swap( adjacent[ v ] );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSparseLDLT::analyse()
+{
+    const SimMatrixPattern& pattern = *_pattern;
+    const UInt32 N = pattern.nbRows();
+    UInt32 i, j, k;
+
+    // Below diagonal pattern of the reordered matrix, by column, and its
+    // transpose, by row.
+    std::vector< std::vector<UInt32> > lowerColumns( N ), lowerRows( N );
+    for ( i = 0; i < N; ++i ) {
+        const UInt32 end = pattern.getRowEnd( i );
+        for ( k = pattern.getRowBegin( i ); k < end; ++k ) {
+            const UInt32 a = _invPerm[ i ];
+            const UInt32 b = _invPerm[ pattern.getColumn( k ) ];
+            if ( a != b ) {
+                lowerColumns[ std::min( a, b ) ].push_back( std::max( a, b ) );
+                lowerRows[ std::max( a, b ) ].push_back( std::min( a, b ) );
+            }
+        }
+    }
+
+    // Elimination tree, by Liu's algorithm with path compression.
+    std::vector<UInt32> parent( N, VERTEX_INVALID );
+    std::vector<UInt32> ancestor( N, VERTEX_INVALID );
+    std::vector<UInt32> nbChildren( N, 0 );
+    for ( j = 0; j < N; ++j ) {
+        for ( k = 0; k < lowerRows[ j ].size(); ++k ) {
+            UInt32 r = lowerRows[ j ][ k ];
+            while ( ancestor[ r ] != VERTEX_INVALID && ancestor[ r ] != j ) {
+                const UInt32 next = ancestor[ r ];
+                ancestor[ r ] = j;
+                r = next;
+            }
+            if ( ancestor[ r ] == VERTEX_INVALID ) {
+                ancestor[ r ] = j;
+                parent[ r ] = j;
+                ++nbChildren[ j ];
+            }
+        }
+    }
+
+    // The pattern of column j of the factor is that of the matrix, plus
+    // those of the children of j in the tree.
+    std::vector< std::vector<UInt32> > structure( N );
+    for ( j = 0; j < N; ++j ) {
+        std::vector<UInt32>& column = structure[ j ];
+        column.swap( lowerColumns[ j ] );
+        std::sort( column.begin(), column.end() );
+        column.erase(
+            std::unique( column.begin(), column.end() ), column.end()
+        );
+        if ( parent[ j ] != VERTEX_INVALID ) {
+            std::vector<UInt32>& p = lowerColumns[ parent[ j ] ];
+            for ( k = 0; k < column.size(); ++k ) {
+                if ( column[ k ] != parent[ j ] ) {
+                    p.push_back( column[ k ] );
+                }
+            }
+        }
+    }
+
+    // Fundamental supernodes: j joins the supernode of j - 1 if j - 1 is
+    // its only child, and the pattern of j - 1 is that of j, plus j.
+    _superOf.resize( N );
+    _superStarts.clear();
+    for ( j = 0; j < N; ++j ) {
+        if ( j == 0 || parent[ j - 1 ] != j || nbChildren[ j ] != 1 ||
+            structure[ j - 1 ].size() != structure[ j ].size() + 1
+        ) {
+            _superStarts.push_back( j );
+        }
+        _superOf[ j ] = _superStarts.size() - 1;
+    }
+    const UInt32 nbSupernodes = _superStarts.size();
+    _superStarts.push_back( N );
+
+    _superRowStarts.resize( nbSupernodes + 1 );
+    _superValueStarts.resize( nbSupernodes + 1 );
+    _superRows.clear();
+    _superRowStarts[ 0 ] = 0;
+    _superValueStarts[ 0 ] = 0;
+    UInt32 maxWidth = 0;
+    UInt32 s;
+    for ( s = 0; s < nbSupernodes; ++s ) {
+        const UInt32 first = _superStarts[ s ];
+        const UInt32 last = _superStarts[ s + 1 ] - 1;
+        for ( j = first; j <= last; ++j ) {
+            _superRows.push_back( j );
+        }
+        _superRows.insert(
+            _superRows.end(), structure[ last ].begin(), structure[ last ].end()
+        );
+        _superRowStarts[ s + 1 ] = _superRows.size();
+        const UInt32 nbRows = _superRowStarts[ s + 1 ] - _superRowStarts[ s ];
+        const UInt32 nbColumns = last + 1 - first;
+        _superValueStarts[ s + 1 ] =
+            _superValueStarts[ s ] + 9 * nbRows * nbColumns;
+        maxWidth = std::max( maxWidth, 3 * nbColumns );
+    }
+    _values.resize( _superValueStarts[ nbSupernodes ] );
+    _update.resize( 3 * maxWidth );
+    _updateColumns.resize( maxWidth );
+    _relative.resize( N );
+    _work.resize( 3 * N );
+    _diagonal.resize( 3 * N );
+
+    // Where each block of the matrix goes in the factor.
+    _slotOffsets.resize( pattern.nbBlocks() );
+    _slotTransposed.resize( pattern.nbBlocks() );
+    for ( i = 0; i < N; ++i ) {
+        const UInt32 end = pattern.getRowEnd( i );
+        for ( k = pattern.getRowBegin( i ); k < end; ++k ) {
+            const UInt32 a = _invPerm[ i ];
+            const UInt32 b = _invPerm[ pattern.getColumn( k ) ];
+            const UInt32 col = std::min( a, b );
+            const UInt32 row = std::max( a, b );
+            s = _superOf[ col ];
+            const UInt32* rowsBegin = &_superRows[ _superRowStarts[ s ] ];
+            const UInt32* rowsEnd = rowsBegin +
+                ( _superRowStarts[ s + 1 ] - _superRowStarts[ s ] );
+            const UInt32* r = std::lower_bound( rowsBegin, rowsEnd, row );
+            DGFX_ASSERT( r != rowsEnd && *r == row );
+            const UInt32 ldim = 3 * ( rowsEnd - rowsBegin );
+            _slotOffsets[ k ] = _superValueStarts[ s ] +
+                3 * ( col - _superStarts[ s ] ) * ldim + 3 * ( r - rowsBegin );
+            _slotTransposed[ k ] = a < b;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSparseLDLT::factor( const SimSymMatrix& matrix )
+{
+    DGFX_ASSERT( matrix.getPattern() == _pattern );
+    const SimMatrixPattern& pattern = *_pattern;
+    const UInt32 N = pattern.nbRows();
+    std::fill( _values.begin(), _values.end(), 0.f );
+    UInt32 i, k, s;
+    for ( i = 0; i < N; ++i ) {
+        const UInt32 end = pattern.getRowEnd( i );
+        const UInt32 a = _invPerm[ i ];
+        for ( k = pattern.getRowBegin( i ); k < end; ++k ) {
+            const GeMatrix3& block = matrix.getBlock( k );
+            const bool diagonal = pattern.getColumn( k ) == i;
+            s = _superOf[ std::min( a, _invPerm[ pattern.getColumn( k ) ] ) ];
+            const UInt32 ldim =
+                3 * ( _superRowStarts[ s + 1 ] - _superRowStarts[ s ] );
+            Float* dest = &_values[ _slotOffsets[ k ] ];
+            for ( UInt32 c = 0; c < 3; ++c ) {
+                // Diagonal blocks only fill the lower triangle.
+                for ( UInt32 r = diagonal ? c : 0; r < 3; ++r ) {
+                    dest[ c * ldim + r ] = _slotTransposed[ k ] ?
+                        block( c, r ) : block( r, c );
+                }
+                if ( diagonal ) {
+                    _diagonal[ 3 * a + c ] = block( c, c );
+                }
+            }
+        }
+    }
+
+    _nbPerturbedPivots = 0;
+    const UInt32 nbSupernodes = getNbSupernodes();
+    for ( s = 0; s < nbSupernodes; ++s ) {
+        factorPanel( s );
+        updateAncestors( s );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSparseLDLT::factorPanel( UInt32 s )
+{
+    const UInt32 first = _superStarts[ s ];
+    const UInt32 width = 3 * ( _superStarts[ s + 1 ] - first );
+    const UInt32 ldim = 3 * ( _superRowStarts[ s + 1 ] - _superRowStarts[ s ] );
+    Float* panel = &_values[ _superValueStarts[ s ] ];
+    UInt32 i, j, k;
+
+    // Dense right-looking LDL^T, a vertex at a time. Each column holds A's
+    // entries, less the updates of the columns to its left, until it is
+    // scaled by its pivot.
+    for ( UInt32 k0 = 0; k0 < width; k0 += 3 ) {
+        for ( k = k0; k < k0 + 3; ++k ) {
+            Float* colK = panel + k * ldim;
+            const Float original = _diagonal[ 3 * first + k ];
+            if ( ! ( BaMath::abs( colK[ k ] ) >
+                    PIVOT_TOLERANCE * BaMath::abs( original ) )
+            ) {
+                colK[ k ] = original != 0 ? original : 1;
+                ++_nbPerturbedPivots;
+            }
+            const Float dInv = 1 / colK[ k ];
+            for ( j = k + 1; j < k0 + 3; ++j ) {
+                const Float f = colK[ j ] * dInv;
+                Float* colJ = panel + j * ldim;
+                for ( i = j; i < ldim; ++i ) {
+                    colJ[ i ] -= colK[ i ] * f;
+                }
+            }
+            for ( i = k + 1; i < ldim; ++i ) {
+                colK[ i ] *= dInv;
+                if ( BaMath::abs( colK[ i ] ) < NEGLIGIBLE_ENTRY ) {
+                    colK[ i ] = 0;
+                }
+            }
+        }
+
+        // Apply the vertex's three columns to the rest of the panel
+        // together, to save passes over it.
+        const Float* l0 = panel + k0 * ldim;
+        const Float* l1 = l0 + ldim;
+        const Float* l2 = l1 + ldim;
+        const Float d0 = l0[ k0 ];
+        const Float d1 = l1[ k0 + 1 ];
+        const Float d2 = l2[ k0 + 2 ];
+        for ( j = k0 + 3; j < width; ++j ) {
+            const Float f0 = l0[ j ] * d0;
+            const Float f1 = l1[ j ] * d1;
+            const Float f2 = l2[ j ] * d2;
+            if ( f0 == 0 && f1 == 0 && f2 == 0 ) {
+                continue;
+            }
+            Float* colJ = panel + j * ldim;
+            for ( i = j; i < ldim; ++i ) {
+                colJ[ i ] -= l0[ i ] * f0 + l1[ i ] * f1 + l2[ i ] * f2;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSparseLDLT::updateAncestors( UInt32 s )
+{
+    const UInt32 nbColumns = _superStarts[ s + 1 ] - _superStarts[ s ];
+    const UInt32 nbRows = _superRowStarts[ s + 1 ] - _superRowStarts[ s ];
+    const UInt32 width = 3 * nbColumns;
+    const UInt32 ldim = 3 * nbRows;
+    if ( nbRows == nbColumns ) {
+        return;
+    }
+    const Float* panel = &_values[ _superValueStarts[ s ] ];
+    const Float* below = panel + width;
+    const UInt32* rows = &_superRows[ _superRowStarts[ s ] ];
+    UInt32 i, k;
+
+    // The update is L_B D L_B^T, where L_B is the part of the panel below
+    // the diagonal block. It is computed a block at a time, down each
+    // block column of its lower triangle, and subtracted from the
+    // supernode owning the column's vertex. Consecutive vertices tend to
+    // share an owner, so the owner's row positions are only looked up when
+    // it changes. Every row from the column's vertex on is in the owner's
+    // pattern, by the nesting of the factor's columns.
+    UInt32 t = VERTEX_INVALID;
+    for ( UInt32 pc = nbColumns; pc < nbRows; ++pc ) {
+        if ( _superOf[ rows[ pc ] ] != t ) {
+            t = _superOf[ rows[ pc ] ];
+            const UInt32 tRowEnd = _superRowStarts[ t + 1 ];
+            for ( i = _superRowStarts[ t ]; i < tRowEnd; ++i ) {
+                _relative[ _superRows[ i ] ] = i - _superRowStarts[ t ];
+            }
+        }
+
+        // D L_B^T for the block column, keeping only the non-zero rows.
+        const UInt32 uCol = 3 * ( pc - nbColumns );
+        UInt32 nbActive = 0;
+        for ( k = 0; k < width; ++k ) {
+            const Float* l = below + k * ldim + uCol;
+            if ( l[ 0 ] == 0 && l[ 1 ] == 0 && l[ 2 ] == 0 ) {
+                continue;
+            }
+            const Float d = panel[ k * ldim + k ];
+            Float* f = &_update[ 3 * nbActive ];
+            f[ 0 ] = l[ 0 ] * d;
+            f[ 1 ] = l[ 1 ] * d;
+            f[ 2 ] = l[ 2 ] * d;
+            _updateColumns[ nbActive++ ] = k * ldim;
+        }
+        if ( nbActive == 0 ) {
+            continue;
+        }
+
+        const UInt32 tLdim =
+            3 * ( _superRowStarts[ t + 1 ] - _superRowStarts[ t ] );
+        Float* tPanel = &_values[ _superValueStarts[ t ] ] +
+            3 * ( rows[ pc ] - _superStarts[ t ] ) * tLdim;
+        for ( UInt32 pr = pc; pr < nbRows; ++pr ) {
+            const Float* lRow = below + 3 * ( pr - nbColumns );
+            Float u[ 3 ][ 3 ] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+            for ( k = 0; k < nbActive; ++k ) {
+                const Float* l = lRow + _updateColumns[ k ];
+                const Float* f = &_update[ 3 * k ];
+                for ( UInt32 c = 0; c < 3; ++c ) {
+                    u[ 0 ][ c ] += l[ 0 ] * f[ c ];
+                    u[ 1 ][ c ] += l[ 1 ] * f[ c ];
+                    u[ 2 ][ c ] += l[ 2 ] * f[ c ];
+                }
+            }
+            Float* dest = tPanel + 3 * _relative[ rows[ pr ] ];
+            for ( UInt32 c = 0; c < 3; ++c ) {
+                for ( UInt32 r = pr == pc ? c : 0; r < 3; ++r ) {
+                    dest[ c * tLdim + r ] -= u[ r ][ c ];
+                }
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimSparseLDLT::solve( SimVector& dest, const SimVector& src )
+{
+    const UInt32 N = _pattern->nbRows();
+    DGFX_ASSERT( src.size() == N );
+    UInt32 i, k, p, s;
+    for ( i = 0; i < N; ++i ) {
+        const UInt32 a = 3 * _invPerm[ i ];
+        for ( k = 0; k < 3; ++k ) {
+            _work[ a + k ] = src[ i ][ k ];
+        }
+    }
+
+    // The rows of a panel are its own vertices, which are contiguous, and
+    // then those below, which are scattered.
+    const UInt32 nbSupernodes = getNbSupernodes();
+    for ( s = 0; s < nbSupernodes; ++s ) {
+        const UInt32 base = 3 * _superStarts[ s ];
+        const UInt32 width = 3 * _superStarts[ s + 1 ] - base;
+        const UInt32 nbRows = _superRowStarts[ s + 1 ] - _superRowStarts[ s ];
+        const UInt32 ldim = 3 * nbRows;
+        const UInt32* rows = &_superRows[ _superRowStarts[ s ] ];
+        const Float* panel = &_values[ _superValueStarts[ s ] ];
+        Float* x = &_work[ base ];
+        for ( k = 0; k < width; ++k ) {
+            const Float xk = x[ k ];
+            if ( xk == 0 ) {
+                continue;
+            }
+            const Float* colK = panel + k * ldim;
+            for ( i = k + 1; i < width; ++i ) {
+                x[ i ] -= colK[ i ] * xk;
+            }
+            for ( p = width / 3; p < nbRows; ++p ) {
+                Float* y = &_work[ 3 * rows[ p ] ];
+                y[ 0 ] -= colK[ 3 * p ] * xk;
+                y[ 1 ] -= colK[ 3 * p + 1 ] * xk;
+                y[ 2 ] -= colK[ 3 * p + 2 ] * xk;
+            }
+        }
+        for ( k = 0; k < width; ++k ) {
+            x[ k ] /= panel[ k * ldim + k ];
+        }
+    }
+    for ( s = nbSupernodes; s-- > 0; ) {
+        const UInt32 base = 3 * _superStarts[ s ];
+        const UInt32 width = 3 * _superStarts[ s + 1 ] - base;
+        const UInt32 nbRows = _superRowStarts[ s + 1 ] - _superRowStarts[ s ];
+        const UInt32 ldim = 3 * nbRows;
+        const UInt32* rows = &_superRows[ _superRowStarts[ s ] ];
+        const Float* panel = &_values[ _superValueStarts[ s ] ];
+        Float* x = &_work[ base ];
+        for ( k = width; k-- > 0; ) {
+            const Float* colK = panel + k * ldim;
+            Float sum = x[ k ];
+            for ( p = width / 3; p < nbRows; ++p ) {
+                const Float* y = &_work[ 3 * rows[ p ] ];
+                sum -= colK[ 3 * p ] * y[ 0 ] + colK[ 3 * p + 1 ] * y[ 1 ] +
+                    colK[ 3 * p + 2 ] * y[ 2 ];
+            }
+            for ( i = k + 1; i < width; ++i ) {
+                sum -= colK[ i ] * x[ i ];
+            }
+            x[ k ] = sum;
+        }
+    }
+
+    if ( dest.size() != N ) {
+        dest = SimVector( N );
+    }
+    for ( i = 0; i < N; ++i ) {
+        const UInt32 a = 3 * _invPerm[ i ];
+        for ( k = 0; k < 3; ++k ) {
+            dest[ i ][ k ] = _work[ a + k ];
+        }
+    }
+}
+
+FREECLOTH_NAMESPACE_END
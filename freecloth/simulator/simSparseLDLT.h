@@ -0,0 +1,157 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_sim_simSparseLDLT_h
+#define freecloth_sim_simSparseLDLT_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_sim_simSymMatrix_h
+#include <freecloth/simulator/simSymMatrix.h>
+#endif
+
+#ifndef freecloth_sim_simVector_h
+#include <freecloth/simulator/simVector.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+#ifndef freecloth_resmgt_rcShdPtr_h
+#include <freecloth/resmgt/rcShdPtr.h>
+#endif
+
+#ifndef freecloth_base_vector
+#include <freecloth/base/vector>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSparseLDLT freecloth/simulator/simSparseLDLT.h
+ * \brief Direct supernodal LDL^T factorization of symmetric block sparse
+ * systems.
+ *
+ * The work is split in two. The symbolic analysis depends only upon the
+ * pattern, and so, for cloth, only upon the mesh topology: it is done once,
+ * at construction. The vertices are reordered by minimum degree to limit
+ * fill, the elimination tree and the pattern of the factor are computed,
+ * and vertices with nested patterns are grouped into supernodes. The
+ * numeric factorization, factor(), is then redone whenever the values
+ * change, and only has to fill in dense supernode panels at positions
+ * known in advance. Its cost is the same from one call to the next.
+ *
+ * Factorization is of the scalar entries, without pivoting, so the matrix
+ * need not be positive definite, as long as its leading minors don't
+ * vanish. Pivots that do are replaced by their original diagonal entry,
+ * which leaves an approximate factorization; see getNbPerturbedPivots().
+ *
+ * Fill grows faster than the number of vertices, so this is aimed at small
+ * and medium meshes, of up to ten thousand or so vertices.
+ */
+class SimSparseLDLT : public RCBase
+{
+public:
+    // ----- member functions -----
+
+    //! Analyse systems with the given upper triangular pattern.
+    explicit SimSparseLDLT( const RCShdPtr<SimMatrixPattern>& pattern );
+    virtual ~SimSparseLDLT();
+
+    const RCShdPtr<SimMatrixPattern>& getPattern() const;
+    //! Number of supernodes.
+    UInt32 getNbSupernodes() const;
+    //! Number of scalar entries stored for the factor, including the
+    //! dense diagonal blocks of the supernodes.
+    UInt32 getFactorSize() const;
+
+    //! Compute the numeric factorization of the matrix, which must use the
+    //! pattern given at construction. Only the upper triangle is read.
+    void factor( const SimSymMatrix& );
+    //! Number of pivots replaced by the last factor().
+    UInt32 getNbPerturbedPivots() const;
+    //! dest = A^-1 src, for the matrix last given to factor(). dest and
+    //! src may be the same vector.
+    void solve( SimVector& dest, const SimVector& src );
+
+private:
+    // ----- member functions -----
+
+    // Factorizations are shared, not copied.
+    SimSparseLDLT( const SimSparseLDLT& );
+    SimSparseLDLT& operator=( const SimSparseLDLT& );
+
+    //! Compute _perm and _invPerm.
+    void orderMinimumDegree();
+    //! Compute the supernodes and their row lists, from the permuted
+    //! pattern.
+    void analyse();
+    //! Factor supernode s's panel, once all updates have been applied.
+    void factorPanel( UInt32 s );
+    //! Subtract the update from the factored supernode s from the panels
+    //! of the supernodes it affects.
+    void updateAncestors( UInt32 s );
+
+    // ----- data members -----
+
+    RCShdPtr<SimMatrixPattern> _pattern;
+    //@{
+    //! Fill-reducing ordering: vertex _perm[ i ] of the matrix is vertex i
+    //! of the factor, and _invPerm is the inverse.
+    std::vector<UInt32> _perm, _invPerm;
+    //@}
+    //! Supernode s covers the factor's vertices [ _superStarts[ s ],
+    //! _superStarts[ s + 1 ] ).
+    std::vector<UInt32> _superStarts;
+    //! Supernode of each of the factor's vertices.
+    std::vector<UInt32> _superOf;
+    //! The rows of supernode s are _superRows[ _superRowStarts[ s ] ..
+    //! _superRowStarts[ s + 1 ] ), in increasing order, starting with its
+    //! own vertices.
+    std::vector<UInt32> _superRowStarts, _superRows;
+    //! Supernode s's panel is stored at _values[ _superValueStarts[ s ] ],
+    //! column-major, with three scalar rows and columns per vertex. On and
+    //! below the diagonal, it holds the unit lower triangular factor L,
+    //! except for the diagonal, which holds D.
+    std::vector<UInt32> _superValueStarts;
+    std::vector<Float> _values;
+    //@{
+    //! Panel offset of the first entry of each slot of the pattern, and
+    //! whether the block is stored transposed in the factor.
+    std::vector<UInt32> _slotOffsets;
+    std::vector<UInt8> _slotTransposed;
+    //@}
+    //! Original diagonal entry of each scalar row of the factor.
+    std::vector<Float> _diagonal;
+    UInt32          _nbPerturbedPivots;
+    //@{
+    //! Work space for updateAncestors() and solve().
+    std::vector<Float> _update;
+    std::vector<UInt32> _updateColumns;
+    std::vector<UInt32> _relative;
+    std::vector<Float> _work;
+    //@}
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif
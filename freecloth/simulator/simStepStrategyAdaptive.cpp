@@ -17,7 +17,7 @@
 // Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 
 #include <freecloth/simulator/simStepStrategyAdaptive.h>
-#include <freecloth/simulator/simSimulator.h>
+#include <freecloth/simulator/simThreadPool.h>
 
 ////////////////////////////////////////////////////////////////////////////////
 // LOCAL DECLARATIONS
@@ -29,10 +29,96 @@ namespace {
     const UInt32 NB_INTERNAL_STEPS_INC_DEFAULT = 2;
     const UInt32 MAX_NB_INTERNAL_STEPS_INC = 40;
     const Float INC_CHANGE_FACTOR = 1.5f;
+    //! Most ticks by which whole timesteps may miss the end of a frame.
+    //! Timesteps are rounded down to whole ticks, so a frame of n steps
+    //! can be short by up to n ticks.
+    const BaTime::Duration MAX_STEP_REMAINDER = 1024;
+    //@{
+    //! Timestep ladder; see SimStepStrategyAdaptive::changeStep().
+    const Int32 MAX_DENOM = 6;
+    const Int32 MIN_POW = -3;
+    const Int32 MAX_SIZE = MAX_DENOM - 1;
+    //@}
+    const UInt32 MAX_SUBSTEPS = 1500;
 }
 
 FREECLOTH_NAMESPACE_START
 
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimStepStrategyAdaptive::SpeculateTask
+
+/*!
+ * Steps one candidate per item, each on its own simulator, reached through
+ * the strategy.
+ */
+class SimStepStrategyAdaptive::SpeculateTask : public SimThreadPool::Task
+{
+public:
+    explicit SpeculateTask( SimStepStrategyAdaptive& strategy )
+      : _strategy( strategy )
+    {
+    }
+
+    virtual void run( UInt32 begin, UInt32 end, UInt32 )
+    {
+        for ( UInt32 i = begin; i < end; ++i ) {
+            Candidate& candidate = _strategy._candidates[ i ];
+            Simulator& simulator = _strategy.getCandidateSimulator( i );
+            simulator.setTimestep( candidate._h );
+            simulator.preSubSteps();
+            UInt32 nbSubSteps = 0;
+            while (
+                ! simulator.subStepsDone() &&
+                nbSubSteps <= _strategy._maxSubSteps
+            ) {
+                ++nbSubSteps;
+                simulator.subStep();
+            }
+            if ( simulator.subStepsDone() ) {
+                simulator.postSubSteps();
+                candidate._succeeded = simulator.stepSucceeded();
+            }
+            else {
+                simulator.cancelStep();
+                candidate._succeeded = false;
+            }
+            candidate._nbPCGIterations = simulator.getNbPCGIterations();
+        }
+    }
+
+private:
+    SimStepStrategyAdaptive& _strategy;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimStepStrategyAdaptive::FrameStats
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyAdaptive::FrameStats::clear()
+{
+    _nbInternalSteps = 0;
+    _nbFailedSteps = 0;
+    _nbPCGIterations = 0;
+    _stepStats.clear();
+    _nbSpeculations = 0;
+    _nbSpeculationWins = 0;
+}
+
+//------------------------------------------------------------------------------
+
+SimStepStrategyAdaptive::FrameStats&
+SimStepStrategyAdaptive::FrameStats::operator+=( const FrameStats& rhs )
+{
+    _nbInternalSteps += rhs._nbInternalSteps;
+    _nbFailedSteps += rhs._nbFailedSteps;
+    _nbPCGIterations += rhs._nbPCGIterations;
+    _stepStats += rhs._stepStats;
+    _nbSpeculations += rhs._nbSpeculations;
+    _nbSpeculationWins += rhs._nbSpeculationWins;
+    return *this;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // CLASS SimStepStrategyAdaptive
 
@@ -42,10 +128,12 @@ SimStepStrategyAdaptive::SimStepStrategyAdaptive(
     const RCShdPtr<Simulator>& simulator,
     UInt32 frameRate
 ) : BaseClass( simulator ),
-    _maxSubSteps( 1500 ),
-    _size( 0 )
+    _maxSubSteps( MAX_SUBSTEPS ),
+    _size( 0 ),
+    _nbCandidates( 0 )
 {
     _inStep = false;
+    _frameStats.clear();
     setFrameRate( frameRate );
     // Set _h to match _size
     changeStep( 0 );
@@ -62,6 +150,7 @@ void SimStepStrategyAdaptive::rewind()
     _frame = 0;
     _size = 0;
     changeStep( 0 );
+    _frameStats.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -77,14 +166,16 @@ bool SimStepStrategyAdaptive::subStepsDone() const
 void SimStepStrategyAdaptive::preSubSteps()
 {
     DGFX_ASSERT( !inStep() );
-    _stepEnd = BaTime::floatAsInstant(
-        static_cast<Float>(_frame + 1) / _frameRate
-    );
-    _simulator->setTimestep( _h );
-    _simulator->preSubSteps();
+    _stepEnd = BaTime::Instant( _frame + 1 ) * BaTime::S / _frameRate;
+    _frameStats.clear();
+    _fullStep = true;
+    // In speculative mode, each subStep() takes a whole internal step.
+    if ( ! isSpeculative() ) {
+        _simulator->setTimestep( clipStep( _h, _fullStep ) );
+        _simulator->preSubSteps();
+    }
     _nbSubSteps = 0;
     _doneSubSteps = false;
-    _fullStep = true;
     _inStep = true;
     _stepFailed = false;
 }
@@ -94,10 +185,15 @@ void SimStepStrategyAdaptive::preSubSteps()
 void SimStepStrategyAdaptive::subStep()
 {
     DGFX_ASSERT( inStep() );
+    if ( isSpeculative() ) {
+        speculate();
+        return;
+    }
     if ( !_simulator->subStepsDone() ) {
         if ( _nbSubSteps > _maxSubSteps ) {
             _stepFailed = true;
             _simulator->cancelStep();
+            recordStep( false );
         }
         else {
             ++_nbSubSteps;
@@ -106,6 +202,7 @@ void SimStepStrategyAdaptive::subStep()
     }
     else {
         _simulator->postSubSteps();
+        recordStep( _simulator->stepSucceeded() );
         if ( _simulator->stepSucceeded() ) {
             if ( _fullStep ) {
                 ++_nbInternalSteps;
@@ -123,36 +220,7 @@ void SimStepStrategyAdaptive::subStep()
                     _doneSubSteps = true;
                 }
                 else {
-                    const BaTime::Duration fudge(
-                        BaTime::floatAsDuration( 0.001f )
-                    );
-                    // If this is positive, the current timestep will take us
-                    // past the end-of-frame.
-                    BaTime::Duration diff(
-                        _simulator->getTime() + _h - _stepEnd
-                    );
-                    if ( diff > fudge ) {
-                        // This will take us way past the end-of-frame.
-                        // Use a temporary smaller step size to compensate.
-                        _fullStep = false;
-                        _simulator->setTimestep( BaTime::getDuration(
-                            _simulator->getTime(), _stepEnd
-                        ) );
-                    }
-                    else if ( diff > -fudge ) {
-                        // Our time step will take us right to end-of-frame,
-                        // with a little numerical fudging. Treat this is a
-                        // full step, but make sure we get *exactly* to the
-                        // end of frame.
-                        _simulator->setTimestep( BaTime::getDuration(
-                            _simulator->getTime(), _stepEnd
-                        ) );
-                    }
-                    else {
-                        // Our timestep won't take us close to end-of-frame.
-                        // Just go.
-                        _simulator->setTimestep( _h );
-                    }
+                    _simulator->setTimestep( clipStep( _h, _fullStep ) );
                     // Start next internal step.
                     _simulator->preSubSteps();
                     _nbSubSteps = 0;
@@ -171,8 +239,8 @@ void SimStepStrategyAdaptive::subStep()
     if ( _stepFailed ) {
         _stepFailed = false;
 
-        // FIXME: deal with case where fullStep is false.
-        // Internal step failed.
+        // Internal step failed. A mini step to reach the end of frame is
+        // shorter than _h, so its failure also calls for a smaller _h.
         if ( _nbInternalSteps == 0 ) {
             // This was the first try with this stepsize, so we probably
             // just increased the stepsize. Drop it back down, and increase
@@ -193,7 +261,8 @@ void SimStepStrategyAdaptive::subStep()
             _nbInternalStepsInc = NB_INTERNAL_STEPS_INC_DEFAULT;
             _nbInternalSteps = 0;
         }
-        _simulator->setTimestep( _h );
+        // The smaller step may still pass the end of frame.
+        _simulator->setTimestep( clipStep( _h, _fullStep ) );
         _simulator->preSubSteps();
         _nbSubSteps = 0;
     }
@@ -203,22 +272,156 @@ void SimStepStrategyAdaptive::subStep()
 
 void SimStepStrategyAdaptive::changeStep( Int32 inc )
 {
-    static const Int32 maxDenom = 6;
-    static const Int32 minPow = -3;
-    static const Int32 maxSize = maxDenom - 1;
-    _size = std::min( maxSize, _size + inc );
-    if ( _size >= 0 ) {
+    _size = std::min( MAX_SIZE, _size + inc );
+    _h = calcStep( _size );
+}
+
+//------------------------------------------------------------------------------
+
+BaTime::Duration SimStepStrategyAdaptive::calcStep( Int32 size ) const
+{
+    DGFX_ASSERT( size <= MAX_SIZE );
+    if ( size >= 0 ) {
         // In this regime, the timestep is a constant fraction of the frame
         // period. The size defines the denominator of the fraction.
-        const Int32 denom = maxSize - _size + 1;
-        _h = BaTime::floatAsDuration( 1.f/_frameRate ) / denom;
+        const Int32 denom = MAX_SIZE - size + 1;
+        return BaTime::fraction( 1, _frameRate * denom );
     }
     else {
         // In this regime, the timestep is a power-of-2 fraction of the
         // frame period. The size defines the exponent of the power of two.
-        const Int32 exp = _size + 1 + minPow;
-        DGFX_ASSERT( exp < minPow && exp <= 0 );
-        _h = BaTime::floatAsDuration( 1.f/_frameRate ) / ( 1 << -exp );
+        const Int32 exp = size + 1 + MIN_POW;
+        DGFX_ASSERT( exp <= MIN_POW && exp <= 0 );
+        return BaTime::fraction( 1, _frameRate << -exp );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+BaTime::Duration SimStepStrategyAdaptive::clipStep(
+    BaTime::Duration h,
+    bool& fullStep
+) const
+{
+    // Timesteps are exact fractions of the frame period, but for the
+    // remainder of the division into ticks, which may leave a few ticks to
+    // absorb at the end.
+    const BaTime::Duration fudge( MAX_STEP_REMAINDER );
+    const BaTime::Duration remaining(
+        BaTime::getDuration( _simulator->getTime(), _stepEnd )
+    );
+    fullStep = true;
+    if ( h - remaining > fudge ) {
+        // This will take us way past the end-of-frame. Use a temporary
+        // smaller step size to compensate.
+        fullStep = false;
+        return remaining;
+    }
+    if ( h - remaining >= -fudge ) {
+        // Our time step will take us right to end-of-frame, give or take a
+        // remainder. Treat this as a full step, but make sure we get
+        // *exactly* to the end of frame.
+        return remaining;
+    }
+    return h;
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyAdaptive::speculate()
+{
+    // Candidates, largest first: the next larger timestep, the current one
+    // and the next smaller one, as for the serial steps, cut down to reach
+    // the end of frame.
+    _nbCandidates = 0;
+    for (
+        Int32 size = std::min( _size + 1, MAX_SIZE ); size >= _size - 1;
+        --size
+    ) {
+        Candidate c;
+        c._size = size;
+        c._h = clipStep( calcStep( size ), c._fullStep );
+        // Timesteps cut down to the same length are tried once, under the
+        // size nearest the current one, so that reaching the end of frame
+        // doesn't change the size.
+        if (
+            _nbCandidates > 0 &&
+            _candidates[ _nbCandidates - 1 ]._h == c._h
+        ) {
+            if ( _candidates[ _nbCandidates - 1 ]._size > _size ) {
+                _candidates[ _nbCandidates - 1 ] = c;
+            }
+            continue;
+        }
+        _candidates[ _nbCandidates++ ] = c;
+    }
+
+    // The simulator tries the largest timestep itself, so that it needs no
+    // copying back if that succeeds.
+    UInt32 i;
+    for ( i = 1; i < _nbCandidates; ++i ) {
+        getCandidateSimulator( i ).copyState( *_simulator );
+    }
+    SpeculateTask task( *this );
+    _speculationPool->run( task, _nbCandidates );
+
+    ++_frameStats._nbSpeculations;
+    for ( i = 0; i < _nbCandidates; ++i ) {
+        _frameStats._nbPCGIterations += _candidates[ i ]._nbPCGIterations;
+    }
+    if ( _simulator->isProfiling() ) {
+        _frameStats._stepStats += _simulator->getStepStats();
+    }
+    UInt32 winner = 0;
+    while ( winner < _nbCandidates && ! _candidates[ winner ]._succeeded ) {
+        ++winner;
+    }
+    if ( winner == _nbCandidates ) {
+        // All failed. Retry below the smallest.
+        ++_frameStats._nbFailedSteps;
+        changeStep( _candidates[ _nbCandidates - 1 ]._size - 1 - _size );
+        return;
+    }
+
+    ++_frameStats._nbInternalSteps;
+    const Candidate& c = _candidates[ winner ];
+    if ( winner > 0 ) {
+        _simulator->copyState( getCandidateSimulator( winner ) );
+    }
+    if ( c._size != _size ) {
+        ++_frameStats._nbSpeculationWins;
+    }
+    // As for serial steps, a step cut down to the end of frame says nothing
+    // about whether the timestep could grow.
+    if ( c._fullStep || c._size < _size ) {
+        changeStep( c._size - _size );
+    }
+    if ( _simulator->getTime() >= _stepEnd ) {
+        _doneSubSteps = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimStepStrategyAdaptive::Simulator&
+SimStepStrategyAdaptive::getCandidateSimulator( UInt32 i )
+{
+    return i == 0 ? *_simulator : *_speculators[ i - 1 ];
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyAdaptive::recordStep( bool succeeded )
+{
+    if ( succeeded ) {
+        ++_frameStats._nbInternalSteps;
+    }
+    else {
+        ++_frameStats._nbFailedSteps;
+    }
+    _frameStats._nbPCGIterations += _simulator->getNbPCGIterations();
+    if ( _simulator->isProfiling() ) {
+        _frameStats._stepStats += _simulator->getStepStats();
     }
 }
 
@@ -237,7 +440,11 @@ void SimStepStrategyAdaptive::cancelStep()
 {
     DGFX_ASSERT( inStep() );
     // FIXME: this will still leave the simulator mid-frame.
-    _simulator->cancelStep();
+    // Speculative steps complete within subStep().
+    if ( _simulator->inStep() ) {
+        _simulator->cancelStep();
+        recordStep( false );
+    }
     _inStep = false;
 }
 
@@ -261,12 +468,9 @@ void SimStepStrategyAdaptive::setFrameRate( UInt32 frameRate )
 {
     DGFX_ASSERT( !inStep() );
     _frameRate = frameRate;
-    BaTime::Duration framePeriod = BaTime::floatAsDuration( 1.f / frameRate );
+    const BaTime::Duration framePeriod = BaTime::fraction( 1, frameRate );
     _h = std::min( _simulator->getTimestep(), framePeriod );
-    _frame = BaMath::floorUInt32(
-        BaTime::instantAsSeconds( _simulator->getTime() ) /
-        BaTime::durationAsSeconds( framePeriod )
-    );
+    _frame = UInt32( _simulator->getTime() * frameRate / BaTime::S );
     _nbInternalStepsInc = NB_INTERNAL_STEPS_INC_DEFAULT;
     _nbInternalSteps = 0;
 }
@@ -278,4 +482,40 @@ UInt32 SimStepStrategyAdaptive::getFrameRate() const
     return _frameRate;
 }
 
+//------------------------------------------------------------------------------
+
+void SimStepStrategyAdaptive::setSpeculative( bool speculative )
+{
+    DGFX_ASSERT( !inStep() );
+    if ( ! speculative ) {
+        _speculationPool = RCShdPtr<SimThreadPool>();
+        _speculators.clear();
+    }
+    else if ( _speculationPool.isNull() ) {
+        _speculationPool = RCShdPtr<SimThreadPool>(
+            new SimThreadPool( NB_CANDIDATES )
+        );
+        for ( UInt32 i = 1; i < NB_CANDIDATES; ++i ) {
+            _speculators.push_back( RCShdPtr<Simulator>(
+                new Simulator( _simulator->getInitialMesh() )
+            ) );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+bool SimStepStrategyAdaptive::isSpeculative() const
+{
+    return ! _speculationPool.isNull();
+}
+
+//------------------------------------------------------------------------------
+
+const SimStepStrategyAdaptive::FrameStats&
+SimStepStrategyAdaptive::getFrameStats() const
+{
+    return _frameStats;
+}
+
 FREECLOTH_NAMESPACE_END
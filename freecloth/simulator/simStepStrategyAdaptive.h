@@ -27,15 +27,25 @@
 #include <freecloth/simulator/simStepStrategy.h>
 #endif
 
+#ifndef freecloth_sim_simSimulator_h
+#include <freecloth/simulator/simSimulator.h>
+#endif
+
 #ifndef freecloth_base_baTime_h
 #include <freecloth/base/baTime.h>
 #endif
 
+#ifndef freecloth_base_vector
+#include <freecloth/base/vector>
+#endif
+
 FREECLOTH_NAMESPACE_START
 
 ////////////////////////////////////////////////////////////////////////////////
 // FORWARD DECLARATIONS
 
+class SimThreadPool;
+
 ////////////////////////////////////////////////////////////////////////////////
 /*!
  * \class SimStepStrategyAdaptive freecloth/simulator/simStepStrategyAdaptive.h
@@ -52,6 +62,15 @@ FREECLOTH_NAMESPACE_START
  * the frame period. We differentiate between calls to step(), "frames",
  * and the calls to the simulator's step function, "internal steps". An
  * adaptive stepsize is used, as per [BarWit98].
+ *
+ * The work done for each frame is summed up in FrameStats.
+ *
+ * In speculative mode, each internal step tries the current timestep, the
+ * next larger and the next smaller at once, on separate threads and copies
+ * of the simulator, and keeps the largest that succeeds. A failure then
+ * costs no extra time, unless all three fail, and the timestep grows as
+ * soon as a larger one succeeds, rather than after a wait. Each internal
+ * step is done in full by a single subStep() call.
  */
 class SimStepStrategyAdaptive : public SimStepStrategy
 {
@@ -60,6 +79,46 @@ public:
     // ----- types and enumerations -----
     typedef SimStepStrategy BaseClass;
 
+    // ----- classes -----
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class FrameStats freecloth/simulator/simStepStrategyAdaptive.h
+     * \brief Totals over the internal steps of a frame.
+     */
+    class FrameStats
+    {
+    public:
+        // ----- member functions -----
+
+        void clear();
+        FrameStats& operator+=( const FrameStats& );
+
+        // ----- data members -----
+
+        //! Internal steps that succeeded, including any shortened one at
+        //! the end of the frame.
+        UInt32          _nbInternalSteps;
+        //! Internal steps that exceeded the stretch limit, or took too
+        //! many substeps, and were retried with a smaller timestep.
+        UInt32          _nbFailedSteps;
+        //! PCG iterations of all internal steps, failed ones included.
+        UInt32          _nbPCGIterations;
+        //! Sum of the simulator's step stats over all internal steps.
+        //! Empty unless the simulator is profiling. In speculative mode,
+        //! only the steps taken by the simulator itself are included.
+        Simulator::StepStats _stepStats;
+        //! Internal steps tried speculatively, including those where all
+        //! timesteps failed. The PCG iterations of all the timesteps tried
+        //! are counted, but only failures of all of them count as failed
+        //! steps.
+        UInt32          _nbSpeculations;
+        //! Speculative steps that kept a timestep other than the current
+        //! one: a larger one, or a smaller one when the current one
+        //! failed. Each saved a serial step.
+        UInt32          _nbSpeculationWins;
+    };
+
     // ----- member functions -----
 
     //! Frame rate is number of frames per second
@@ -79,12 +138,63 @@ public:
 
     void setFrameRate( UInt32 );
     UInt32 getFrameRate() const;
+    //! Select speculative mode; see the class description. This takes
+    //! three threads, and two extra simulators. The simulator's own thread
+    //! count applies to the current timestep; the others are stepped
+    //! single-threaded. Disabled by default.
+    void setSpeculative( bool );
+    bool isSpeculative() const;
+    //! Totals for the last frame, or for the frame in progress.
+    const FrameStats& getFrameStats() const;
 
 private:
+    // ----- classes -----
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class Candidate freecloth/simulator/simStepStrategyAdaptive.h
+     * \brief A timestep tried by a speculative step.
+     */
+    class Candidate
+    {
+    public:
+        // ----- data members -----
+
+        //! Size of the timestep; see changeStep().
+        Int32           _size;
+        //! Timestep, shortened to reach the end of frame if need be.
+        BaTime::Duration _h;
+        //! False if the timestep was shortened to reach the end of frame.
+        bool            _fullStep;
+        bool            _succeeded;
+        UInt32          _nbPCGIterations;
+    };
+
+    //! Internal class used to step the candidates on the pool.
+    class SpeculateTask;
+    friend class SpeculateTask;
+
+    // ----- types and enumerations -----
+
+    enum { NB_CANDIDATES = 3 };
+
     // ----- member functions -----
 
+    //! Add the internal step just completed or cancelled to _frameStats.
+    void recordStep( bool succeeded );
+
     //! Grow or shrink the timestep. Adds inc to _size, and updates _h to match.
     void changeStep( Int32 inc );
+    //! Timestep for the given size, on the ladder of frame period
+    //! fractions.
+    BaTime::Duration calcStep( Int32 size ) const;
+    //! Timestep h from the current time, cut down to reach the end of frame
+    //! if it would pass it. fullStep is set false if it was cut down.
+    BaTime::Duration clipStep( BaTime::Duration h, bool& fullStep ) const;
+    //! Take one internal step speculatively.
+    void speculate();
+    //! The simulator that steps candidate i.
+    Simulator& getCandidateSimulator( UInt32 i );
 
     // ----- data members -----
     UInt32 _frameRate;
@@ -112,6 +222,18 @@ private:
     bool _fullStep;
     bool _doneSubSteps;
     bool _stepFailed;
+
+    FrameStats _frameStats;
+
+    //@{
+    //! Threads and extra simulators for speculative mode. Empty unless
+    //! speculative.
+    RCShdPtr<SimThreadPool> _speculationPool;
+    std::vector< RCShdPtr<Simulator> > _speculators;
+    //@}
+    //! Timesteps tried by the speculative step in progress, largest first.
+    Candidate _candidates[ NB_CANDIDATES ];
+    UInt32 _nbCandidates;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
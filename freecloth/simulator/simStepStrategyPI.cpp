@@ -0,0 +1,341 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simStepStrategyPI.h>
+#include <freecloth/base/baMath.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    using namespace freecloth;
+
+    const Float TARGET_DEFAULT = .6f;
+    //@{
+    //! Controller gains. The stretch change of a step is about proportional
+    //! to the timestep, so these are [Gus91]'s gains for first order errors.
+    const Double K_I = .3;
+    const Double K_P = .4;
+    //@}
+    //@{
+    //! Bounds on the change of timestep after a successful step. The
+    //! controller is trusted less the further it extrapolates.
+    const Double MIN_ACCEPT_FACTOR = .2;
+    const Double MAX_ACCEPT_FACTOR = 1.5;
+    //@}
+    //@{
+    //! Bounds on the change of timestep after a failed step.
+    const Double MIN_REJECT_FACTOR = .1;
+    const Double MAX_REJECT_FACTOR = .9;
+    //@}
+    //! Change of timestep after a step that took too many substeps, and so
+    //! has no error to go on.
+    const Double SUBSTEP_REJECT_FACTOR = .5;
+    //! Smallest error used by the controller, so that steps with no
+    //! stretch change don't grow the timestep without bound.
+    const Double MIN_ERROR = 1e-3;
+    //! The first timestep is this fraction of the frame period, as for
+    //! SimStepStrategyAdaptive.
+    const UInt32 INITIAL_FRAME_DIVISOR = 6;
+    //! The timestep is no smaller than this fraction of the frame period.
+    const UInt32 MAX_FRAME_DIVISOR = 1024;
+    //! Most ticks by which a timestep may overshoot the end of a frame and
+    //! still be taken in full, shortened to end exactly on the frame.
+    const BaTime::Duration MAX_STEP_REMAINDER = 1024;
+    //! Internal step is cancelled if its substeps exceed this.
+    const UInt32 MAX_SUBSTEPS = 1500;
+}
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimStepStrategyPI
+
+//------------------------------------------------------------------------------
+
+SimStepStrategyPI::SimStepStrategyPI(
+    const RCShdPtr<Simulator>& simulator,
+    UInt32 frameRate
+) : BaseClass( simulator ),
+    _target( TARGET_DEFAULT ),
+    _maxSubSteps( MAX_SUBSTEPS )
+{
+    _inStep = false;
+    _stepFailed = false;
+    _frameStats.clear();
+    setFrameRate( frameRate );
+    _h = BaTime::fraction( 1, _frameRate * INITIAL_FRAME_DIVISOR );
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::rewind()
+{
+    _simulator->rewind();
+    _inStep = false;
+    _stepFailed = false;
+    _frame = 0;
+    _h = BaTime::fraction( 1, _frameRate * INITIAL_FRAME_DIVISOR );
+    _prevError = 0;
+    _frameStats.clear();
+}
+
+//------------------------------------------------------------------------------
+
+bool SimStepStrategyPI::subStepsDone() const
+{
+    DGFX_ASSERT( inStep() );
+    return _doneSubSteps;
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::preSubSteps()
+{
+    DGFX_ASSERT( !inStep() );
+    _stepEnd = BaTime::Instant( _frame + 1 ) * BaTime::S / _frameRate;
+    _frameStats.clear();
+    _doneSubSteps = false;
+    _stepFailed = false;
+    _inStep = true;
+    startStep();
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::subStep()
+{
+    DGFX_ASSERT( inStep() );
+    if ( !_simulator->subStepsDone() ) {
+        if ( _nbSubSteps > _maxSubSteps ) {
+            _simulator->cancelStep();
+            recordStep( false );
+            rejectStep( _stepH, 0 );
+        }
+        else {
+            ++_nbSubSteps;
+            _simulator->subStep();
+        }
+        return;
+    }
+
+    _simulator->postSubSteps();
+    recordStep( _simulator->stepSucceeded() );
+    const Float error =
+        _simulator->getMaxStretchChange() / _simulator->getStretchLimit();
+    if ( _simulator->stepSucceeded() ) {
+        acceptStep( _stepH, error );
+        if ( _simulator->getTime() >= _stepEnd ) {
+            _doneSubSteps = true;
+        }
+        else {
+            startStep();
+        }
+    }
+    else {
+        rejectStep( _stepH, error );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::startStep()
+{
+    const BaTime::Duration remaining(
+        BaTime::getDuration( _simulator->getTime(), _stepEnd )
+    );
+    DGFX_ASSERT( remaining > 0 );
+    if ( remaining <= _h + MAX_STEP_REMAINDER ) {
+        // Last step of the frame.
+        _stepH = remaining;
+    }
+    else if ( remaining < 2 * _h ) {
+        // Two steps will do. Split the remainder evenly, rather than
+        // following a full step with a much shorter one.
+        _stepH = remaining / 2;
+    }
+    else {
+        _stepH = _h;
+    }
+    _simulator->setTimestep( _stepH );
+    _simulator->preSubSteps();
+    _nbSubSteps = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::acceptStep( BaTime::Duration h, Float error )
+{
+    // If the step was shortened to fit the frame, scale its error up to
+    // what a full step would have seen, so that the controller isn't
+    // pulled towards the shorter step.
+    const Double e = std::max( Double( error ) * _h / h, MIN_ERROR );
+    Double factor = ::pow( _target / e, K_I );
+    if ( _prevError > 0 ) {
+        factor *= ::pow( _prevError / e, K_P );
+    }
+    else {
+        // Don't grow straight after a failure, as per [Gus91].
+        factor = std::min( factor, 1. );
+    }
+    factor = std::max(
+        MIN_ACCEPT_FACTOR, std::min( factor, MAX_ACCEPT_FACTOR )
+    );
+    _prevError = Float( e );
+    setStep( _h * factor );
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::rejectStep( BaTime::Duration h, Float error )
+{
+    if ( h <= getMinStep() ) {
+        // No smaller step to retry with. Give up on the frame, leaving the
+        // simulator at the last step that succeeded.
+        _stepFailed = true;
+        _doneSubSteps = true;
+        return;
+    }
+    // Retry at the step that the error predicts will reach the target,
+    // but make sure it's a real reduction.
+    Double factor = SUBSTEP_REJECT_FACTOR;
+    if ( error > 0 ) {
+        factor = std::max(
+            MIN_REJECT_FACTOR,
+            std::min( _target / Double( error ), MAX_REJECT_FACTOR )
+        );
+    }
+    _prevError = 0;
+    setStep( h * factor );
+    startStep();
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::setStep( Double h )
+{
+    const BaTime::Duration framePeriod = BaTime::fraction( 1, _frameRate );
+    _h = std::max(
+        getMinStep(),
+        std::min( BaTime::Duration( h + .5 ), framePeriod )
+    );
+}
+
+//------------------------------------------------------------------------------
+
+BaTime::Duration SimStepStrategyPI::getMinStep() const
+{
+    return BaTime::fraction( 1, _frameRate * MAX_FRAME_DIVISOR );
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::recordStep( bool succeeded )
+{
+    if ( succeeded ) {
+        ++_frameStats._nbInternalSteps;
+    }
+    else {
+        ++_frameStats._nbFailedSteps;
+    }
+    _frameStats._nbPCGIterations += _simulator->getNbPCGIterations();
+    if ( _simulator->isProfiling() ) {
+        _frameStats._stepStats += _simulator->getStepStats();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::postSubSteps()
+{
+    DGFX_ASSERT( inStep() );
+    _inStep = false;
+    // A failed frame is left unfinished, to be retried by the next step.
+    if ( ! _stepFailed ) {
+        ++_frame;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::cancelStep()
+{
+    DGFX_ASSERT( inStep() );
+    if ( _simulator->inStep() ) {
+        _simulator->cancelStep();
+        recordStep( false );
+    }
+    _inStep = false;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimStepStrategyPI::inStep() const
+{
+    return _inStep;
+}
+
+//------------------------------------------------------------------------------
+
+bool SimStepStrategyPI::stepSucceeded() const
+{
+    return ! _stepFailed;
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::setFrameRate( UInt32 frameRate )
+{
+    DGFX_ASSERT( !inStep() );
+    _frameRate = frameRate;
+    setStep( Double( _simulator->getTimestep() ) );
+    _frame = UInt32( _simulator->getTime() * frameRate / BaTime::S );
+    _prevError = 0;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimStepStrategyPI::getFrameRate() const
+{
+    return _frameRate;
+}
+
+//------------------------------------------------------------------------------
+
+void SimStepStrategyPI::setTarget( Float target )
+{
+    DGFX_ASSERT( target > 0 && target < 1 );
+    _target = target;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimStepStrategyPI::getTarget() const
+{
+    return _target;
+}
+
+//------------------------------------------------------------------------------
+
+const SimStepStrategyPI::FrameStats& SimStepStrategyPI::getFrameStats() const
+{
+    return _frameStats;
+}
+
+FREECLOTH_NAMESPACE_END
@@ -0,0 +1,163 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#ifndef freecloth_sim_simStepStrategyPI_h
+#define freecloth_sim_simStepStrategyPI_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_sim_simStepStrategyAdaptive_h
+#include <freecloth/simulator/simStepStrategyAdaptive.h>
+#endif
+
+#ifndef freecloth_base_baTime_h
+#include <freecloth/base/baTime.h>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimStepStrategyPI freecloth/simulator/simStepStrategyPI.h
+ * \brief Adaptive stepping strategy with error-controlled step sizes.
+ * \pattern Strategy
+ *
+ * Like SimStepStrategyAdaptive, this makes each call to step() advance the
+ * animation by one frame, in as many internal steps as needed. Rather than
+ * probing a fixed ladder of timesteps, and learning of a step too large
+ * only when it fails, the timestep is chosen to keep the stretch change of
+ * each step near a target fraction of the stretch limit.
+ *
+ * The "error" of an internal step is the simulator's getMaxStretchChange()
+ * relative to the stretch limit; the step fails if this exceeds 1. For
+ * small steps, the change is nearly proportional to the timestep. After
+ * each successful full step, the next timestep is set by a
+ * proportional-integral controller, as per [Gus91]:
+ *
+ *     h' = h ( target / e )^kI ( e_prev / e )^kP
+ *
+ * The integral term predicts the step that will reach the target; the
+ * proportional term damps the oscillation that the integral term alone
+ * shows on scenes that hover near the limit. After a failure, the step is
+ * retried at the size that the error predicts will just reach the target.
+ * The timestep is continuous, to the tick, but is bounded above by the
+ * frame period and below by 1/1024 of it. If a step of the smallest size
+ * fails, the frame stops there, and stepSucceeded() returns false.
+ *
+ * References:
+ * - [Gus91] K. Gustafsson. Control theoretic techniques for stepsize
+ *    selection in explicit Runge-Kutta methods. ACM Trans. Math. Softw.,
+ *    17(4), 1991.
+ */
+class SimStepStrategyPI : public SimStepStrategy
+{
+public:
+
+    // ----- types and enumerations -----
+    typedef SimStepStrategy BaseClass;
+    typedef SimStepStrategyAdaptive::FrameStats FrameStats;
+
+    // ----- member functions -----
+
+    //! Frame rate is number of frames per second
+    SimStepStrategyPI(
+        const RCShdPtr<Simulator>& simulator,
+        UInt32 frameRate
+    );
+
+    virtual void rewind();
+    virtual bool subStepsDone() const;
+    virtual void preSubSteps();
+    virtual void subStep();
+    virtual void postSubSteps();
+    virtual void cancelStep();
+    virtual bool inStep() const;
+    virtual bool stepSucceeded() const;
+
+    void setFrameRate( UInt32 );
+    UInt32 getFrameRate() const;
+    //! Fraction of the stretch limit that each step aims for. Lower
+    //! targets fail less often, but take more steps. Defaults to 0.6.
+    void setTarget( Float );
+    Float getTarget() const;
+    //! Totals for the last frame, or for the frame in progress.
+    const FrameStats& getFrameStats() const;
+
+private:
+    // ----- member functions -----
+
+    //! Add the internal step just completed or cancelled to _frameStats.
+    void recordStep( bool succeeded );
+
+    //! Choose the next timestep after a successful full step of size h.
+    void acceptStep( BaTime::Duration h, Float error );
+    //! Retry a failed step of size h, with the timestep that the error
+    //! predicts will reach the target. error is zero if the step failed
+    //! without finishing its substeps. If h is already the smallest
+    //! timestep, fail the frame instead.
+    void rejectStep( BaTime::Duration h, Float error );
+    //! Set _h, within the bounds given by the frame period.
+    void setStep( Double h );
+    //! Smallest timestep, a fixed fraction of the frame period.
+    BaTime::Duration getMinStep() const;
+    //! Start the next internal step, shortening it to end on the frame
+    //! boundary if need be.
+    void startStep();
+
+    // ----- data members -----
+    UInt32 _frameRate;
+    Float _target;
+    bool _inStep;
+    //! Timestep chosen by the controller.
+    BaTime::Duration _h;
+    //! Timestep of the internal step in progress. Shorter than _h if the
+    //! step was shortened to reach the end of frame.
+    BaTime::Duration _stepH;
+    //! Error of the last successful full step, or 0 if the last full step
+    //! failed; the proportional term is skipped then.
+    Float _prevError;
+    //! Current frame number.
+    UInt32 _frame;
+    //! Time at end of frame.
+    BaTime::Instant _stepEnd;
+
+    //! Substeps executed within this internal step. Internal step is
+    //! cancelled if these exceed maxSubSteps.
+    UInt32 _nbSubSteps;
+    const UInt32 _maxSubSteps;
+
+    bool _doneSubSteps;
+    //! True if a step of the smallest size failed, ending the frame early.
+    bool _stepFailed;
+
+    FrameStats _frameStats;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// GLOBAL FUNCTIONS
+//
+
+FREECLOTH_NAMESPACE_END
+
+#endif
@@ -0,0 +1,212 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simSymMatrix.h>
+#include <freecloth/simulator/simMatrixKernels.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSymMatrix
+
+//------------------------------------------------------------------------------
+
+void SimSymMatrix::multiply(
+    SimVector& destV,
+    const SimSymMatrix& srcM,
+    const SimVector& srcV
+) {
+    DGFX_ASSERT( srcM.nbColumns() == srcV.size() );
+    const UInt32 nbRows = srcM.nbRows();
+    if ( destV.size() != nbRows ) {
+        destV = SimVector( nbRows );
+    }
+    if ( nbRows == 0 ) {
+        return;
+    }
+    DGFX_ASSERT( &destV != &srcV );
+    SimMatrixKernels::getMultiplySymmetric()(
+        nbRows,
+        srcM.getPattern()->getRowStarts(),
+        srcM.getPattern()->getColumns(),
+        &srcM.getBlock( 0 ),
+        &srcV[ 0 ],
+        &destV[ 0 ]
+    );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSymMatrix::multiplyRows(
+    SimVector& destV,
+    const SimSymMatrix& srcM,
+    const SimVector& srcV,
+    UInt32 rowBegin,
+    UInt32 rowEnd
+) {
+    DGFX_ASSERT( srcM.nbColumns() == srcV.size() );
+    DGFX_ASSERT( destV.size() == srcM.nbRows() );
+    DGFX_ASSERT( rowBegin <= rowEnd && rowEnd <= srcM.nbRows() );
+    DGFX_ASSERT( &destV != &srcV );
+    if ( rowBegin == rowEnd ) {
+        return;
+    }
+    const Pattern& pattern = *srcM.getPattern();
+    SimMatrixKernels::getMultiplySymmetricRows()(
+        rowBegin,
+        rowEnd,
+        pattern.getRowStarts(),
+        pattern.getColumns(),
+        pattern.getColumnStarts(),
+        pattern.getColumnSlots(),
+        pattern.getColumnRows(),
+        &srcM.getBlock( 0 ),
+        &srcV[ 0 ],
+        &destV[ 0 ]
+    );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSymMatrix::multiplyDiagonal(
+    SimVector& destV,
+    const SimSymMatrix& srcM,
+    const SimVector& srcV
+) {
+    SimMatrix::multiplyDiagonal( destV, srcM._upper, srcV );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSymMatrix::multiplyCombined(
+    SimVector& destV,
+    Float a,
+    const SimSymMatrix& A,
+    Float b,
+    const SimSymMatrix& B,
+    const SimSymMatrix& D,
+    const SimVector& srcV
+) {
+    DGFX_ASSERT( A.getPattern() == B.getPattern() );
+    DGFX_ASSERT( A.getPattern() == D.getPattern() );
+    DGFX_ASSERT( A.nbColumns() == srcV.size() );
+    DGFX_ASSERT( &destV != &srcV );
+    const UInt32 nbRows = A.nbRows();
+    if ( destV.size() != nbRows ) {
+        destV = SimVector( nbRows );
+    }
+    if ( nbRows == 0 ) {
+        return;
+    }
+    const Pattern& pattern = *A.getPattern();
+    SimMatrixKernels::getMultiplyCombined()(
+        nbRows,
+        pattern.getRowStarts(),
+        pattern.getColumns(),
+        a,
+        &A.getBlock( 0 ),
+        b,
+        &B.getBlock( 0 ),
+        &D.getBlock( 0 ),
+        &srcV[ 0 ],
+        &destV[ 0 ]
+    );
+}
+
+//------------------------------------------------------------------------------
+
+void SimSymMatrix::multiplyCombinedRows(
+    SimVector& destV,
+    Float a,
+    const SimSymMatrix& A,
+    Float b,
+    const SimSymMatrix& B,
+    const SimSymMatrix& D,
+    const SimVector& srcV,
+    UInt32 rowBegin,
+    UInt32 rowEnd
+) {
+    DGFX_ASSERT( A.getPattern() == B.getPattern() );
+    DGFX_ASSERT( A.getPattern() == D.getPattern() );
+    DGFX_ASSERT( A.nbColumns() == srcV.size() );
+    DGFX_ASSERT( destV.size() == A.nbRows() );
+    DGFX_ASSERT( rowBegin <= rowEnd && rowEnd <= A.nbRows() );
+    DGFX_ASSERT( &destV != &srcV );
+    if ( rowBegin == rowEnd ) {
+        return;
+    }
+    const Pattern& pattern = *A.getPattern();
+    SimMatrixKernels::getMultiplyCombinedRows()(
+        rowBegin,
+        rowEnd,
+        pattern.getRowStarts(),
+        pattern.getColumns(),
+        pattern.getColumnStarts(),
+        pattern.getColumnSlots(),
+        pattern.getColumnRows(),
+        a,
+        &A.getBlock( 0 ),
+        b,
+        &B.getBlock( 0 ),
+        &D.getBlock( 0 ),
+        &srcV[ 0 ],
+        &destV[ 0 ]
+    );
+}
+
+//------------------------------------------------------------------------------
+
+GeMatrix3 SimSymMatrix::getCombinedDiagonal(
+    UInt32 row,
+    Float a,
+    const SimSymMatrix& A,
+    Float b,
+    const SimSymMatrix& B,
+    const SimSymMatrix& D
+) {
+    return SimMatrix::getCombinedDiagonal(
+        row, a, A._upper, b, B._upper, D._upper
+    );
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GLOBAL FUNCTIONS
+//
+
+//------------------------------------------------------------------------------
+
+std::ostream& operator<<( std::ostream& out, const SimSymMatrix& m )
+{
+    out << "M(" << std::endl;
+    for ( UInt32 r = 0; r < m.nbRows(); ++r ) {
+        out << "  ";
+        for ( UInt32 c = 0; c < m.nbColumns(); ++c ) {
+            out << m( r, c ) << " ";
+        }
+        out << std::endl;
+    }
+    out << ")";
+    return out;
+}
+
+FREECLOTH_NAMESPACE_END
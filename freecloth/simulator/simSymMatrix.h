@@ -0,0 +1,183 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#ifndef freecloth_sim_simSymMatrix_h
+#define freecloth_sim_simSymMatrix_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_sim_simMatrix_h
+#include <freecloth/simulator/simMatrix.h>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class SimVector;
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimSymMatrix freecloth/simulator/simSymMatrix.h
+ * \brief Symmetric sparse matrix class.
+ *
+ * Stores only the diagonal and upper triangle of a symmetric block sparse
+ * matrix; block (c,r) below the diagonal is implicitly the transpose of
+ * block (r,c). The pattern must be upper triangular (see
+ * SimMatrixPattern::createUpperTriangle()).
+ *
+ * The matrix-vector product applies each off-diagonal block and its
+ * transpose in a single pass, so it reads half as much matrix data as the
+ * equivalent SimMatrix product.
+ */
+
+class SimSymMatrix
+{
+public:
+    // ----- types and enumerations -----
+
+    typedef SimMatrixPattern Pattern;
+
+    // ----- static member functions -----
+
+    static void multiply(
+        SimVector& destV,
+        const SimSymMatrix& srcM,
+        const SimVector& srcV
+    );
+    //! Compute rows [ rowBegin, rowEnd ) of srcM * srcV into destV, which
+    //! must already have the right size. Other rows of destV are left
+    //! untouched, so disjoint row ranges may be computed concurrently. The
+    //! result matches multiply() exactly.
+    static void multiplyRows(
+        SimVector& destV,
+        const SimSymMatrix& srcM,
+        const SimVector& srcV,
+        UInt32 rowBegin,
+        UInt32 rowEnd
+    );
+    //! Multiply by the block diagonal of srcM only. See
+    //! SimMatrix::multiplyDiagonal.
+    static void multiplyDiagonal(
+        SimVector& destV,
+        const SimSymMatrix& srcM,
+        const SimVector& srcV
+    );
+    //! Compute destV = ( a * A + b * B + diag( D ) ) * srcV in a single
+    //! pass, without forming the combined matrix. A, B and D must share the
+    //! same pattern; only the diagonal blocks of D are used. The result is
+    //! identical to multiply() by setCombination( a, A, b, B, D ) when D is
+    //! block diagonal.
+    static void multiplyCombined(
+        SimVector& destV,
+        Float a,
+        const SimSymMatrix& A,
+        Float b,
+        const SimSymMatrix& B,
+        const SimSymMatrix& D,
+        const SimVector& srcV
+    );
+    //! Row range version of multiplyCombined(), as for multiplyRows().
+    static void multiplyCombinedRows(
+        SimVector& destV,
+        Float a,
+        const SimSymMatrix& A,
+        Float b,
+        const SimSymMatrix& B,
+        const SimSymMatrix& D,
+        const SimVector& srcV,
+        UInt32 rowBegin,
+        UInt32 rowEnd
+    );
+    //! Diagonal block of row r of ( a * A + b * B + diag( D ) ), as used by
+    //! multiplyCombined().
+    static GeMatrix3 getCombinedDiagonal(
+        UInt32 row,
+        Float a,
+        const SimSymMatrix& A,
+        Float b,
+        const SimSymMatrix& B,
+        const SimSymMatrix& D
+    );
+
+    // ----- member functions -----
+
+    SimSymMatrix();
+    //! Create a zero matrix with the given upper triangular pattern.
+    explicit SimSymMatrix( const RCShdPtr<Pattern>& );
+    // Default copy constructor is fine.
+
+    UInt32 nbRows() const;
+    UInt32 nbColumns() const;
+    const RCShdPtr<Pattern>& getPattern() const;
+
+    // Default assignment operator is fine.
+    //! Blocks below the diagonal are returned as the transpose of the
+    //! corresponding upper block. Returns zero for blocks outside the
+    //! pattern.
+    GeMatrix3 operator()( UInt32 row, UInt32 col ) const;
+    //! The block must be in the pattern, on or above the diagonal.
+    GeMatrix3& operator()( UInt32 row, UInt32 col );
+    //@{
+    //! Direct access to the block in the given pattern slot.
+    const GeMatrix3& getBlock( UInt32 slot ) const;
+    GeMatrix3& getBlock( UInt32 slot );
+    //@}
+
+    //! Set all blocks to zero, retaining the pattern.
+    void clear();
+
+    SimSymMatrix& operator*=( Float );
+    //! rhs must share the same pattern.
+    SimSymMatrix& operator+=( const SimSymMatrix& );
+    //! Set *this = a * A + b * B + C in a single pass. A, B and C must
+    //! share the same pattern. The existing blocks are reused if *this
+    //! already has that pattern, so no temporaries are allocated.
+    void setCombination(
+        Float a,
+        const SimSymMatrix& A,
+        Float b,
+        const SimSymMatrix& B,
+        const SimSymMatrix& C
+    );
+    SimVector operator*( const SimVector& ) const;
+    SimSymMatrix operator*( Float ) const;
+    SimSymMatrix operator+( const SimSymMatrix& ) const;
+
+private:
+    // ----- data members -----
+
+    //! The stored upper triangle.
+    SimMatrix _upper;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// GLOBAL FUNCTIONS
+//
+std::ostream& operator<<( std::ostream&, const SimSymMatrix& );
+SimSymMatrix operator*( Float, const SimSymMatrix& );
+
+FREECLOTH_NAMESPACE_END
+
+#include <freecloth/simulator/simSymMatrix.inline.h>
+
+#endif
@@ -0,0 +1,172 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+// 
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#ifndef freecloth_simulator_simSymMatrix_inline_h
+#define freecloth_simulator_simSymMatrix_inline_h
+
+#include <freecloth/simulator/simVector.h>
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimSymMatrix
+
+//------------------------------------------------------------------------------
+
+inline SimSymMatrix::SimSymMatrix()
+{}
+
+//------------------------------------------------------------------------------
+
+inline SimSymMatrix::SimSymMatrix( const RCShdPtr<Pattern>& pattern )
+  : _upper( pattern )
+{
+    DGFX_ASSERT( pattern->isUpperTriangle() );
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimSymMatrix::nbRows() const
+{
+    return _upper.nbRows();
+}
+
+//------------------------------------------------------------------------------
+
+inline UInt32 SimSymMatrix::nbColumns() const
+{
+    return _upper.nbColumns();
+}
+
+//------------------------------------------------------------------------------
+
+inline const RCShdPtr<SimSymMatrix::Pattern>& SimSymMatrix::getPattern() const
+{
+    return _upper.getPattern();
+}
+
+//------------------------------------------------------------------------------
+
+inline GeMatrix3& SimSymMatrix::operator() ( UInt32 row, UInt32 col )
+{
+    DGFX_ASSERT( row <= col );
+    return _upper( row, col );
+}
+
+//------------------------------------------------------------------------------
+
+inline GeMatrix3 SimSymMatrix::operator() ( UInt32 row, UInt32 col ) const
+{
+    if ( row > col ) {
+        return _upper( col, row ).getTranspose();
+    }
+    return _upper( row, col );
+}
+
+//------------------------------------------------------------------------------
+
+inline GeMatrix3& SimSymMatrix::getBlock( UInt32 slot )
+{
+    return _upper.getBlock( slot );
+}
+
+//------------------------------------------------------------------------------
+
+inline const GeMatrix3& SimSymMatrix::getBlock( UInt32 slot ) const
+{
+    return _upper.getBlock( slot );
+}
+
+//------------------------------------------------------------------------------
+
+inline void SimSymMatrix::clear()
+{
+    _upper.clear();
+}
+
+//------------------------------------------------------------------------------
+
+inline SimSymMatrix& SimSymMatrix::operator*=( Float rhs )
+{
+    _upper *= rhs;
+    return *this;
+}
+
+//------------------------------------------------------------------------------
+
+inline SimSymMatrix& SimSymMatrix::operator+=( const SimSymMatrix& rhs )
+{
+    _upper += rhs._upper;
+    return *this;
+}
+
+//------------------------------------------------------------------------------
+
+inline void SimSymMatrix::setCombination(
+    Float a,
+    const SimSymMatrix& A,
+    Float b,
+    const SimSymMatrix& B,
+    const SimSymMatrix& C
+) {
+    _upper.setCombination( a, A._upper, b, B._upper, C._upper );
+}
+
+//------------------------------------------------------------------------------
+
+inline SimSymMatrix SimSymMatrix::operator*( Float rhs ) const
+{
+    SimSymMatrix temp( *this );
+    temp *= rhs;
+    return temp;
+}
+
+//------------------------------------------------------------------------------
+
+inline SimVector SimSymMatrix::operator*( const SimVector& rhs ) const
+{
+    SimVector result;
+    multiply( result, *this, rhs );
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+inline SimSymMatrix SimSymMatrix::operator+( const SimSymMatrix& rhs ) const
+{
+    SimSymMatrix temp( *this );
+    temp += rhs;
+    return temp;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// GLOBAL FUNCTIONS
+//
+
+//------------------------------------------------------------------------------
+
+inline SimSymMatrix operator*( Float lhs, const SimSymMatrix& rhs )
+{
+    return rhs * lhs;
+}
+
+FREECLOTH_NAMESPACE_END
+
+#endif
@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simThreadPool.h>
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimThreadPool::Task
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::Task::~Task()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimThreadPool
+
+//------------------------------------------------------------------------------
+
+UInt32 SimThreadPool::getNbThreads() const
+{
+    return _nbThreads;
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::getRange(
+    UInt32 nbItems,
+    UInt32 threadIndex,
+    UInt32& begin,
+    UInt32& end
+) const {
+    DGFX_ASSERT( threadIndex < _nbThreads );
+    // The first ( nbItems % _nbThreads ) threads take one extra item.
+    const UInt32 chunk = nbItems / _nbThreads;
+    const UInt32 extra = nbItems % _nbThreads;
+    begin = threadIndex * chunk + ( threadIndex < extra ? threadIndex : extra );
+    end = begin + chunk + ( threadIndex < extra ? 1 : 0 );
+}
+
+FREECLOTH_NAMESPACE_END
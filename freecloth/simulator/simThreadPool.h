@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#ifndef freecloth_sim_simThreadPool_h
+#define freecloth_sim_simThreadPool_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimThreadPool freecloth/simulator/simThreadPool.h
+ * \brief Fixed set of worker threads for data-parallel loops.
+ *
+ * A pool runs a Task over a range of items by splitting the range into
+ * one contiguous chunk per thread. The calling thread always processes
+ * the first chunk itself, so a pool of N threads owns only N-1 workers,
+ * and a pool of one thread simply runs the task inline.
+ *
+ * The split depends only upon the number of items and the number of
+ * threads, so a task that keeps per-thread partial results and reduces
+ * them in thread order gives reproducible results for a given pool size.
+ *
+ * runDynamic() instead hands the items out one at a time, to whichever
+ * thread is free, for a few items of very uneven cost.
+ *
+ * run() blocks until every chunk has been processed. A pool may only run
+ * one task at a time, and tasks must not call run() on their own pool.
+ */
+class SimThreadPool : public RCBase
+{
+public:
+    // ----- classes -----
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class Task freecloth/simulator/simThreadPool.h
+     * \brief Work item interface for SimThreadPool::run().
+     *
+     * A task runs on several threads at once. RCShdPtr reference counts
+     * aren't thread-safe, so a task should reach shared objects through
+     * plain references, and mustn't copy or release any shared pointers
+     * while it runs.
+     */
+    class Task
+    {
+    public:
+        // ----- member functions -----
+
+        virtual ~Task();
+        //! Process the items in [ begin, end ). threadIndex is in
+        //! [ 0, getNbThreads() ), and is unique among the concurrent calls
+        //! made by a single run(), for indexing per-thread data.
+        virtual void run( UInt32 begin, UInt32 end, UInt32 threadIndex ) = 0;
+    };
+
+    // ----- static member functions -----
+
+    //! Number of processors available to this process, at least 1.
+    static UInt32 getNbProcessors();
+
+    // ----- member functions -----
+
+    //! Create a pool of nbThreads threads, including the calling thread.
+    //! If the system can't start them all, the pool keeps those it could,
+    //! and getNbThreads() says how many.
+    explicit SimThreadPool( UInt32 nbThreads );
+    virtual ~SimThreadPool();
+
+    UInt32 getNbThreads() const;
+
+    //! Run the task over items [ 0, nbItems ), and wait for completion.
+    void run( Task&, UInt32 nbItems );
+    //! As run(), but each thread repeatedly takes the next unclaimed item,
+    //! in order, until none are left. List the costliest items first for
+    //! the best balance. Which thread runs which item varies from one run
+    //! to the next.
+    void runDynamic( Task&, UInt32 nbItems );
+
+    //! The chunk of [ 0, nbItems ) processed by the given thread in run().
+    void getRange(
+        UInt32 nbItems,
+        UInt32 threadIndex,
+        UInt32& begin,
+        UInt32& end
+    ) const;
+
+private:
+    // ----- classes -----
+
+    //! Platform-specific threads and synchronisation.
+    class Impl;
+
+    // ----- member functions -----
+
+    // Pools own threads, and are shared, not copied.
+    SimThreadPool( const SimThreadPool& );
+    SimThreadPool& operator=( const SimThreadPool& );
+
+    // ----- data members -----
+
+    UInt32          _nbThreads;
+    //! Null for single-threaded pools.
+    Impl*           _impl;
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif
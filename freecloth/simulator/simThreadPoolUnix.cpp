@@ -0,0 +1,312 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simThreadPool.h>
+#include <freecloth/base/vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimThreadPool::Impl
+
+/*!
+ * Workers sleep on _startCond until _generation changes, process their
+ * chunk of the current task, and the last one to finish signals _doneCond.
+ * Dynamic tasks are shared out through _nextItem instead.
+ */
+class SimThreadPool::Impl
+{
+public:
+    // ----- member functions -----
+
+    explicit Impl( const SimThreadPool& );
+    ~Impl();
+
+    //! Workers actually started; fewer than asked if some couldn't be.
+    UInt32 getNbWorkers() const;
+    void run( Task&, UInt32 nbItems, bool dynamic );
+
+private:
+    // ----- classes -----
+
+    //! Argument to each worker's start routine.
+    class Worker
+    {
+    public:
+        // ----- data members -----
+        Impl*           _impl;
+        UInt32          _threadIndex;
+    };
+
+    // ----- static member functions -----
+
+    static void* workerMain( void* );
+
+    // ----- member functions -----
+
+    void workerLoop( UInt32 threadIndex );
+    //! Process the calling thread's share of the task.
+    void process(
+        Task&,
+        UInt32 nbItems,
+        bool dynamic,
+        UInt32 threadIndex
+    );
+
+    // ----- data members -----
+
+    const SimThreadPool& _pool;
+    std::vector<pthread_t> _threads;
+    std::vector<Worker> _workers;
+
+    pthread_mutex_t _mutex;
+    pthread_cond_t  _startCond;
+    pthread_cond_t  _doneCond;
+
+    //@{
+    //! Protected by _mutex.
+    UInt32          _generation;
+    UInt32          _nbPending;
+    bool            _quit;
+    Task*           _task;
+    UInt32          _nbItems;
+    bool            _dynamic;
+    UInt32          _nextItem;
+    //@}
+};
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::Impl::Impl( const SimThreadPool& pool )
+  : _pool( pool ),
+    _generation( 0 ),
+    _nbPending( 0 ),
+    _quit( false ),
+    _task( 0 ),
+    _nbItems( 0 ),
+    _dynamic( false ),
+    _nextItem( 0 )
+{
+    ::pthread_mutex_init( &_mutex, 0 );
+    ::pthread_cond_init( &_startCond, 0 );
+    ::pthread_cond_init( &_doneCond, 0 );
+
+    // Thread 0 is the caller of run().
+    const UInt32 nbWorkers = pool.getNbThreads() - 1;
+    _threads.resize( nbWorkers );
+    _workers.resize( nbWorkers );
+    UInt32 i;
+    for ( i = 0; i < nbWorkers; ++i ) {
+        _workers[ i ]._impl = this;
+        _workers[ i ]._threadIndex = i + 1;
+        if ( ::pthread_create(
+            &_threads[ i ], 0, workerMain, &_workers[ i ]
+        ) != 0 ) {
+            break;
+        }
+    }
+    // Shrinking doesn't move the workers already started.
+    _threads.resize( i );
+    _workers.resize( i );
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimThreadPool::Impl::getNbWorkers() const
+{
+    return _threads.size();
+}
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::Impl::~Impl()
+{
+    ::pthread_mutex_lock( &_mutex );
+    _quit = true;
+    ::pthread_cond_broadcast( &_startCond );
+    ::pthread_mutex_unlock( &_mutex );
+
+    for ( UInt32 i = 0; i < _threads.size(); ++i ) {
+        ::pthread_join( _threads[ i ], 0 );
+    }
+    ::pthread_cond_destroy( &_doneCond );
+    ::pthread_cond_destroy( &_startCond );
+    ::pthread_mutex_destroy( &_mutex );
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::Impl::run( Task& task, UInt32 nbItems, bool dynamic )
+{
+    ::pthread_mutex_lock( &_mutex );
+    DGFX_ASSERT( _nbPending == 0 );
+    _task = &task;
+    _nbItems = nbItems;
+    _dynamic = dynamic;
+    _nextItem = 0;
+    _nbPending = _threads.size();
+    ++_generation;
+    ::pthread_cond_broadcast( &_startCond );
+    ::pthread_mutex_unlock( &_mutex );
+
+    process( task, nbItems, dynamic, 0 );
+
+    ::pthread_mutex_lock( &_mutex );
+    while ( _nbPending > 0 ) {
+        ::pthread_cond_wait( &_doneCond, &_mutex );
+    }
+    _task = 0;
+    ::pthread_mutex_unlock( &_mutex );
+}
+
+//------------------------------------------------------------------------------
+
+void* SimThreadPool::Impl::workerMain( void* arg )
+{
+    Worker* worker = static_cast<Worker*>( arg );
+    worker->_impl->workerLoop( worker->_threadIndex );
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::Impl::workerLoop( UInt32 threadIndex )
+{
+    UInt32 seen = 0;
+    ::pthread_mutex_lock( &_mutex );
+    for ( ;; ) {
+        while ( _generation == seen && ! _quit ) {
+            ::pthread_cond_wait( &_startCond, &_mutex );
+        }
+        if ( _quit ) {
+            break;
+        }
+        seen = _generation;
+        Task& task = *_task;
+        const UInt32 nbItems = _nbItems;
+        const bool dynamic = _dynamic;
+        ::pthread_mutex_unlock( &_mutex );
+
+        process( task, nbItems, dynamic, threadIndex );
+
+        ::pthread_mutex_lock( &_mutex );
+        if ( --_nbPending == 0 ) {
+            ::pthread_cond_signal( &_doneCond );
+        }
+    }
+    ::pthread_mutex_unlock( &_mutex );
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::Impl::process(
+    Task& task,
+    UInt32 nbItems,
+    bool dynamic,
+    UInt32 threadIndex
+) {
+    if ( ! dynamic ) {
+        UInt32 begin, end;
+        _pool.getRange( nbItems, threadIndex, begin, end );
+        if ( begin < end ) {
+            task.run( begin, end, threadIndex );
+        }
+        return;
+    }
+    for ( ;; ) {
+        ::pthread_mutex_lock( &_mutex );
+        const UInt32 item = _nextItem;
+        if ( item < nbItems ) {
+            ++_nextItem;
+        }
+        ::pthread_mutex_unlock( &_mutex );
+        if ( item >= nbItems ) {
+            break;
+        }
+        task.run( item, item + 1, threadIndex );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimThreadPool
+
+//------------------------------------------------------------------------------
+
+UInt32 SimThreadPool::getNbProcessors()
+{
+    const long nb = ::sysconf( _SC_NPROCESSORS_ONLN );
+    return nb > 0 ? UInt32( nb ) : 1;
+}
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::SimThreadPool( UInt32 nbThreads )
+  : _nbThreads( nbThreads ),
+    _impl( 0 )
+{
+    DGFX_ASSERT( nbThreads > 0 );
+    if ( nbThreads > 1 ) {
+        _impl = new Impl( *this );
+        // Make do with the workers that could be started, if any.
+        _nbThreads = _impl->getNbWorkers() + 1;
+        if ( _nbThreads == 1 ) {
+            delete _impl;
+            _impl = 0;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::~SimThreadPool()
+{
+    delete _impl;
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::run( Task& task, UInt32 nbItems )
+{
+    // Not worth waking the workers for a single item.
+    if ( _impl == 0 || nbItems < 2 ) {
+        if ( nbItems > 0 ) {
+            task.run( 0, nbItems, 0 );
+        }
+        return;
+    }
+    _impl->run( task, nbItems, false );
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::runDynamic( Task& task, UInt32 nbItems )
+{
+    if ( _impl == 0 || nbItems < 2 ) {
+        if ( nbItems > 0 ) {
+            task.run( 0, nbItems, 0 );
+        }
+        return;
+    }
+    _impl->run( task, nbItems, true );
+}
+
+FREECLOTH_NAMESPACE_END
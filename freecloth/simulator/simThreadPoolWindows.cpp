@@ -0,0 +1,286 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+
+#include <freecloth/simulator/simThreadPool.h>
+#include <freecloth/base/vector>
+#include <freecloth/base/windows.h>
+
+#include <process.h>
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimThreadPool::Impl
+
+/*!
+ * Each worker waits on its own auto-reset start event. The last worker to
+ * finish a task sets the shared done event. Dynamic tasks are shared out
+ * through _nextItem.
+ */
+class SimThreadPool::Impl
+{
+public:
+    // ----- member functions -----
+
+    explicit Impl( const SimThreadPool& );
+    ~Impl();
+
+    //! Workers actually started; fewer than asked if some couldn't be.
+    UInt32 getNbWorkers() const;
+    void run( Task&, UInt32 nbItems, bool dynamic );
+
+private:
+    // ----- classes -----
+
+    //! Argument to each worker's start routine.
+    class Worker
+    {
+    public:
+        // ----- data members -----
+        Impl*           _impl;
+        UInt32          _threadIndex;
+        HANDLE          _thread;
+        HANDLE          _startEvent;
+    };
+
+    // ----- static member functions -----
+
+    static unsigned __stdcall workerMain( void* );
+
+    // ----- member functions -----
+
+    void workerLoop( UInt32 threadIndex, HANDLE startEvent );
+    //! Process the calling thread's share of the current task.
+    void process( UInt32 threadIndex );
+
+    // ----- data members -----
+
+    const SimThreadPool& _pool;
+    std::vector<Worker> _workers;
+    HANDLE          _doneEvent;
+
+    //@{
+    //! Written by run() before the start events are set.
+    bool            _quit;
+    Task*           _task;
+    UInt32          _nbItems;
+    bool            _dynamic;
+    //@}
+    volatile LONG   _nbPending;
+    //! Next unclaimed item of a dynamic task.
+    volatile LONG   _nextItem;
+};
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::Impl::Impl( const SimThreadPool& pool )
+  : _pool( pool ),
+    _quit( false ),
+    _task( 0 ),
+    _nbItems( 0 ),
+    _dynamic( false ),
+    _nbPending( 0 ),
+    _nextItem( 0 )
+{
+    _doneEvent = ::CreateEvent( 0, FALSE, FALSE, 0 );
+
+    // Thread 0 is the caller of run().
+    const UInt32 nbWorkers = pool.getNbThreads() - 1;
+    _workers.resize( nbWorkers );
+    UInt32 i;
+    for ( i = 0; i < nbWorkers; ++i ) {
+        _workers[ i ]._impl = this;
+        _workers[ i ]._threadIndex = i + 1;
+        _workers[ i ]._startEvent = ::CreateEvent( 0, FALSE, FALSE, 0 );
+    }
+    // Start threads only once the vector has stopped moving.
+    UInt32 nbStarted;
+    for ( nbStarted = 0; nbStarted < nbWorkers; ++nbStarted ) {
+        Worker& worker = _workers[ nbStarted ];
+        worker._thread = reinterpret_cast<HANDLE>( ::_beginthreadex(
+            0, 0, workerMain, &worker, 0, 0
+        ) );
+        if ( worker._thread == 0 ) {
+            break;
+        }
+    }
+    // Shrinking doesn't move the workers already started.
+    for ( i = nbStarted; i < nbWorkers; ++i ) {
+        ::CloseHandle( _workers[ i ]._startEvent );
+    }
+    _workers.resize( nbStarted );
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimThreadPool::Impl::getNbWorkers() const
+{
+    return _workers.size();
+}
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::Impl::~Impl()
+{
+    _quit = true;
+    UInt32 i;
+    for ( i = 0; i < _workers.size(); ++i ) {
+        ::SetEvent( _workers[ i ]._startEvent );
+    }
+    for ( i = 0; i < _workers.size(); ++i ) {
+        ::WaitForSingleObject( _workers[ i ]._thread, INFINITE );
+        ::CloseHandle( _workers[ i ]._thread );
+        ::CloseHandle( _workers[ i ]._startEvent );
+    }
+    ::CloseHandle( _doneEvent );
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::Impl::run( Task& task, UInt32 nbItems, bool dynamic )
+{
+    DGFX_ASSERT( _nbPending == 0 );
+    _task = &task;
+    _nbItems = nbItems;
+    _dynamic = dynamic;
+    _nextItem = 0;
+    _nbPending = _workers.size();
+    // SetEvent is a full memory barrier, publishing the fields above.
+    UInt32 i;
+    for ( i = 0; i < _workers.size(); ++i ) {
+        ::SetEvent( _workers[ i ]._startEvent );
+    }
+
+    process( 0 );
+
+    ::WaitForSingleObject( _doneEvent, INFINITE );
+    _task = 0;
+}
+
+//------------------------------------------------------------------------------
+
+unsigned __stdcall SimThreadPool::Impl::workerMain( void* arg )
+{
+    Worker* worker = static_cast<Worker*>( arg );
+    worker->_impl->workerLoop( worker->_threadIndex, worker->_startEvent );
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::Impl::workerLoop( UInt32 threadIndex, HANDLE startEvent )
+{
+    for ( ;; ) {
+        ::WaitForSingleObject( startEvent, INFINITE );
+        if ( _quit ) {
+            break;
+        }
+        process( threadIndex );
+        if ( ::InterlockedDecrement( &_nbPending ) == 0 ) {
+            ::SetEvent( _doneEvent );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::Impl::process( UInt32 threadIndex )
+{
+    if ( ! _dynamic ) {
+        UInt32 begin, end;
+        _pool.getRange( _nbItems, threadIndex, begin, end );
+        if ( begin < end ) {
+            _task->run( begin, end, threadIndex );
+        }
+        return;
+    }
+    for ( ;; ) {
+        const UInt32 item = ::InterlockedIncrement( &_nextItem ) - 1;
+        if ( item >= _nbItems ) {
+            break;
+        }
+        _task->run( item, item + 1, threadIndex );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimThreadPool
+
+//------------------------------------------------------------------------------
+
+UInt32 SimThreadPool::getNbProcessors()
+{
+    SYSTEM_INFO info;
+    ::GetSystemInfo( &info );
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::SimThreadPool( UInt32 nbThreads )
+  : _nbThreads( nbThreads ),
+    _impl( 0 )
+{
+    DGFX_ASSERT( nbThreads > 0 );
+    if ( nbThreads > 1 ) {
+        _impl = new Impl( *this );
+        // Make do with the workers that could be started, if any.
+        _nbThreads = _impl->getNbWorkers() + 1;
+        if ( _nbThreads == 1 ) {
+            delete _impl;
+            _impl = 0;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+SimThreadPool::~SimThreadPool()
+{
+    delete _impl;
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::run( Task& task, UInt32 nbItems )
+{
+    // Not worth waking the workers for a single item.
+    if ( _impl == 0 || nbItems < 2 ) {
+        if ( nbItems > 0 ) {
+            task.run( 0, nbItems, 0 );
+        }
+        return;
+    }
+    _impl->run( task, nbItems, false );
+}
+
+//------------------------------------------------------------------------------
+
+void SimThreadPool::runDynamic( Task& task, UInt32 nbItems )
+{
+    if ( _impl == 0 || nbItems < 2 ) {
+        if ( nbItems > 0 ) {
+            task.run( 0, nbItems, 0 );
+        }
+        return;
+    }
+    _impl->run( task, nbItems, true );
+}
+
+FREECLOTH_NAMESPACE_END
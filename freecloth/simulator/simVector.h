@@ -94,6 +94,9 @@ public:
     SimVector& plusEqualsScaled( Float, const SimVector& );
 
     Float dot( const SimVector& ) const;
+    //! Dot product with every product and sum evaluated in double
+    //! precision, for reductions over long vectors.
+    Double dotDouble( const SimVector& ) const;
     Float length() const;
 
     const GeVector& operator[]( UInt32 ) const;
@@ -101,6 +104,8 @@ public:
 
     // Set to zero
     void clear();
+    //! Exchange contents with another vector, without copying.
+    void swap( SimVector& );
 
 private:
 
@@ -234,6 +234,18 @@ inline Float SimVector::dot( const SimVector& rhs ) const
 
 //------------------------------------------------------------------------------
 
+inline Double SimVector::dotDouble( const SimVector& rhs ) const
+{
+    DGFX_ASSERT( size() == rhs.size() );
+    Double result = 0;
+    for ( const_iterator i = begin(), j = rhs.begin(); i != end(); ++i, ++j ) {
+        result += i->dotDouble( *j );
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
 inline Float SimVector::length() const
 {
     Float sum = 0;
@@ -266,6 +278,13 @@ inline void SimVector::clear()
     std::fill( begin(), end(), GeVector::ZERO );
 }
 
+//------------------------------------------------------------------------------
+
+inline void SimVector::swap( SimVector& rhs )
+{
+    _data.swap( rhs._data );
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // GLOBAL FUNCTIONS
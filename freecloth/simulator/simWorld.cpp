@@ -0,0 +1,274 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#include <freecloth/simulator/simWorld.h>
+#include <freecloth/simulator/simSimulator.h>
+#include <freecloth/simulator/simStepStrategy.h>
+#include <freecloth/simulator/simThreadPool.h>
+#include <freecloth/geom/geMesh.h>
+#include <freecloth/base/baTime.h>
+#include <freecloth/base/algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+// LOCAL DECLARATIONS
+
+namespace {
+    using namespace freecloth;
+
+    ////////////////////////////////////////////////////////////////////////////
+    //! Sort key for scheduling: untimed entries first, then decreasing
+    //! expected cost, then index, so the order is reproducible.
+    class Priority
+    {
+    public:
+        bool operator<( const Priority& rhs ) const
+        {
+            if ( _timed != rhs._timed ) {
+                return ! _timed;
+            }
+            if ( _cost != rhs._cost ) {
+                return _cost > rhs._cost;
+            }
+            return _index < rhs._index;
+        }
+
+        bool    _timed;
+        Float   _cost;
+        UInt32  _index;
+    };
+}
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimWorld::AdvanceTask
+
+/*!
+ * Steps one entry per item, in the order given by _order, reached through
+ * the world.
+ */
+class SimWorld::AdvanceTask : public SimThreadPool::Task
+{
+public:
+    AdvanceTask( SimWorld& world, UInt32 frame )
+      : _world( world ),
+        _frame( frame )
+    {
+    }
+
+    virtual void run( UInt32 begin, UInt32 end, UInt32 )
+    {
+        for ( UInt32 i = begin; i < end; ++i ) {
+            Entry& entry = _world._entries[ _world._order[ i ] ];
+            const UInt32 nbFrames = _frame - entry._frame;
+            const BaTime::Instant start = BaTime::getTime();
+            while ( entry._frame < _frame ) {
+                entry._strategy->step();
+                ++entry._frame;
+            }
+            entry._frameCost = BaTime::durationAsSeconds(
+                BaTime::getDuration( start, BaTime::getTime() )
+            ) / nbFrames;
+        }
+    }
+
+private:
+    SimWorld&       _world;
+    const UInt32    _frame;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimWorld::Entry
+
+//------------------------------------------------------------------------------
+
+SimWorld::Entry::Entry(
+    const RCShdPtr<Simulator>& simulator,
+    const RCShdPtr<StepStrategy>& strategy
+) : _simulator( simulator ),
+    _strategy( strategy ),
+    _frame( 0 ),
+    _frameCost( 0 )
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CLASS SimWorld
+
+//------------------------------------------------------------------------------
+
+SimWorld::SimWorld()
+  : _threadPool( new SimThreadPool( 1 ) ),
+    _advanceTime( 0 )
+{
+}
+
+//------------------------------------------------------------------------------
+
+SimWorld::~SimWorld()
+{
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimWorld::addSimulator(
+    const RCShdPtr<Simulator>& simulator,
+    const RCShdPtr<StepStrategy>& strategy
+) {
+    DGFX_ASSERT( ! simulator.isNull() && ! strategy.isNull() );
+    _entries.push_back( Entry( simulator, strategy ) );
+    return _entries.size() - 1;
+}
+
+//------------------------------------------------------------------------------
+
+void SimWorld::removeAllSimulators()
+{
+    _entries.clear();
+    _order.clear();
+}
+
+//------------------------------------------------------------------------------
+
+void SimWorld::setNbThreads( UInt32 nbThreads )
+{
+    DGFX_ASSERT( nbThreads > 0 );
+    if ( nbThreads != getNbThreads() ) {
+        _threadPool = RCShdPtr<SimThreadPool>( new SimThreadPool( nbThreads ) );
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimWorld::advanceToFrame( UInt32 frame )
+{
+    const BaTime::Instant start = BaTime::getTime();
+    orderByCost( frame );
+    AdvanceTask task( *this, frame );
+    _threadPool->runDynamic( task, _order.size() );
+    _advanceTime = BaTime::durationAsSeconds(
+        BaTime::getDuration( start, BaTime::getTime() )
+    );
+}
+
+//------------------------------------------------------------------------------
+
+void SimWorld::step()
+{
+    UInt32 frame = 0;
+    for ( UInt32 i = 0; i < _entries.size(); ++i ) {
+        frame = std::max( frame, _entries[ i ]._frame );
+    }
+    advanceToFrame( frame + 1 );
+}
+
+//------------------------------------------------------------------------------
+
+void SimWorld::rewind()
+{
+    for ( UInt32 i = 0; i < _entries.size(); ++i ) {
+        _entries[ i ]._strategy->rewind();
+        _entries[ i ]._frame = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void SimWorld::orderByCost( UInt32 frame )
+{
+    std::vector<Priority> priorities;
+    priorities.reserve( _entries.size() );
+    for ( UInt32 i = 0; i < _entries.size(); ++i ) {
+        const Entry& entry = _entries[ i ];
+        if ( entry._frame >= frame ) {
+            continue;
+        }
+        const UInt32 nbFrames = frame - entry._frame;
+        Priority p;
+        // Untimed entries are compared by mesh size instead.
+        p._timed = entry._frameCost > 0;
+        p._cost = nbFrames * ( p._timed
+            ? entry._frameCost
+            : entry._simulator->getMesh().getNbVertices()
+        );
+        p._index = i;
+        priorities.push_back( p );
+    }
+    std::sort( priorities.begin(), priorities.end() );
+
+    _order.resize( priorities.size() );
+    for ( UInt32 i = 0; i < priorities.size(); ++i ) {
+        _order[ i ] = priorities[ i ]._index;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimWorld::getNbThreads() const
+{
+    return _threadPool->getNbThreads();
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimWorld::getNbSimulators() const
+{
+    return _entries.size();
+}
+
+//------------------------------------------------------------------------------
+
+const RCShdPtr<SimSimulator>& SimWorld::getSimulator( UInt32 index ) const
+{
+    DGFX_ASSERT( index < _entries.size() );
+    return _entries[ index ]._simulator;
+}
+
+//------------------------------------------------------------------------------
+
+const RCShdPtr<SimStepStrategy>& SimWorld::getStepStrategy(
+    UInt32 index
+) const {
+    DGFX_ASSERT( index < _entries.size() );
+    return _entries[ index ]._strategy;
+}
+
+//------------------------------------------------------------------------------
+
+UInt32 SimWorld::getFrame( UInt32 index ) const
+{
+    DGFX_ASSERT( index < _entries.size() );
+    return _entries[ index ]._frame;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimWorld::getFrameCost( UInt32 index ) const
+{
+    DGFX_ASSERT( index < _entries.size() );
+    return _entries[ index ]._frameCost;
+}
+
+//------------------------------------------------------------------------------
+
+Float SimWorld::getAdvanceTime() const
+{
+    return _advanceTime;
+}
+
+FREECLOTH_NAMESPACE_END
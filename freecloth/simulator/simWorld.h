@@ -0,0 +1,172 @@
+//////////////////////////////////////////////////////////////////////
+// Copyright (c) 2003 David Pritchard <drpritch@alumni.uwaterloo.ca>
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation; either
+// version 2 of the License, or (at your option) any later
+// version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+
+#ifndef freecloth_sim_simWorld_h
+#define freecloth_sim_simWorld_h
+
+#ifndef freecloth_simulator_package_h
+#include <freecloth/simulator/package.h>
+#endif
+
+#ifndef freecloth_resmgt_rcBase_h
+#include <freecloth/resmgt/rcBase.h>
+#endif
+
+#ifndef freecloth_resmgt_rcShdPtr_h
+#include <freecloth/resmgt/rcShdPtr.h>
+#endif
+
+#ifndef freecloth_base_vector
+#include <freecloth/base/vector>
+#endif
+
+FREECLOTH_NAMESPACE_START
+
+////////////////////////////////////////////////////////////////////////////////
+// FORWARD DECLARATIONS
+
+class SimSimulator;
+class SimStepStrategy;
+class SimThreadPool;
+
+////////////////////////////////////////////////////////////////////////////////
+/*!
+ * \class SimWorld freecloth/simulator/simWorld.h
+ * \brief Steps many independent simulators concurrently.
+ *
+ * A world holds any number of simulators, each with the step strategy that
+ * drives it, and advances them all to a common frame on a shared thread
+ * pool. A frame is one SimStepStrategy::step(), so with an adaptive
+ * strategy it may take any number of simulator steps, and the cost of a
+ * frame varies widely between simulators and over time.
+ *
+ * Each simulator is advanced to the target frame by a single thread, and
+ * threads take simulators as they become free, so a simulator that needs
+ * many small steps holds up only the thread it's on. To keep the last
+ * simulators to finish from leaving the other threads idle, simulators are
+ * started in decreasing order of expected cost, estimated from the time
+ * each took per frame in the previous advance. Simulators not yet timed are
+ * started first, largest mesh first.
+ *
+ * The simulators share no data, so the results don't depend upon the
+ * number of threads or the order of stepping. Each simulator's own thread
+ * count still applies within its steps; when the world has as many
+ * threads as there are processors, leave the simulators single-threaded.
+ *
+ * Simulators and strategies may not be stepped or changed by other means
+ * while the world is advancing them.
+ */
+class SimWorld : public RCBase
+{
+public:
+    // ----- types and enumerations -----
+
+    typedef SimSimulator Simulator;
+    typedef SimStepStrategy StepStrategy;
+
+    // ----- member functions -----
+
+    SimWorld();
+    virtual ~SimWorld();
+
+    //! Add a simulator, driven by the given strategy, which must have been
+    //! created for it. The simulator starts at frame zero. Returns its
+    //! index.
+    UInt32 addSimulator(
+        const RCShdPtr<Simulator>&,
+        const RCShdPtr<StepStrategy>&
+    );
+    void removeAllSimulators();
+
+    //! Number of threads used to step the simulators, including the
+    //! calling thread. Defaults to 1.
+    void setNbThreads( UInt32 );
+
+    //! Step every simulator that is behind the given frame until it gets
+    //! there, and wait until all are done.
+    void advanceToFrame( UInt32 frame );
+    //! Advance every simulator by one frame past the furthest along.
+    void step();
+    //! Rewind every strategy, and so every simulator, to frame zero. The
+    //! cost estimates are kept.
+    void rewind();
+
+    //@{
+    //! Accessor
+    UInt32 getNbThreads() const;
+    UInt32 getNbSimulators() const;
+    const RCShdPtr<Simulator>& getSimulator( UInt32 index ) const;
+    const RCShdPtr<StepStrategy>& getStepStrategy( UInt32 index ) const;
+    //! Number of frames the given simulator has been stepped since it was
+    //! added or rewound.
+    UInt32 getFrame( UInt32 index ) const;
+    //! Wall-clock seconds per frame taken by the given simulator in the
+    //! last advance that stepped it, or 0 if it hasn't been stepped yet.
+    Float getFrameCost( UInt32 index ) const;
+    //! Wall-clock seconds taken by the last advanceToFrame().
+    Float getAdvanceTime() const;
+    //@}
+
+private:
+    // ----- classes -----
+
+    ////////////////////////////////////////////////////////////////////////////
+    /*!
+     * \class Entry freecloth/simulator/simWorld.h
+     * \brief A simulator, its strategy, and its stepping history.
+     */
+    class Entry
+    {
+    public:
+        Entry(
+            const RCShdPtr<Simulator>&,
+            const RCShdPtr<StepStrategy>&
+        );
+
+        RCShdPtr<Simulator>     _simulator;
+        RCShdPtr<StepStrategy>  _strategy;
+        UInt32                  _frame;
+        Float                   _frameCost;
+    };
+
+    //! Internal class used to step the entries on the pool.
+    class AdvanceTask;
+    friend class AdvanceTask;
+
+    // ----- member functions -----
+
+    // Worlds are shared, not copied.
+    SimWorld( const SimWorld& );
+    SimWorld& operator=( const SimWorld& );
+
+    //! Fill _order with the entries behind the given frame, costliest
+    //! first.
+    void orderByCost( UInt32 frame );
+
+    // ----- data members -----
+
+    std::vector<Entry>      _entries;
+    //! Indices into _entries, in the order they're handed to the pool.
+    std::vector<UInt32>     _order;
+    RCShdPtr<SimThreadPool> _threadPool;
+    Float                   _advanceTime;
+};
+
+FREECLOTH_NAMESPACE_END
+
+#endif